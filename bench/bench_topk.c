@@ -0,0 +1,121 @@
+/*
+ * bench_topk.c
+ * Microbenchmark for the top-k collector used by the scan modules.
+ *
+ * Compares the bounded max-heap in vector-topk.h with the previous linear
+ * max-slot strategy (O(k) rescan on every accepted candidate followed by an
+ * O(k^2) exchange sort) across k from 1 to 10000.
+ * Usage: make bench-topk
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vector-topk.h"
+
+/* ---------- Reference: linear max-slot top-k ---------- */
+
+static int linear_find_max (const double *values, int n) {
+    int max_idx = 0;
+    for (int i = 1; i < n; ++i) {
+        if (values[i] > values[max_idx]) max_idx = i;
+    }
+    return max_idx;
+}
+
+static int linear_topk (const double *input, int n, int k, double *distance, int64_t *rowids) {
+    for (int i = 0; i < k; ++i) distance[i] = INFINITY;
+    int max_index = 0;
+    for (int i = 0; i < n; ++i) {
+        if (input[i] < distance[max_index]) {
+            distance[max_index] = input[i];
+            rowids[max_index] = i;
+            max_index = linear_find_max(distance, k);
+        }
+    }
+
+    int counter = 0;
+    for (int i = 0; i < k - 1; ++i) {
+        if (distance[i] == INFINITY) ++counter;
+        for (int j = i + 1; j < k; ++j) {
+            if (distance[j] < distance[i]) {
+                double td = distance[i]; distance[i] = distance[j]; distance[j] = td;
+                int64_t tr = rowids[i]; rowids[i] = rowids[j]; rowids[j] = tr;
+            }
+        }
+    }
+    if (distance[k - 1] == INFINITY) ++counter;
+    return k - counter;
+}
+
+/* ---------- Heap ---------- */
+
+static int heap_topk (const double *input, int n, int k, double *distance, int64_t *rowids) {
+    vector_topk t;
+    vector_topk_init(&t, distance, rowids, k);
+    double threshold = vector_topk_threshold(&t);
+    for (int i = 0; i < n; ++i) {
+        if (input[i] <= threshold) {
+            vector_topk_push(&t, input[i], i);
+            threshold = vector_topk_threshold(&t);
+        }
+    }
+    return vector_topk_sort(&t);
+}
+
+/* ---------- Driver ---------- */
+
+static double now_ms (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+typedef int (*topk_fn)(const double *, int, int, double *, int64_t *);
+
+static double run (topk_fn fn, const double *input, int n, int k, double *distance, int64_t *rowids, int *count) {
+    double start = now_ms();
+    *count = fn(input, n, k, distance, rowids);
+    return now_ms() - start;
+}
+
+static void bench (const char *label, const double *input, int n) {
+    const int ks[] = {1, 10, 100, 500, 1000, 2000, 10000};
+    double *d1 = malloc(10000 * sizeof(double)), *d2 = malloc(10000 * sizeof(double));
+    int64_t *r1 = malloc(10000 * sizeof(int64_t)), *r2 = malloc(10000 * sizeof(int64_t));
+
+    printf("\n%s (n=%d)\n", label, n);
+    printf("%8s %14s %14s %10s %8s\n", "k", "linear (ms)", "heap (ms)", "speedup", "match");
+    for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); ++i) {
+        int k = ks[i], c1 = 0, c2 = 0;
+        double t1 = run(linear_topk, input, n, k, d1, r1, &c1);
+        double t2 = run(heap_topk, input, n, k, d2, r2, &c2);
+
+        int match = (c1 == c2);
+        for (int j = 0; match && j < c1; ++j) match = (d1[j] == d2[j]);
+        printf("%8d %14.3f %14.3f %9.1fx %8s\n", k, t1, t2, (t2 > 0) ? t1 / t2 : 0.0, match ? "yes" : "NO");
+    }
+
+    free(d1); free(d2); free(r1); free(r2);
+}
+
+int main (int argc, char **argv) {
+    int n = (argc > 1) ? atoi(argv[1]) : 1000000;
+    if (n <= 0) n = 1000000;
+
+    double *input = malloc((size_t)n * sizeof(double));
+    if (!input) return 1;
+
+    srand(42);
+    for (int i = 0; i < n; ++i) input[i] = (double)rand() / RAND_MAX;
+    bench("random order", input, n);
+
+    // worst case: every candidate improves the current top-k
+    int nd = (n > 100000) ? 100000 : n;
+    for (int i = 0; i < nd; ++i) input[i] = (double)(nd - i);
+    bench("descending order", input, nd);
+
+    free(input);
+    return 0;
+}
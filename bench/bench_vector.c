@@ -0,0 +1,471 @@
+/*
+ * bench_vector.c
+ * End-to-end benchmark of the SQLite Vector extension.
+ *
+ * Builds a table from a synthetic or an fvecs/bvecs dataset, times vector_init, vector_quantize and
+ * vector_quantize_preload, then runs vector_full_scan and vector_quantize_scan at several k, comparing
+ * the backend picked at runtime by init_distance_functions with the portable CPU kernels.
+ * Reports QPS, p50/p99 latencies and recall@k against the full scan ground truth as CSV or JSON.
+ *
+ * Compiled with -DSQLITE_CORE so sqlite3_vector_init links statically.
+ * Usage: make bench BENCH_ARGS="--n 100000 --dim 128 --k 1,10,100 --format json"
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <time.h>
+#include "sqlite3.h"
+#include "sqlite-vector.h"
+#include "distance-cpu.h"
+
+#define BENCH_MAX_K             8               // k values measured in a single run
+#define BENCH_MAX_RESULTS       256
+#define BENCH_CLUSTERS          64              // synthetic vectors are spread around this many centers
+
+typedef struct {
+    int             n;                          // vectors in the table
+    int             dim;
+    int             nq;                         // queries
+    int             ks[BENCH_MAX_K];
+    int             nk;
+    const char      *type;                      // f32, f16, bf16, i8, u8
+    const char      *distance;
+    const char      *quantize;                  // vector_quantize options
+    const char      *scan;                      // vector_quantize_scan options
+    const char      *data_path;                 // fvecs or bvecs file (NULL = synthetic)
+    const char      *query_path;                // queries file (NULL = the last nq vectors of the dataset)
+    const char      *db_path;
+    const char      *backends;                  // all, native or cpu
+    const char      *out_path;                  // NULL = stdout
+    bool            json;
+    unsigned int    seed;
+} bench_config;
+
+typedef struct {
+    char            backend[32];
+    char            operation[32];
+    int             k;
+    int             queries;
+    double          total_ms;
+    double          qps;
+    double          p50_ms;
+    double          p99_ms;
+    double          recall;                     // negative if not measured
+} bench_result;
+
+static bench_result results[BENCH_MAX_RESULTS];
+static int nresults = 0;
+
+/* ---------- Helpers ---------- */
+
+static double now_ms (void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+static unsigned int rnd_state = 42;
+static float rnd_uniform (void) {
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return (float)((rnd_state >> 8) & 0xFFFF) / 65535.0f;
+}
+
+static int exec_sql (sqlite3 *db, const char *sql) {
+    char *err = NULL;
+    int rc = sqlite3_exec(db, sql, NULL, NULL, &err);
+    if (rc != SQLITE_OK) {
+        fprintf(stderr, "SQL error (%d): %s\nStatement: %s\n", rc, err ? err : "unknown", sql);
+        sqlite3_free(err);
+    }
+    return rc;
+}
+
+static bench_result *add_result (const char *backend, const char *operation, int k, int queries, double total_ms) {
+    if (nresults == BENCH_MAX_RESULTS) return NULL;
+    bench_result *r = &results[nresults++];
+    memset(r, 0, sizeof(bench_result));
+    snprintf(r->backend, sizeof(r->backend), "%s", backend);
+    snprintf(r->operation, sizeof(r->operation), "%s", operation);
+    r->k = k;
+    r->queries = queries;
+    r->total_ms = total_ms;
+    r->recall = -1.0;
+    return r;
+}
+
+static int compare_double (const void *a, const void *b) {
+    double d1 = *(const double *)a, d2 = *(const double *)b;
+    return (d1 > d2) - (d1 < d2);
+}
+
+static double percentile (const double *sorted, int n, double p) {
+    // nearest rank
+    if (n == 0) return 0.0;
+    int i = (int)ceil(p / 100.0 * n) - 1;
+    if (i < 0) i = 0;
+    if (i >= n) i = n - 1;
+    return sorted[i];
+}
+
+/* ---------- Datasets ---------- */
+
+static float *load_vecs (const char *path, int max_n, int *dim, int *count) {
+    // fvecs: (int32 d, d float32) records, bvecs: (int32 d, d uint8) records
+    const char *ext = strrchr(path, '.');
+    bool bytes = (ext && strcasecmp(ext, ".bvecs") == 0);
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {fprintf(stderr, "Unable to open %s\n", path); return NULL;}
+
+    int32_t d = 0;
+    if (fread(&d, sizeof(d), 1, f) != 1 || d <= 0 || d > 65536) {fprintf(stderr, "Invalid header in %s\n", path); fclose(f); return NULL;}
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    size_t record = sizeof(int32_t) + (size_t)d * (bytes ? 1 : sizeof(float));
+    int n = (int)(size / (long)record);
+    if (max_n > 0 && n > max_n) n = max_n;
+
+    float *data = (float *)malloc((size_t)n * d * sizeof(float));
+    uint8_t *buffer = (uint8_t *)malloc(record);
+    if (!data || !buffer) {free(data); free(buffer); fclose(f); return NULL;}
+
+    for (int i = 0; i < n; ++i) {
+        if (fread(buffer, record, 1, f) != 1) {n = i; break;}
+        float *v = data + (size_t)i * d;
+        if (bytes) for (int j = 0; j < d; ++j) v[j] = (float)buffer[sizeof(int32_t) + j];
+        else memcpy(v, buffer + sizeof(int32_t), (size_t)d * sizeof(float));
+    }
+
+    free(buffer);
+    fclose(f);
+    *dim = d;
+    *count = n;
+    return data;
+}
+
+static float *synthetic_vecs (const char *type, int n, int dim, const float *centers) {
+    // clustered vectors in the natural range of the type (so that recall is meaningful)
+    float lo = -1.0f, hi = 1.0f;
+    if (strcasecmp(type, "u8") == 0) {lo = 0.0f; hi = 255.0f;}
+    else if (strcasecmp(type, "i8") == 0) {lo = -127.0f; hi = 127.0f;}
+
+    float *data = (float *)malloc((size_t)n * dim * sizeof(float));
+    if (!data) return NULL;
+    for (int i = 0; i < n; ++i) {
+        const float *c = centers + (size_t)(rnd_state % BENCH_CLUSTERS) * dim;
+        for (int j = 0; j < dim; ++j) {
+            float x = c[j] + (rnd_uniform() - 0.5f) * 0.5f;
+            data[(size_t)i * dim + j] = lo + (x < 0.0f ? 0.0f : x > 1.0f ? 1.0f : x) * (hi - lo);
+        }
+    }
+    return data;
+}
+
+static size_t encode_vector (const char *type, const float *v, int dim, uint8_t *out) {
+    // returns the BLOB size of v in the column type
+    if (strcasecmp(type, "f16") == 0 || strcasecmp(type, "bf16") == 0) {
+        bool half = (strcasecmp(type, "f16") == 0);
+        for (int j = 0; j < dim; ++j) {
+            uint16_t h = (half) ? float32_to_float16(v[j]) : float32_to_bfloat16(v[j]);
+            memcpy(out + (size_t)j * sizeof(h), &h, sizeof(h));
+        }
+        return (size_t)dim * sizeof(uint16_t);
+    }
+    if (strcasecmp(type, "u8") == 0) {
+        for (int j = 0; j < dim; ++j) out[j] = (uint8_t)fminf(fmaxf(roundf(v[j]), 0.0f), 255.0f);
+        return (size_t)dim;
+    }
+    if (strcasecmp(type, "i8") == 0) {
+        for (int j = 0; j < dim; ++j) out[j] = (uint8_t)(int8_t)fminf(fmaxf(roundf(v[j]), -128.0f), 127.0f);
+        return (size_t)dim;
+    }
+    memcpy(out, v, (size_t)dim * sizeof(float));
+    return (size_t)dim * sizeof(float);
+}
+
+/* ---------- Measurements ---------- */
+
+static int build_table (sqlite3 *db, const bench_config *cfg, const float *data, int n) {
+    char sql[512];
+    if (exec_sql(db, "DROP TABLE IF EXISTS bench; CREATE TABLE bench (id INTEGER PRIMARY KEY, v BLOB);") != SQLITE_OK) return -1;
+
+    uint8_t *blob = (uint8_t *)malloc((size_t)cfg->dim * sizeof(float));
+    sqlite3_stmt *stmt = NULL;
+    if (!blob || sqlite3_prepare_v2(db, "INSERT INTO bench (id, v) VALUES (?1, ?2);", -1, &stmt, NULL) != SQLITE_OK) {free(blob); return -1;}
+
+    double start = now_ms();
+    exec_sql(db, "BEGIN;");
+    for (int i = 0; i < n; ++i) {
+        size_t size = encode_vector(cfg->type, data + (size_t)i * cfg->dim, cfg->dim, blob);
+        sqlite3_bind_int(stmt, 1, i + 1);
+        sqlite3_bind_blob(stmt, 2, blob, (int)size, SQLITE_STATIC);
+        if (sqlite3_step(stmt) != SQLITE_DONE) {fprintf(stderr, "INSERT failed: %s\n", sqlite3_errmsg(db)); break;}
+        sqlite3_reset(stmt);
+    }
+    exec_sql(db, "COMMIT;");
+    add_result("", "insert", 0, n, now_ms() - start);
+    sqlite3_finalize(stmt);
+    free(blob);
+
+    snprintf(sql, sizeof(sql), "SELECT vector_init('bench', 'v', 'type=%s,dimension=%d,distance=%s');", cfg->type, cfg->dim, cfg->distance);
+    start = now_ms();
+    if (exec_sql(db, sql) != SQLITE_OK) return -1;
+    add_result("", "vector_init", 0, 0, now_ms() - start);
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('bench', 'v', '%s');", cfg->quantize);
+    start = now_ms();
+    if (exec_sql(db, sql) != SQLITE_OK) return -1;
+    add_result("", "vector_quantize", 0, 0, now_ms() - start);
+    return 0;
+}
+
+static int run_queries (sqlite3 *db, const bench_config *cfg, const char *backend, const char *operation, const char *module, int k, const uint8_t *queries, size_t qsize, int64_t *found, const int64_t *truth, int kmax) {
+    // runs every query with the given module and k, found receives nq x kmax rowids (if not NULL)
+    char sql[512];
+    bool quantized = (strcmp(module, "vector_quantize_scan") == 0);
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM %s('bench', 'v', ?1, ?2%s%s%s);", module, (quantized && cfg->scan[0]) ? ", '" : "", (quantized) ? cfg->scan : "", (quantized && cfg->scan[0]) ? "'" : "");
+
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Unable to prepare %s: %s\n", sql, sqlite3_errmsg(db));
+        return -1;
+    }
+
+    double *latency = (double *)malloc((size_t)cfg->nq * sizeof(double));
+    if (!latency) {sqlite3_finalize(stmt); return -1;}
+
+    double hits = 0.0;
+    double start = now_ms();
+    for (int q = 0; q < cfg->nq; ++q) {
+        double t0 = now_ms();
+        sqlite3_bind_blob(stmt, 1, queries + (size_t)q * qsize, (int)qsize, SQLITE_STATIC);
+        sqlite3_bind_int(stmt, 2, k);
+        int count = 0;
+        int64_t rowids[4096];
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            if (count < k && count < 4096) rowids[count] = sqlite3_column_int64(stmt, 0);
+            ++count;
+        }
+        sqlite3_reset(stmt);
+        latency[q] = now_ms() - t0;
+
+        if (found) for (int i = 0; i < k && i < kmax; ++i) found[(size_t)q * kmax + i] = (i < count) ? rowids[i] : -1;
+        if (truth) {
+            // recall@k: fraction of the k exact nearest neighbors returned
+            for (int i = 0; i < count && i < k; ++i) {
+                for (int j = 0; j < k; ++j) if (truth[(size_t)q * kmax + j] == rowids[i]) {hits += 1.0; break;}
+            }
+        }
+    }
+    double total = now_ms() - start;
+
+    qsort(latency, (size_t)cfg->nq, sizeof(double), compare_double);
+    bench_result *r = add_result(backend, operation, k, cfg->nq, total);
+    if (r) {
+        r->qps = (total > 0.0) ? cfg->nq * 1000.0 / total : 0.0;
+        r->p50_ms = percentile(latency, cfg->nq, 50.0);
+        r->p99_ms = percentile(latency, cfg->nq, 99.0);
+        if (truth) r->recall = hits / ((double)cfg->nq * k);
+    }
+
+    free(latency);
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+/* ---------- Report ---------- */
+
+static void report (const bench_config *cfg) {
+    FILE *out = (cfg->out_path) ? fopen(cfg->out_path, "w") : stdout;
+    if (!out) {fprintf(stderr, "Unable to write %s\n", cfg->out_path); out = stdout;}
+
+    if (cfg->json) {
+        fprintf(out, "{\"n\": %d, \"dim\": %d, \"type\": \"%s\", \"distance\": \"%s\", \"quantize\": \"%s\", \"scan\": \"%s\", \"results\": [\n", cfg->n, cfg->dim, cfg->type, cfg->distance, cfg->quantize, cfg->scan);
+        for (int i = 0; i < nresults; ++i) {
+            const bench_result *r = &results[i];
+            fprintf(out, "  {\"backend\": \"%s\", \"operation\": \"%s\", \"k\": %d, \"queries\": %d, \"total_ms\": %.3f, \"qps\": %.1f, \"p50_ms\": %.4f, \"p99_ms\": %.4f, ", r->backend, r->operation, r->k, r->queries, r->total_ms, r->qps, r->p50_ms, r->p99_ms);
+            if (r->recall >= 0.0) fprintf(out, "\"recall\": %.4f}", r->recall);
+            else fprintf(out, "\"recall\": null}");
+            fprintf(out, "%s\n", (i + 1 < nresults) ? "," : "");
+        }
+        fprintf(out, "]}\n");
+    } else {
+        fprintf(out, "backend,operation,k,queries,total_ms,qps,p50_ms,p99_ms,recall\n");
+        for (int i = 0; i < nresults; ++i) {
+            const bench_result *r = &results[i];
+            fprintf(out, "%s,%s,%d,%d,%.3f,%.1f,%.4f,%.4f,", r->backend, r->operation, r->k, r->queries, r->total_ms, r->qps, r->p50_ms, r->p99_ms);
+            if (r->recall >= 0.0) fprintf(out, "%.4f\n", r->recall);
+            else fprintf(out, "\n");
+        }
+    }
+
+    if (out != stdout) fclose(out);
+}
+
+/* ---------- Driver ---------- */
+
+static void usage (void) {
+    printf("Usage: bench_vector [options]\n");
+    printf("  --n N              vectors in the table (default 20000)\n");
+    printf("  --dim D            dimension of the synthetic vectors (default 128)\n");
+    printf("  --queries Q        number of queries (default 200)\n");
+    printf("  --k LIST           comma separated k values (default 1,10,100)\n");
+    printf("  --type T           f32, f16, bf16, i8 or u8 (default f32)\n");
+    printf("  --distance D       vector_init distance (default L2)\n");
+    printf("  --quantize OPTS    vector_quantize options (default qtype=UINT8)\n");
+    printf("  --scan OPTS        vector_quantize_scan options (default none)\n");
+    printf("  --data FILE        fvecs or bvecs dataset (default synthetic)\n");
+    printf("  --query-data FILE  fvecs or bvecs queries (default the last Q vectors of --data)\n");
+    printf("  --db PATH          database file (default :memory:)\n");
+    printf("  --backends B       all, native or cpu (default all)\n");
+    printf("  --format F         csv or json (default csv)\n");
+    printf("  --out FILE         report file (default stdout)\n");
+    printf("  --seed S           synthetic data seed (default 42)\n");
+}
+
+static int parse_args (int argc, char **argv, bench_config *cfg) {
+    for (int i = 1; i < argc; ++i) {
+        const char *key = argv[i];
+        if (strcmp(key, "--help") == 0 || strcmp(key, "-h") == 0) {usage(); exit(0);}
+        if (i + 1 >= argc) {fprintf(stderr, "Missing value for %s\n", key); return -1;}
+        const char *value = argv[++i];
+
+        if (strcmp(key, "--n") == 0) cfg->n = atoi(value);
+        else if (strcmp(key, "--dim") == 0) cfg->dim = atoi(value);
+        else if (strcmp(key, "--queries") == 0) cfg->nq = atoi(value);
+        else if (strcmp(key, "--type") == 0) cfg->type = value;
+        else if (strcmp(key, "--distance") == 0) cfg->distance = value;
+        else if (strcmp(key, "--quantize") == 0) cfg->quantize = value;
+        else if (strcmp(key, "--scan") == 0) cfg->scan = value;
+        else if (strcmp(key, "--data") == 0) cfg->data_path = value;
+        else if (strcmp(key, "--query-data") == 0) cfg->query_path = value;
+        else if (strcmp(key, "--db") == 0) cfg->db_path = value;
+        else if (strcmp(key, "--backends") == 0) cfg->backends = value;
+        else if (strcmp(key, "--out") == 0) cfg->out_path = value;
+        else if (strcmp(key, "--seed") == 0) cfg->seed = (unsigned int)strtoul(value, NULL, 10);
+        else if (strcmp(key, "--format") == 0) cfg->json = (strcasecmp(value, "json") == 0);
+        else if (strcmp(key, "--k") == 0) {
+            cfg->nk = 0;
+            for (const char *p = value; *p && cfg->nk < BENCH_MAX_K; p = strchr(p, ',') ? strchr(p, ',') + 1 : p + strlen(p)) {
+                int k = atoi(p);
+                if (k > 0 && k <= 4096) cfg->ks[cfg->nk++] = k;
+            }
+        } else {
+            fprintf(stderr, "Unknown option %s\n", key);
+            return -1;
+        }
+    }
+
+    if (cfg->n <= 0 || cfg->dim <= 0 || cfg->nq <= 0 || cfg->nk == 0) {fprintf(stderr, "Invalid n, dim, queries or k\n"); return -1;}
+    return 0;
+}
+
+int main (int argc, char **argv) {
+    bench_config cfg = {
+        .n = 20000, .dim = 128, .nq = 200, .ks = {1, 10, 100}, .nk = 3,
+        .type = "f32", .distance = "L2", .quantize = "qtype=UINT8", .scan = "",
+        .db_path = ":memory:", .backends = "all", .seed = 42
+    };
+    if (parse_args(argc, argv, &cfg) != 0) {usage(); return 1;}
+    rnd_state = cfg.seed;
+
+    // dataset and queries (as float32, encoded in the column type when bound)
+    float *data = NULL, *qdata = NULL;
+    if (cfg.data_path) {
+        int count = 0;
+        data = load_vecs(cfg.data_path, (cfg.query_path) ? cfg.n : cfg.n + cfg.nq, &cfg.dim, &count);
+        if (!data) return 1;
+        if (cfg.query_path) {
+            int qdim = 0, qcount = 0;
+            qdata = load_vecs(cfg.query_path, cfg.nq, &qdim, &qcount);
+            if (!qdata || qdim != cfg.dim) {fprintf(stderr, "Queries must have dimension %d\n", cfg.dim); return 1;}
+            cfg.nq = qcount;
+            cfg.n = count;
+        } else {
+            // the last nq vectors are held out as queries
+            if (count <= cfg.nq) {fprintf(stderr, "The dataset holds only %d vectors\n", count); return 1;}
+            cfg.n = count - cfg.nq;
+            qdata = data + (size_t)cfg.n * cfg.dim;
+        }
+    } else {
+        float *centers = (float *)malloc((size_t)BENCH_CLUSTERS * cfg.dim * sizeof(float));
+        if (!centers) return 1;
+        for (int i = 0; i < BENCH_CLUSTERS * cfg.dim; ++i) centers[i] = rnd_uniform();
+        data = synthetic_vecs(cfg.type, cfg.n + cfg.nq, cfg.dim, centers);
+        free(centers);
+        if (!data) return 1;
+        qdata = data + (size_t)cfg.n * cfg.dim;
+    }
+
+    size_t qsize = 0;
+    uint8_t *queries = (uint8_t *)malloc((size_t)cfg.nq * cfg.dim * sizeof(float));
+    if (!queries) return 1;
+    for (int q = 0; q < cfg.nq; ++q) qsize = encode_vector(cfg.type, qdata + (size_t)q * cfg.dim, cfg.dim, queries + (size_t)q * cfg.dim * sizeof(float));
+    if (qsize < (size_t)cfg.dim * sizeof(float)) {
+        // compact the encoded queries
+        for (int q = 1; q < cfg.nq; ++q) memmove(queries + (size_t)q * qsize, queries + (size_t)q * cfg.dim * sizeof(float), qsize);
+    }
+
+    sqlite3 *db = NULL;
+    if (sqlite3_open(cfg.db_path, &db) != SQLITE_OK || sqlite3_vector_init(db, NULL, NULL) != SQLITE_OK) {
+        fprintf(stderr, "Unable to open %s\n", cfg.db_path);
+        return 1;
+    }
+    if (build_table(db, &cfg, data, cfg.n) != 0) return 1;
+
+    // backends: the best one available (the default) and the portable CPU one
+    bool force[2] = {false, true};
+    int first = (strcasecmp(cfg.backends, "cpu") == 0) ? 1 : 0;
+    int last = (strcasecmp(cfg.backends, "native") == 0) ? 0 : 1;
+    char names[2][32] = {"", ""};
+    for (int b = first; b <= last; ++b) {
+        init_distance_functions(force[b]);
+        sqlite3_stmt *stmt = NULL;
+        if (sqlite3_prepare_v2(db, "SELECT vector_backend();", -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+            snprintf(names[b], sizeof(names[b]), "%s", (const char *)sqlite3_column_text(stmt, 0));
+        }
+        sqlite3_finalize(stmt);
+    }
+    // without SIMD support both backends are the same one
+    if (first != last && strcmp(names[0], names[1]) == 0) last = first;
+
+    // ground truth: exact top-kmax of every query with the first backend
+    int kmax = 0;
+    for (int i = 0; i < cfg.nk; ++i) if (cfg.ks[i] > kmax) kmax = cfg.ks[i];
+    int64_t *truth = (int64_t *)malloc((size_t)cfg.nq * kmax * sizeof(int64_t));
+    if (!truth) return 1;
+    init_distance_functions(force[first]);
+    if (run_queries(db, &cfg, names[first], "ground_truth", "vector_full_scan", kmax, queries, qsize, truth, NULL, kmax) != 0) return 1;
+
+    // full and quantized scans read from disk, then the quantized scans of the preloaded records
+    const char *operations[] = {"full_scan", "quantize_scan", "quantize_scan_preload"};
+    const char *modules[] = {"vector_full_scan", "vector_quantize_scan", "vector_quantize_scan"};
+    for (int o = 0; o < 3; ++o) {
+        if (o == 2) {
+            double start = now_ms();
+            if (exec_sql(db, "SELECT vector_quantize_preload('bench', 'v');") != SQLITE_OK) return 1;
+            add_result("", "vector_quantize_preload", 0, 0, now_ms() - start);
+        }
+        for (int b = first; b <= last; ++b) {
+            init_distance_functions(force[b]);
+            for (int i = 0; i < cfg.nk; ++i) {
+                if (run_queries(db, &cfg, names[b], operations[o], modules[o], cfg.ks[i], queries, qsize, NULL, truth, kmax) != 0) return 1;
+            }
+        }
+    }
+
+    report(&cfg);
+
+    init_distance_functions(false);
+    sqlite3_close(db);
+    free(truth);
+    free(queries);
+    if (qdata && (qdata < data || qdata >= data + (size_t)(cfg.n + cfg.nq) * cfg.dim)) free(qdata);
+    free(data);
+    return 0;
+}
@@ -14,6 +14,8 @@
 #include <math.h>
 
 extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern quantize_functions dispatch_quantize_table;
 extern const char *distance_backend_name;
 
 #define _mm256_abs_ps(x) _mm256_andnot_ps(_mm256_set1_ps(-0.0f), (x))
@@ -425,15 +427,15 @@ static inline float bfloat16_distance_l2_impl_avx2 (const void *v1, const void *
     return use_sqrt ? (float)sqrt(sum) : (float)sum;
 }
 
-float bfloat16_distance_l2_avx2 (const void *v1, const void *v2, int n) {
+static float bfloat16_distance_l2_checked_avx2 (const void *v1, const void *v2, int n) {
     return bfloat16_distance_l2_impl_avx2(v1, v2, n, true);
 }
 
-float bfloat16_distance_l2_squared_avx2 (const void *v1, const void *v2, int n) {
+static float bfloat16_distance_l2_squared_checked_avx2 (const void *v1, const void *v2, int n) {
     return bfloat16_distance_l2_impl_avx2(v1, v2, n, false);
 }
 
-float bfloat16_distance_l1_avx2 (const void *v1, const void *v2, int n) {
+static float bfloat16_distance_l1_checked_avx2 (const void *v1, const void *v2, int n) {
     const uint16_t *a = (const uint16_t *)v1;
     const uint16_t *b = (const uint16_t *)v2;
 
@@ -492,7 +494,7 @@ float bfloat16_distance_l1_avx2 (const void *v1, const void *v2, int n) {
     return (float)sum;
 }
 
-float bfloat16_distance_dot_avx2 (const void *v1, const void *v2, int n) {
+static float bfloat16_distance_dot_checked_avx2 (const void *v1, const void *v2, int n) {
     const uint16_t *a = (const uint16_t *)v1;
     const uint16_t *b = (const uint16_t *)v2;
 
@@ -568,11 +570,11 @@ float bfloat16_distance_dot_avx2 (const void *v1, const void *v2, int n) {
     return (float)(-dot);
 }
 
-float bfloat16_distance_cosine_avx2 (const void *v1, const void *v2, int n) {
+static float bfloat16_distance_cosine_checked_avx2 (const void *v1, const void *v2, int n) {
     /* reuse dot routine like your original float32 version */
-    float dot    = -bfloat16_distance_dot_avx2(v1, v2, n);
-    float norm_a =  sqrtf(-bfloat16_distance_dot_avx2(v1, v1, n));
-    float norm_b =  sqrtf(-bfloat16_distance_dot_avx2(v2, v2, n));
+    float dot    = -bfloat16_distance_dot_checked_avx2(v1, v2, n);
+    float norm_a =  sqrtf(-bfloat16_distance_dot_checked_avx2(v1, v1, n));
+    float norm_b =  sqrtf(-bfloat16_distance_dot_checked_avx2(v2, v2, n));
 
     if (!(norm_a > 0.0f) || !(norm_b > 0.0f) || !isfinite(norm_a) || !isfinite(norm_b) || !isfinite(dot))
         return 1.0f;
@@ -583,6 +585,162 @@ float bfloat16_distance_cosine_avx2 (const void *v1, const void *v2, int n) {
     return 1.0f - cs;
 }
 
+// MARK: - FLOAT16/BFLOAT16 -
+// The kernels above check every element or block for Inf/NaN. Here the whole vector runs without checks: an Inf or NaN
+// input (or an overflow) can only make the result non-finite, and only then the checked kernel runs, once per vector pair.
+
+static inline __m256 half8_to_f32x8_avx2 (const uint16_t *p, bool is_bf16) {
+    // 8 halves to 8 floats (exact): vcvtph2ps (F16C), or bf16 widened to the top 16 bits of a float
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+#if defined(__F16C__)
+    if (!is_bf16) return _mm256_cvtph_ps(v);
+#endif
+    return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_cvtepu16_epi32(v), 16));
+}
+
+static inline void half_accumulate_avx2 (__m256 v, __m256d *acc) {
+    // 8 floats summed in double, like the checked kernels
+    acc[0] = _mm256_add_pd(acc[0], _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+    acc[1] = _mm256_add_pd(acc[1], _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+}
+
+static inline float half_cosine_finalize (double dot, double norm_a, double norm_b) {
+    // same arithmetic as the checked kernels, NAN sends non-finite sums back to them
+    float d = (float)dot, na = sqrtf((float)norm_a), nb = sqrtf((float)norm_b);
+    if (!isfinite(d) || !isfinite(na) || !isfinite(nb)) return NAN;
+    if (!(na > 0.0f) || !(nb > 0.0f)) return 1.0f;
+    
+    float cosine = d / (na * nb);
+    if (cosine > 1.0f) cosine = 1.0f;
+    if (cosine < -1.0f) cosine = -1.0f;
+    return 1.0f - cosine;
+}
+
+DISTANCE_BATCH_INLINE float half_distance_avx2 (const void *v1, const void *v2, int n, distance_batch_op op, bool is_bf16) {
+    const uint16_t *a = (const uint16_t *)v1;
+    const uint16_t *b = (const uint16_t *)v2;
+    __m256d sum[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    __m256d norm_a[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    __m256d norm_b[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    
+    int i = 0;
+    for (; i <= n - 8; i += 8) {
+        __m256 va = half8_to_f32x8_avx2(a + i, is_bf16);
+        __m256 vb = half8_to_f32x8_avx2(b + i, is_bf16);
+        __m256 d;
+        __m256d d0, d1;
+        switch (op) {
+            case DISTANCE_BATCH_L2:
+            case DISTANCE_BATCH_SQUARED_L2:
+                d = _mm256_sub_ps(va, vb);
+                d0 = _mm256_cvtps_pd(_mm256_castps256_ps128(d));
+                d1 = _mm256_cvtps_pd(_mm256_extractf128_ps(d, 1));
+            #if defined(__FMA__)
+                sum[0] = _mm256_fmadd_pd(d0, d0, sum[0]);
+                sum[1] = _mm256_fmadd_pd(d1, d1, sum[1]);
+            #else
+                sum[0] = _mm256_add_pd(sum[0], _mm256_mul_pd(d0, d0));
+                sum[1] = _mm256_add_pd(sum[1], _mm256_mul_pd(d1, d1));
+            #endif
+                break;
+            case DISTANCE_BATCH_L1:
+                half_accumulate_avx2(_mm256_abs_ps(_mm256_sub_ps(va, vb)), sum);
+                break;
+            case DISTANCE_BATCH_DOT:
+                half_accumulate_avx2(_mm256_mul_ps(va, vb), sum);
+                break;
+            case DISTANCE_BATCH_COSINE:
+                half_accumulate_avx2(_mm256_mul_ps(va, vb), sum);
+                half_accumulate_avx2(_mm256_mul_ps(va, va), norm_a);
+                half_accumulate_avx2(_mm256_mul_ps(vb, vb), norm_b);
+                break;
+        }
+    }
+    
+    double total = hsum256d(sum[0]) + hsum256d(sum[1]);
+    double total_a = hsum256d(norm_a[0]) + hsum256d(norm_a[1]);
+    double total_b = hsum256d(norm_b[0]) + hsum256d(norm_b[1]);
+    
+    // scalar tail, same float arithmetic
+    for (; i < n; ++i) {
+        float x = (is_bf16) ? bfloat16_to_float32(a[i]) : float16_to_float32(a[i]);
+        float y = (is_bf16) ? bfloat16_to_float32(b[i]) : float16_to_float32(b[i]);
+        double d = (double)(x - y);
+        switch (op) {
+            case DISTANCE_BATCH_L2:
+            case DISTANCE_BATCH_SQUARED_L2: total = fma(d, d, total); break;
+            case DISTANCE_BATCH_L1: total += fabs(d); break;
+            case DISTANCE_BATCH_DOT: total += (double)(x * y); break;
+            case DISTANCE_BATCH_COSINE:
+                total += (double)(x * y);
+                total_a += (double)(x * x);
+                total_b += (double)(y * y);
+                break;
+        }
+    }
+    
+    switch (op) {
+        case DISTANCE_BATCH_L2: return (float)sqrt(total);
+        case DISTANCE_BATCH_SQUARED_L2: return (float)total;
+        case DISTANCE_BATCH_L1: return (float)total;
+        case DISTANCE_BATCH_DOT: return (float)(-total);
+        case DISTANCE_BATCH_COSINE: break;
+    }
+    return half_cosine_finalize(total, total_a, total_b);
+}
+
+float bfloat16_distance_l2_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_L2, true);
+    return isfinite(d) ? d : bfloat16_distance_l2_checked_avx2(v1, v2, n);
+}
+
+float bfloat16_distance_l2_squared_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+    return isfinite(d) ? d : bfloat16_distance_l2_squared_checked_avx2(v1, v2, n);
+}
+
+float bfloat16_distance_l1_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_L1, true);
+    return isfinite(d) ? d : bfloat16_distance_l1_checked_avx2(v1, v2, n);
+}
+
+float bfloat16_distance_dot_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_DOT, true);
+    return isfinite(d) ? d : bfloat16_distance_dot_checked_avx2(v1, v2, n);
+}
+
+float bfloat16_distance_cosine_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+    return isfinite(d) ? d : bfloat16_distance_cosine_checked_avx2(v1, v2, n);
+}
+
+#if defined(__F16C__)
+float float16_distance_l2_f16c_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_L2, false);
+    return isfinite(d) ? d : float16_distance_l2_avx2(v1, v2, n);
+}
+
+float float16_distance_l2_squared_f16c_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+    return isfinite(d) ? d : float16_distance_l2_squared_avx2(v1, v2, n);
+}
+
+float float16_distance_l1_f16c_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_L1, false);
+    return isfinite(d) ? d : float16_distance_l1_avx2(v1, v2, n);
+}
+
+float float16_distance_dot_f16c_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_DOT, false);
+    return isfinite(d) ? d : float16_distance_dot_avx2(v1, v2, n);
+}
+
+float float16_distance_cosine_f16c_avx2 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx2(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+    return isfinite(d) ? d : float16_distance_cosine_avx2(v1, v2, n);
+}
+#endif
+
 // MARK: - UINT8 -
 
 static inline float uint8_distance_l2_impl_avx2 (const void *v1, const void *v2, int n, bool use_sqrt) {
@@ -996,6 +1154,455 @@ float bit1_distance_hamming_avx2 (const void *v1, const void *v2, int n) {
     return (float)distance;
 }
 
+// MARK: - BATCH -
+
+#define DISTANCE_BATCH_WIDTH        4       // candidates sharing every load of the query
+
+static inline __m256i int8x16_to_epi16_loadu (const uint8_t *p, bool is_signed) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    return (is_signed) ? _mm256_cvtepi8_epi16(v) : _mm256_cvtepu8_epi16(v);
+}
+
+static inline int64_t hsum256_epi32 (__m256i v) {
+    int32_t temp[8];
+    _mm256_storeu_si256((__m256i *)temp, v);
+    return (int64_t)temp[0] + temp[1] + temp[2] + temp[3] + temp[4] + temp[5] + temp[6] + temp[7];
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_block_avx2 (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum[DISTANCE_BATCH_WIDTH];
+    __m256i norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = _mm256_setzero_si256();
+        norm[k] = _mm256_setzero_si256();
+    }
+    
+    // 16 elements widened to 16-bit per step, pairs of products summed to 32-bit by madd (exact)
+    int i = 0;
+    for (; i <= n - 16; i += 16) {
+        __m256i vq = int8x16_to_epi16_loadu(q + i, is_signed);
+        for (int k = 0; k < width; ++k) {
+            __m256i vx = int8x16_to_epi16_loadu(base + (size_t)k * stride + i, is_signed);
+            __m256i d;
+            switch (op) {
+                case DISTANCE_BATCH_L2:
+                case DISTANCE_BATCH_SQUARED_L2:
+                    d = _mm256_sub_epi16(vq, vx);
+                    sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(d, d));
+                    break;
+                case DISTANCE_BATCH_DOT:
+                    sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(vq, vx));
+                    break;
+                case DISTANCE_BATCH_L1:
+                    d = _mm256_abs_epi16(_mm256_sub_epi16(vq, vx));
+                    sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(d, ones));
+                    break;
+                case DISTANCE_BATCH_COSINE:
+                    sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(vq, vx));
+                    norm[k] = _mm256_add_epi32(norm[k], _mm256_madd_epi16(vx, vx));
+                    break;
+            }
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = hsum256_epi32(sum[k]);
+        int64_t norm_x = hsum256_epi32(norm[k]);
+        for (int t = i; t < n; ++t) {
+            distance_batch_accumulate(op, distance_batch_load(q, t, is_signed), distance_batch_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = distance_batch_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        integer_distance_block_avx2(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_avx2(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+void uint8_distance_l2_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint8_distance_l1_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint8_distance_cosine_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_l1_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int8_distance_cosine_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+void bit1_distance_hamming_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        const uint8_t *x[DISTANCE_BATCH_WIDTH];
+        __m256i acc[DISTANCE_BATCH_WIDTH];
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            x[k] = b + (size_t)(j + k) * stride;
+            acc[k] = _mm256_setzero_si256();
+        }
+        
+        int i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i vq = _mm256_loadu_si256((const __m256i *)(q + i));
+            for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+                __m256i xored = _mm256_xor_si256(vq, _mm256_loadu_si256((const __m256i *)(x[k] + i)));
+                acc[k] = _mm256_add_epi64(acc[k], _mm256_sad_epu8(popcount_avx2(xored), _mm256_setzero_si256()));
+            }
+        }
+        
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            __m128i sum128 = _mm_add_epi64(_mm256_extracti128_si256(acc[k], 0), _mm256_extracti128_si256(acc[k], 1));
+            int distance = (int)(_mm_extract_epi64(sum128, 0) + _mm_extract_epi64(sum128, 1));
+            distance += (int)bit1_distance_hamming_avx2(q + i, x[k] + i, n - i);   // remainder
+            distances[j + k] = (float)distance;
+        }
+    }
+    
+    for (; j < count; ++j) {
+        distances[j] = bit1_distance_hamming_avx2(q, b + (size_t)j * stride, n);
+    }
+}
+
+// MARK: - UINT4/INT4 -
+// packed 4-bit codes (see nibble_load), n is the number of bytes
+
+static inline void nibble_unpack_avx2 (const uint8_t *p, bool is_signed, __m256i *lo, __m256i *hi) {
+    // 32 bytes to 64 codes: the low nibbles in lo and the high ones in hi (INT4 codes sign extended by a vpshufb lookup)
+    const __m256i mask = _mm256_set1_epi8(0x0F);
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    *lo = _mm256_and_si256(v, mask);
+    *hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), mask);
+    if (is_signed) {
+        const __m256i lut = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, -8, -7, -6, -5, -4, -3, -2, -1, 0, 1, 2, 3, 4, 5, 6, 7, -8, -7, -6, -5, -4, -3, -2, -1);
+        *lo = _mm256_shuffle_epi8(lut, *lo);
+        *hi = _mm256_shuffle_epi8(lut, *hi);
+    }
+}
+
+static inline __m256i nibble_madd_avx2 (__m256i a, __m256i b, bool is_signed) {
+    // sums of adjacent products as 16-bit lanes (exact, codes are at most 15 in absolute value)
+    // vpmaddubsw takes one unsigned operand: signed codes move the sign of a to b
+    if (is_signed) return _mm256_maddubs_epi16(_mm256_abs_epi8(a), _mm256_sign_epi8(b, a));
+    return _mm256_maddubs_epi16(a, b);
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_block_avx2 (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    const __m256i ones8 = _mm256_set1_epi8(1);
+    const __m256i ones16 = _mm256_set1_epi16(1);
+    __m256i sum[DISTANCE_BATCH_WIDTH];
+    __m256i norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = _mm256_setzero_si256();
+        norm[k] = _mm256_setzero_si256();
+    }
+    
+    // 64 codes per step: both halves summed in 16-bit lanes (at most 4 * 225), then to 32-bit by madd
+    int i = 0;
+    for (; i <= n - 32; i += 32) {
+        __m256i qlo, qhi;
+        nibble_unpack_avx2(q + i, is_signed, &qlo, &qhi);
+        for (int k = 0; k < width; ++k) {
+            __m256i xlo, xhi, s;
+            nibble_unpack_avx2(base + (size_t)k * stride + i, is_signed, &xlo, &xhi);
+            switch (op) {
+                case DISTANCE_BATCH_L2:
+                case DISTANCE_BATCH_SQUARED_L2:
+                    xlo = _mm256_abs_epi8(_mm256_sub_epi8(qlo, xlo));
+                    xhi = _mm256_abs_epi8(_mm256_sub_epi8(qhi, xhi));
+                    s = _mm256_add_epi16(_mm256_maddubs_epi16(xlo, xlo), _mm256_maddubs_epi16(xhi, xhi));
+                    break;
+                case DISTANCE_BATCH_L1:
+                    s = _mm256_add_epi8(_mm256_abs_epi8(_mm256_sub_epi8(qlo, xlo)), _mm256_abs_epi8(_mm256_sub_epi8(qhi, xhi)));
+                    s = _mm256_maddubs_epi16(s, ones8);
+                    break;
+                case DISTANCE_BATCH_COSINE:
+                    s = _mm256_add_epi16(nibble_madd_avx2(xlo, xlo, is_signed), nibble_madd_avx2(xhi, xhi, is_signed));
+                    norm[k] = _mm256_add_epi32(norm[k], _mm256_madd_epi16(s, ones16));
+                    // fall through
+                case DISTANCE_BATCH_DOT:
+                    s = _mm256_add_epi16(nibble_madd_avx2(qlo, xlo, is_signed), nibble_madd_avx2(qhi, xhi, is_signed));
+                    break;
+            }
+            sum[k] = _mm256_add_epi32(sum[k], _mm256_madd_epi16(s, ones16));
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = hsum256_epi32(sum[k]);
+        int64_t norm_x = hsum256_epi32(norm[k]);
+        for (int t = 2 * i; t < 2 * n; ++t) {
+            distance_batch_accumulate(op, nibble_load(q, t, is_signed), nibble_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = nibble_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        nibble_distance_block_avx2(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        nibble_distance_block_avx2(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+static inline float nibble_distance_avx2 (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    nibble_distance_batch_avx2(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint4_distance_l2_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint4_distance_l2_squared_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint4_distance_dot_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint4_distance_l1_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint4_distance_cosine_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int4_distance_l2_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int4_distance_l2_squared_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int4_distance_dot_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int4_distance_l1_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int4_distance_cosine_avx2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx2(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint4_distance_l2_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint4_distance_l2_squared_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint4_distance_dot_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint4_distance_l1_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint4_distance_cosine_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int4_distance_l2_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int4_distance_l2_squared_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int4_distance_dot_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int4_distance_l1_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int4_distance_cosine_batch_avx2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+// MARK: - QUANTIZE -
+
+// s + 0.5 or s - 0.5 (half away from zero, truncated by the caller) where s = (v - offset) * scale
+static inline __m256 quantize_round_avx2 (__m256 v, __m256 offset, __m256 scale) {
+    __m256 s = _mm256_mul_ps(_mm256_sub_ps(v, offset), scale);
+    __m256 negative = _mm256_and_ps(_mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_LT_OQ), _mm256_set1_ps(1.0f));
+    return _mm256_add_ps(s, _mm256_sub_ps(_mm256_set1_ps(0.5f), negative));
+}
+
+// per-dimension codes saturate in float32 (NaN -> 0), so the conversion never overflows
+static inline __m256i quantize_round_dims_avx2 (const float *v, const float *offsets, const float *scales, __m256 lo, __m256 hi) {
+    __m256 r = quantize_round_avx2(_mm256_loadu_ps(v), _mm256_loadu_ps(offsets), _mm256_loadu_ps(scales));
+    r = _mm256_and_ps(r, _mm256_cmp_ps(r, r, _CMP_ORD_Q));
+    r = _mm256_min_ps(_mm256_max_ps(r, lo), hi);
+    return _mm256_cvttps_epi32(r);
+}
+
+// 32 int32 values to 32 saturated 8-bit codes: the packs work on 128-bit lanes, the final permute restores the order
+static inline __m256i quantize_pack_u8_avx2 (__m256i r0, __m256i r1, __m256i r2, __m256i r3) {
+    __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(r0, r1), _mm256_packs_epi32(r2, r3));
+    return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+static inline __m256i quantize_pack_s8_avx2 (__m256i r0, __m256i r1, __m256i r2, __m256i r3) {
+    __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(r0, r1), _mm256_packs_epi32(r2, r3));
+    return _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+}
+
+static void float32_quantize_u8_avx2 (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const __m256 vo = _mm256_set1_ps(offset);
+    const __m256 vs = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i r0 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i), vo, vs));
+        __m256i r1 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i + 8), vo, vs));
+        __m256i r2 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i + 16), vo, vs));
+        __m256i r3 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i + 24), vo, vs));
+        _mm256_storeu_si256((__m256i *)(q + i), quantize_pack_u8_avx2(r0, r1, r2, r3));
+    }
+    for (; i < n; ++i) {
+        q[i] = q_convert_u8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_s8_avx2 (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const __m256 vo = _mm256_set1_ps(offset);
+    const __m256 vs = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i r0 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i), vo, vs));
+        __m256i r1 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i + 8), vo, vs));
+        __m256i r2 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i + 16), vo, vs));
+        __m256i r3 = _mm256_cvttps_epi32(quantize_round_avx2(_mm256_loadu_ps(v + i + 24), vo, vs));
+        _mm256_storeu_si256((__m256i *)(q + i), quantize_pack_s8_avx2(r0, r1, r2, r3));
+    }
+    for (; i < n; ++i) {
+        q[i] = (uint8_t)q_convert_s8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_u8_dims_avx2 (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    const __m256 lo = _mm256_setzero_ps();
+    const __m256 hi = _mm256_set1_ps(255.0f);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i r0 = quantize_round_dims_avx2(v + i, offsets + i, scales + i, lo, hi);
+        __m256i r1 = quantize_round_dims_avx2(v + i + 8, offsets + i + 8, scales + i + 8, lo, hi);
+        __m256i r2 = quantize_round_dims_avx2(v + i + 16, offsets + i + 16, scales + i + 16, lo, hi);
+        __m256i r3 = quantize_round_dims_avx2(v + i + 24, offsets + i + 24, scales + i + 24, lo, hi);
+        _mm256_storeu_si256((__m256i *)(q + i), quantize_pack_u8_avx2(r0, r1, r2, r3));
+    }
+    for (; i < n; ++i) {
+        q[i] = q_round_u8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_s8_dims_avx2 (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    const __m256 lo = _mm256_set1_ps(-128.0f);
+    const __m256 hi = _mm256_set1_ps(127.0f);
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i r0 = quantize_round_dims_avx2(v + i, offsets + i, scales + i, lo, hi);
+        __m256i r1 = quantize_round_dims_avx2(v + i + 8, offsets + i + 8, scales + i + 8, lo, hi);
+        __m256i r2 = quantize_round_dims_avx2(v + i + 16, offsets + i + 16, scales + i + 16, lo, hi);
+        __m256i r3 = quantize_round_dims_avx2(v + i + 24, offsets + i + 24, scales + i + 24, lo, hi);
+        _mm256_storeu_si256((__m256i *)(q + i), quantize_pack_s8_avx2(r0, r1, r2, r3));
+    }
+    for (; i < n; ++i) {
+        q[i] = (uint8_t)q_round_s8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_bit_avx2 (const float *v, uint8_t *q, float threshold, int n) {
+    const __m256 t = _mm256_set1_ps(threshold);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        q[i / 8] = (uint8_t)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(v + i), t, _CMP_GE_OQ));
+    }
+    float32_quantize_bit_scalar(v, q, threshold, i, n);
+}
+
+static inline void bytes_quantize_bit_avx2 (const uint8_t *v, uint8_t *q, int n, bool is_signed) {
+    // the byte movemask collects the top bits: set for UINT8 >= 128, clear for INT8 >= 0
+    uint32_t flip = (is_signed) ? 0xFFFFFFFFu : 0;
+    int i = 0;
+    for (; i + 32 <= n; i += 32) {
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(v + i))) ^ flip;
+        q[i / 8] = (uint8_t)mask;
+        q[i / 8 + 1] = (uint8_t)(mask >> 8);
+        q[i / 8 + 2] = (uint8_t)(mask >> 16);
+        q[i / 8 + 3] = (uint8_t)(mask >> 24);
+    }
+    bytes_quantize_bit_scalar(v, q, i, n, is_signed);
+}
+
+static void uint8_quantize_bit_avx2 (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_avx2(v, q, n, false);
+}
+
+static void int8_quantize_bit_avx2 (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_avx2(v, q, n, true);
+}
+
 #endif
 
 // MARK: -
@@ -1032,8 +1639,60 @@ void init_distance_functions_avx2 (void) {
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_avx2;
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_avx2;
     
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_avx2;
+    
     dispatch_distance_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_avx2;
     
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_batch_avx2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_batch_avx2;
+    
+    dispatch_quantize_table.f32_to_u8 = float32_quantize_u8_avx2;
+    dispatch_quantize_table.f32_to_s8 = float32_quantize_s8_avx2;
+    dispatch_quantize_table.f32_to_u8_dims = float32_quantize_u8_dims_avx2;
+    dispatch_quantize_table.f32_to_s8_dims = float32_quantize_s8_dims_avx2;
+    dispatch_quantize_table.f32_to_bit = float32_quantize_bit_avx2;
+    dispatch_quantize_table.u8_to_bit = uint8_quantize_bit_avx2;
+    dispatch_quantize_table.i8_to_bit = int8_quantize_bit_avx2;
+    
     distance_backend_name = "AVX2";
 #endif
 }
+
+void init_distance_functions_avx2_f16c (void) {
+#if (defined(__AVX2__) || (defined(_MSC_VER) && defined(__AVX2__))) && defined(__F16C__)
+    // applied on top of the AVX2 tier
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_F16] = float16_distance_l2_f16c_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_F16] = float16_distance_l2_squared_f16c_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_F16] = float16_distance_cosine_f16c_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_F16] = float16_distance_dot_f16c_avx2;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_F16] = float16_distance_l1_f16c_avx2;
+#endif
+}
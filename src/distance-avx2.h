@@ -11,5 +11,6 @@
 #include <stdio.h>
 
 void init_distance_functions_avx2 (void);
+void init_distance_functions_avx2_f16c (void);
 
 #endif
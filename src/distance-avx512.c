@@ -15,6 +15,8 @@
 #include <math.h>
 
 extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern quantize_functions dispatch_quantize_table;
 extern const char *distance_backend_name;
 
 // Abs for f32 (AVX512F has native abs)
@@ -228,15 +230,15 @@ static inline float float16_distance_l2_impl_avx512(const void* v1, const void*
     return use_sqrt ? (float)sqrt(sum) : (float)sum;
 }
 
-float float16_distance_l2_avx512(const void* v1, const void* v2, int n) {
+static float float16_distance_l2_checked_avx512(const void* v1, const void* v2, int n) {
     return float16_distance_l2_impl_avx512(v1, v2, n, true);
 }
 
-float float16_distance_l2_squared_avx512(const void* v1, const void* v2, int n) {
+static float float16_distance_l2_squared_checked_avx512(const void* v1, const void* v2, int n) {
     return float16_distance_l2_impl_avx512(v1, v2, n, false);
 }
 
-float float16_distance_l1_avx512(const void* v1, const void* v2, int n) {
+static float float16_distance_l1_checked_avx512(const void* v1, const void* v2, int n) {
     const uint16_t* a = (const uint16_t*)v1;
     const uint16_t* b = (const uint16_t*)v2;
 
@@ -280,7 +282,7 @@ float float16_distance_l1_avx512(const void* v1, const void* v2, int n) {
     return (float)sum;
 }
 
-float float16_distance_dot_avx512(const void* v1, const void* v2, int n) {
+static float float16_distance_dot_checked_avx512(const void* v1, const void* v2, int n) {
     const uint16_t* a = (const uint16_t*)v1;
     const uint16_t* b = (const uint16_t*)v2;
 
@@ -357,7 +359,7 @@ float float16_distance_dot_avx512(const void* v1, const void* v2, int n) {
     return (float)(-dot);
 }
 
-float float16_distance_cosine_avx512(const void* va, const void* vb, int n) {
+static float float16_distance_cosine_checked_avx512(const void* va, const void* vb, int n) {
     const uint16_t* a = (const uint16_t*)va;
     const uint16_t* b = (const uint16_t*)vb;
 
@@ -365,9 +367,9 @@ float float16_distance_cosine_avx512(const void* va, const void* vb, int n) {
         if (f16_is_inf(a[i]) || f16_is_inf(b[i])) return 1.0f;
     }
 
-    float dot = -float16_distance_dot_avx512(a, b, n);
-    float norm_a = sqrtf(-float16_distance_dot_avx512(a, a, n));
-    float norm_b = sqrtf(-float16_distance_dot_avx512(b, b, n));
+    float dot = -float16_distance_dot_checked_avx512(a, b, n);
+    float norm_a = sqrtf(-float16_distance_dot_checked_avx512(a, a, n));
+    float norm_b = sqrtf(-float16_distance_dot_checked_avx512(b, b, n));
 
     if (!(norm_a > 0.0f) || !(norm_b > 0.0f) || !isfinite(norm_a) || !isfinite(norm_b) || !isfinite(dot))
         return 1.0f;
@@ -432,15 +434,15 @@ static inline float bfloat16_distance_l2_impl_avx512(const void* v1, const void*
     return use_sqrt ? (float)sqrt(sum) : (float)sum;
 }
 
-float bfloat16_distance_l2_avx512(const void* v1, const void* v2, int n) {
+static float bfloat16_distance_l2_checked_avx512(const void* v1, const void* v2, int n) {
     return bfloat16_distance_l2_impl_avx512(v1, v2, n, true);
 }
 
-float bfloat16_distance_l2_squared_avx512(const void* v1, const void* v2, int n) {
+static float bfloat16_distance_l2_squared_checked_avx512(const void* v1, const void* v2, int n) {
     return bfloat16_distance_l2_impl_avx512(v1, v2, n, false);
 }
 
-float bfloat16_distance_l1_avx512(const void* v1, const void* v2, int n) {
+static float bfloat16_distance_l1_checked_avx512(const void* v1, const void* v2, int n) {
     const uint16_t* a = (const uint16_t*)v1;
     const uint16_t* b = (const uint16_t*)v2;
 
@@ -487,7 +489,7 @@ float bfloat16_distance_l1_avx512(const void* v1, const void* v2, int n) {
     return (float)sum;
 }
 
-float bfloat16_distance_dot_avx512(const void* v1, const void* v2, int n) {
+static float bfloat16_distance_dot_checked_avx512(const void* v1, const void* v2, int n) {
     const uint16_t* a = (const uint16_t*)v1;
     const uint16_t* b = (const uint16_t*)v2;
 
@@ -553,10 +555,10 @@ float bfloat16_distance_dot_avx512(const void* v1, const void* v2, int n) {
     return (float)(-dot);
 }
 
-float bfloat16_distance_cosine_avx512(const void* v1, const void* v2, int n) {
-    float dot = -bfloat16_distance_dot_avx512(v1, v2, n);
-    float norm_a = sqrtf(-bfloat16_distance_dot_avx512(v1, v1, n));
-    float norm_b = sqrtf(-bfloat16_distance_dot_avx512(v2, v2, n));
+static float bfloat16_distance_cosine_checked_avx512(const void* v1, const void* v2, int n) {
+    float dot = -bfloat16_distance_dot_checked_avx512(v1, v2, n);
+    float norm_a = sqrtf(-bfloat16_distance_dot_checked_avx512(v1, v1, n));
+    float norm_b = sqrtf(-bfloat16_distance_dot_checked_avx512(v2, v2, n));
 
     if (!(norm_a > 0.0f) || !(norm_b > 0.0f) || !isfinite(norm_a) || !isfinite(norm_b) || !isfinite(dot))
         return 1.0f;
@@ -568,6 +570,169 @@ float bfloat16_distance_cosine_avx512(const void* v1, const void* v2, int n) {
 }
 
 
+// MARK: - FLOAT16/BFLOAT16 -
+// The kernels above check every block for Inf/NaN. Here the whole vector runs without checks: an Inf or NaN input
+// (or an overflow) can only make the result non-finite, and only then the checked kernel runs, once per vector pair.
+
+static inline __m512 half16_to_f32x16_avx512 (const uint16_t *p, __mmask16 m, bool is_bf16) {
+    // 16 halves to 16 floats (exact): vcvtph2ps, or bf16 widened to the top 16 bits of a float
+    __m256i v = _mm256_maskz_loadu_epi16(m, p);
+    return (is_bf16) ? _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_cvtepu16_epi32(v), 16)) : _mm512_cvtph_ps(v);
+}
+
+static inline void half_accumulate_avx512 (__m512 v, __m512d *acc) {
+    // 16 floats summed in double, like the checked kernels
+    acc[0] = _mm512_add_pd(acc[0], _mm512_cvtps_pd(_mm512_castps512_ps256(v)));
+    acc[1] = _mm512_add_pd(acc[1], _mm512_cvtps_pd(_mm512_extractf32x8_ps(v, 1)));
+}
+
+static inline float half_cosine_finalize (double dot, double norm_a, double norm_b) {
+    // same arithmetic as the checked kernels, NAN sends non-finite sums back to them
+    float d = (float)dot, na = sqrtf((float)norm_a), nb = sqrtf((float)norm_b);
+    if (!isfinite(d) || !isfinite(na) || !isfinite(nb)) return NAN;
+    if (!(na > 0.0f) || !(nb > 0.0f)) return 1.0f;
+    
+    float cosine = d / (na * nb);
+    if (cosine > 1.0f) cosine = 1.0f;
+    if (cosine < -1.0f) cosine = -1.0f;
+    return 1.0f - cosine;
+}
+
+DISTANCE_BATCH_INLINE float half_distance_avx512 (const void *v1, const void *v2, int n, distance_batch_op op, bool is_bf16) {
+    const uint16_t *a = (const uint16_t *)v1;
+    const uint16_t *b = (const uint16_t *)v2;
+    __m512d sum[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+    __m512d norm_a[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+    __m512d norm_b[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+    
+    // lanes out of the mask load as zero on both sides and add nothing
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 m = (n - i >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << (n - i)) - 1);
+        __m512 va = half16_to_f32x16_avx512(a + i, m, is_bf16);
+        __m512 vb = half16_to_f32x16_avx512(b + i, m, is_bf16);
+        __m512 d;
+        __m512d d0, d1;
+        switch (op) {
+            case DISTANCE_BATCH_L2:
+            case DISTANCE_BATCH_SQUARED_L2:
+                d = _mm512_sub_ps(va, vb);
+                d0 = _mm512_cvtps_pd(_mm512_castps512_ps256(d));
+                d1 = _mm512_cvtps_pd(_mm512_extractf32x8_ps(d, 1));
+                sum[0] = _mm512_fmadd_pd(d0, d0, sum[0]);
+                sum[1] = _mm512_fmadd_pd(d1, d1, sum[1]);
+                break;
+            case DISTANCE_BATCH_L1:
+                half_accumulate_avx512(_mm512_abs_ps(_mm512_sub_ps(va, vb)), sum);
+                break;
+            case DISTANCE_BATCH_DOT:
+                half_accumulate_avx512(_mm512_mul_ps(va, vb), sum);
+                break;
+            case DISTANCE_BATCH_COSINE:
+                half_accumulate_avx512(_mm512_mul_ps(va, vb), sum);
+                half_accumulate_avx512(_mm512_mul_ps(va, va), norm_a);
+                half_accumulate_avx512(_mm512_mul_ps(vb, vb), norm_b);
+                break;
+        }
+    }
+    
+    double total = hsum512d(sum[0]) + hsum512d(sum[1]);
+    switch (op) {
+        case DISTANCE_BATCH_L2: return (float)sqrt(total);
+        case DISTANCE_BATCH_SQUARED_L2: return (float)total;
+        case DISTANCE_BATCH_L1: return (float)total;
+        case DISTANCE_BATCH_DOT: return (float)(-total);
+        case DISTANCE_BATCH_COSINE: break;
+    }
+    return half_cosine_finalize(total, hsum512d(norm_a[0]) + hsum512d(norm_a[1]), hsum512d(norm_b[0]) + hsum512d(norm_b[1]));
+}
+
+float float16_distance_l2_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_L2, false);
+    return isfinite(d) ? d : float16_distance_l2_checked_avx512(v1, v2, n);
+}
+
+float float16_distance_l2_squared_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+    return isfinite(d) ? d : float16_distance_l2_squared_checked_avx512(v1, v2, n);
+}
+
+float float16_distance_l1_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_L1, false);
+    return isfinite(d) ? d : float16_distance_l1_checked_avx512(v1, v2, n);
+}
+
+float float16_distance_dot_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_DOT, false);
+    return isfinite(d) ? d : float16_distance_dot_checked_avx512(v1, v2, n);
+}
+
+float float16_distance_cosine_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+    return isfinite(d) ? d : float16_distance_cosine_checked_avx512(v1, v2, n);
+}
+
+float bfloat16_distance_l2_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_L2, true);
+    return isfinite(d) ? d : bfloat16_distance_l2_checked_avx512(v1, v2, n);
+}
+
+float bfloat16_distance_l2_squared_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+    return isfinite(d) ? d : bfloat16_distance_l2_squared_checked_avx512(v1, v2, n);
+}
+
+float bfloat16_distance_l1_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_L1, true);
+    return isfinite(d) ? d : bfloat16_distance_l1_checked_avx512(v1, v2, n);
+}
+
+float bfloat16_distance_dot_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_DOT, true);
+    return isfinite(d) ? d : bfloat16_distance_dot_checked_avx512(v1, v2, n);
+}
+
+float bfloat16_distance_cosine_avx512 (const void *v1, const void *v2, int n) {
+    float d = half_distance_avx512(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+    return isfinite(d) ? d : bfloat16_distance_cosine_checked_avx512(v1, v2, n);
+}
+
+#if defined(__AVX512BF16__)
+// vdpbf16ps: the two products of each float lane are exact and summed once in float (bf16 subnormals read as zero),
+// then every step is added in double like the other kernels
+DISTANCE_BATCH_INLINE float bfloat16_distance_dpbf16_avx512 (const void *v1, const void *v2, int n, distance_batch_op op) {
+    const uint16_t *a = (const uint16_t *)v1;
+    const uint16_t *b = (const uint16_t *)v2;
+    __m512d sum[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+    __m512d norm_a[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+    __m512d norm_b[2] = {_mm512_setzero_pd(), _mm512_setzero_pd()};
+    
+    for (int i = 0; i < n; i += 32) {
+        __mmask32 m = (n - i >= 32) ? ~(__mmask32)0 : (((__mmask32)1 << (n - i)) - 1);
+        __m512bh va = (__m512bh)_mm512_maskz_loadu_epi16(m, a + i);
+        __m512bh vb = (__m512bh)_mm512_maskz_loadu_epi16(m, b + i);
+        half_accumulate_avx512(_mm512_dpbf16_ps(_mm512_setzero_ps(), va, vb), sum);
+        if (op == DISTANCE_BATCH_COSINE) {
+            half_accumulate_avx512(_mm512_dpbf16_ps(_mm512_setzero_ps(), va, va), norm_a);
+            half_accumulate_avx512(_mm512_dpbf16_ps(_mm512_setzero_ps(), vb, vb), norm_b);
+        }
+    }
+    
+    double dot = hsum512d(sum[0]) + hsum512d(sum[1]);
+    if (op == DISTANCE_BATCH_DOT) return (float)(-dot);
+    return half_cosine_finalize(dot, hsum512d(norm_a[0]) + hsum512d(norm_a[1]), hsum512d(norm_b[0]) + hsum512d(norm_b[1]));
+}
+
+float bfloat16_distance_dot_avx512_bf16 (const void *v1, const void *v2, int n) {
+    float d = bfloat16_distance_dpbf16_avx512(v1, v2, n, DISTANCE_BATCH_DOT);
+    return isfinite(d) ? d : bfloat16_distance_dot_checked_avx512(v1, v2, n);
+}
+
+float bfloat16_distance_cosine_avx512_bf16 (const void *v1, const void *v2, int n) {
+    float d = bfloat16_distance_dpbf16_avx512(v1, v2, n, DISTANCE_BATCH_COSINE);
+    return isfinite(d) ? d : bfloat16_distance_cosine_checked_avx512(v1, v2, n);
+}
+#endif
+
 // MARK: - UINT8 -
 
 static inline float uint8_distance_l2_impl_avx512(const void* v1, const void* v2, int n, bool use_sqrt) {
@@ -746,11 +911,11 @@ static inline float int8_distance_l2_impl_avx512(const void* v1, const void* v2,
         __m512i s_lo = _mm512_mullo_epi16(d_lo, d_lo);
         __m512i s_hi = _mm512_mullo_epi16(d_hi, d_hi);
 
-        // Sign extend 16 to 32 and add (results of square are positive, but keeping types consistent)
-        acc = _mm512_add_epi32(acc, _mm512_cvtepi16_epi32(_mm512_castsi512_si256(s_lo)));
-        acc = _mm512_add_epi32(acc, _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(s_lo, 1)));
-        acc = _mm512_add_epi32(acc, _mm512_cvtepi16_epi32(_mm512_castsi512_si256(s_hi)));
-        acc = _mm512_add_epi32(acc, _mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(s_hi, 1)));
+        // Zero extend 16 to 32 and add (squares of differences up to 255 overflow int16 but fit uint16)
+        acc = _mm512_add_epi32(acc, _mm512_cvtepu16_epi32(_mm512_castsi512_si256(s_lo)));
+        acc = _mm512_add_epi32(acc, _mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(s_lo, 1)));
+        acc = _mm512_add_epi32(acc, _mm512_cvtepu16_epi32(_mm512_castsi512_si256(s_hi)));
+        acc = _mm512_add_epi32(acc, _mm512_cvtepu16_epi32(_mm512_extracti64x4_epi64(s_hi, 1)));
     }
 
     uint32_t total = hsum512_epi32(acc);
@@ -899,22 +1064,627 @@ static float bit1_distance_hamming_avx512(const void *v1, const void *v2, int n)
 #endif
     }
 
+    // Handle remaining bytes with a masked load (short codes, such as the 1BIT level of a cascade, fit entirely here)
+    if (i < n) {
+        __mmask64 k = (__mmask64)((1ULL << (n - i)) - 1);
+        __m512i xored = _mm512_xor_si512(_mm512_maskz_loadu_epi8(k, a + i), _mm512_maskz_loadu_epi8(k, b + i));
+#if defined(__AVX512VPOPCNTDQ__)
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(xored));
+#else
+        acc = _mm512_add_epi64(acc, _mm512_sad_epu8(popcount_avx512(xored), _mm512_setzero_si512()));
+#endif
+    }
+
     // Horizontal sum
     uint64_t distance = _mm512_reduce_add_epi64(acc);
+    return (float)distance;
+}
+
+// MARK: - BATCH -
+
+#define DISTANCE_BATCH_WIDTH        4       // candidates sharing every load of the query
+
+static inline __m512i int8x32_to_epi16 (__m256i v, bool is_signed) {
+    return (is_signed) ? _mm512_cvtepi8_epi16(v) : _mm512_cvtepu8_epi16(v);
+}
+
+static inline int64_t hsum512_epi32_wide (__m512i v) {
+    // lanes are summed in 64-bit (a full vector sum may exceed int32)
+    __m512i lo = _mm512_cvtepi32_epi64(_mm512_castsi512_si256(v));
+    __m512i hi = _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(v, 1));
+    return (int64_t)_mm512_reduce_add_epi64(_mm512_add_epi64(lo, hi));
+}
+
+// 32 elements widened to 16-bit, pairs of products summed to 32-bit by madd (exact)
+DISTANCE_BATCH_INLINE void integer_distance_step_avx512 (distance_batch_op op, __m512i vq, __m512i vx, __m512i *sum, __m512i *norm) {
+    __m512i d;
+    switch (op) {
+        case DISTANCE_BATCH_L2:
+        case DISTANCE_BATCH_SQUARED_L2:
+            d = _mm512_sub_epi16(vq, vx);
+            *sum = _mm512_add_epi32(*sum, _mm512_madd_epi16(d, d));
+            break;
+        case DISTANCE_BATCH_DOT:
+            *sum = _mm512_add_epi32(*sum, _mm512_madd_epi16(vq, vx));
+            break;
+        case DISTANCE_BATCH_L1:
+            d = _mm512_abs_epi16(_mm512_sub_epi16(vq, vx));
+            *sum = _mm512_add_epi32(*sum, _mm512_madd_epi16(d, _mm512_set1_epi16(1)));
+            break;
+        case DISTANCE_BATCH_COSINE:
+            *sum = _mm512_add_epi32(*sum, _mm512_madd_epi16(vq, vx));
+            *norm = _mm512_add_epi32(*norm, _mm512_madd_epi16(vx, vx));
+            break;
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_block_avx512 (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    __m512i sum[DISTANCE_BATCH_WIDTH];
+    __m512i norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = _mm512_setzero_si512();
+        norm[k] = _mm512_setzero_si512();
+    }
+    
+    // full 64 bytes loads, split in two halves
+    int i = 0;
+    for (; i <= n - 64; i += 64) {
+        __m512i vq = _mm512_loadu_si512((const void *)(q + i));
+        __m512i vq_lo = int8x32_to_epi16(_mm512_castsi512_si256(vq), is_signed);
+        __m512i vq_hi = int8x32_to_epi16(_mm512_extracti64x4_epi64(vq, 1), is_signed);
+        for (int k = 0; k < width; ++k) {
+            __m512i vx = _mm512_loadu_si512((const void *)(base + (size_t)k * stride + i));
+            integer_distance_step_avx512(op, vq_lo, int8x32_to_epi16(_mm512_castsi512_si256(vx), is_signed), &sum[k], &norm[k]);
+            integer_distance_step_avx512(op, vq_hi, int8x32_to_epi16(_mm512_extracti64x4_epi64(vx, 1), is_signed), &sum[k], &norm[k]);
+        }
+    }
+    for (; i <= n - 32; i += 32) {
+        __m512i vq = int8x32_to_epi16(_mm256_loadu_si256((const __m256i *)(q + i)), is_signed);
+        for (int k = 0; k < width; ++k) {
+            __m512i vx = int8x32_to_epi16(_mm256_loadu_si256((const __m256i *)(base + (size_t)k * stride + i)), is_signed);
+            integer_distance_step_avx512(op, vq, vx, &sum[k], &norm[k]);
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = hsum512_epi32_wide(sum[k]);
+        int64_t norm_x = hsum512_epi32_wide(norm[k]);
+        for (int t = i; t < n; ++t) {
+            distance_batch_accumulate(op, distance_batch_load(q, t, is_signed), distance_batch_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = distance_batch_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        integer_distance_block_avx512(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_avx512(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+void uint8_distance_l2_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
 
-    // Handle remaining bytes with scalar code
-    for (; i < n; i++) {
-#if defined(__GNUC__) || defined(__clang__)
-        distance += __builtin_popcount(a[i] ^ b[i]);
+void uint8_distance_l1_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint8_distance_cosine_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_l1_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int8_distance_cosine_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+void bit1_distance_hamming_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        const uint8_t *x[DISTANCE_BATCH_WIDTH];
+        __m512i acc[DISTANCE_BATCH_WIDTH];
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            x[k] = b + (size_t)(j + k) * stride;
+            acc[k] = _mm512_setzero_si512();
+        }
+        
+        int i = 0;
+        for (; i + 64 <= n; i += 64) {
+            __m512i vq = _mm512_loadu_si512((const void *)(q + i));
+            for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+                __m512i xored = _mm512_xor_si512(vq, _mm512_loadu_si512((const void *)(x[k] + i)));
+#if defined(__AVX512VPOPCNTDQ__)
+                acc[k] = _mm512_add_epi64(acc[k], _mm512_popcnt_epi64(xored));
 #else
-        uint8_t x = a[i] ^ b[i];
-        x = x - ((x >> 1) & 0x55);
-        x = (x & 0x33) + ((x >> 2) & 0x33);
-        distance += (x + (x >> 4)) & 0x0f;
+                acc[k] = _mm512_add_epi64(acc[k], _mm512_sad_epu8(popcount_avx512(xored), _mm512_setzero_si512()));
 #endif
+            }
+        }
+        
+        // remainder (masked load)
+        if (i < n) {
+            __mmask64 m = (__mmask64)((1ULL << (n - i)) - 1);
+            __m512i vq = _mm512_maskz_loadu_epi8(m, q + i);
+            for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+                __m512i xored = _mm512_xor_si512(vq, _mm512_maskz_loadu_epi8(m, x[k] + i));
+#if defined(__AVX512VPOPCNTDQ__)
+                acc[k] = _mm512_add_epi64(acc[k], _mm512_popcnt_epi64(xored));
+#else
+                acc[k] = _mm512_add_epi64(acc[k], _mm512_sad_epu8(popcount_avx512(xored), _mm512_setzero_si512()));
+#endif
+            }
+        }
+        
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            distances[j + k] = (float)_mm512_reduce_add_epi64(acc[k]);
+        }
+    }
+    
+    for (; j < count; ++j) {
+        distances[j] = bit1_distance_hamming_avx512(q, b + (size_t)j * stride, n);
     }
+}
 
-    return (float)distance;
+// MARK: - UINT4/INT4 -
+// packed 4-bit codes (see nibble_load), n is the number of bytes
+
+static inline void nibble_unpack_avx512 (const uint8_t *p, __mmask64 m, bool is_signed, __m512i *lo, __m512i *hi) {
+    // up to 64 bytes to 128 codes: the low nibbles in lo and the high ones in hi (INT4 codes sign extended by a vpshufb lookup)
+    // bytes out of the mask load as zero, a zero code on both sides adds nothing to any distance
+    const __m512i mask = _mm512_set1_epi8(0x0F);
+    __m512i v = _mm512_maskz_loadu_epi8(m, p);
+    *lo = _mm512_and_si512(v, mask);
+    *hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), mask);
+    if (is_signed) {
+        const __m512i lut = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, -8, -7, -6, -5, -4, -3, -2, -1));
+        *lo = _mm512_shuffle_epi8(lut, *lo);
+        *hi = _mm512_shuffle_epi8(lut, *hi);
+    }
+}
+
+static inline __m512i nibble_madd_avx512 (__m512i a, __m512i b, bool is_signed) {
+    // sums of adjacent products as 16-bit lanes (exact, codes are at most 15 in absolute value)
+    // vpmaddubsw takes one unsigned operand: signed codes move the sign of a to b
+    if (is_signed) return _mm512_maddubs_epi16(_mm512_abs_epi8(a), _mm512_mask_sub_epi8(b, _mm512_movepi8_mask(a), _mm512_setzero_si512(), b));
+    return _mm512_maddubs_epi16(a, b);
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_block_avx512 (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    const __m512i ones8 = _mm512_set1_epi8(1);
+    const __m512i ones16 = _mm512_set1_epi16(1);
+    __m512i sum[DISTANCE_BATCH_WIDTH];
+    __m512i norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = _mm512_setzero_si512();
+        norm[k] = _mm512_setzero_si512();
+    }
+    
+    // 128 codes per step: both halves summed in 16-bit lanes (at most 4 * 225), then to 32-bit by madd
+    // the last step is a masked load, so there is no scalar tail
+    int i = 0;
+    for (; i < n; i += 64) {
+        __mmask64 m = (n - i >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << (n - i)) - 1);
+        __m512i qlo, qhi;
+        nibble_unpack_avx512(q + i, m, is_signed, &qlo, &qhi);
+        for (int k = 0; k < width; ++k) {
+            __m512i xlo, xhi, s;
+            nibble_unpack_avx512(base + (size_t)k * stride + i, m, is_signed, &xlo, &xhi);
+            switch (op) {
+                case DISTANCE_BATCH_L2:
+                case DISTANCE_BATCH_SQUARED_L2:
+                    xlo = _mm512_abs_epi8(_mm512_sub_epi8(qlo, xlo));
+                    xhi = _mm512_abs_epi8(_mm512_sub_epi8(qhi, xhi));
+                    s = _mm512_add_epi16(_mm512_maddubs_epi16(xlo, xlo), _mm512_maddubs_epi16(xhi, xhi));
+                    break;
+                case DISTANCE_BATCH_L1:
+                    s = _mm512_add_epi8(_mm512_abs_epi8(_mm512_sub_epi8(qlo, xlo)), _mm512_abs_epi8(_mm512_sub_epi8(qhi, xhi)));
+                    s = _mm512_maddubs_epi16(s, ones8);
+                    break;
+                case DISTANCE_BATCH_COSINE:
+                    s = _mm512_add_epi16(nibble_madd_avx512(xlo, xlo, is_signed), nibble_madd_avx512(xhi, xhi, is_signed));
+                    norm[k] = _mm512_add_epi32(norm[k], _mm512_madd_epi16(s, ones16));
+                    // fall through
+                case DISTANCE_BATCH_DOT:
+                    s = _mm512_add_epi16(nibble_madd_avx512(qlo, xlo, is_signed), nibble_madd_avx512(qhi, xhi, is_signed));
+                    break;
+            }
+            sum[k] = _mm512_add_epi32(sum[k], _mm512_madd_epi16(s, ones16));
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        distances[k] = distance_batch_finalize(op, hsum512_epi32_wide(sum[k]), norm_q, hsum512_epi32_wide(norm[k]));
+    }
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = nibble_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        nibble_distance_block_avx512(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        nibble_distance_block_avx512(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+static inline float nibble_distance_avx512 (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    nibble_distance_batch_avx512(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint4_distance_l2_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint4_distance_l2_squared_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint4_distance_dot_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint4_distance_l1_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint4_distance_cosine_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int4_distance_l2_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int4_distance_l2_squared_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int4_distance_dot_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int4_distance_l1_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int4_distance_cosine_avx512 (const void *v1, const void *v2, int n) {
+    return nibble_distance_avx512(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint4_distance_l2_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint4_distance_l2_squared_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint4_distance_dot_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint4_distance_l1_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint4_distance_cosine_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int4_distance_l2_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int4_distance_l2_squared_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int4_distance_dot_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int4_distance_l1_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int4_distance_cosine_batch_avx512 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_avx512(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+// MARK: - VNNI -
+#if defined(__AVX512VNNI__)
+// vpdpbusd sums four unsigned by signed byte products into each 32-bit lane (exact, the lanes are summed in 64-bit).
+// Products: flipping the top bit of the candidate (x ^ 0x80, x - 128 for UINT8, x + 128 as unsigned for INT8) brings
+// both code types to that form, UINT8 accumulates q * (x - 128), INT8 (x + 128) * q, and the 128 * sum(q) bias is
+// removed at the end. Squared differences: |q - x| fits an unsigned byte and d * d = d * (d & 0x7F) - d * (int8_t)(d & 0x80).
+
+static inline __mmask64 vnni_mask_avx512 (int remaining) {
+    return (remaining >= 64) ? ~(__mmask64)0 : (((__mmask64)1 << remaining) - 1);
+}
+
+// L2: sum and norm get the two halves of the squared differences
+// DOT, COSINE: sum gets the biased q.x, norm the biased x.x and xsum the sum of x that unbiases it (COSINE only)
+DISTANCE_BATCH_INLINE void integer_distance_step_vnni (distance_batch_op op, bool is_signed, __m512i vq, __m512i vx, __m512i *sum, __m512i *norm, __m512i *xsum) {
+    if (op == DISTANCE_BATCH_L2 || op == DISTANCE_BATCH_SQUARED_L2) {
+        __m512i d = (is_signed) ? _mm512_sub_epi8(_mm512_max_epi8(vq, vx), _mm512_min_epi8(vq, vx)) : _mm512_sub_epi8(_mm512_max_epu8(vq, vx), _mm512_min_epu8(vq, vx));
+        *sum = _mm512_dpbusd_epi32(*sum, d, _mm512_and_si512(d, _mm512_set1_epi8(0x7F)));
+        *norm = _mm512_dpbusd_epi32(*norm, d, _mm512_and_si512(d, _mm512_set1_epi8((char)0x80)));
+        return;
+    }
+    
+    __m512i vf = _mm512_xor_si512(vx, _mm512_set1_epi8((char)0x80));
+    *sum = (is_signed) ? _mm512_dpbusd_epi32(*sum, vf, vq) : _mm512_dpbusd_epi32(*sum, vq, vf);
+    if (op != DISTANCE_BATCH_COSINE) return;
+    
+    *norm = (is_signed) ? _mm512_dpbusd_epi32(*norm, vf, vx) : _mm512_dpbusd_epi32(*norm, vx, vf);
+    *xsum = (is_signed) ? _mm512_dpbusd_epi32(*xsum, _mm512_set1_epi8(1), vx) : _mm512_dpbusd_epi32(*xsum, vx, _mm512_set1_epi8(1));
+}
+
+static inline void integer_query_stats_vnni (const uint8_t *q, int n, bool is_signed, int64_t *sum_q, int64_t *norm_q) {
+    // sum and squared norm of the query, through the same biased products
+    __m512i dot = _mm512_setzero_si512();
+    __m512i norm = _mm512_setzero_si512();
+    __m512i sum = _mm512_setzero_si512();
+    for (int i = 0; i < n; i += 64) {
+        __m512i vq = _mm512_maskz_loadu_epi8(vnni_mask_avx512(n - i), q + i);
+        integer_distance_step_vnni(DISTANCE_BATCH_COSINE, is_signed, vq, vq, &dot, &norm, &sum);
+    }
+    *sum_q = hsum512_epi32_wide(sum);
+    *norm_q = hsum512_epi32_wide(norm) + ((is_signed) ? -128 : 128) * *sum_q;
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_block_vnni (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t sum_q, int64_t norm_q) {
+    __m512i sum[DISTANCE_BATCH_WIDTH];
+    __m512i norm[DISTANCE_BATCH_WIDTH];
+    __m512i xsum[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = _mm512_setzero_si512();
+        norm[k] = _mm512_setzero_si512();
+        xsum[k] = _mm512_setzero_si512();
+    }
+    
+    // bytes out of the mask load as zero on both sides and add nothing to any of the sums
+    for (int i = 0; i < n; i += 64) {
+        __mmask64 m = vnni_mask_avx512(n - i);
+        __m512i vq = _mm512_maskz_loadu_epi8(m, q + i);
+        for (int k = 0; k < width; ++k) {
+            __m512i vx = _mm512_maskz_loadu_epi8(m, base + (size_t)k * stride + i);
+            integer_distance_step_vnni(op, is_signed, vq, vx, &sum[k], &norm[k], &xsum[k]);
+        }
+    }
+    
+    const int64_t bias = (is_signed) ? -128 : 128;
+    for (int k = 0; k < width; ++k) {
+        int64_t total, norm_x = 0;
+        if (op == DISTANCE_BATCH_L2 || op == DISTANCE_BATCH_SQUARED_L2) {
+            total = hsum512_epi32_wide(sum[k]) - hsum512_epi32_wide(norm[k]);
+        } else {
+            total = hsum512_epi32_wide(sum[k]) + bias * sum_q;
+            if (op == DISTANCE_BATCH_COSINE) norm_x = hsum512_epi32_wide(norm[k]) + bias * hsum512_epi32_wide(xsum[k]);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t sum_q = 0, norm_q = 0;
+    if (op == DISTANCE_BATCH_DOT || op == DISTANCE_BATCH_COSINE) integer_query_stats_vnni(q, n, is_signed, &sum_q, &norm_q);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        integer_distance_block_vnni(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, sum_q, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_vnni(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, sum_q, norm_q);
+    }
+}
+
+static inline float integer_distance_vnni (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    integer_distance_batch_vnni(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint8_distance_l2_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint8_distance_l2_squared_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint8_distance_dot_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint8_distance_cosine_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int8_distance_l2_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int8_distance_l2_squared_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int8_distance_dot_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int8_distance_cosine_avx512_vnni (const void *v1, const void *v2, int n) {
+    return integer_distance_vnni(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint8_distance_l2_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint8_distance_cosine_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_cosine_batch_avx512_vnni (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_vnni(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+#endif
+
+// MARK: - QUANTIZE -
+
+// s + 0.5 or s - 0.5 (half away from zero, truncated by the caller) where s = (v - offset) * scale
+static inline __m512 quantize_round_avx512 (__m512 v, __m512 offset, __m512 scale) {
+    __m512 s = _mm512_mul_ps(_mm512_sub_ps(v, offset), scale);
+    __mmask16 negative = _mm512_cmp_ps_mask(s, _mm512_setzero_ps(), _CMP_LT_OQ);
+    return _mm512_add_ps(s, _mm512_mask_blend_ps(negative, _mm512_set1_ps(0.5f), _mm512_set1_ps(-0.5f)));
+}
+
+// per-dimension codes saturate in float32 (NaN -> 0), so the conversion never overflows
+static inline __m512i quantize_round_dims_avx512 (__mmask16 k, const float *v, const float *offsets, const float *scales, __m512 lo, __m512 hi) {
+    __m512 r = quantize_round_avx512(_mm512_maskz_loadu_ps(k, v), _mm512_maskz_loadu_ps(k, offsets), _mm512_maskz_loadu_ps(k, scales));
+    r = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(r, r, _CMP_ORD_Q), r);
+    r = _mm512_min_ps(_mm512_max_ps(r, lo), hi);
+    return _mm512_cvttps_epi32(r);
+}
+
+// masked loads and stores cover the tail, so every kernel is a single loop
+static inline __mmask16 quantize_tail_mask_avx512 (int remaining) {
+    return (remaining >= 16) ? (__mmask16)0xFFFF : (__mmask16)((1u << remaining) - 1);
+}
+
+static void float32_quantize_u8_avx512 (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const __m512 vo = _mm512_set1_ps(offset);
+    const __m512 vs = _mm512_set1_ps(scale);
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 k = quantize_tail_mask_avx512(n - i);
+        __m512i r = _mm512_cvttps_epi32(quantize_round_avx512(_mm512_maskz_loadu_ps(k, v + i), vo, vs));
+        // negative values (and the overflow result of the conversion) become 0 before the unsigned saturation
+        r = _mm512_max_epi32(r, _mm512_setzero_si512());
+        _mm512_mask_cvtusepi32_storeu_epi8(q + i, k, r);
+    }
+}
+
+static void float32_quantize_s8_avx512 (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const __m512 vo = _mm512_set1_ps(offset);
+    const __m512 vs = _mm512_set1_ps(scale);
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 k = quantize_tail_mask_avx512(n - i);
+        __m512i r = _mm512_cvttps_epi32(quantize_round_avx512(_mm512_maskz_loadu_ps(k, v + i), vo, vs));
+        _mm512_mask_cvtsepi32_storeu_epi8(q + i, k, r);
+    }
+}
+
+static void float32_quantize_u8_dims_avx512 (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    const __m512 lo = _mm512_setzero_ps();
+    const __m512 hi = _mm512_set1_ps(255.0f);
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 k = quantize_tail_mask_avx512(n - i);
+        __m512i r = quantize_round_dims_avx512(k, v + i, offsets + i, scales + i, lo, hi);
+        _mm512_mask_cvtepi32_storeu_epi8(q + i, k, r);
+    }
+}
+
+static void float32_quantize_s8_dims_avx512 (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    const __m512 lo = _mm512_set1_ps(-128.0f);
+    const __m512 hi = _mm512_set1_ps(127.0f);
+    for (int i = 0; i < n; i += 16) {
+        __mmask16 k = quantize_tail_mask_avx512(n - i);
+        __m512i r = quantize_round_dims_avx512(k, v + i, offsets + i, scales + i, lo, hi);
+        _mm512_mask_cvtepi32_storeu_epi8(q + i, k, r);
+    }
+}
+
+static void float32_quantize_bit_avx512 (const float *v, uint8_t *q, float threshold, int n) {
+    const __m512 t = _mm512_set1_ps(threshold);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __mmask16 bits = _mm512_cmp_ps_mask(_mm512_loadu_ps(v + i), t, _CMP_GE_OQ);
+        q[i / 8] = (uint8_t)bits;
+        q[i / 8 + 1] = (uint8_t)(bits >> 8);
+    }
+    float32_quantize_bit_scalar(v, q, threshold, i, n);
+}
+
+static inline void bytes_quantize_bit_avx512 (const uint8_t *v, uint8_t *q, int n, bool is_signed) {
+    // top bit of every byte: set for UINT8 >= 128, clear for INT8 >= 0
+    uint64_t flip = (is_signed) ? UINT64_MAX : 0;
+    int i = 0;
+    for (; i + 64 <= n; i += 64) {
+        uint64_t mask = (uint64_t)_mm512_movepi8_mask(_mm512_loadu_si512((const void *)(v + i))) ^ flip;
+        for (int j = 0; j < 8; ++j) q[i / 8 + j] = (uint8_t)(mask >> (8 * j));
+    }
+    bytes_quantize_bit_scalar(v, q, i, n, is_signed);
+}
+
+static void uint8_quantize_bit_avx512 (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_avx512(v, q, n, false);
+}
+
+static void int8_quantize_bit_avx512 (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_avx512(v, q, n, true);
 }
 
 #endif
@@ -953,8 +1723,83 @@ void init_distance_functions_avx512(void) {
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_avx512;
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_avx512;
 
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_avx512;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_avx512;
+    
     dispatch_distance_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_avx512;
 
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_batch_avx512;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_batch_avx512;
+    
+    dispatch_quantize_table.f32_to_u8 = float32_quantize_u8_avx512;
+    dispatch_quantize_table.f32_to_s8 = float32_quantize_s8_avx512;
+    dispatch_quantize_table.f32_to_u8_dims = float32_quantize_u8_dims_avx512;
+    dispatch_quantize_table.f32_to_s8_dims = float32_quantize_s8_dims_avx512;
+    dispatch_quantize_table.f32_to_bit = float32_quantize_bit_avx512;
+    dispatch_quantize_table.u8_to_bit = uint8_quantize_bit_avx512;
+    dispatch_quantize_table.i8_to_bit = int8_quantize_bit_avx512;
+
     distance_backend_name = "AVX512";
 #endif
 }
+
+void init_distance_functions_avx512_vnni (void) {
+    init_distance_functions_avx512();
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512VNNI__)
+    // VNNI replaces the widening multiplies of the 8-bit dot products (L1 keeps the AVX512 kernels)
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_avx512_vnni;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_avx512_vnni;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_avx512_vnni;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_avx512_vnni;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_avx512_vnni;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_avx512_vnni;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_avx512_vnni;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_avx512_vnni;
+    
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_batch_avx512_vnni;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_batch_avx512_vnni;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_batch_avx512_vnni;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_batch_avx512_vnni;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_batch_avx512_vnni;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_batch_avx512_vnni;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_batch_avx512_vnni;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_batch_avx512_vnni;
+    
+    distance_backend_name = "AVX512-VNNI";
+#endif
+}
+
+void init_distance_functions_avx512_bf16 (void) {
+#if defined(__AVX512F__) && defined(__AVX512BW__) && defined(__AVX512BF16__)
+    // applied on top of an AVX512 tier
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_BF16] = bfloat16_distance_dot_avx512_bf16;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_BF16] = bfloat16_distance_cosine_avx512_bf16;
+#endif
+}
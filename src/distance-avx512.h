@@ -11,5 +11,7 @@
 #include <stdio.h>
 
 void init_distance_functions_avx512 (void);
+void init_distance_functions_avx512_vnni (void);
+void init_distance_functions_avx512_bf16 (void);
 
 #endif
@@ -18,9 +18,12 @@
 #include "distance-avx2.h"
 #include "distance-avx512.h"
 #include "distance-rvv.h"
+#include "distance-sve.h"
 
 const char *distance_backend_name = "CPU";
 distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX] = {0};
+distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX] = {0};
+quantize_functions dispatch_quantize_table = {0};
 
 #define LASSQ_UPDATE(ad_) do {                            \
         double _ad = (ad_);                               \
@@ -741,6 +744,278 @@ float bit1_distance_hamming_cpu (const void *v1, const void *v2, int n) {
     return (float)distance;
 }
 
+// MARK: - BATCH -
+
+#define DISTANCE_BATCH_WIDTH        4       // candidates sharing every load of the query
+
+DISTANCE_BATCH_INLINE void integer_distance_block_cpu (const void *query, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    int64_t sum[DISTANCE_BATCH_WIDTH] = {0};
+    int64_t norm[DISTANCE_BATCH_WIDTH] = {0};
+    
+    for (int i = 0; i < n; ++i) {
+        int q = distance_batch_load(query, i, is_signed);
+        for (int k = 0; k < width; ++k) {
+            distance_batch_accumulate(op, q, distance_batch_load(base + (size_t)k * stride, i, is_signed), &sum[k], &norm[k]);
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        distances[k] = distance_batch_finalize(op, sum[k], norm_q, norm[k]);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = distance_batch_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        integer_distance_block_cpu(query, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_cpu(query, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+void uint8_distance_l2_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint8_distance_l1_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint8_distance_cosine_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_l1_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int8_distance_cosine_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+void bit1_distance_hamming_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        const uint8_t *b0 = b + (size_t)j * stride;
+        const uint8_t *b1 = b0 + stride;
+        const uint8_t *b2 = b1 + stride;
+        const uint8_t *b3 = b2 + stride;
+        int d0 = 0, d1 = 0, d2 = 0, d3 = 0;
+        
+        int i = 0;
+        for (; i + 8 <= n; i += 8) {
+            uint64_t xq, x0, x1, x2, x3;
+            memcpy(&xq, q + i, sizeof(uint64_t));
+            memcpy(&x0, b0 + i, sizeof(uint64_t));
+            memcpy(&x1, b1 + i, sizeof(uint64_t));
+            memcpy(&x2, b2 + i, sizeof(uint64_t));
+            memcpy(&x3, b3 + i, sizeof(uint64_t));
+            d0 += popcount64(xq ^ x0);
+            d1 += popcount64(xq ^ x1);
+            d2 += popcount64(xq ^ x2);
+            d3 += popcount64(xq ^ x3);
+        }
+        for (; i < n; ++i) {
+            d0 += popcount64(q[i] ^ b0[i]);
+            d1 += popcount64(q[i] ^ b1[i]);
+            d2 += popcount64(q[i] ^ b2[i]);
+            d3 += popcount64(q[i] ^ b3[i]);
+        }
+        
+        distances[j + 0] = (float)d0;
+        distances[j + 1] = (float)d1;
+        distances[j + 2] = (float)d2;
+        distances[j + 3] = (float)d3;
+    }
+    
+    for (; j < count; ++j) {
+        distances[j] = bit1_distance_hamming_cpu(q, b + (size_t)j * stride, n);
+    }
+}
+
+// MARK: - UINT4/INT4 -
+// packed 4-bit codes (see nibble_load), n is the number of bytes
+
+DISTANCE_BATCH_INLINE void nibble_distance_block_cpu (const void *query, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    int64_t sum[DISTANCE_BATCH_WIDTH] = {0};
+    int64_t norm[DISTANCE_BATCH_WIDTH] = {0};
+    
+    for (int i = 0; i < 2 * n; ++i) {
+        int q = nibble_load(query, i, is_signed);
+        for (int k = 0; k < width; ++k) {
+            distance_batch_accumulate(op, q, nibble_load(base + (size_t)k * stride, i, is_signed), &sum[k], &norm[k]);
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        distances[k] = distance_batch_finalize(op, sum[k], norm_q, norm[k]);
+    }
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = nibble_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        nibble_distance_block_cpu(query, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        nibble_distance_block_cpu(query, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+static inline float nibble_distance_cpu (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    nibble_distance_batch_cpu(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint4_distance_l2_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint4_distance_l2_squared_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint4_distance_dot_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint4_distance_l1_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint4_distance_cosine_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int4_distance_l2_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int4_distance_l2_squared_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int4_distance_dot_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int4_distance_l1_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int4_distance_cosine_cpu (const void *v1, const void *v2, int n) {
+    return nibble_distance_cpu(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint4_distance_l2_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint4_distance_l2_squared_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint4_distance_dot_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint4_distance_l1_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint4_distance_cosine_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int4_distance_l2_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int4_distance_l2_squared_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int4_distance_dot_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int4_distance_l1_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int4_distance_cosine_batch_cpu (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_cpu(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+// MARK: - QUANTIZE -
+
+static void float32_quantize_u8_cpu (const float *v, uint8_t *q, float offset, float scale, int n) {
+    for (int i = 0; i < n; ++i) {
+        q[i] = q_convert_u8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_s8_cpu (const float *v, uint8_t *q, float offset, float scale, int n) {
+    for (int i = 0; i < n; ++i) {
+        q[i] = (uint8_t)q_convert_s8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_u8_dims_cpu (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    for (int i = 0; i < n; ++i) {
+        q[i] = q_round_u8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_s8_dims_cpu (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    for (int i = 0; i < n; ++i) {
+        q[i] = (uint8_t)q_round_s8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_bit_cpu (const float *v, uint8_t *q, float threshold, int n) {
+    float32_quantize_bit_scalar(v, q, threshold, 0, n);
+}
+
+static void uint8_quantize_bit_cpu (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_scalar(v, q, 0, n, false);
+}
+
+static void int8_quantize_bit_cpu (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_scalar(v, q, 0, n, true);
+}
+
 // MARK: - ENTRYPOINT -
 
 #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
@@ -824,6 +1099,30 @@ float bit1_distance_hamming_cpu (const void *v1, const void *v2, int n) {
         #endif
     }
 
+    bool cpu_supports_avx512_vnni (void) {
+        if (!cpu_supports_avx512()) return false;
+        
+        // Leaf 7, Subleaf 0, ECX Bit 11: AVX512_VNNI (vpdpbusd)
+        int cpu_info[4];
+        run_cpuid(7, 0, cpu_info);
+        return (cpu_info[2] & (1 << 11)) != 0;
+    }
+
+    bool cpu_supports_avx512_bf16 (void) {
+        if (!cpu_supports_avx512()) return false;
+        
+        // Leaf 7, Subleaf 1, EAX Bit 5: AVX512_BF16 (vdpbf16ps)
+        int cpu_info[4];
+        run_cpuid(7, 1, cpu_info);
+        return (cpu_info[0] & (1 << 5)) != 0;
+    }
+
+    bool cpu_supports_f16c (void) {
+        int eax, ebx, ecx, edx;
+        x86_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+        return (ecx & (1 << 29)) != 0;  // F16C (vcvtph2ps)
+    }
+
     bool cpu_supports_sse2 (void) {
         int eax, ebx, ecx, edx;
         x86_cpuid(1, 0, &eax, &ebx, &ecx, &edx);
@@ -843,6 +1142,33 @@ float bit1_distance_hamming_cpu (const void *v1, const void *v2, int n) {
     bool cpu_supports_neon (void) {
         return true;
     }
+    
+    // dotprod and SVE are optional on aarch64: the kernels are only built when the target enables them
+    // (e.g. -march=armv8.2-a+dotprod+sve), and on Linux the kernel reports whether the CPU has them
+    #if defined(__linux__) && !defined(SQLITE_WASM_EXTRA_INIT)
+    #include <sys/auxv.h>
+    #include <asm/hwcap.h>
+    #endif
+    
+    bool cpu_supports_neon_dotprod (void) {
+        #if !defined(__ARM_FEATURE_DOTPROD)
+        return false;
+        #elif defined(__linux__) && defined(HWCAP_ASIMDDP)
+        return (getauxval(AT_HWCAP) & HWCAP_ASIMDDP) != 0;
+        #else
+        return true;    // Apple silicon and other targets built for it
+        #endif
+    }
+    
+    bool cpu_supports_sve (void) {
+        #if !defined(__ARM_FEATURE_SVE)
+        return false;
+        #elif defined(__linux__) && defined(HWCAP_SVE)
+        return (getauxval(AT_HWCAP) & HWCAP_SVE) != 0;
+        #else
+        return true;
+        #endif
+    }
     #else
         #ifdef SQLITE_WASM_EXTRA_INIT
         bool cpu_supports_neon (void) {
@@ -872,6 +1198,8 @@ void init_cpu_functions (void) {
                 [VECTOR_TYPE_BF16] = bfloat16_distance_l2_cpu,
                 [VECTOR_TYPE_U8]  = uint8_distance_l2_cpu,
                 [VECTOR_TYPE_I8]  = int8_distance_l2_cpu,
+                [VECTOR_TYPE_U4]  = uint4_distance_l2_cpu,
+                [VECTOR_TYPE_I4]  = int4_distance_l2_cpu,
             },
             [VECTOR_DISTANCE_SQUARED_L2] = {
                 [VECTOR_TYPE_F32] = float32_distance_l2_squared_cpu,
@@ -879,6 +1207,8 @@ void init_cpu_functions (void) {
                 [VECTOR_TYPE_BF16] = bfloat16_distance_l2_squared_cpu,
                 [VECTOR_TYPE_U8]  = uint8_distance_l2_squared_cpu,
                 [VECTOR_TYPE_I8]  = int8_distance_l2_squared_cpu,
+                [VECTOR_TYPE_U4]  = uint4_distance_l2_squared_cpu,
+                [VECTOR_TYPE_I4]  = int4_distance_l2_squared_cpu,
             },
             [VECTOR_DISTANCE_COSINE] = {
                 [VECTOR_TYPE_F32] = float32_distance_cosine_cpu,
@@ -886,6 +1216,8 @@ void init_cpu_functions (void) {
                 [VECTOR_TYPE_BF16] = bfloat16_distance_cosine_cpu,
                 [VECTOR_TYPE_U8]  = uint8_distance_cosine_cpu,
                 [VECTOR_TYPE_I8]  = int8_distance_cosine_cpu,
+                [VECTOR_TYPE_U4]  = uint4_distance_cosine_cpu,
+                [VECTOR_TYPE_I4]  = int4_distance_cosine_cpu,
             },
             [VECTOR_DISTANCE_DOT] = {
                 [VECTOR_TYPE_F32] = float32_distance_dot_cpu,
@@ -893,6 +1225,8 @@ void init_cpu_functions (void) {
                 [VECTOR_TYPE_BF16] = bfloat16_distance_dot_cpu,
                 [VECTOR_TYPE_U8]  = uint8_distance_dot_cpu,
                 [VECTOR_TYPE_I8]  = int8_distance_dot_cpu,
+                [VECTOR_TYPE_U4]  = uint4_distance_dot_cpu,
+                [VECTOR_TYPE_I4]  = int4_distance_dot_cpu,
             },
             [VECTOR_DISTANCE_L1] = {
                 [VECTOR_TYPE_F32] = float32_distance_l1_cpu,
@@ -900,6 +1234,8 @@ void init_cpu_functions (void) {
                 [VECTOR_TYPE_BF16] = bfloat16_distance_l1_cpu,
                 [VECTOR_TYPE_U8]  = uint8_distance_l1_cpu,
                 [VECTOR_TYPE_I8]  = int8_distance_l1_cpu,
+                [VECTOR_TYPE_U4]  = uint4_distance_l1_cpu,
+                [VECTOR_TYPE_I4]  = int4_distance_l1_cpu,
             },
             [VECTOR_DISTANCE_HAMMING] = {
                 [VECTOR_TYPE_BIT] = bit1_distance_hamming_cpu
@@ -907,6 +1243,55 @@ void init_cpu_functions (void) {
     };
     
     memcpy(dispatch_distance_table, cpu_table, sizeof(cpu_table));
+    
+    distance_batch_function_t cpu_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX] = {
+        [VECTOR_DISTANCE_L2] = {
+            [VECTOR_TYPE_U8]  = uint8_distance_l2_batch_cpu,
+            [VECTOR_TYPE_I8]  = int8_distance_l2_batch_cpu,
+            [VECTOR_TYPE_U4]  = uint4_distance_l2_batch_cpu,
+            [VECTOR_TYPE_I4]  = int4_distance_l2_batch_cpu,
+        },
+        [VECTOR_DISTANCE_SQUARED_L2] = {
+            [VECTOR_TYPE_U8]  = uint8_distance_l2_squared_batch_cpu,
+            [VECTOR_TYPE_I8]  = int8_distance_l2_squared_batch_cpu,
+            [VECTOR_TYPE_U4]  = uint4_distance_l2_squared_batch_cpu,
+            [VECTOR_TYPE_I4]  = int4_distance_l2_squared_batch_cpu,
+        },
+        [VECTOR_DISTANCE_COSINE] = {
+            [VECTOR_TYPE_U8]  = uint8_distance_cosine_batch_cpu,
+            [VECTOR_TYPE_I8]  = int8_distance_cosine_batch_cpu,
+            [VECTOR_TYPE_U4]  = uint4_distance_cosine_batch_cpu,
+            [VECTOR_TYPE_I4]  = int4_distance_cosine_batch_cpu,
+        },
+        [VECTOR_DISTANCE_DOT] = {
+            [VECTOR_TYPE_U8]  = uint8_distance_dot_batch_cpu,
+            [VECTOR_TYPE_I8]  = int8_distance_dot_batch_cpu,
+            [VECTOR_TYPE_U4]  = uint4_distance_dot_batch_cpu,
+            [VECTOR_TYPE_I4]  = int4_distance_dot_batch_cpu,
+        },
+        [VECTOR_DISTANCE_L1] = {
+            [VECTOR_TYPE_U8]  = uint8_distance_l1_batch_cpu,
+            [VECTOR_TYPE_I8]  = int8_distance_l1_batch_cpu,
+            [VECTOR_TYPE_U4]  = uint4_distance_l1_batch_cpu,
+            [VECTOR_TYPE_I4]  = int4_distance_l1_batch_cpu,
+        },
+        [VECTOR_DISTANCE_HAMMING] = {
+            [VECTOR_TYPE_BIT] = bit1_distance_hamming_batch_cpu
+        }
+    };
+    
+    memcpy(dispatch_distance_batch_table, cpu_batch_table, sizeof(cpu_batch_table));
+    
+    dispatch_quantize_table = (quantize_functions){
+        .f32_to_u8 = float32_quantize_u8_cpu,
+        .f32_to_s8 = float32_quantize_s8_cpu,
+        .f32_to_u8_dims = float32_quantize_u8_dims_cpu,
+        .f32_to_s8_dims = float32_quantize_s8_dims_cpu,
+        .f32_to_bit = float32_quantize_bit_cpu,
+        .u8_to_bit = uint8_quantize_bit_cpu,
+        .i8_to_bit = int8_quantize_bit_cpu
+    };
+    distance_backend_name = "CPU";
 }
 
 void init_distance_functions (bool force_cpu) {
@@ -914,22 +1299,32 @@ void init_distance_functions (bool force_cpu) {
     if (force_cpu) return;
     
     #if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
-    if (cpu_supports_avx512()) {
+    if (cpu_supports_avx512_vnni()) {
+        init_distance_functions_avx512_vnni();
+        if (cpu_supports_avx512_bf16()) init_distance_functions_avx512_bf16();
+    }
+    else if (cpu_supports_avx512()) {
         init_distance_functions_avx512();
+        if (cpu_supports_avx512_bf16()) init_distance_functions_avx512_bf16();
     }
     else if (cpu_supports_avx2()) {
         init_distance_functions_avx2();
+        if (cpu_supports_f16c()) init_distance_functions_avx2_f16c();
     }
     else if (cpu_supports_sse2()) {
         init_distance_functions_sse2();
     }
     #elif defined(__ARM_NEON) || defined(__aarch64__)
     if (cpu_supports_neon()) {
-        init_distance_functions_neon();
+        if (cpu_supports_neon_dotprod()) init_distance_functions_neon_dotprod();
+        else init_distance_functions_neon();
+        if (cpu_supports_sve()) init_distance_functions_sve();
     }
     #elif defined(__riscv) || defined(__riscv__)
     if (cpu_supports_rvv()) {
+        // no RVV batch kernels: scans call the vector length agnostic single pair kernels
         init_distance_functions_rvv();
+        memset(dispatch_distance_batch_table, 0, sizeof(dispatch_distance_batch_table));
     }
     #endif
 }
@@ -9,6 +9,8 @@
 #define __VECTOR_DISTANCE_CPU__
 
 #include "fp16/fp16.h"
+#include <math.h>
+#include <stddef.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -41,13 +43,21 @@ typedef enum {
     VECTOR_TYPE_I8,
     VECTOR_TYPE_BIT
 } vector_type;
-#define VECTOR_TYPE_MAX         7
+
+// dispatch slots of the packed 4-bit quantized codes (they are not column types)
+#define VECTOR_TYPE_U4          (VECTOR_TYPE_BIT + 1)
+#define VECTOR_TYPE_I4          (VECTOR_TYPE_BIT + 2)
+#define VECTOR_TYPE_MAX         9
 
 typedef enum {
     VECTOR_QUANT_AUTO = 0,
     VECTOR_QUANT_U8BIT = 1,
     VECTOR_QUANT_S8BIT = 2,
-    VECTOR_QUANT_1BIT = 3
+    VECTOR_QUANT_1BIT = 3,
+    VECTOR_QUANT_PQ = 4,
+    VECTOR_QUANT_4BIT = 5,          // 4-bit codes, signedness detected from the data (like VECTOR_QUANT_AUTO)
+    VECTOR_QUANT_U4BIT = 6,
+    VECTOR_QUANT_S4BIT = 7
 } vector_qtype;
 
 typedef enum {
@@ -62,6 +72,27 @@ typedef enum {
 
 typedef float (*distance_function_t)(const void *v1, const void *v2, int n);
 
+// distances between query and count vectors of n elements, the i-th one at base + i * stride
+typedef void (*distance_batch_function_t)(const void *query, const void *base, size_t stride, int count, int n, float *distances);
+
+// 8-bit codes of float32 values: one offset/scale pair for every element, or one per element (int8 codes are stored as uint8_t)
+typedef void (*quantize_scaled_function_t)(const float *v, uint8_t *q, float offset, float scale, int n);
+typedef void (*quantize_dims_function_t)(const float *v, uint8_t *q, const float *offsets, const float *scales, int n);
+
+// 1-bit codes, packed LSB first: bit i is set when v[i] >= threshold (float32) or when the byte v[i] is >= 128 (UINT8) or >= 0 (INT8)
+typedef void (*quantize_threshold_function_t)(const float *v, uint8_t *q, float threshold, int n);
+typedef void (*quantize_bytes_function_t)(const uint8_t *v, uint8_t *q, int n);
+
+typedef struct {
+    quantize_scaled_function_t      f32_to_u8;      // (int)round((v - offset) * scale) clamped to [0, 255]
+    quantize_scaled_function_t      f32_to_s8;      // (int)round((v - offset) * scale) clamped to [-128, 127]
+    quantize_dims_function_t        f32_to_u8_dims; // q_round_u8((v[i] - offsets[i]) * scales[i])
+    quantize_dims_function_t        f32_to_s8_dims; // q_round_s8((v[i] - offsets[i]) * scales[i])
+    quantize_threshold_function_t   f32_to_bit;
+    quantize_bytes_function_t       u8_to_bit;
+    quantize_bytes_function_t       i8_to_bit;
+} quantize_functions;
+
 // ENTRYPOINT
 void init_distance_functions (bool force_cpu);
 
@@ -130,4 +161,146 @@ static inline float float16_to_float32 (uint16_t h) {
     return fp16_ieee_to_fp32_value(h);
 }
 
+// MARK: - BATCH -
+// Batch kernels (UINT8, INT8 and BIT) accumulate exact integer sums for several candidates at a time
+// and share the conversion of those sums into a distance.
+
+// the generic kernels below are specialized for each operation by inlining, which must not be left to the compiler
+#if defined(_MSC_VER)
+#define DISTANCE_BATCH_INLINE       static __forceinline
+#else
+#define DISTANCE_BATCH_INLINE       static inline __attribute__((always_inline))
+#endif
+
+typedef enum {
+    DISTANCE_BATCH_L2,
+    DISTANCE_BATCH_SQUARED_L2,
+    DISTANCE_BATCH_DOT,
+    DISTANCE_BATCH_L1,
+    DISTANCE_BATCH_COSINE
+} distance_batch_op;
+
+static inline int distance_batch_load (const void *p, int i, bool is_signed) {
+    return (is_signed) ? (int)((const int8_t *)p)[i] : (int)((const uint8_t *)p)[i];
+}
+
+// scalar step (tails of the SIMD kernels)
+static inline void distance_batch_accumulate (distance_batch_op op, int q, int x, int64_t *sum, int64_t *norm) {
+    switch (op) {
+        case DISTANCE_BATCH_L2:
+        case DISTANCE_BATCH_SQUARED_L2: *sum += (q - x) * (q - x); break;
+        case DISTANCE_BATCH_DOT: *sum += q * x; break;
+        case DISTANCE_BATCH_L1: *sum += (q > x) ? q - x : x - q; break;
+        case DISTANCE_BATCH_COSINE: *sum += q * x; *norm += x * x; break;
+    }
+}
+
+// squared norm of the query, computed once per batch (COSINE only)
+static inline int64_t distance_batch_query_norm (distance_batch_op op, const void *query, int n, bool is_signed) {
+    int64_t norm = 0;
+    if (op != DISTANCE_BATCH_COSINE) return 0;
+    for (int i = 0; i < n; ++i) {
+        int q = distance_batch_load(query, i, is_signed);
+        norm += q * q;
+    }
+    return norm;
+}
+
+// sum is the sum of squared differences (L2), of products (DOT, COSINE) or of absolute differences (L1),
+// norm_q and norm_v the squared norms of query and vector (COSINE only)
+static inline float distance_batch_finalize (distance_batch_op op, int64_t sum, int64_t norm_q, int64_t norm_v) {
+    switch (op) {
+        case DISTANCE_BATCH_L2: return sqrtf((float)sum);
+        case DISTANCE_BATCH_SQUARED_L2: return (float)sum;
+        case DISTANCE_BATCH_DOT: return -(float)sum;
+        case DISTANCE_BATCH_L1: return (float)sum;
+        case DISTANCE_BATCH_COSINE: break;
+    }
+    
+    if (norm_q == 0 || norm_v == 0) return 1.0f;
+    float cosine_similarity = (float)sum / (sqrtf((float)norm_q) * sqrtf((float)norm_v));
+    if (cosine_similarity > 1.0f) cosine_similarity = 1.0f;
+    if (cosine_similarity < -1.0f) cosine_similarity = -1.0f;
+    return 1.0f - cosine_similarity;
+}
+
+// MARK: - NIBBLES -
+// 4-bit codes (UINT4 0..15, INT4 -8..7 in two's complement) are packed two per byte, element 2i in the low nibble of byte i.
+// Their kernels take n = bytes: an odd dimension leaves a zero nibble in both vectors, which adds nothing to any sum.
+
+static inline int nibble_load (const void *p, int i, bool is_signed) {
+    // element i of the packed codes (0 <= i < 2 * bytes)
+    int x = (((const uint8_t *)p)[i >> 1] >> ((i & 1) << 2)) & 0x0F;
+    return (is_signed) ? (x ^ 8) - 8 : x;
+}
+
+static inline int64_t nibble_query_norm (distance_batch_op op, const void *query, int n, bool is_signed) {
+    int64_t norm = 0;
+    if (op != DISTANCE_BATCH_COSINE) return 0;
+    for (int i = 0; i < 2 * n; ++i) {
+        int q = nibble_load(query, i, is_signed);
+        norm += q * q;
+    }
+    return norm;
+}
+
+// MARK: - QUANTIZE -
+// Every backend must produce the codes of the CPU kernels bit for bit: rounding is half away from zero
+// (s + 0.5 or s - 0.5, then truncated) and non-finite or out of range values saturate as below.
+
+static inline uint8_t q_round_u8 (float s) {
+    if (!isfinite(s)) {
+        return (s > 0.0f) ? 255u : 0u;   /* NaN -> 0, +Inf -> 255, -Inf -> 0 */
+    }
+    float r = s + 0.5f * (1.0f - 2.0f * (s < 0.0f));  /* half away from zero */
+    if (r >= 255.0f) return 255u;
+    if (r <= 0.0f)   return 0u;
+    int ir = (int)r;                      /* safe after the clamp above */
+    return (uint8_t)ir;
+}
+
+static inline int8_t q_round_s8 (float s) {
+    if (!isfinite(s)) {
+        return (s > 0.0f) ? 127 : (s < 0.0f ? -128 : 0);
+    }
+    /* half-away-from-zero */
+    float r = s + 0.5f * (1.0f - 2.0f * (s < 0.0f));
+    if (r >= 127.0f)  return 127;
+    if (r <= -128.0f) return -128;
+    return (int8_t)(int)r;
+}
+
+// global scale/offset codes: same rounding, but values out of the int range saturate through the float to int
+// conversion of the platform (the SIMD kernels use the vector form of the same instruction)
+static inline uint8_t q_convert_u8 (float s) {
+    int r = (int)(s + 0.5f * (1.0f - 2.0f * (s < 0.0f)));
+    return (uint8_t)(r > 255 ? 255 : (r < 0 ? 0 : r));
+}
+
+static inline int8_t q_convert_s8 (float s) {
+    int r = (int)(s + 0.5f * (1.0f - 2.0f * (s < 0.0f)));
+    return (int8_t)(r > 127 ? 127 : (r < -128 ? -128 : r));
+}
+
+// 1-bit codes from element start (a multiple of 8) to n, one output byte at a time
+static inline void float32_quantize_bit_scalar (const float *v, uint8_t *q, float threshold, int start, int n) {
+    for (int i = start; i < n; i += 8) {
+        int count = (n - i < 8) ? n - i : 8;
+        uint8_t byte = 0;
+        for (int j = 0; j < count; ++j) byte |= (uint8_t)((v[i + j] >= threshold) << j);
+        q[i / 8] = byte;
+    }
+}
+
+static inline void bytes_quantize_bit_scalar (const uint8_t *v, uint8_t *q, int start, int n, bool is_signed) {
+    // UINT8: bit set when v >= 128, INT8: when v >= 0 (the top bit is clear)
+    uint8_t flip = (is_signed) ? 1 : 0;
+    for (int i = start; i < n; i += 8) {
+        int count = (n - i < 8) ? n - i : 8;
+        uint8_t byte = 0;
+        for (int j = 0; j < count; ++j) byte |= (uint8_t)(((v[i + j] >> 7) ^ flip) << j);
+        q[i / 8] = byte;
+    }
+}
+
 #endif
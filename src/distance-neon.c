@@ -21,6 +21,8 @@
 #include <arm_neon.h>
 
 extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern quantize_functions dispatch_quantize_table;
 extern const char *distance_backend_name;
 
 // Helper function for 32-bit ARM: vmaxv_u16 is not available in ARMv7 NEON
@@ -1271,6 +1273,685 @@ float bit1_distance_hamming_neon (const void *v1, const void *v2, int n) {
     return (float)distance;
 }
 
+// MARK: - BATCH -
+
+#define DISTANCE_BATCH_WIDTH        4       // candidates sharing every load of the query
+
+static inline int64_t hsum_s32x4_neon (int32x4_t v) {
+    return (int64_t)vgetq_lane_s32(v, 0) + vgetq_lane_s32(v, 1) + vgetq_lane_s32(v, 2) + vgetq_lane_s32(v, 3);
+}
+
+static inline uint32x4_t squared_abd_u8_neon (uint32x4_t acc, uint8x16_t abd) {
+    // |a - b|^2 fits 16-bit, pairs are accumulated into 32-bit lanes
+    acc = vpadalq_u16(acc, vmull_u8(vget_low_u8(abd), vget_low_u8(abd)));
+    return vpadalq_u16(acc, vmull_u8(vget_high_u8(abd), vget_high_u8(abd)));
+}
+
+static inline int32x4_t dot_u8_neon (int32x4_t acc, uint8x16_t a, uint8x16_t b) {
+    uint32x4_t sum = vreinterpretq_u32_s32(acc);
+    sum = vpadalq_u16(sum, vmull_u8(vget_low_u8(a), vget_low_u8(b)));
+    sum = vpadalq_u16(sum, vmull_u8(vget_high_u8(a), vget_high_u8(b)));
+    return vreinterpretq_s32_u32(sum);
+}
+
+static inline int32x4_t dot_s8_neon (int32x4_t acc, uint8x16_t a, uint8x16_t b) {
+    int8x16_t sa = vreinterpretq_s8_u8(a);
+    int8x16_t sb = vreinterpretq_s8_u8(b);
+    acc = vpadalq_s16(acc, vmull_s8(vget_low_s8(sa), vget_low_s8(sb)));
+    return vpadalq_s16(acc, vmull_s8(vget_high_s8(sa), vget_high_s8(sb)));
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_block_neon (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    int32x4_t sum[DISTANCE_BATCH_WIDTH];
+    int32x4_t norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = vdupq_n_s32(0);
+        norm[k] = vdupq_n_s32(0);
+    }
+    
+    // 16 elements per step, products widened to 16-bit and pairwise accumulated into 32-bit lanes (exact)
+    int i = 0;
+    for (; i <= n - 16; i += 16) {
+        uint8x16_t vq = vld1q_u8(q + i);
+        for (int k = 0; k < width; ++k) {
+            uint8x16_t vx = vld1q_u8(base + (size_t)k * stride + i);
+            uint8x16_t abd;
+            switch (op) {
+                case DISTANCE_BATCH_L2:
+                case DISTANCE_BATCH_SQUARED_L2:
+                case DISTANCE_BATCH_L1:
+                    // the signed absolute difference (at most 255) is exact when read as unsigned
+                    abd = (is_signed) ? vreinterpretq_u8_s8(vabdq_s8(vreinterpretq_s8_u8(vq), vreinterpretq_s8_u8(vx))) : vabdq_u8(vq, vx);
+                    if (op == DISTANCE_BATCH_L1) {
+                        sum[k] = vreinterpretq_s32_u32(vpadalq_u16(vreinterpretq_u32_s32(sum[k]), vpaddlq_u8(abd)));
+                    } else {
+                        sum[k] = vreinterpretq_s32_u32(squared_abd_u8_neon(vreinterpretq_u32_s32(sum[k]), abd));
+                    }
+                    break;
+                case DISTANCE_BATCH_DOT:
+                    sum[k] = (is_signed) ? dot_s8_neon(sum[k], vq, vx) : dot_u8_neon(sum[k], vq, vx);
+                    break;
+                case DISTANCE_BATCH_COSINE:
+                    sum[k] = (is_signed) ? dot_s8_neon(sum[k], vq, vx) : dot_u8_neon(sum[k], vq, vx);
+                    norm[k] = (is_signed) ? dot_s8_neon(norm[k], vx, vx) : dot_u8_neon(norm[k], vx, vx);
+                    break;
+            }
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = hsum_s32x4_neon(sum[k]);
+        int64_t norm_x = hsum_s32x4_neon(norm[k]);
+        for (int t = i; t < n; ++t) {
+            distance_batch_accumulate(op, distance_batch_load(q, t, is_signed), distance_batch_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = distance_batch_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        integer_distance_block_neon(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_neon(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+void uint8_distance_l2_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint8_distance_l1_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint8_distance_cosine_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_l1_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int8_distance_cosine_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+void bit1_distance_hamming_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        const uint8_t *x[DISTANCE_BATCH_WIDTH];
+        uint64x2_t acc[DISTANCE_BATCH_WIDTH];
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            x[k] = b + (size_t)(j + k) * stride;
+            acc[k] = vdupq_n_u64(0);
+        }
+        
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+            uint8x16_t vq = vld1q_u8(q + i);
+            for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+                uint8x16_t popcnt = vcntq_u8(veorq_u8(vq, vld1q_u8(x[k] + i)));
+                acc[k] = vpadalq_u32(acc[k], vpaddlq_u16(vpaddlq_u8(popcnt)));
+            }
+        }
+        
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            int distance = (int)(vgetq_lane_u64(acc[k], 0) + vgetq_lane_u64(acc[k], 1));
+            distance += (int)bit1_distance_hamming_neon(q + i, x[k] + i, n - i);   // remainder
+            distances[j + k] = (float)distance;
+        }
+    }
+    
+    for (; j < count; ++j) {
+        distances[j] = bit1_distance_hamming_neon(q, b + (size_t)j * stride, n);
+    }
+}
+
+// MARK: - UINT4/INT4 -
+// packed 4-bit codes (see nibble_load), n is the number of bytes
+
+static inline void nibble_unpack_neon (const uint8_t *p, bool is_signed, uint8x16_t *lo, uint8x16_t *hi) {
+    // 16 bytes to 32 codes: the low nibbles in lo and the high ones in hi
+    // INT4 codes are sign extended by arithmetic shifts (no table lookup needed, same code on armv7)
+    uint8x16_t v = vld1q_u8(p);
+    if (is_signed) {
+        int8x16_t sv = vreinterpretq_s8_u8(v);
+        *lo = vreinterpretq_u8_s8(vshrq_n_s8(vshlq_n_s8(sv, 4), 4));
+        *hi = vreinterpretq_u8_s8(vshrq_n_s8(sv, 4));
+    } else {
+        *lo = vandq_u8(v, vdupq_n_u8(0x0F));
+        *hi = vshrq_n_u8(v, 4);
+    }
+}
+
+static inline uint8x16_t nibble_abd_neon (uint8x16_t a, uint8x16_t b, bool is_signed) {
+    return (is_signed) ? vreinterpretq_u8_s8(vabdq_s8(vreinterpretq_s8_u8(a), vreinterpretq_s8_u8(b))) : vabdq_u8(a, b);
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_block_neon (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    int32x4_t sum[DISTANCE_BATCH_WIDTH];
+    int32x4_t norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = vdupq_n_s32(0);
+        norm[k] = vdupq_n_s32(0);
+    }
+    
+    // 32 codes per step, accumulated like the 8-bit codes above (exact)
+    int i = 0;
+    for (; i <= n - 16; i += 16) {
+        uint8x16_t qlo, qhi;
+        nibble_unpack_neon(q + i, is_signed, &qlo, &qhi);
+        for (int k = 0; k < width; ++k) {
+            uint8x16_t xlo, xhi, abd;
+            nibble_unpack_neon(base + (size_t)k * stride + i, is_signed, &xlo, &xhi);
+            switch (op) {
+                case DISTANCE_BATCH_L2:
+                case DISTANCE_BATCH_SQUARED_L2:
+                    sum[k] = vreinterpretq_s32_u32(squared_abd_u8_neon(vreinterpretq_u32_s32(sum[k]), nibble_abd_neon(qlo, xlo, is_signed)));
+                    sum[k] = vreinterpretq_s32_u32(squared_abd_u8_neon(vreinterpretq_u32_s32(sum[k]), nibble_abd_neon(qhi, xhi, is_signed)));
+                    break;
+                case DISTANCE_BATCH_L1:
+                    // both differences are at most 15, their sum fits a byte
+                    abd = vaddq_u8(nibble_abd_neon(qlo, xlo, is_signed), nibble_abd_neon(qhi, xhi, is_signed));
+                    sum[k] = vreinterpretq_s32_u32(vpadalq_u16(vreinterpretq_u32_s32(sum[k]), vpaddlq_u8(abd)));
+                    break;
+                case DISTANCE_BATCH_COSINE:
+                    norm[k] = (is_signed) ? dot_s8_neon(norm[k], xlo, xlo) : dot_u8_neon(norm[k], xlo, xlo);
+                    norm[k] = (is_signed) ? dot_s8_neon(norm[k], xhi, xhi) : dot_u8_neon(norm[k], xhi, xhi);
+                    // fall through
+                case DISTANCE_BATCH_DOT:
+                    sum[k] = (is_signed) ? dot_s8_neon(sum[k], qlo, xlo) : dot_u8_neon(sum[k], qlo, xlo);
+                    sum[k] = (is_signed) ? dot_s8_neon(sum[k], qhi, xhi) : dot_u8_neon(sum[k], qhi, xhi);
+                    break;
+            }
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = hsum_s32x4_neon(sum[k]);
+        int64_t norm_x = hsum_s32x4_neon(norm[k]);
+        for (int t = 2 * i; t < 2 * n; ++t) {
+            distance_batch_accumulate(op, nibble_load(q, t, is_signed), nibble_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = nibble_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        nibble_distance_block_neon(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        nibble_distance_block_neon(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+static inline float nibble_distance_neon (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    nibble_distance_batch_neon(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint4_distance_l2_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint4_distance_l2_squared_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint4_distance_dot_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint4_distance_l1_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint4_distance_cosine_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int4_distance_l2_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int4_distance_l2_squared_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int4_distance_dot_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int4_distance_l1_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int4_distance_cosine_neon (const void *v1, const void *v2, int n) {
+    return nibble_distance_neon(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint4_distance_l2_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint4_distance_l2_squared_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint4_distance_dot_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint4_distance_l1_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint4_distance_cosine_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int4_distance_l2_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int4_distance_l2_squared_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int4_distance_dot_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int4_distance_l1_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int4_distance_cosine_batch_neon (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_neon(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+// MARK: - DOTPROD -
+#if defined(__ARM_FEATURE_DOTPROD)
+// udot/sdot sum four byte products into each 32-bit lane (exact, the lanes are summed in 64-bit).
+// Unsigned and signed codes both have their own instruction, so no bias is needed: squared differences are
+// |q - x| * |q - x| through udot, L1 sums |q - x| against ones and hamming sums the vcnt bit counts the same way.
+
+static inline int64_t hsum_u32x4_neon (uint32x4_t v) {
+    return (int64_t)vgetq_lane_u32(v, 0) + vgetq_lane_u32(v, 1) + vgetq_lane_u32(v, 2) + vgetq_lane_u32(v, 3);
+}
+
+// L2, L1: sum gets the unsigned squared or absolute differences
+// DOT, COSINE: sum gets q.x and norm x.x (COSINE only), in signed lanes for INT8
+DISTANCE_BATCH_INLINE void integer_distance_step_dotprod (distance_batch_op op, bool is_signed, uint8x16_t vq, uint8x16_t vx, uint32x4_t *sum, uint32x4_t *norm) {
+    if (op == DISTANCE_BATCH_L2 || op == DISTANCE_BATCH_SQUARED_L2 || op == DISTANCE_BATCH_L1) {
+        // the signed absolute difference (at most 255) is exact when read as unsigned
+        uint8x16_t abd = (is_signed) ? vreinterpretq_u8_s8(vabdq_s8(vreinterpretq_s8_u8(vq), vreinterpretq_s8_u8(vx))) : vabdq_u8(vq, vx);
+        *sum = vdotq_u32(*sum, abd, (op == DISTANCE_BATCH_L1) ? vdupq_n_u8(1) : abd);
+        return;
+    }
+    
+    if (is_signed) {
+        int8x16_t sq = vreinterpretq_s8_u8(vq);
+        int8x16_t sx = vreinterpretq_s8_u8(vx);
+        *sum = vreinterpretq_u32_s32(vdotq_s32(vreinterpretq_s32_u32(*sum), sq, sx));
+        if (op == DISTANCE_BATCH_COSINE) *norm = vreinterpretq_u32_s32(vdotq_s32(vreinterpretq_s32_u32(*norm), sx, sx));
+    } else {
+        *sum = vdotq_u32(*sum, vq, vx);
+        if (op == DISTANCE_BATCH_COSINE) *norm = vdotq_u32(*norm, vx, vx);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_block_dotprod (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    uint32x4_t sum[DISTANCE_BATCH_WIDTH];
+    uint32x4_t norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = vdupq_n_u32(0);
+        norm[k] = vdupq_n_u32(0);
+    }
+    
+    int i = 0;
+    for (; i <= n - 16; i += 16) {
+        uint8x16_t vq = vld1q_u8(q + i);
+        for (int k = 0; k < width; ++k) {
+            integer_distance_step_dotprod(op, is_signed, vq, vld1q_u8(base + (size_t)k * stride + i), &sum[k], &norm[k]);
+        }
+    }
+    
+    // products of INT8 codes are summed in signed lanes
+    const bool signed_lanes = (is_signed && (op == DISTANCE_BATCH_DOT || op == DISTANCE_BATCH_COSINE));
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = (signed_lanes) ? hsum_s32x4_neon(vreinterpretq_s32_u32(sum[k])) : hsum_u32x4_neon(sum[k]);
+        int64_t norm_x = hsum_u32x4_neon(norm[k]);
+        for (int t = i; t < n; ++t) {
+            distance_batch_accumulate(op, distance_batch_load(q, t, is_signed), distance_batch_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = distance_batch_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        integer_distance_block_dotprod(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_dotprod(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+static inline float integer_distance_dotprod (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    integer_distance_batch_dotprod(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint8_distance_l2_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint8_distance_l2_squared_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint8_distance_dot_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint8_distance_l1_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint8_distance_cosine_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int8_distance_l2_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int8_distance_l2_squared_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int8_distance_dot_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int8_distance_l1_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int8_distance_cosine_neon_dotprod (const void *v1, const void *v2, int n) {
+    return integer_distance_dotprod(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint8_distance_l2_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint8_distance_l1_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint8_distance_cosine_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_l1_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int8_distance_cosine_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_dotprod(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+float bit1_distance_hamming_neon_dotprod (const void *v1, const void *v2, int n) {
+    const uint8_t *a = (const uint8_t *)v1;
+    const uint8_t *b = (const uint8_t *)v2;
+    uint32x4_t acc = vdupq_n_u32(0);
+    int i = 0;
+    
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t popcnt = vcntq_u8(veorq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+        acc = vdotq_u32(acc, popcnt, vdupq_n_u8(1));
+    }
+    
+    int distance = (int)hsum_u32x4_neon(acc);
+    for (; i < n; i++) {
+        distance += __builtin_popcount(a[i] ^ b[i]);
+    }
+    
+    return (float)distance;
+}
+
+void bit1_distance_hamming_batch_neon_dotprod (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        const uint8_t *x[DISTANCE_BATCH_WIDTH];
+        uint32x4_t acc[DISTANCE_BATCH_WIDTH];
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            x[k] = b + (size_t)(j + k) * stride;
+            acc[k] = vdupq_n_u32(0);
+        }
+        
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+            uint8x16_t vq = vld1q_u8(q + i);
+            for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+                acc[k] = vdotq_u32(acc[k], vcntq_u8(veorq_u8(vq, vld1q_u8(x[k] + i))), vdupq_n_u8(1));
+            }
+        }
+        
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            int distance = (int)hsum_u32x4_neon(acc[k]);
+            distance += (int)bit1_distance_hamming_neon(q + i, x[k] + i, n - i);   // remainder
+            distances[j + k] = (float)distance;
+        }
+    }
+    
+    for (; j < count; ++j) {
+        distances[j] = bit1_distance_hamming_neon_dotprod(q, b + (size_t)j * stride, n);
+    }
+}
+#endif
+
+// MARK: - QUANTIZE -
+
+// s + 0.5 or s - 0.5 (half away from zero, truncated by the caller) where s = (v - offset) * scale
+static inline float32x4_t quantize_round_neon (float32x4_t v, float32x4_t offset, float32x4_t scale) {
+    float32x4_t s = vmulq_f32(vsubq_f32(v, offset), scale);
+    uint32x4_t negative = vandq_u32(vcltq_f32(s, vdupq_n_f32(0.0f)), vreinterpretq_u32_f32(vdupq_n_f32(1.0f)));
+    return vaddq_f32(s, vsubq_f32(vdupq_n_f32(0.5f), vreinterpretq_f32_u32(negative)));
+}
+
+// per-dimension codes saturate in float32 (NaN -> 0, vmaxq_f32 would propagate it), so the conversion never overflows
+static inline int32x4_t quantize_round_dims_neon (const float *v, const float *offsets, const float *scales, float lo, float hi) {
+    float32x4_t r = quantize_round_neon(vld1q_f32(v), vld1q_f32(offsets), vld1q_f32(scales));
+    r = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(r), vceqq_f32(r, r)));
+    r = vminq_f32(vmaxq_f32(r, vdupq_n_f32(lo)), vdupq_n_f32(hi));
+    return vcvtq_s32_f32(r);
+}
+
+static inline int16x8_t quantize_narrow_neon (int32x4_t a, int32x4_t b) {
+    return vcombine_s16(vqmovn_s32(a), vqmovn_s32(b));
+}
+
+static void float32_quantize_u8_neon (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const float32x4_t vo = vdupq_n_f32(offset);
+    const float32x4_t vs = vdupq_n_f32(scale);
+    int i = 0;
+    
+    // vcvtq_s32_f32 saturates like the scalar conversion, the saturating narrows clamp to [0, 255]
+    for (; i + 16 <= n; i += 16) {
+        int32x4_t r0 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i), vo, vs));
+        int32x4_t r1 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i + 4), vo, vs));
+        int32x4_t r2 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i + 8), vo, vs));
+        int32x4_t r3 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i + 12), vo, vs));
+        uint8x16_t packed = vcombine_u8(vqmovun_s16(quantize_narrow_neon(r0, r1)), vqmovun_s16(quantize_narrow_neon(r2, r3)));
+        vst1q_u8(q + i, packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = q_convert_u8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_s8_neon (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const float32x4_t vo = vdupq_n_f32(offset);
+    const float32x4_t vs = vdupq_n_f32(scale);
+    int i = 0;
+    
+    for (; i + 16 <= n; i += 16) {
+        int32x4_t r0 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i), vo, vs));
+        int32x4_t r1 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i + 4), vo, vs));
+        int32x4_t r2 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i + 8), vo, vs));
+        int32x4_t r3 = vcvtq_s32_f32(quantize_round_neon(vld1q_f32(v + i + 12), vo, vs));
+        int8x16_t packed = vcombine_s8(vqmovn_s16(quantize_narrow_neon(r0, r1)), vqmovn_s16(quantize_narrow_neon(r2, r3)));
+        vst1q_s8((int8_t *)(q + i), packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = (uint8_t)q_convert_s8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_u8_dims_neon (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int32x4_t r0 = quantize_round_dims_neon(v + i, offsets + i, scales + i, 0.0f, 255.0f);
+        int32x4_t r1 = quantize_round_dims_neon(v + i + 4, offsets + i + 4, scales + i + 4, 0.0f, 255.0f);
+        int32x4_t r2 = quantize_round_dims_neon(v + i + 8, offsets + i + 8, scales + i + 8, 0.0f, 255.0f);
+        int32x4_t r3 = quantize_round_dims_neon(v + i + 12, offsets + i + 12, scales + i + 12, 0.0f, 255.0f);
+        uint8x16_t packed = vcombine_u8(vqmovun_s16(quantize_narrow_neon(r0, r1)), vqmovun_s16(quantize_narrow_neon(r2, r3)));
+        vst1q_u8(q + i, packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = q_round_u8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_s8_dims_neon (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int32x4_t r0 = quantize_round_dims_neon(v + i, offsets + i, scales + i, -128.0f, 127.0f);
+        int32x4_t r1 = quantize_round_dims_neon(v + i + 4, offsets + i + 4, scales + i + 4, -128.0f, 127.0f);
+        int32x4_t r2 = quantize_round_dims_neon(v + i + 8, offsets + i + 8, scales + i + 8, -128.0f, 127.0f);
+        int32x4_t r3 = quantize_round_dims_neon(v + i + 12, offsets + i + 12, scales + i + 12, -128.0f, 127.0f);
+        int8x16_t packed = vcombine_s8(vqmovn_s16(quantize_narrow_neon(r0, r1)), vqmovn_s16(quantize_narrow_neon(r2, r3)));
+        vst1q_s8((int8_t *)(q + i), packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = (uint8_t)q_round_s8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_bit_neon (const float *v, uint8_t *q, float threshold, int n) {
+    static const uint32_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    const uint32x4_t w_lo = vld1q_u32(weights);
+    const uint32x4_t w_hi = vld1q_u32(weights + 4);
+    const float32x4_t t = vdupq_n_f32(threshold);
+    int i = 0;
+    
+    // each lane keeps its bit weight where v >= threshold, then the 8 lanes are OR-reduced into one byte
+    for (; i + 8 <= n; i += 8) {
+        uint32x4_t lo = vandq_u32(vcgeq_f32(vld1q_f32(v + i), t), w_lo);
+        uint32x4_t hi = vandq_u32(vcgeq_f32(vld1q_f32(v + i + 4), t), w_hi);
+        uint32x4_t m = vorrq_u32(lo, hi);
+        uint32x2_t p = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+        q[i / 8] = (uint8_t)(vget_lane_u32(p, 0) | vget_lane_u32(p, 1));
+    }
+    float32_quantize_bit_scalar(v, q, threshold, i, n);
+}
+
+static inline void bytes_quantize_bit_neon (const uint8_t *v, uint8_t *q, int n, bool is_signed) {
+    // the top bit of each byte is shifted into its position in the output byte and summed pairwise:
+    // set for UINT8 >= 128, clear for INT8 >= 0 (inverted first)
+    static const int8_t shifts[16] = {0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7};
+    const int8x16_t vshift = vld1q_s8(shifts);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t x = vld1q_u8(v + i);
+        if (is_signed) x = vmvnq_u8(x);
+        uint8x16_t bits = vshlq_u8(vshrq_n_u8(x, 7), vshift);
+        uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(bits)));
+        q[i / 8] = (uint8_t)vgetq_lane_u64(sum, 0);
+        q[i / 8 + 1] = (uint8_t)vgetq_lane_u64(sum, 1);
+    }
+    bytes_quantize_bit_scalar(v, q, i, n, is_signed);
+}
+
+static void uint8_quantize_bit_neon (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_neon(v, q, n, false);
+}
+
+static void int8_quantize_bit_neon (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_neon(v, q, n, true);
+}
+
 #endif
 
 // MARK: -
@@ -1307,8 +1988,81 @@ void init_distance_functions_neon (void) {
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_neon;
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_neon;
     
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_neon;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_neon;
+    
     dispatch_distance_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_neon;
     
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_batch_neon;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_batch_neon;
+    
+    dispatch_quantize_table.f32_to_u8 = float32_quantize_u8_neon;
+    dispatch_quantize_table.f32_to_s8 = float32_quantize_s8_neon;
+    dispatch_quantize_table.f32_to_u8_dims = float32_quantize_u8_dims_neon;
+    dispatch_quantize_table.f32_to_s8_dims = float32_quantize_s8_dims_neon;
+    dispatch_quantize_table.f32_to_bit = float32_quantize_bit_neon;
+    dispatch_quantize_table.u8_to_bit = uint8_quantize_bit_neon;
+    dispatch_quantize_table.i8_to_bit = int8_quantize_bit_neon;
+    
     distance_backend_name = "NEON";
 #endif
 }
+
+void init_distance_functions_neon_dotprod (void) {
+    init_distance_functions_neon();
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__ARM_FEATURE_DOTPROD)
+    // udot/sdot replace the widening multiplies of the 8-bit kernels and the pairwise sums of the bit counts
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_neon_dotprod;
+    dispatch_distance_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_neon_dotprod;
+    
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_batch_neon_dotprod;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_batch_neon_dotprod;
+    
+    distance_backend_name = "NEON-DOTPROD";
+#endif
+}
@@ -11,5 +11,6 @@
 #include <stdio.h>
 
 void init_distance_functions_neon (void);
+void init_distance_functions_neon_dotprod (void);
 
 #endif
@@ -15,6 +15,7 @@
 #include <stdlib.h>
 
 extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern quantize_functions dispatch_quantize_table;
 extern const char *distance_backend_name;
 
 // MARK: - UTILS -
@@ -67,6 +68,14 @@ static inline int32_t int32_sum_vector_i32m8 (vint32m8_t vec, size_t vl) {
     return __riscv_vmv_x_s_i32m1_i32(acc);
 }
 
+// Reduces a vector by summing all of it's elements into a single scalar integer
+static inline int32_t int32_sum_vector_i32m4 (vint32m4_t vec, size_t vl) {
+    vint32m1_t acc = __riscv_vmv_s_x_i32m1(0, 1);
+    vl = __riscv_vsetvl_e32m4(vl);
+    acc = __riscv_vredsum_vs_i32m4_i32m1(vec, acc, vl);
+    return __riscv_vmv_x_s_i32m1_i32(acc);
+}
+
 // Scalar-load fp16 payloads, convert to fp32, and pack as an f32m2 vector.
 static inline vfloat32m2_t rvv_load_f16_as_f32m2 (const uint16_t *src, size_t n) {
     size_t vl = __riscv_vsetvl_e32m2(n);
@@ -985,6 +994,202 @@ float bit1_distance_hamming_rvv (const void *v1, const void *v2, int n) {
     // Copy the accumulator back into a scalar register
     return (float) uint64_sum_vector_u64m8(vdistance, vl);
 }
+
+// MARK: - UINT4/INT4 -
+// packed 4-bit codes (see nibble_load), n is the number of bytes
+
+static inline vint16m2_t nibble_unpack_rvv (vuint8m1_t v, bool high, bool is_signed, size_t vl) {
+    // one nibble of each byte widened to 16-bit, INT4 codes are sign extended by arithmetic shifts
+    vint8m1_t codes;
+    if (is_signed) {
+        codes = __riscv_vreinterpret_v_u8m1_i8m1(v);
+        if (!high) codes = __riscv_vsll_vx_i8m1(codes, 4, vl);
+        codes = __riscv_vsra_vx_i8m1(codes, 4, vl);
+    } else {
+        v = (high) ? __riscv_vsrl_vx_u8m1(v, 4, vl) : __riscv_vand_vx_u8m1(v, 0x0F, vl);
+        codes = __riscv_vreinterpret_v_u8m1_i8m1(v);
+    }
+    return __riscv_vwcvt_x_x_v_i16m2(codes, vl);
+}
+
+static inline void nibble_accumulate_rvv (distance_batch_op op, vint16m2_t va, vint16m2_t vb, vint32m4_t *vsum, vint32m4_t *vnorm_a, vint32m4_t *vnorm_b, size_t vl) {
+    // tail undisturbed, so the last (shorter) step keeps the other lanes of the accumulators
+    vint16m2_t vdiff;
+    switch (op) {
+        case DISTANCE_BATCH_L2:
+        case DISTANCE_BATCH_SQUARED_L2:
+            vdiff = __riscv_vsub_vv_i16m2(va, vb, vl);
+            *vsum = __riscv_vwmacc_vv_i32m4_tu(*vsum, vdiff, vdiff, vl);
+            break;
+        case DISTANCE_BATCH_L1:
+            vdiff = __riscv_vsub_vv_i16m2(va, vb, vl);
+            vdiff = __riscv_vmax_vv_i16m2(vdiff, __riscv_vneg_v_i16m2(vdiff, vl), vl);
+            *vsum = __riscv_vwadd_wv_i32m4_tu(*vsum, *vsum, vdiff, vl);
+            break;
+        case DISTANCE_BATCH_COSINE:
+            *vnorm_a = __riscv_vwmacc_vv_i32m4_tu(*vnorm_a, va, va, vl);
+            *vnorm_b = __riscv_vwmacc_vv_i32m4_tu(*vnorm_b, vb, vb, vl);
+            // fall through
+        case DISTANCE_BATCH_DOT:
+            *vsum = __riscv_vwmacc_vv_i32m4_tu(*vsum, va, vb, vl);
+            break;
+    }
+}
+
+static inline float nibble_distance_rvv (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    const uint8_t *a = (const uint8_t *)v1;
+    const uint8_t *b = (const uint8_t *)v2;
+    
+    // We accumulate the results into vector registers
+    size_t vlmax = __riscv_vsetvlmax_e32m4();
+    vint32m4_t vsum = __riscv_vmv_v_x_i32m4(0, vlmax);
+    vint32m4_t vnorm_a = __riscv_vmv_v_x_i32m4(0, vlmax);
+    vint32m4_t vnorm_b = __riscv_vmv_v_x_i32m4(0, vlmax);
+    
+    // Iterate by VL bytes, each one holds two codes
+    size_t vl;
+    for (size_t i = n; i > 0; i -= vl) {
+        vl = __riscv_vsetvl_e8m1(i);
+        vuint8m1_t va = __riscv_vle8_v_u8m1(a, vl);
+        vuint8m1_t vb = __riscv_vle8_v_u8m1(b, vl);
+        
+        nibble_accumulate_rvv(op, nibble_unpack_rvv(va, false, is_signed, vl), nibble_unpack_rvv(vb, false, is_signed, vl), &vsum, &vnorm_a, &vnorm_b, vl);
+        nibble_accumulate_rvv(op, nibble_unpack_rvv(va, true, is_signed, vl), nibble_unpack_rvv(vb, true, is_signed, vl), &vsum, &vnorm_a, &vnorm_b, vl);
+        
+        a = &a[vl];
+        b = &b[vl];
+    }
+    
+    // same finalization as the scalar kernels
+    return distance_batch_finalize(op, int32_sum_vector_i32m4(vsum, vlmax), int32_sum_vector_i32m4(vnorm_a, vlmax), int32_sum_vector_i32m4(vnorm_b, vlmax));
+}
+
+float uint4_distance_l2_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint4_distance_l2_squared_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint4_distance_dot_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint4_distance_l1_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint4_distance_cosine_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int4_distance_l2_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int4_distance_l2_squared_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int4_distance_dot_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int4_distance_l1_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int4_distance_cosine_rvv (const void *v1, const void *v2, int n) {
+    return nibble_distance_rvv(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+// MARK: - QUANTIZE -
+
+// s + 0.5 or s - 0.5 (half away from zero, truncated by the caller)
+static inline vfloat32m4_t quantize_round_rvv (vfloat32m4_t s, size_t vl) {
+    vbool8_t negative = __riscv_vmflt_vf_f32m4_b8(s, 0.0f, vl);
+    vfloat32m4_t half = __riscv_vfmerge_vfm_f32m4(__riscv_vfmv_v_f_f32m4(0.5f, vl), -0.5f, negative, vl);
+    return __riscv_vfadd_vv_f32m4(s, half, vl);
+}
+
+// int32 -> int8 through two narrowing steps, the values are already clamped
+static inline void quantize_store_rvv (uint8_t *q, vint32m4_t r, size_t vl) {
+    vint8m1_t packed = __riscv_vncvt_x_x_w_i8m1(__riscv_vncvt_x_x_w_i16m2(r, vl), vl);
+    __riscv_vse8_v_i8m1((int8_t *)q, packed, vl);
+}
+
+static inline void float32_quantize_scaled_rvv (const float *v, uint8_t *q, float offset, float scale, int n, int lo, int hi) {
+    // vfcvt_rtz saturates like the scalar conversion, so no scalar tail is needed
+    for (size_t i = 0, vl; i < (size_t)n; i += vl) {
+        vl = __riscv_vsetvl_e32m4((size_t)n - i);
+        vfloat32m4_t s = __riscv_vfmul_vf_f32m4(__riscv_vfsub_vf_f32m4(__riscv_vle32_v_f32m4(v + i, vl), offset, vl), scale, vl);
+        vint32m4_t r = __riscv_vfcvt_rtz_x_f_v_i32m4(quantize_round_rvv(s, vl), vl);
+        r = __riscv_vmin_vx_i32m4(__riscv_vmax_vx_i32m4(r, lo, vl), hi, vl);
+        quantize_store_rvv(q + i, r, vl);
+    }
+}
+
+static inline void float32_quantize_dims_rvv (const float *v, uint8_t *q, const float *offsets, const float *scales, int n, float lo, float hi) {
+    // per-dimension codes saturate in float32 (NaN -> 0), so the conversion never overflows
+    for (size_t i = 0, vl; i < (size_t)n; i += vl) {
+        vl = __riscv_vsetvl_e32m4((size_t)n - i);
+        vfloat32m4_t d = __riscv_vfsub_vv_f32m4(__riscv_vle32_v_f32m4(v + i, vl), __riscv_vle32_v_f32m4(offsets + i, vl), vl);
+        vfloat32m4_t r = quantize_round_rvv(__riscv_vfmul_vv_f32m4(d, __riscv_vle32_v_f32m4(scales + i, vl), vl), vl);
+        r = __riscv_vfmerge_vfm_f32m4(r, 0.0f, __riscv_vmfne_vv_f32m4_b8(r, r, vl), vl);
+        r = __riscv_vfmin_vf_f32m4(__riscv_vfmax_vf_f32m4(r, lo, vl), hi, vl);
+        quantize_store_rvv(q + i, __riscv_vfcvt_rtz_x_f_v_i32m4(r, vl), vl);
+    }
+}
+
+static void float32_quantize_u8_rvv (const float *v, uint8_t *q, float offset, float scale, int n) {
+    float32_quantize_scaled_rvv(v, q, offset, scale, n, 0, 255);
+}
+
+static void float32_quantize_s8_rvv (const float *v, uint8_t *q, float offset, float scale, int n) {
+    float32_quantize_scaled_rvv(v, q, offset, scale, n, -128, 127);
+}
+
+static void float32_quantize_u8_dims_rvv (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    float32_quantize_dims_rvv(v, q, offsets, scales, n, 0.0f, 255.0f);
+}
+
+static void float32_quantize_s8_dims_rvv (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    float32_quantize_dims_rvv(v, q, offsets, scales, n, -128.0f, 127.0f);
+}
+
+static void float32_quantize_bit_rvv (const float *v, uint8_t *q, float threshold, int n) {
+    // mask registers store one bit per element in element order, which is the BIT layout;
+    // full vectors only (VLMAX is a multiple of 8), the remainder goes through the scalar path
+    size_t vl = __riscv_vsetvlmax_e32m8();
+    int i = 0;
+    for (; i + (int)vl <= n; i += (int)vl) {
+        vbool4_t m = __riscv_vmfge_vf_f32m8_b4(__riscv_vle32_v_f32m8(v + i, vl), threshold, vl);
+        __riscv_vsm_v_b4(q + i / 8, m, vl);
+    }
+    float32_quantize_bit_scalar(v, q, threshold, i, n);
+}
+
+static inline void bytes_quantize_bit_rvv (const uint8_t *v, uint8_t *q, int n, bool is_signed) {
+    // UINT8: bit set when v >= 128, INT8: when v >= 0 (below 128 as unsigned)
+    size_t vl = __riscv_vsetvlmax_e8m8();
+    int i = 0;
+    for (; i + (int)vl <= n; i += (int)vl) {
+        vuint8m8_t x = __riscv_vle8_v_u8m8(v + i, vl);
+        vbool1_t m = (is_signed) ? __riscv_vmsltu_vx_u8m8_b1(x, 128, vl) : __riscv_vmsgeu_vx_u8m8_b1(x, 128, vl);
+        __riscv_vsm_v_b1(q + i / 8, m, vl);
+    }
+    bytes_quantize_bit_scalar(v, q, i, n, is_signed);
+}
+
+static void uint8_quantize_bit_rvv (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_rvv(v, q, n, false);
+}
+
+static void int8_quantize_bit_rvv (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_rvv(v, q, n, true);
+}
+
 #endif
 
 // MARK: -
@@ -1021,8 +1226,27 @@ void init_distance_functions_rvv (void) {
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_rvv;
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_rvv;
     
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_rvv;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_rvv;
+    
     dispatch_distance_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_rvv;
     
+    dispatch_quantize_table.f32_to_u8 = float32_quantize_u8_rvv;
+    dispatch_quantize_table.f32_to_s8 = float32_quantize_s8_rvv;
+    dispatch_quantize_table.f32_to_u8_dims = float32_quantize_u8_dims_rvv;
+    dispatch_quantize_table.f32_to_s8_dims = float32_quantize_s8_dims_rvv;
+    dispatch_quantize_table.f32_to_bit = float32_quantize_bit_rvv;
+    dispatch_quantize_table.u8_to_bit = uint8_quantize_bit_rvv;
+    dispatch_quantize_table.i8_to_bit = int8_quantize_bit_rvv;
+    
     distance_backend_name = "RVV";
 #endif
 }
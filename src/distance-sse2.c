@@ -14,6 +14,8 @@
 #include <math.h>
 
 extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern quantize_functions dispatch_quantize_table;
 extern const char *distance_backend_name;
 
 // accumulate 32-bit
@@ -786,12 +788,8 @@ float uint8_distance_cosine_sse2 (const void *v1, const void *v2, int n) {
         total_b2  += vb * vb;
     }
 
-    float denom = sqrtf((float)total_a2 * (float)total_b2);
-    if (denom == 0.0f) return 1.0f; // orthogonal or zero
-    float cosine_sim = total_dot / denom;
-    if (cosine_sim > 1.0f) cosine_sim = 1.0f;
-    if (cosine_sim < -1.0f) cosine_sim = -1.0f;
-    return 1.0f - cosine_sim; // cosine distance
+    // same finalization as the CPU and batch kernels, so streamed and batched scans rank identically
+    return distance_batch_finalize(DISTANCE_BATCH_COSINE, total_dot, total_a2, total_b2);
 }
 
 // MARK: - INT8 -
@@ -1004,12 +1002,7 @@ float int8_distance_cosine_sse2 (const void *v1, const void *v2, int n) {
         total_b2  += vb * vb;
     }
 
-    float denom = sqrtf((float)total_a2 * (float)total_b2);
-    if (denom == 0.0f) return 1.0f;
-    float cosine_sim = total_dot / denom;
-    if (cosine_sim > 1.0f) cosine_sim = 1.0f;
-    if (cosine_sim < -1.0f) cosine_sim = -1.0f;
-    return 1.0f - cosine_sim;
+    return distance_batch_finalize(DISTANCE_BATCH_COSINE, total_dot, total_a2, total_b2);
 }
 
 // MARK: - BIT -
@@ -1073,6 +1066,443 @@ float bit1_distance_hamming_sse2 (const void *v1, const void *v2, int n) {
     return (float)distance;
 }
 
+// MARK: - BATCH -
+
+#define DISTANCE_BATCH_WIDTH        4       // candidates sharing every load of the query
+
+static inline __m128i int8x8_to_epi16_loadu (const uint8_t *p, bool is_signed) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)p);
+    // SSE2 has no widening moves: unpack with zero, or with itself and shift arithmetically to sign extend
+    return (is_signed) ? _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8) : _mm_unpacklo_epi8(v, _mm_setzero_si128());
+}
+
+static inline int64_t hsum128_epi32 (__m128i v) {
+    int32_t temp[4];
+    _mm_storeu_si128((__m128i *)temp, v);
+    return (int64_t)temp[0] + temp[1] + temp[2] + temp[3];
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_block_sse2 (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum[DISTANCE_BATCH_WIDTH];
+    __m128i norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = _mm_setzero_si128();
+        norm[k] = _mm_setzero_si128();
+    }
+    
+    // 8 elements widened to 16-bit per step, pairs of products summed to 32-bit by madd (exact)
+    int i = 0;
+    for (; i <= n - 8; i += 8) {
+        __m128i vq = int8x8_to_epi16_loadu(q + i, is_signed);
+        for (int k = 0; k < width; ++k) {
+            __m128i vx = int8x8_to_epi16_loadu(base + (size_t)k * stride + i, is_signed);
+            __m128i d;
+            switch (op) {
+                case DISTANCE_BATCH_L2:
+                case DISTANCE_BATCH_SQUARED_L2:
+                    d = _mm_sub_epi16(vq, vx);
+                    sum[k] = _mm_add_epi32(sum[k], _mm_madd_epi16(d, d));
+                    break;
+                case DISTANCE_BATCH_DOT:
+                    sum[k] = _mm_add_epi32(sum[k], _mm_madd_epi16(vq, vx));
+                    break;
+                case DISTANCE_BATCH_L1:
+                    d = _mm_sub_epi16(vq, vx);
+                    d = _mm_max_epi16(d, _mm_sub_epi16(_mm_setzero_si128(), d));
+                    sum[k] = _mm_add_epi32(sum[k], _mm_madd_epi16(d, ones));
+                    break;
+                case DISTANCE_BATCH_COSINE:
+                    sum[k] = _mm_add_epi32(sum[k], _mm_madd_epi16(vq, vx));
+                    norm[k] = _mm_add_epi32(norm[k], _mm_madd_epi16(vx, vx));
+                    break;
+            }
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = hsum128_epi32(sum[k]);
+        int64_t norm_x = hsum128_epi32(norm[k]);
+        for (int t = i; t < n; ++t) {
+            distance_batch_accumulate(op, distance_batch_load(q, t, is_signed), distance_batch_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = distance_batch_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        integer_distance_block_sse2(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_sse2(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+void uint8_distance_l2_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint8_distance_l1_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint8_distance_cosine_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_l1_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int8_distance_cosine_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+void bit1_distance_hamming_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        const uint8_t *x[DISTANCE_BATCH_WIDTH];
+        __m128i acc[DISTANCE_BATCH_WIDTH];
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            x[k] = b + (size_t)(j + k) * stride;
+            acc[k] = _mm_setzero_si128();
+        }
+        
+        int i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i vq = _mm_loadu_si128((const __m128i *)(q + i));
+            for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+                __m128i xored = _mm_xor_si128(vq, _mm_loadu_si128((const __m128i *)(x[k] + i)));
+                acc[k] = _mm_add_epi64(acc[k], _mm_sad_epu8(popcount_sse2(xored), _mm_setzero_si128()));
+            }
+        }
+        
+        for (int k = 0; k < DISTANCE_BATCH_WIDTH; ++k) {
+            uint64_t temp[2];
+            _mm_storeu_si128((__m128i *)temp, acc[k]);
+            int distance = (int)(temp[0] + temp[1]);
+            distance += (int)bit1_distance_hamming_sse2(q + i, x[k] + i, n - i);   // remainder
+            distances[j + k] = (float)distance;
+        }
+    }
+    
+    for (; j < count; ++j) {
+        distances[j] = bit1_distance_hamming_sse2(q, b + (size_t)j * stride, n);
+    }
+}
+
+// MARK: - UINT4/INT4 -
+// packed 4-bit codes (see nibble_load), n is the number of bytes
+
+static inline void nibble_unpack_sse2 (const uint8_t *p, bool is_signed, __m128i *lo, __m128i *hi) {
+    // 8 bytes to 16 codes widened to 16-bit: the low nibbles in lo and the high ones in hi
+    // SSE2 has no byte shuffle: INT4 codes are sign extended as (x ^ 8) - 8
+    __m128i v = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)p), _mm_setzero_si128());
+    *lo = _mm_and_si128(v, _mm_set1_epi16(0x0F));
+    *hi = _mm_srli_epi16(v, 4);
+    if (is_signed) {
+        const __m128i eight = _mm_set1_epi16(8);
+        *lo = _mm_sub_epi16(_mm_xor_si128(*lo, eight), eight);
+        *hi = _mm_sub_epi16(_mm_xor_si128(*hi, eight), eight);
+    }
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_block_sse2 (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum[DISTANCE_BATCH_WIDTH];
+    __m128i norm[DISTANCE_BATCH_WIDTH];
+    for (int k = 0; k < width; ++k) {
+        sum[k] = _mm_setzero_si128();
+        norm[k] = _mm_setzero_si128();
+    }
+    
+    // 16 codes per step, pairs of products summed to 32-bit by madd (exact)
+    int i = 0;
+    for (; i <= n - 8; i += 8) {
+        __m128i qlo, qhi;
+        nibble_unpack_sse2(q + i, is_signed, &qlo, &qhi);
+        for (int k = 0; k < width; ++k) {
+            __m128i xlo, xhi, dlo, dhi;
+            nibble_unpack_sse2(base + (size_t)k * stride + i, is_signed, &xlo, &xhi);
+            switch (op) {
+                case DISTANCE_BATCH_L2:
+                case DISTANCE_BATCH_SQUARED_L2:
+                    dlo = _mm_sub_epi16(qlo, xlo);
+                    dhi = _mm_sub_epi16(qhi, xhi);
+                    sum[k] = _mm_add_epi32(sum[k], _mm_add_epi32(_mm_madd_epi16(dlo, dlo), _mm_madd_epi16(dhi, dhi)));
+                    break;
+                case DISTANCE_BATCH_L1:
+                    dlo = _mm_sub_epi16(qlo, xlo);
+                    dhi = _mm_sub_epi16(qhi, xhi);
+                    dlo = _mm_max_epi16(dlo, _mm_sub_epi16(_mm_setzero_si128(), dlo));
+                    dhi = _mm_max_epi16(dhi, _mm_sub_epi16(_mm_setzero_si128(), dhi));
+                    sum[k] = _mm_add_epi32(sum[k], _mm_madd_epi16(_mm_add_epi16(dlo, dhi), ones));
+                    break;
+                case DISTANCE_BATCH_COSINE:
+                    norm[k] = _mm_add_epi32(norm[k], _mm_add_epi32(_mm_madd_epi16(xlo, xlo), _mm_madd_epi16(xhi, xhi)));
+                    // fall through
+                case DISTANCE_BATCH_DOT:
+                    sum[k] = _mm_add_epi32(sum[k], _mm_add_epi32(_mm_madd_epi16(qlo, xlo), _mm_madd_epi16(qhi, xhi)));
+                    break;
+            }
+        }
+    }
+    
+    for (int k = 0; k < width; ++k) {
+        const uint8_t *x = base + (size_t)k * stride;
+        int64_t total = hsum128_epi32(sum[k]);
+        int64_t norm_x = hsum128_epi32(norm[k]);
+        for (int t = 2 * i; t < 2 * n; ++t) {
+            distance_batch_accumulate(op, nibble_load(q, t, is_signed), nibble_load(x, t, is_signed), &total, &norm_x);
+        }
+        distances[k] = distance_batch_finalize(op, total, norm_q, norm_x);
+    }
+}
+
+DISTANCE_BATCH_INLINE void nibble_distance_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = nibble_query_norm(op, query, n, is_signed);
+    
+    int j = 0;
+    for (; j + DISTANCE_BATCH_WIDTH <= count; j += DISTANCE_BATCH_WIDTH) {
+        nibble_distance_block_sse2(q, b + (size_t)j * stride, stride, DISTANCE_BATCH_WIDTH, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        nibble_distance_block_sse2(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+static inline float nibble_distance_sse2 (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    nibble_distance_batch_sse2(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint4_distance_l2_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint4_distance_l2_squared_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint4_distance_dot_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint4_distance_l1_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint4_distance_cosine_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int4_distance_l2_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int4_distance_l2_squared_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int4_distance_dot_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int4_distance_l1_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int4_distance_cosine_sse2 (const void *v1, const void *v2, int n) {
+    return nibble_distance_sse2(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint4_distance_l2_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint4_distance_l2_squared_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint4_distance_dot_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint4_distance_l1_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint4_distance_cosine_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int4_distance_l2_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int4_distance_l2_squared_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int4_distance_dot_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int4_distance_l1_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int4_distance_cosine_batch_sse2 (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    nibble_distance_batch_sse2(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+// MARK: - QUANTIZE -
+
+// s + 0.5 or s - 0.5 (half away from zero, truncated by the caller) where s = (v - offset) * scale
+static inline __m128 quantize_round_sse2 (__m128 v, __m128 offset, __m128 scale) {
+    __m128 s = _mm_mul_ps(_mm_sub_ps(v, offset), scale);
+    __m128 negative = _mm_and_ps(_mm_cmplt_ps(s, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    return _mm_add_ps(s, _mm_sub_ps(_mm_set1_ps(0.5f), negative));
+}
+
+// per-dimension codes saturate in float32 (NaN -> 0), so the conversion never overflows
+static inline __m128i quantize_round_dims_sse2 (const float *v, const float *offsets, const float *scales, float lo, float hi) {
+    __m128 r = quantize_round_sse2(_mm_loadu_ps(v), _mm_loadu_ps(offsets), _mm_loadu_ps(scales));
+    r = _mm_and_ps(r, _mm_cmpord_ps(r, r));
+    r = _mm_min_ps(_mm_max_ps(r, _mm_set1_ps(lo)), _mm_set1_ps(hi));
+    return _mm_cvttps_epi32(r);
+}
+
+static void float32_quantize_u8_sse2 (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const __m128 vo = _mm_set1_ps(offset);
+    const __m128 vs = _mm_set1_ps(scale);
+    int i = 0;
+    
+    // the two saturating packs clamp the int32 results to [0, 255]
+    for (; i + 16 <= n; i += 16) {
+        __m128i r0 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i), vo, vs));
+        __m128i r1 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i + 4), vo, vs));
+        __m128i r2 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i + 8), vo, vs));
+        __m128i r3 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i + 12), vo, vs));
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+        _mm_storeu_si128((__m128i *)(q + i), packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = q_convert_u8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_s8_sse2 (const float *v, uint8_t *q, float offset, float scale, int n) {
+    const __m128 vo = _mm_set1_ps(offset);
+    const __m128 vs = _mm_set1_ps(scale);
+    int i = 0;
+    
+    for (; i + 16 <= n; i += 16) {
+        __m128i r0 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i), vo, vs));
+        __m128i r1 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i + 4), vo, vs));
+        __m128i r2 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i + 8), vo, vs));
+        __m128i r3 = _mm_cvttps_epi32(quantize_round_sse2(_mm_loadu_ps(v + i + 12), vo, vs));
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+        _mm_storeu_si128((__m128i *)(q + i), packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = (uint8_t)q_convert_s8((v[i] - offset) * scale);
+    }
+}
+
+static void float32_quantize_u8_dims_sse2 (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i r0 = quantize_round_dims_sse2(v + i, offsets + i, scales + i, 0.0f, 255.0f);
+        __m128i r1 = quantize_round_dims_sse2(v + i + 4, offsets + i + 4, scales + i + 4, 0.0f, 255.0f);
+        __m128i r2 = quantize_round_dims_sse2(v + i + 8, offsets + i + 8, scales + i + 8, 0.0f, 255.0f);
+        __m128i r3 = quantize_round_dims_sse2(v + i + 12, offsets + i + 12, scales + i + 12, 0.0f, 255.0f);
+        __m128i packed = _mm_packus_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+        _mm_storeu_si128((__m128i *)(q + i), packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = q_round_u8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_s8_dims_sse2 (const float *v, uint8_t *q, const float *offsets, const float *scales, int n) {
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i r0 = quantize_round_dims_sse2(v + i, offsets + i, scales + i, -128.0f, 127.0f);
+        __m128i r1 = quantize_round_dims_sse2(v + i + 4, offsets + i + 4, scales + i + 4, -128.0f, 127.0f);
+        __m128i r2 = quantize_round_dims_sse2(v + i + 8, offsets + i + 8, scales + i + 8, -128.0f, 127.0f);
+        __m128i r3 = quantize_round_dims_sse2(v + i + 12, offsets + i + 12, scales + i + 12, -128.0f, 127.0f);
+        __m128i packed = _mm_packs_epi16(_mm_packs_epi32(r0, r1), _mm_packs_epi32(r2, r3));
+        _mm_storeu_si128((__m128i *)(q + i), packed);
+    }
+    for (; i < n; ++i) {
+        q[i] = (uint8_t)q_round_s8((v[i] - offsets[i]) * scales[i]);
+    }
+}
+
+static void float32_quantize_bit_sse2 (const float *v, uint8_t *q, float threshold, int n) {
+    const __m128 t = _mm_set1_ps(threshold);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int lo = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(v + i), t));
+        int hi = _mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(v + i + 4), t));
+        q[i / 8] = (uint8_t)(lo | (hi << 4));
+    }
+    float32_quantize_bit_scalar(v, q, threshold, i, n);
+}
+
+static inline void bytes_quantize_bit_sse2 (const uint8_t *v, uint8_t *q, int n, bool is_signed) {
+    // the byte movemask collects the top bits: set for UINT8 >= 128, clear for INT8 >= 0
+    int flip = (is_signed) ? 0xFFFF : 0;
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(v + i))) ^ flip;
+        q[i / 8] = (uint8_t)mask;
+        q[i / 8 + 1] = (uint8_t)(mask >> 8);
+    }
+    bytes_quantize_bit_scalar(v, q, i, n, is_signed);
+}
+
+static void uint8_quantize_bit_sse2 (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_sse2(v, q, n, false);
+}
+
+static void int8_quantize_bit_sse2 (const uint8_t *v, uint8_t *q, int n) {
+    bytes_quantize_bit_sse2(v, q, n, true);
+}
+
 #endif
 
 // MARK: -
@@ -1109,8 +1539,49 @@ void init_distance_functions_sse2 (void) {
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_sse2;
     dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_sse2;
     
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_sse2;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_sse2;
+    
     dispatch_distance_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_sse2;
     
+        dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U4] = uint4_distance_l2_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I4] = int4_distance_l2_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4] = uint4_distance_l2_squared_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I4] = int4_distance_l2_squared_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U4] = uint4_distance_cosine_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I4] = int4_distance_cosine_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U4] = uint4_distance_dot_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4] = int4_distance_dot_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U4] = uint4_distance_l1_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I4] = int4_distance_l1_batch_sse2;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_batch_sse2;
+    
+    dispatch_quantize_table.f32_to_u8 = float32_quantize_u8_sse2;
+    dispatch_quantize_table.f32_to_s8 = float32_quantize_s8_sse2;
+    dispatch_quantize_table.f32_to_u8_dims = float32_quantize_u8_dims_sse2;
+    dispatch_quantize_table.f32_to_s8_dims = float32_quantize_s8_dims_sse2;
+    dispatch_quantize_table.f32_to_bit = float32_quantize_bit_sse2;
+    dispatch_quantize_table.u8_to_bit = uint8_quantize_bit_sse2;
+    dispatch_quantize_table.i8_to_bit = int8_quantize_bit_sse2;
+    
     distance_backend_name = "SSE2";
 #endif
 }
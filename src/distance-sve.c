@@ -0,0 +1,277 @@
+//
+//  distance-sve.c
+//  sqlitevector
+//
+//  SVE kernels for the 8-bit and 1BIT distances
+//
+
+#include "distance-sve.h"
+#include "distance-cpu.h"
+
+#if defined(__ARM_FEATURE_SVE)
+#include <arm_sve.h>
+#include <stdint.h>
+#include <math.h>
+
+extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern const char *distance_backend_name;
+
+// MARK: - UINT8/INT8 -
+// Vector length agnostic: every loop steps by svcntb() bytes and the whilelt predicate covers the tail, inactive bytes
+// load as zero on both sides and add nothing to any sum. udot/sdot sum four byte products into each 32-bit lane
+// (exact, the lanes are summed in 64-bit). SVE types have no size, so the four candidates of a block get named accumulators.
+
+// L2, L1: sum gets the unsigned squared or absolute differences
+// DOT, COSINE: sum gets q.x and norm x.x (COSINE only), in signed lanes for INT8
+DISTANCE_BATCH_INLINE void integer_distance_step_sve (distance_batch_op op, bool is_signed, svuint8_t vq, svuint8_t vx, svuint32_t *sum, svuint32_t *norm) {
+    const svbool_t all = svptrue_b8();
+    if (op == DISTANCE_BATCH_L2 || op == DISTANCE_BATCH_SQUARED_L2 || op == DISTANCE_BATCH_L1) {
+        // the signed absolute difference (at most 255) is exact when read as unsigned
+        svuint8_t abd;
+        if (is_signed) abd = svreinterpret_u8_s8(svabd_s8_x(all, svreinterpret_s8_u8(vq), svreinterpret_s8_u8(vx)));
+        else abd = svabd_u8_x(all, vq, vx);
+        if (op == DISTANCE_BATCH_L1) *sum = svdot_u32(*sum, abd, svdup_n_u8(1));
+        else *sum = svdot_u32(*sum, abd, abd);
+        return;
+    }
+    
+    if (is_signed) {
+        svint8_t sq = svreinterpret_s8_u8(vq);
+        svint8_t sx = svreinterpret_s8_u8(vx);
+        *sum = svreinterpret_u32_s32(svdot_s32(svreinterpret_s32_u32(*sum), sq, sx));
+        if (op == DISTANCE_BATCH_COSINE) *norm = svreinterpret_u32_s32(svdot_s32(svreinterpret_s32_u32(*norm), sx, sx));
+    } else {
+        *sum = svdot_u32(*sum, vq, vx);
+        if (op == DISTANCE_BATCH_COSINE) *norm = svdot_u32(*norm, vx, vx);
+    }
+}
+
+static inline float integer_distance_finalize_sve (distance_batch_op op, bool is_signed, svuint32_t sum, svuint32_t norm, int64_t norm_q) {
+    // products of INT8 codes are summed in signed lanes
+    const svbool_t all = svptrue_b32();
+    const bool signed_lanes = (is_signed && (op == DISTANCE_BATCH_DOT || op == DISTANCE_BATCH_COSINE));
+    int64_t total = (signed_lanes) ? svaddv_s32(all, svreinterpret_s32_u32(sum)) : (int64_t)svaddv_u32(all, sum);
+    int64_t norm_x = (int64_t)svaddv_u32(all, norm);
+    return distance_batch_finalize(op, total, norm_q, norm_x);
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_block_sve (const uint8_t *q, const uint8_t *base, size_t stride, int width, int n, float *distances, distance_batch_op op, bool is_signed, int64_t norm_q) {
+    svuint32_t sum0 = svdup_n_u32(0), sum1 = svdup_n_u32(0), sum2 = svdup_n_u32(0), sum3 = svdup_n_u32(0);
+    svuint32_t norm0 = svdup_n_u32(0), norm1 = svdup_n_u32(0), norm2 = svdup_n_u32(0), norm3 = svdup_n_u32(0);
+    const uint8_t *x0 = base;
+    const uint8_t *x1 = (width > 1) ? x0 + stride : x0;
+    const uint8_t *x2 = (width > 1) ? x1 + stride : x0;
+    const uint8_t *x3 = (width > 1) ? x2 + stride : x0;
+    
+    const int step = (int)svcntb();
+    for (int i = 0; i < n; i += step) {
+        svbool_t pg = svwhilelt_b8_s32(i, n);
+        svuint8_t vq = svld1_u8(pg, q + i);
+        integer_distance_step_sve(op, is_signed, vq, svld1_u8(pg, x0 + i), &sum0, &norm0);
+        if (width > 1) {
+            integer_distance_step_sve(op, is_signed, vq, svld1_u8(pg, x1 + i), &sum1, &norm1);
+            integer_distance_step_sve(op, is_signed, vq, svld1_u8(pg, x2 + i), &sum2, &norm2);
+            integer_distance_step_sve(op, is_signed, vq, svld1_u8(pg, x3 + i), &sum3, &norm3);
+        }
+    }
+    
+    distances[0] = integer_distance_finalize_sve(op, is_signed, sum0, norm0, norm_q);
+    if (width > 1) {
+        distances[1] = integer_distance_finalize_sve(op, is_signed, sum1, norm1, norm_q);
+        distances[2] = integer_distance_finalize_sve(op, is_signed, sum2, norm2, norm_q);
+        distances[3] = integer_distance_finalize_sve(op, is_signed, sum3, norm3, norm_q);
+    }
+}
+
+DISTANCE_BATCH_INLINE void integer_distance_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances, distance_batch_op op, bool is_signed) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    int64_t norm_q = distance_batch_query_norm(op, query, n, is_signed);
+    
+    // blocks of four candidates (the named accumulators), then one at a time
+    int j = 0;
+    for (; j + 4 <= count; j += 4) {
+        integer_distance_block_sve(q, b + (size_t)j * stride, stride, 4, n, distances + j, op, is_signed, norm_q);
+    }
+    for (; j < count; ++j) {
+        integer_distance_block_sve(q, b + (size_t)j * stride, stride, 1, n, distances + j, op, is_signed, norm_q);
+    }
+}
+
+static inline float integer_distance_sve (const void *v1, const void *v2, int n, distance_batch_op op, bool is_signed) {
+    float distance;
+    integer_distance_batch_sve(v1, v2, 0, 1, n, &distance, op, is_signed);
+    return distance;
+}
+
+float uint8_distance_l2_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_L2, false);
+}
+
+float uint8_distance_l2_squared_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+float uint8_distance_dot_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_DOT, false);
+}
+
+float uint8_distance_l1_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_L1, false);
+}
+
+float uint8_distance_cosine_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_COSINE, false);
+}
+
+float int8_distance_l2_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_L2, true);
+}
+
+float int8_distance_l2_squared_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+float int8_distance_dot_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_DOT, true);
+}
+
+float int8_distance_l1_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_L1, true);
+}
+
+float int8_distance_cosine_sve (const void *v1, const void *v2, int n) {
+    return integer_distance_sve(v1, v2, n, DISTANCE_BATCH_COSINE, true);
+}
+
+void uint8_distance_l2_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, false);
+}
+
+void uint8_distance_l2_squared_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, false);
+}
+
+void uint8_distance_dot_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, false);
+}
+
+void uint8_distance_l1_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, false);
+}
+
+void uint8_distance_cosine_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, false);
+}
+
+void int8_distance_l2_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_L2, true);
+}
+
+void int8_distance_l2_squared_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_SQUARED_L2, true);
+}
+
+void int8_distance_dot_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_DOT, true);
+}
+
+void int8_distance_l1_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_L1, true);
+}
+
+void int8_distance_cosine_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    integer_distance_batch_sve(query, base, stride, count, n, distances, DISTANCE_BATCH_COSINE, true);
+}
+
+// MARK: - BIT -
+
+static inline svuint32_t hamming_step_sve (svbool_t pg, const uint8_t *a, const uint8_t *b, svuint32_t acc) {
+    // per byte bit counts of a ^ b, summed four at a time into the 32-bit lanes
+    svuint8_t popcnt = svcnt_u8_x(svptrue_b8(), sveor_u8_x(svptrue_b8(), svld1_u8(pg, a), svld1_u8(pg, b)));
+    return svdot_u32(acc, popcnt, svdup_n_u8(1));
+}
+
+float bit1_distance_hamming_sve (const void *v1, const void *v2, int n) {
+    const uint8_t *a = (const uint8_t *)v1;
+    const uint8_t *b = (const uint8_t *)v2;
+    svuint32_t acc = svdup_n_u32(0);
+    
+    const int step = (int)svcntb();
+    for (int i = 0; i < n; i += step) {
+        acc = hamming_step_sve(svwhilelt_b8_s32(i, n), a + i, b + i, acc);
+    }
+    
+    return (float)svaddv_u32(svptrue_b32(), acc);
+}
+
+void bit1_distance_hamming_batch_sve (const void *query, const void *base, size_t stride, int count, int n, float *distances) {
+    const uint8_t *q = (const uint8_t *)query;
+    const uint8_t *b = (const uint8_t *)base;
+    const int step = (int)svcntb();
+    
+    int j = 0;
+    for (; j + 4 <= count; j += 4) {
+        const uint8_t *x0 = b + (size_t)j * stride;
+        const uint8_t *x1 = x0 + stride;
+        const uint8_t *x2 = x1 + stride;
+        const uint8_t *x3 = x2 + stride;
+        svuint32_t acc0 = svdup_n_u32(0), acc1 = svdup_n_u32(0), acc2 = svdup_n_u32(0), acc3 = svdup_n_u32(0);
+        
+        for (int i = 0; i < n; i += step) {
+            svbool_t pg = svwhilelt_b8_s32(i, n);
+            acc0 = hamming_step_sve(pg, q + i, x0 + i, acc0);
+            acc1 = hamming_step_sve(pg, q + i, x1 + i, acc1);
+            acc2 = hamming_step_sve(pg, q + i, x2 + i, acc2);
+            acc3 = hamming_step_sve(pg, q + i, x3 + i, acc3);
+        }
+        
+        distances[j] = (float)svaddv_u32(svptrue_b32(), acc0);
+        distances[j + 1] = (float)svaddv_u32(svptrue_b32(), acc1);
+        distances[j + 2] = (float)svaddv_u32(svptrue_b32(), acc2);
+        distances[j + 3] = (float)svaddv_u32(svptrue_b32(), acc3);
+    }
+    
+    for (; j < count; ++j) {
+        distances[j] = bit1_distance_hamming_sve(q, b + (size_t)j * stride, n);
+    }
+}
+
+#endif
+
+// MARK: -
+
+void init_distance_functions_sve (void) {
+#if defined(__ARM_FEATURE_SVE)
+    // applied on top of a NEON tier, only where the vectors are wider than the 128-bit NEON ones (Graviton3: 256-bit):
+    // at 128 bits the NEON-DOTPROD kernels do the same work without the predicates
+    if (svcntb() <= 16) return;
+    
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_sve;
+    dispatch_distance_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_sve;
+    
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_U8] = uint8_distance_l2_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L2][VECTOR_TYPE_I8] = int8_distance_l2_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8] = uint8_distance_l2_squared_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_I8] = int8_distance_l2_squared_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_U8] = uint8_distance_cosine_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_COSINE][VECTOR_TYPE_I8] = int8_distance_cosine_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_U8] = uint8_distance_dot_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8] = int8_distance_dot_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_U8] = uint8_distance_l1_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_L1][VECTOR_TYPE_I8] = int8_distance_l1_batch_sve;
+    dispatch_distance_batch_table[VECTOR_DISTANCE_HAMMING][VECTOR_TYPE_BIT] = bit1_distance_hamming_batch_sve;
+    
+    distance_backend_name = "SVE";
+#endif
+}
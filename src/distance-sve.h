@@ -0,0 +1,15 @@
+//
+//  distance-sve.h
+//  sqlitevector
+//
+//  SVE kernels for the 8-bit and 1BIT distances
+//
+
+#ifndef __VECTOR_DISTANCE_SVE__
+#define __VECTOR_DISTANCE_SVE__
+
+#include <stdio.h>
+
+void init_distance_functions_sve (void);
+
+#endif
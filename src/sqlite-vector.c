@@ -8,6 +8,10 @@
 #include "fp16/fp16.h"
 #include "sqlite-vector.h"
 #include "distance-cpu.h"
+#include "vector-topk.h"
+#include "vector-pool.h"
+#include "vector-sidecar.h"
+#include "vector-chunk.h"
 
 #include <math.h>
 #include <float.h>
@@ -22,6 +26,7 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <time.h>
 
 #if defined(_WIN32) || ((defined(__linux__) && !defined(__GLIBC__) && !defined(__ANDROID__))) || defined(SQLITE_WASM_EXTRA_INIT)
 // Provide strcasestr function implementation for environments that lack it:
@@ -71,11 +76,51 @@ SQLITE_EXTENSION_INIT1
 #define VECTOR_PRINT(_b,_t,_n)
 #endif
 
+// scan statistics (see vector_stats): collected only by the scans run with stats=1, compiled out with -DVECTOR_STATS_DISABLED
+#ifdef VECTOR_STATS_DISABLED
+#define VECTOR_STATS                                0
+#define VECTOR_STATS_ADD(_s, _field, _n)            ((void)(_s))
+#define VECTOR_STATS_KERNEL_BEGIN(_s)               ((void)(_s))
+#define VECTOR_STATS_KERNEL_END(_s)                 ((void)(_s))
+#else
+#define VECTOR_STATS                                1
+#define VECTOR_STATS_ADD(_s, _field, _n)            do {if (_s) (_s)->_field += (int64_t)(_n);} while (0)
+#define VECTOR_STATS_KERNEL_BEGIN(_s)               int64_t _stats_clock = ((_s) ? vector_stats_clock() : 0)
+#define VECTOR_STATS_KERNEL_END(_s)                 do {if (_s) (_s)->kernel_ns += vector_stats_clock() - _stats_clock;} while (0)
+#endif
+
 #define SKIP_SPACES(_p)                             while (*(_p) && isspace((unsigned char)*(_p))) (_p)++
 #define TRIM_TRAILING(_start, _len)                 while ((_len) > 0 && isspace((unsigned char)(_start)[(_len) - 1])) (_len)--
 
 #define DEFAULT_MAX_MEMORY                          30*1024*1024
+#define MAX_RERANK_FACTOR                           1024
+#define MAX_CASCADE_FACTOR                          1024
+#define MAX_IVF_NLIST                               65536
+#define DEFAULT_IVF_NPROBE                          8
+#define IVF_SAMPLES_PER_LIST                        64
+#define IVF_MAX_SAMPLES                             65536
+#define IVF_TRAIN_ITERATIONS                        10
+#define DEFAULT_HNSW_M                              16
+#define DEFAULT_HNSW_EF_CONSTRUCTION                200
+#define DEFAULT_HNSW_EF_SEARCH                      64
+#define MAX_HNSW_M                                  128
+#define MAX_HNSW_EF                                 4096
+#define MAX_HNSW_LEVEL                              16
+#define MAX_PQ_M                                    4096
+#define DEFAULT_PQ_NBITS                            8
+#define PQ_SAMPLES_PER_CENTROID                     64
+#define PQ_MAX_SAMPLES                              65536
+#define CALIB_MAX_SAMPLES                           4096
+#define CALIB_BLOCK                                 64
+#define QUANT_NIBBLE_BLOCK                          256         // 4-bit quantization: codes computed on the stack per block (even)
+#define REBUILD_BATCH_ROWS                          1024        // rows copied out of the base table per pipeline round
+#define REBUILD_MIN_SHARD_ROWS                      64
+#define SCAN_MIN_SHARD_RECORDS                      256
+#define SCAN_BATCH_BYTES                            16*1024*1024
+#define SCAN_DISTANCE_BLOCK                         64          // records per call of a batch distance kernel
+#define SCAN_QUERY_TILE_BYTES                       32*1024     // batch scan: codes compared with every query before moving on
 #define MAX_TABLES                                  128
+#define VECTOR_DELTA_LIST                           -2              // list of the delta chunks of a flat layout (IVF list L: -3 - L)
 #define STATIC_SQL_SIZE                             2048
 
 #define INT64_TO_INT8PTR(_val, _ptr)                do { \
@@ -106,8 +151,16 @@ SQLITE_EXTENSION_INIT1
 #define VECTOR_COLUMN_VECTOR                        1
 #define VECTOR_COLUMN_K                             2
 #define VECTOR_COLUMN_MEMIDX                        3
-#define VECTOR_COLUMN_ROWID                         4
-#define VECTOR_COLUMN_DISTANCE                      5
+#define VECTOR_COLUMN_OPTIONS                       4
+#define VECTOR_COLUMN_FILTER                        5
+#define VECTOR_COLUMN_ROWID                         6
+#define VECTOR_COLUMN_DISTANCE                      7
+#define VECTOR_MAX_ROWID_CONSTRAINTS                16          // rowid (and distance) constraints pushed down into a single scan
+
+#define VECTOR_BATCH_COLUMN_OPTIONS                 5           // hidden columns: tbl, col, queries, nq, k, options
+#define VECTOR_BATCH_COLUMN_QUERY                   6
+#define VECTOR_BATCH_COLUMN_ROWID                   7
+#define VECTOR_BATCH_COLUMN_DISTANCE                8
 
 #define OPTION_KEY_TYPE                             "type"
 #define OPTION_KEY_DIMENSION                        "dimension"
@@ -115,10 +168,47 @@ SQLITE_EXTENSION_INIT1
 #define OPTION_KEY_MAXMEMORY                        "max_memory"
 #define OPTION_KEY_DISTANCE                         "distance"
 #define OPTION_KEY_QUANTTYPE                        "qtype"
+#define OPTION_KEY_RERANK                           "rerank"
+#define OPTION_KEY_CASCADE                          "cascade"
+#define OPTION_KEY_INDEX                            "index"
+#define OPTION_KEY_NLIST                            "nlist"
+#define OPTION_KEY_NPROBE                           "nprobe"
+#define OPTION_KEY_IVFCENTROIDS                     "ivf_centroids" // used only in serialize/unserialize
+#define OPTION_KEY_M                                "M"             // HNSW: links per node
+#define OPTION_KEY_EF_CONSTRUCTION                  "ef_construction"
+#define OPTION_KEY_EF_SEARCH                        "ef_search"
+#define OPTION_KEY_THREADS                          "threads"
+#define OPTION_KEY_NBITS                            "nbits"
+#define OPTION_KEY_CALIBRATION                      "calibration"
+#define OPTION_KEY_PERCENTILE                       "percentile"
+#define OPTION_KEY_CALIBSAMPLE                      "calib_sample"
+#define OPTION_KEY_AUTOUPDATE                       "auto_update"
+#define OPTION_KEY_MMAP                             "mmap"
+#define OPTION_KEY_STATS                            "stats"
+#define OPTION_KEY_PQM                              "pq_m"
+#define OPTION_KEY_PQNBITS                          "pq_nbits"      // used only in serialize/unserialize
+#define OPTION_KEY_PQCODEBOOKS                      "pq_codebooks"  // used only in serialize/unserialize
+#define OPTION_KEY_HNSWENTRY                        "hnsw_entry"    // used only in serialize/unserialize
+#define OPTION_KEY_HNSWLEVEL                        "hnsw_level"    // used only in serialize/unserialize
+#define OPTION_KEY_HNSWCOUNT                        "hnsw_count"    // used only in serialize/unserialize
 #define OPTION_KEY_QUANTSCALE                       "qscale"        // used only in serialize/unserialize
 #define OPTION_KEY_QUANTOFFSET                      "qoffset"       // used only in serialize/unserialize
+#define OPTION_KEY_QUANTCALIBRATION                 "qcalibration"  // used only in serialize/unserialize
+#define OPTION_KEY_GENERATION                       "generation"    // used only in serialize/unserialize
+#define OPTION_KEY_CHUNKFORMAT                      "chunk_format"  // used only in serialize/unserialize
 
 #define VECTOR_INTERNAL_TABLE                       "CREATE TABLE IF NOT EXISTS _sqliteai_vector (tblname TEXT, colname TEXT, key TEXT, value ANY, PRIMARY KEY(tblname, colname, key));"
+#define VECTOR_SPILL_TABLE                          "CREATE TEMP TABLE IF NOT EXISTS _sqliteai_vector_spill (list INTEGER, id INTEGER, data BLOB, PRIMARY KEY(list, id)) WITHOUT ROWID;"
+
+typedef enum {
+    VECTOR_INDEX_NONE = 0,                  // flat quantized scan
+    VECTOR_INDEX_IVF = 1                    // inverted file: quantized vectors grouped in per-centroid posting lists
+} vector_index;
+
+typedef enum {
+    VECTOR_CALIBRATION_GLOBAL = 0,          // one scale/offset pair shared by every dimension
+    VECTOR_CALIBRATION_DIMENSION = 1        // one scale/offset pair per dimension
+} vector_calibration;
 
 typedef struct {
     vector_type     v_type;                 // vector type
@@ -128,8 +218,67 @@ typedef struct {
     
     vector_qtype    q_type;                 // quantization type
     uint64_t        max_memory;             // max memory
+    int             rerank;                 // quantized top-k: collect k*rerank candidates and re-score them at full precision (0 = disabled)
+    int             cascade;                // 8-bit quantization: also keep a 1BIT code per record, top-k re-scores the k*cascade closest 1BIT codes (0 = disabled)
+    vector_calibration calibration;         // 8-bit quantization: global or per-dimension scale/offset
+    float           percentile;             // 8-bit quantization: clip the calibration range to [100-p, p] percentiles (0 = min/max)
+    int64_t         calib_sample;           // quantization: calibrate and train on a random sample of rows instead of a full pass (0 = all rows)
+    bool            auto_update;            // triggers keep the quantization up to date (delta chunks + tombstones)
+    bool            mmap;                   // preload: map a sidecar file of the quantized data instead of copying it in memory
+    
+    vector_index    index;                  // index built by vector_quantize
+    int             nlist;                  // IVF: number of posting lists (centroids) to train
+    int             nprobe;                 // IVF: number of closest posting lists visited by a top-k query
+    
+    int             m;                      // HNSW: max links per node on upper layers (2*M on layer 0)
+    int             pq_m;                   // PQ: number of sub-quantizers
+    int             nbits;                  // PQ: bits per sub-quantizer code (4 or 8)
+    int             ef_construction;        // HNSW: candidate list size used while building the graph
+    int             ef_search;              // HNSW: candidate list size used by a top-k query
+    
+    int             threads;                // top-k scan: number of shards scanned in parallel, vector_quantize: number of build workers (0 or 1 = single-threaded)
+    bool            stats;                  // scans add their counters to the ones exposed by vector_stats
 } vector_options;
 
+typedef struct hnsw_graph hnsw_graph;
+
+// counters of the scans of a table (see vector_stats)
+typedef struct {
+    int64_t         scans;                  // scans started
+    int64_t         rows_scanned;           // vectors or codes compared with the query
+    int64_t         rows_skipped;           // NULL or undersized vectors
+    int64_t         chunks_read;            // quantized chunks read from disk
+    int64_t         bytes_touched;          // bytes of the vectors or codes compared with the query
+    int64_t         kernel_ns;              // time spent in the distance kernels
+    int64_t         heap_updates;           // candidates retained by the top-k collector
+    int64_t         preload_hits;           // quantized scans of preloaded records
+    int64_t         preload_misses;         // quantized scans of the chunks on disk
+} vector_stats;
+
+typedef struct {
+    float           *codebooks;             // m x 2^nbits x dsub float32 codewords (NULL if the table is not PQ quantized)
+    int             m;                      // number of sub-quantizers (bytes per code with nbits=8)
+    int             nbits;                  // bits per code: 8 (one byte per sub-quantizer) or 4 (two codes per byte)
+    int             dsub;                   // dimensions covered by each sub-quantizer (v_dim / m)
+} pq_codebook;
+
+// preloaded quantized records shared by every connection of the process (see Preload Registry)
+typedef struct vector_preload {
+    char            *key;                   // database file (or connection), table and column
+    int64_t         generation;             // quantization generation the records were read from
+    size_t          stride;                 // bytes per record (rowid followed by the code)
+    const uint8_t   *data;                  // records (inside buffer or inside the sidecar mapping)
+    void            *buffer;                // allocated records (NULL if memory mapped)
+    vector_sidecar  *sidecar;               // memory mapped sidecar (NULL if allocated)
+    int             counter;                // number of records
+    float           *norms;                 // COSINE over 8-bit codes: norm of each code (NULL if not cached)
+    int             *lists;                 // IVF: (start, count) vector index pairs of each posting list inside data
+    int             lists_count;            // IVF: number of posting lists described by lists
+    int             refcount;               // table contexts attached to the entry and cursors scanning it
+    bool            published;              // found by lookups (false once the quantization has been dropped)
+    struct vector_preload *next;
+} vector_preload;
+
 typedef struct {
     char            *t_name;                // table name
     char            *c_name;                // column name
@@ -139,9 +288,26 @@ typedef struct {
     float           scale;                  // computed value by quantization
     float           offset;                 // computed value by quantization
     bool            binary_mean;            // binary mean option for 1BIT quantization
+    bool            binary_level;           // cascade: every 8-bit code is preceded by a 1BIT code of the same vector
+    float           *qcalib;                // per-dimension calibration: v_dim scales followed by v_dim offsets (NULL with a global scale/offset)
+    
+    float           *ivf_centroids;         // IVF: ivf_nlist x v_dim float32 centroids (NULL if no IVF index)
+    int             ivf_nlist;              // IVF: number of trained posting lists
     
-    void            *preloaded;
-    int             precounter;
+    int64_t         generation;             // quantization generation the parameters above were loaded from
+    int             chunk_format;           // record layout of the quantized chunks (VECTOR_CHUNK_FORMAT_*)
+    char            *preload_key;           // preload registry key of this table and column
+    vector_preload  *preload;               // preloaded quantization this connection is attached to (NULL if none)
+    
+    pq_codebook     pq;                     // PQ: trained sub-quantizers
+    
+    int64_t         hnsw_count;             // HNSW: number of indexed nodes (0 if no graph has been built)
+    int64_t         hnsw_entry;             // HNSW: rowid of the entry point
+    int             hnsw_level;             // HNSW: level of the entry point
+    int             hnsw_m;                 // HNSW: M used to build the graph
+    hnsw_graph      *hnsw;                  // HNSW: in-memory upper layers (lazily loaded on first query)
+    
+    vector_stats    stats;                  // counters of the scans run with stats=1
 } table_context;
 
 typedef struct {
@@ -155,9 +321,59 @@ typedef struct {
     vector_context  *ctx;
 } vFullScan;
 
+// rowids whose records in the base (non delta) chunks are no longer valid
+typedef struct {
+    int64_t         *rowids;                // sorted
+    int             count;
+} vector_tombstones;
+
+// rowids a scan is restricted to: the rowid constraints pushed down by SQLite and the optional allow-list argument
+typedef struct {
+    int64_t         lo;                     // inclusive bounds (lo > hi matches nothing)
+    int64_t         hi;
+    int64_t         *rowids;                // sorted allow-list (NULL means every rowid between lo and hi)
+    int             count;
+    int64_t         *slots;                 // open addressing set of the allow-list (NULL if not built, searched in rowids then)
+    uint64_t        mask;                   // slots - 1 (a power of two)
+    int64_t         empty;                  // value of the empty slots (a rowid outside lo..hi)
+    bool            active;                 // false if the scan is not restricted
+} vector_rowid_filter;
+
+static inline bool vector_rowids_search (const int64_t *rowids, int count, int64_t rowid) {
+    int lo = 0, hi = count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (rowids[mid] == rowid) return true;
+        if (rowids[mid] < rowid) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return false;
+}
+
+static inline bool vector_tombstones_contains (const vector_tombstones *dead, int64_t rowid) {
+    return vector_rowids_search(dead->rowids, dead->count, rowid);
+}
+
+static inline uint64_t vector_rowid_hash (int64_t rowid) {
+    return ((uint64_t)rowid * 0x9E3779B97F4A7C15ULL) >> 32;
+}
+
+static inline bool vector_rowid_filter_contains (const vector_rowid_filter *filter, int64_t rowid) {
+    if (rowid < filter->lo || rowid > filter->hi) return false;
+    if (filter->slots) {
+        // every record of a scan is checked: one or two probes instead of a binary search
+        for (uint64_t i = vector_rowid_hash(rowid) & filter->mask;; i = (i + 1) & filter->mask) {
+            if (filter->slots[i] == rowid) return true;
+            if (filter->slots[i] == filter->empty) return false;
+        }
+    }
+    return (filter->rowids == NULL) || vector_rowids_search(filter->rowids, filter->count, rowid);
+}
+
 typedef struct {
     sqlite3_vtab_cursor base;               // Base class - must be first
     table_context       *table;
+    vector_options      options;            // table options overridden by the optional per-query options argument
     
     // STREAMING VT INTERFACE
     bool                is_streaming;
@@ -171,18 +387,45 @@ typedef struct {
         void                *vector;
         int                 vsize;
         int                 vdim;
+        size_t              code_offset;    // cascade: bytes of the 1BIT code that precedes the compared 8-bit code (0 otherwise)
         
-        void                *data;
+        vector_records      records;        // current chunk (or preloaded records)
         int                 dcounter;
         int                 dindex;
+        bool                masked;         // records of the current chunk are filtered by the tombstones
+        
+        // distances are precomputed a block at a time, xNext only returns the next row of the block
+        distance_batch_function_t batch_fn; // NULL if not available
+        uint8_t             *staging;       // full scan: (rowid, vector) records copied for batch_fn (NULL without it)
+        int64_t             block_rowids[SCAN_DISTANCE_BLOCK];
+        float               block_distances[SCAN_DISTANCE_BLOCK];
+        int                 block_count;
+        int                 block_index;
+        bool                exhausted;      // no more rows to read (the block may still hold some)
         int                 is_eof;
     } stream;
     
+    // ROWID FILTER
+    vector_rowid_filter filter;             // records outside the filter are skipped before their distance is computed
+    
+    // DISTANCE CONSTRAINT (streaming only)
+    bool                bounded;            // a distance < or <= constraint was pushed down
+    bool                bound_inclusive;
+    double              bound;              // rows whose distance is not below bound (or equal to it, if inclusive) are skipped
+    
+    // STATISTICS
+    vector_stats        stats;              // counters of the current scan (added to the table ones when the cursor is closed or filtered again)
+    
+    // AUTO UPDATE
+    vector_tombstones   dead;               // tombstones loaded when the scan starts
+    vector_preload      *preload;           // preloaded records pinned for the whole scan (NULL = chunks read from disk)
+    
     // NON-STREAMING VT INTERFACE
     int64_t             *rowids;
     double              *distance;
-    int                 size;
-    int                 max_index;
+    int                 capacity;           // allocated slots in rowids/distance
+    int                 k;                  // number of requested results
+    vector_topk         topk;               // top-k collector backed by rowids/distance
     int                 row_index;
     int                 row_count;
 } vFullScanCursor;
@@ -192,9 +435,12 @@ typedef int (*vcursor_run_callback)(sqlite3 *db, vFullScanCursor *c, const void
 typedef int (*vcursor_sort_callback)(vFullScanCursor *c);
 
 extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern quantize_functions dispatch_quantize_table;
 extern const char *distance_backend_name;
 
 static sqlite3_mutex *qmutex;
+static sqlite3_mutex *pmutex;               // preload registry
 
 // MARK: - SQLite Utils -
 
@@ -406,6 +652,42 @@ static sqlite3_int64 sqlite_read_int64 (sqlite3 *db, const char *sql) {
     return value;
 }
 
+static const char *sqlite_table_filename (sqlite3 *db, const char *table_name) {
+    // file of the database that holds table_name, searched like an unqualified name: temp, main, then attached ones
+    // ("" for in-memory and temporary databases, NULL if the table does not exist)
+    const char *filename = NULL;
+    sqlite3_stmt *vm = NULL;
+    
+    int rc = sqlite3_prepare_v2(db, "SELECT name FROM pragma_database_list ORDER BY (seq = 1) DESC, seq;", -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    while (!filename && sqlite3_step(vm) == SQLITE_ROW) {
+        const char *schema = (const char *)sqlite3_column_text(vm, 0);
+        char sql[STATIC_SQL_SIZE];
+        sqlite3_snprintf(sizeof(sql), sql, "SELECT EXISTS (SELECT 1 FROM \"%w\".sqlite_master WHERE type='table' AND name='%q' COLLATE NOCASE);", schema, table_name);
+        if (sqlite_read_int64(db, sql) == 1) filename = sqlite3_db_filename(db, schema);
+    }
+    
+cleanup:
+    if (vm) sqlite3_finalize(vm);
+    return filename;
+}
+
+static bool sqlite_trusted_schema (sqlite3 *db) {
+    // PRAGMA trusted_schema exists since SQLite 3.31: older versions return no row and always trust the schema
+    bool trusted = true;
+    
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, "PRAGMA trusted_schema;", -1, &stmt, NULL) == SQLITE_OK) {
+        if (sqlite3_step(stmt) == SQLITE_ROW) {
+            trusted = (sqlite3_column_int(stmt, 0) != 0);
+        }
+    }
+    
+    sqlite3_finalize(stmt);
+    return trusted;
+}
+
 static void *sqlite_common_set_error (sqlite3_context *context, sqlite3_vtab *vtab, int rc, const char *format, ...) {
     char buffer[4096];
     char *err = NULL;
@@ -426,7 +708,8 @@ static void *sqlite_common_set_error (sqlite3_context *context, sqlite3_vtab *vt
     return NULL;
 }
 
-static int sqlite_serialize (sqlite3_context *context, const char *table_name, const char *column_name, int type, const char *key, int64_t ivalue, double fvalue) {
+static int sqlite_serialize (sqlite3_context *context, const char *table_name, const char *column_name, int type, const char *key, int64_t ivalue, double fvalue, const void *bvalue) {
+    // in case of SQLITE_BLOB ivalue is the size of bvalue
     const char *sql = "REPLACE INTO _sqliteai_vector (tblname, colname, key, value) VALUES (?, ?, ?, ?);";
     sqlite3 *db = sqlite3_context_db_handle(context);
     sqlite3_stmt *vm = NULL;
@@ -446,6 +729,7 @@ static int sqlite_serialize (sqlite3_context *context, const char *table_name, c
     switch (type) {
         case SQLITE_INTEGER: rc = sqlite3_bind_int64(vm, 4, (sqlite3_int64)ivalue); break;
         case SQLITE_FLOAT: rc = sqlite3_bind_double(vm, 4, fvalue); break;
+        case SQLITE_BLOB: rc = sqlite3_bind_blob64(vm, 4, bvalue, (sqlite3_uint64)ivalue, SQLITE_STATIC); break;
     }
     if (rc != SQLITE_OK) goto cleanup;
     
@@ -458,10 +742,13 @@ cleanup:
     return rc;
 }
 
-static int sqlite_unserialize (sqlite3_context *context, table_context *ctx) {
+static int sqlite_unserialize (sqlite3 *db, table_context *ctx) {
     const char *sql = "SELECT key, value FROM _sqliteai_vector WHERE tblname = ? AND colname = ?;";
-    sqlite3 *db = sqlite3_context_db_handle(context);
     sqlite3_stmt *vm = NULL;
+    int centroids_bytes = 0;
+    int codebooks_bytes = 0;
+    int qcalib_bytes = 0;
+    int cascade = 0;
     
     int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
     if (rc != SQLITE_OK) goto cleanup;
@@ -492,8 +779,125 @@ static int sqlite_unserialize (sqlite3_context *context, table_context *ctx) {
             ctx->offset = (float)sqlite3_column_double(vm, 1);
             continue;
         }
+        
+        if (strcmp(key, OPTION_KEY_QUANTCALIBRATION) == 0) {
+            if (ctx->qcalib) sqlite3_free(ctx->qcalib);
+            qcalib_bytes = sqlite3_column_bytes(vm, 1);
+            ctx->qcalib = (float *)sqlite_memdup(sqlite3_column_blob(vm, 1), qcalib_bytes);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_CASCADE) == 0) {
+            cascade = sqlite3_column_int(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_GENERATION) == 0) {
+            ctx->generation = (int64_t)sqlite3_column_int64(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_CHUNKFORMAT) == 0) {
+            ctx->chunk_format = sqlite3_column_int(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_AUTOUPDATE) == 0) {
+            ctx->options.auto_update = (sqlite3_column_int(vm, 1) != 0);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_HNSWCOUNT) == 0) {
+            ctx->hnsw_count = (int64_t)sqlite3_column_int64(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_HNSWENTRY) == 0) {
+            ctx->hnsw_entry = (int64_t)sqlite3_column_int64(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_HNSWLEVEL) == 0) {
+            ctx->hnsw_level = sqlite3_column_int(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_M) == 0) {
+            ctx->hnsw_m = sqlite3_column_int(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_NLIST) == 0) {
+            ctx->ivf_nlist = sqlite3_column_int(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_IVFCENTROIDS) == 0) {
+            if (ctx->ivf_centroids) sqlite3_free(ctx->ivf_centroids);
+            centroids_bytes = sqlite3_column_bytes(vm, 1);
+            ctx->ivf_centroids = (float *)sqlite_memdup(sqlite3_column_blob(vm, 1), centroids_bytes);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_PQM) == 0) {
+            ctx->pq.m = sqlite3_column_int(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_PQNBITS) == 0) {
+            ctx->pq.nbits = sqlite3_column_int(vm, 1);
+            continue;
+        }
+        
+        if (strcmp(key, OPTION_KEY_PQCODEBOOKS) == 0) {
+            if (ctx->pq.codebooks) sqlite3_free(ctx->pq.codebooks);
+            codebooks_bytes = sqlite3_column_bytes(vm, 1);
+            ctx->pq.codebooks = (float *)sqlite_memdup(sqlite3_column_blob(vm, 1), codebooks_bytes);
+            continue;
+        }
+    }
+    
+    // chunks quantized before the split format existed have no format entry
+    if (ctx->chunk_format != VECTOR_CHUNK_FORMAT_SPLIT) ctx->chunk_format = VECTOR_CHUNK_FORMAT_INTERLEAVED;
+    
+    // IVF centroids are valid only if they match the serialized number of lists
+    if (ctx->ivf_centroids && (ctx->ivf_nlist <= 0 || (size_t)centroids_bytes != (size_t)ctx->ivf_nlist * (size_t)ctx->options.v_dim * sizeof(float))) {
+        sqlite3_free(ctx->ivf_centroids);
+        ctx->ivf_centroids = NULL;
+    }
+    if (ctx->ivf_centroids) {
+        ctx->options.index = VECTOR_INDEX_IVF;
+        ctx->options.nlist = ctx->ivf_nlist;
+    } else {
+        ctx->ivf_nlist = 0;
+    }
+    
+    // PQ codebooks are valid only for a PQ quantization whose geometry matches the serialized one
+    int dim = ctx->options.v_dim;
+    bool pq_valid = (ctx->options.q_type == VECTOR_QUANT_PQ) && (ctx->pq.m > 0) && (dim % ctx->pq.m == 0) && (ctx->pq.nbits == 4 || ctx->pq.nbits == 8);
+    if (pq_valid) pq_valid = (ctx->pq.codebooks) && ((size_t)codebooks_bytes == (size_t)dim * (size_t)(1 << ctx->pq.nbits) * sizeof(float));
+    if (pq_valid) {
+        ctx->pq.dsub = dim / ctx->pq.m;
+    } else {
+        if (ctx->pq.codebooks) sqlite3_free(ctx->pq.codebooks);
+        memset(&ctx->pq, 0, sizeof(pq_codebook));
+    }
+    
+    // per-dimension calibration applies only to 8-bit and 4-bit codes of the current dimension
+    vector_qtype qtype = ctx->options.q_type;
+    bool qcalib_valid = (ctx->qcalib) && (qtype == VECTOR_QUANT_U8BIT || qtype == VECTOR_QUANT_S8BIT || qtype == VECTOR_QUANT_U4BIT || qtype == VECTOR_QUANT_S4BIT);
+    if (qcalib_valid) qcalib_valid = ((size_t)qcalib_bytes == (size_t)dim * 2 * sizeof(float));
+    if (qcalib_valid) {
+        ctx->options.calibration = VECTOR_CALIBRATION_DIMENSION;
+    } else if (ctx->qcalib) {
+        sqlite3_free(ctx->qcalib);
+        ctx->qcalib = NULL;
     }
     
+    // the 1BIT level of a cascade exists only in front of 8-bit codes
+    ctx->binary_level = (cascade > 0) && (qtype == VECTOR_QUANT_U8BIT || qtype == VECTOR_QUANT_S8BIT);
+    if (ctx->binary_level) ctx->options.cascade = cascade;
+    
 cleanup:
     //if (rc != SQLITE_OK) sqlite3_result_error(context, sqlite3_errmsg(db), -1);
     if (vm) sqlite3_finalize(vm);
@@ -502,61 +906,6 @@ cleanup:
 
 // MARK: - Quantization -
 
-static inline uint8_t q_round_u8 (float s) {
-    if (!isfinite(s)) {
-        return (s > 0.0f) ? 255u : 0u;   /* NaN -> 0, +Inf -> 255, -Inf -> 0 */
-    }
-    float r = s + 0.5f * (1.0f - 2.0f * (s < 0.0f));  /* half away from zero */
-    if (r >= 255.0f) return 255u;
-    if (r <= 0.0f)   return 0u;
-    int ir = (int)r;                      /* safe after the clamp above */
-    return (uint8_t)ir;
-}
-
-static inline int8_t q_round_s8 (float s) {
-    if (!isfinite(s)) {
-        return (s > 0.0f) ? 127 : (s < 0.0f ? -128 : 0);
-    }
-    /* half-away-from-zero */
-    float r = s + 0.5f * (1.0f - 2.0f * (s < 0.0f));
-    if (r >= 127.0f)  return 127;
-    if (r <= -128.0f) return -128;
-    return (int8_t)(int)r;
-}
-
-static inline void quantize_float32_to_unsigned8bit (const float *v, uint8_t *q, float offset, float scale, int n) {
-    int i = 0;
-    for (; i + 3 < n; i += 4) {
-        float s0 = (v[i]     - offset) * scale;
-        float s1 = (v[i + 1] - offset) * scale;
-        float s2 = (v[i + 2] - offset) * scale;
-        float s3 = (v[i + 3] - offset) * scale;
-
-        int r0 = (int)(s0 + 0.5f * (1.0f - 2.0f * (s0 < 0.0f)));
-        int r1 = (int)(s1 + 0.5f * (1.0f - 2.0f * (s1 < 0.0f)));
-        int r2 = (int)(s2 + 0.5f * (1.0f - 2.0f * (s2 < 0.0f)));
-        int r3 = (int)(s3 + 0.5f * (1.0f - 2.0f * (s3 < 0.0f)));
-
-        r0 = r0 > 255 ? 255 : (r0 < 0 ? 0 : r0);
-        r1 = r1 > 255 ? 255 : (r1 < 0 ? 0 : r1);
-        r2 = r2 > 255 ? 255 : (r2 < 0 ? 0 : r2);
-        r3 = r3 > 255 ? 255 : (r3 < 0 ? 0 : r3);
-
-        q[i]     = (uint8_t)r0;
-        q[i + 1] = (uint8_t)r1;
-        q[i + 2] = (uint8_t)r2;
-        q[i + 3] = (uint8_t)r3;
-    }
-
-    // Handle remaining elements
-    for (; i < n; ++i) {
-        float scaled = (v[i] - offset) * scale;
-        int rounded = (int)(scaled + 0.5f * (1.0f - 2.0f * (scaled < 0.0f)));
-        rounded = rounded > 255 ? 255 : (rounded < 0 ? 0 : rounded);
-        q[i] = (uint8_t)rounded;
-    }
-}
-
 static inline void quantize_float16_to_unsigned8bit (const uint16_t *v, uint8_t *q, float offset, float scale, int n) {
     int i = 0;
     for (; i + 3 < n; i += 4) {
@@ -633,38 +982,6 @@ static inline void quantize_i8_to_unsigned8bit (const int8_t *v, uint8_t *q, flo
     }
 }
 
-static inline void quantize_float32_to_signed8bit (const float *v, int8_t *q, float offset, float scale, int n) {
-    int i = 0;
-    for (; i + 3 < n; i += 4) {
-        float s0 = (v[i]     - offset) * scale;
-        float s1 = (v[i + 1] - offset) * scale;
-        float s2 = (v[i + 2] - offset) * scale;
-        float s3 = (v[i + 3] - offset) * scale;
-
-        int r0 = (int)(s0 + 0.5f * (1.0f - 2.0f * (s0 < 0.0f)));
-        int r1 = (int)(s1 + 0.5f * (1.0f - 2.0f * (s1 < 0.0f)));
-        int r2 = (int)(s2 + 0.5f * (1.0f - 2.0f * (s2 < 0.0f)));
-        int r3 = (int)(s3 + 0.5f * (1.0f - 2.0f * (s3 < 0.0f)));
-
-        r0 = r0 > 127 ? 127 : (r0 < -128 ? -128 : r0);
-        r1 = r1 > 127 ? 127 : (r1 < -128 ? -128 : r1);
-        r2 = r2 > 127 ? 127 : (r2 < -128 ? -128 : r2);
-        r3 = r3 > 127 ? 127 : (r3 < -128 ? -128 : r3);
-
-        q[i]     = (int8_t)r0;
-        q[i + 1] = (int8_t)r1;
-        q[i + 2] = (int8_t)r2;
-        q[i + 3] = (int8_t)r3;
-    }
-
-    for (; i < n; ++i) {
-        float scaled = (v[i] - offset) * scale;
-        int rounded = (int)(scaled + 0.5f * (1.0f - 2.0f * (scaled < 0.0f)));
-        rounded = rounded > 127 ? 127 : (rounded < -128 ? -128 : rounded);
-        q[i] = (int8_t)rounded;
-    }
-}
-
 static inline void quantize_float16_to_signed8bit (const uint16_t *v, int8_t *q, float offset, float scale, int n) {
     int i = 0;
     for (; i + 3 < n; i += 4) {
@@ -742,8 +1059,8 @@ static inline void quantize_i8_to_signed8bit (const int8_t *v, int8_t *q, float
 }
 
 static inline void quantize_float32 (const float *v, uint8_t *q, float offset, float scale, int dim, vector_qtype qtype) {
-    if (qtype == VECTOR_QUANT_U8BIT) quantize_float32_to_unsigned8bit(v, q, offset, scale, dim);
-    else quantize_float32_to_signed8bit(v, (int8_t *)q, offset, scale, dim);
+    if (qtype == VECTOR_QUANT_U8BIT) dispatch_quantize_table.f32_to_u8(v, q, offset, scale, dim);
+    else dispatch_quantize_table.f32_to_s8(v, q, offset, scale, dim);
 }
 
 static inline void quantize_float16 (const uint16_t *v, uint8_t *q, float offset, float scale, int dim, vector_qtype qtype) {
@@ -767,25 +1084,19 @@ static inline void quantize_i8 (const int8_t *v, uint8_t *q, float offset, float
 }
 
 static void quantize_binary (const float *input, uint8_t *output, int dim, bool is_binary_mean) {
-      float threshold = 0.0f;
-
-      if (is_binary_mean) {
-          // compute mean as threshold
-          float sum = 0.0f;
-          for (int i = 0; i < dim; i++) {
-              sum += input[i];
-          }
-          threshold = sum / dim;
-      }
-
-      // quantize
-      memset(output, 0, (dim + 7) / 8);
-      for (int i = 0; i < dim; i++) {
-          if (input[i] >= threshold) {
-              output[i / 8] |= (1 << (i % 8));
-          }
-      }
-  }
+    float threshold = 0.0f;
+    
+    if (is_binary_mean) {
+        // compute mean as threshold
+        float sum = 0.0f;
+        for (int i = 0; i < dim; i++) {
+            sum += input[i];
+        }
+        threshold = sum / dim;
+    }
+    
+    dispatch_quantize_table.f32_to_bit(input, output, threshold, dim);
+}
 
 static void quantize_binary_f16 (const uint16_t *input, uint8_t *output, int dim, bool is_binary_mean) {
     float threshold = 0.0f;
@@ -827,26 +1138,100 @@ static void quantize_binary_bf16 (const uint16_t *input, uint8_t *output, int di
 
 static void quantize_binary_u8 (const uint8_t *input, uint8_t *output, int dim) {
     // For unsigned 8-bit, threshold at 128 (midpoint)
-    memset(output, 0, (dim + 7) / 8);
-    for (int i = 0; i < dim; i++) {
-        if (input[i] >= 128) {
-            output[i / 8] |= (1 << (i % 8));
-        }
-    }
+    dispatch_quantize_table.u8_to_bit(input, output, dim);
 }
 
 static void quantize_binary_i8 (const int8_t *input, uint8_t *output, int dim) {
     // For signed 8-bit, threshold at 0 (sign-based)
-    memset(output, 0, (dim + 7) / 8);
-    for (int i = 0; i < dim; i++) {
-        if (input[i] >= 0) {
-            output[i / 8] |= (1 << (i % 8));
+    dispatch_quantize_table.i8_to_bit((const uint8_t *)input, output, dim);
+}
+
+static inline bool quant_is_4bit (vector_qtype qtype) {
+    return (qtype == VECTOR_QUANT_4BIT || qtype == VECTOR_QUANT_U4BIT || qtype == VECTOR_QUANT_S4BIT);
+}
+
+static inline uint8_t quantize_nibble (uint8_t code, bool is_signed) {
+    // an 8-bit code computed at a 4-bit scale, clamped to 0..15 (UINT4) or -8..7 (INT4)
+    if (is_signed) {
+        int c = (int8_t)code;
+        return (uint8_t)(((c < -8) ? -8 : (c > 7) ? 7 : c) & 0x0F);
+    }
+    return (code > 15) ? 15 : code;
+}
+
+static void quantize_nibbles (const uint8_t *codes, uint8_t *q, int n, bool is_signed) {
+    // packs n codes two per byte, the first one in the low nibble (the high nibble of an odd last code is zero)
+    for (int i=0; i<n; i+=2) {
+        uint8_t hi = (i + 1 < n) ? quantize_nibble(codes[i + 1], is_signed) : 0;
+        q[i / 2] = (uint8_t)(quantize_nibble(codes[i], is_signed) | (hi << 4));
+    }
+}
+
+static void quantize_vector (const void *v, uint8_t *q, vector_type type, int dim, vector_qtype qtype, float offset, float scale, bool binary_mean) {
+    if (quant_is_4bit(qtype)) {
+        // 4-bit quantization: 8-bit codes at a 4-bit scale, packed block by block
+        bool is_signed = (qtype == VECTOR_QUANT_S4BIT);
+        size_t esize = (type == VECTOR_TYPE_F32) ? sizeof(float) : (type == VECTOR_TYPE_F16 || type == VECTOR_TYPE_BF16) ? sizeof(uint16_t) : sizeof(uint8_t);
+        uint8_t codes[QUANT_NIBBLE_BLOCK];
+        for (int i=0; i<dim; i+=QUANT_NIBBLE_BLOCK) {
+            int n = (dim - i < QUANT_NIBBLE_BLOCK) ? dim - i : QUANT_NIBBLE_BLOCK;
+            quantize_vector((const uint8_t *)v + (size_t)i * esize, codes, type, n, (is_signed) ? VECTOR_QUANT_S8BIT : VECTOR_QUANT_U8BIT, offset, scale, binary_mean);
+            quantize_nibbles(codes, q + i / 2, n, is_signed);
+        }
+        return;
+    }
+    
+    if (qtype == VECTOR_QUANT_1BIT) {
+        // 1-bit quantization: convert source to binary based on type
+        switch (type) {
+            case VECTOR_TYPE_F32: quantize_binary((const float *)v, q, dim, binary_mean); break;
+            case VECTOR_TYPE_F16: quantize_binary_f16((const uint16_t *)v, q, dim, false); break;
+            case VECTOR_TYPE_BF16: quantize_binary_bf16((const uint16_t *)v, q, dim, false); break;
+            case VECTOR_TYPE_U8: quantize_binary_u8((const uint8_t *)v, q, dim); break;
+            case VECTOR_TYPE_I8: quantize_binary_i8((const int8_t *)v, q, dim); break;
+            case VECTOR_TYPE_BIT: memcpy(q, v, (dim + 7) / 8); break; // Already binary
         }
+        return;
+    }
+    
+    // 8-bit quantization (U8BIT or S8BIT)
+    switch (type) {
+        case VECTOR_TYPE_F32: quantize_float32((const float *)v, q, offset, scale, dim, qtype); break;
+        case VECTOR_TYPE_F16: quantize_float16((const uint16_t *)v, q, offset, scale, dim, qtype); break;
+        case VECTOR_TYPE_BF16: quantize_bfloat16((const uint16_t *)v, q, offset, scale, dim, qtype); break;
+        case VECTOR_TYPE_U8: quantize_u8((const uint8_t *)v, q, offset, scale, dim, qtype); break;
+        case VECTOR_TYPE_I8: quantize_i8((const int8_t *)v, q, offset, scale, dim, qtype); break;
+        case VECTOR_TYPE_BIT: memcpy(q, v, (dim + 7) / 8); break; // BIT to 8-bit: just copy
     }
 }
 
 // MARK: - General Utils -
 
+#if VECTOR_STATS
+static int64_t vector_stats_clock (void) {
+    // monotonic time in nanoseconds
+    struct timespec ts;
+    #ifdef _WIN32
+    timespec_get(&ts, TIME_UTC);
+    #else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    #endif
+    return (int64_t)ts.tv_sec * 1000000000LL + (int64_t)ts.tv_nsec;
+}
+
+static void vector_stats_add (vector_stats *dst, const vector_stats *src) {
+    dst->scans += src->scans;
+    dst->rows_scanned += src->rows_scanned;
+    dst->rows_skipped += src->rows_skipped;
+    dst->chunks_read += src->chunks_read;
+    dst->bytes_touched += src->bytes_touched;
+    dst->kernel_ns += src->kernel_ns;
+    dst->heap_updates += src->heap_updates;
+    dst->preload_hits += src->preload_hits;
+    dst->preload_misses += src->preload_misses;
+}
+#endif
+
 static int vector_type_to_size (vector_type type) {
     switch (type) {
         case VECTOR_TYPE_F32:  return sizeof(float);        // 4 bytes
@@ -889,10 +1274,91 @@ static size_t vector_bytes_for_dim (vector_type type, int dim) {
     return (size_t)dim * vector_type_to_size(type);
 }
 
+static size_t pq_code_bytes (const pq_codebook *pq) {
+    return (pq->nbits == 4) ? (size_t)((pq->m + 1) / 2) : (size_t)pq->m;
+}
+
+static size_t quant_bytes_for_dim (vector_qtype qtype, int dim, const pq_codebook *pq) {
+    // returns the bytes of a quantized vector inside a quant chunk record
+    if (qtype == VECTOR_QUANT_1BIT) return (size_t)((dim + 7) / 8);
+    if (qtype == VECTOR_QUANT_PQ) return pq_code_bytes(pq);
+    if (quant_is_4bit(qtype)) return (size_t)((dim + 1) / 2);
+    return (size_t)dim * sizeof(uint8_t);
+}
+
+static size_t quant_level_bytes (bool binary_level, int dim) {
+    // bytes of the 1BIT code that precedes the 8-bit code of a record in a cascaded quantization (0 otherwise)
+    return (binary_level) ? (size_t)((dim + 7) / 8) : 0;
+}
+
+static size_t quant_code_bytes (const table_context *t) {
+    // bytes of the code of a quant chunk record (both levels of a cascaded quantization)
+    return quant_level_bytes(t->binary_level, t->options.v_dim) + quant_bytes_for_dim(t->options.q_type, t->options.v_dim, &t->pq);
+}
+
+static void quantize_code_bits (const uint8_t *code, uint8_t *bits, vector_qtype qtype, int dim) {
+    // 1BIT level of a cascaded quantization: every 8-bit code compared with the middle of its calibrated range
+    if (qtype == VECTOR_QUANT_S8BIT) quantize_binary_i8((const int8_t *)code, bits, dim);
+    else quantize_binary_u8(code, bits, dim);
+}
+
+static bool vector_to_float32 (const void *v, vector_type type, float *out, int dim) {
+    // widen a stored vector to float32 (BIT vectors have no meaningful float representation)
+    switch (type) {
+        case VECTOR_TYPE_F32: memcpy(out, v, (size_t)dim * sizeof(float)); return true;
+        case VECTOR_TYPE_F16: for (int i=0; i<dim; ++i) out[i] = float16_to_float32(((const uint16_t *)v)[i]); return true;
+        case VECTOR_TYPE_BF16: for (int i=0; i<dim; ++i) out[i] = bfloat16_to_float32(((const uint16_t *)v)[i]); return true;
+        case VECTOR_TYPE_U8: for (int i=0; i<dim; ++i) out[i] = (float)((const uint8_t *)v)[i]; return true;
+        case VECTOR_TYPE_I8: for (int i=0; i<dim; ++i) out[i] = (float)((const int8_t *)v)[i]; return true;
+        case VECTOR_TYPE_BIT: break;
+    }
+    return false;
+}
+
+static void vector_minmax_f32 (const float *v, int n, float *min_val, float *max_val) {
+    // eight independent lanes: the compiler turns the two reductions into packed min/max instructions
+    float lo[8], hi[8];
+    for (int j=0; j<8; ++j) {
+        lo[j] = *min_val;
+        hi[j] = *max_val;
+    }
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int j=0; j<8; ++j) {
+            lo[j] = (v[i + j] < lo[j]) ? v[i + j] : lo[j];
+            hi[j] = (v[i + j] > hi[j]) ? v[i + j] : hi[j];
+        }
+    }
+    for (; i < n; ++i) {
+        lo[0] = (v[i] < lo[0]) ? v[i] : lo[0];
+        hi[0] = (v[i] > hi[0]) ? v[i] : hi[0];
+    }
+    for (int j=0; j<8; ++j) {
+        if (lo[j] < *min_val) *min_val = lo[j];
+        if (hi[j] > *max_val) *max_val = hi[j];
+    }
+}
+
 static vector_qtype quant_name_to_type (const char *qname) {
     if (strcasecmp(qname, "UINT8") == 0) return VECTOR_QUANT_U8BIT;
     if (strcasecmp(qname, "INT8") == 0) return VECTOR_QUANT_S8BIT;
+    if (strcasecmp(qname, "UINT4") == 0) return VECTOR_QUANT_U4BIT;
+    if (strcasecmp(qname, "INT4") == 0) return VECTOR_QUANT_S4BIT;
+    if (strcasecmp(qname, "4BIT") == 0) return VECTOR_QUANT_4BIT;
     if (strcasecmp(qname, "1BIT") == 0 || strcasecmp(qname, "BIT") == 0 || strcasecmp(qname, "BINARY") == 0) return VECTOR_QUANT_1BIT;
+    if (strcasecmp(qname, "PQ") == 0) return VECTOR_QUANT_PQ;
+    return -1;
+}
+
+static int index_name_to_type (const char *iname) {
+    if (strcasecmp(iname, "IVF") == 0) return VECTOR_INDEX_IVF;
+    if (strcasecmp(iname, "NONE") == 0 || strcasecmp(iname, "FLAT") == 0) return VECTOR_INDEX_NONE;
+    return -1;
+}
+
+static int calibration_name_to_type (const char *cname) {
+    if (strcasecmp(cname, "GLOBAL") == 0) return VECTOR_CALIBRATION_GLOBAL;
+    if (strcasecmp(cname, "DIMENSION") == 0 || strcasecmp(cname, "DIM") == 0) return VECTOR_CALIBRATION_DIMENSION;
     return -1;
 }
 
@@ -1089,645 +1555,3472 @@ bool vector_keyvalue_callback (sqlite3_context *context, void *xdata, const char
         return true;
     }
     
-    if (KEY_MATCH(OPTION_KEY_DISTANCE)) {
-        vector_distance type = distance_name_to_type(buffer);
-        if (type == 0) return context_result_error(context, SQLITE_ERROR, "Invalid distance name: '%s' is not a recognized or supported distance", buffer);
-        options->v_distance = type;
+    if (KEY_MATCH(OPTION_KEY_RERANK)) {
+        int rerank = (int)strtol(buffer, NULL, 0);
+        if (rerank < 0 || rerank > MAX_RERANK_FACTOR) return context_result_error(context, SQLITE_ERROR, "Invalid rerank factor: expected an integer between 0 and %d, got '%s'", MAX_RERANK_FACTOR, buffer);
+        options->rerank = rerank;
         return true;
     }
-
-    // means ignore unknown keys
-    return true;
-}
-
-static inline int nearly_zero_float32 (float x) {
-    return fabsf(x) <= 8.0f * FLT_EPSILON;  // tweak factor for your use
-}
-
-// MARK: - SQL -
-
-static char *generate_create_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
-    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "CREATE TABLE IF NOT EXISTS vector0_%q_%q (rowid1 INTEGER, rowid2 INTEGER, counter INTEGER, data BLOB);", table_name, column_name);
-}
-
-static char *generate_drop_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
-    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DROP TABLE IF EXISTS vector0_%q_%q;", table_name, column_name);
-}
-
-static char *generate_select_from_table (const char *table_name, const char *column_name, const char *pk_name, char sql[STATIC_SQL_SIZE]) {
-    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT %q, %q FROM %q ORDER BY %q;", pk_name, column_name, table_name, pk_name);
-}
-
-static char *generate_select_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
-    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q;", table_name, column_name);
-}
-
-static char *generate_memory_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
-    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT SUM(LENGTH(data)) FROM vector0_%q_%q;", table_name, column_name);
-}
-
-static char *generate_insert_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
-    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "INSERT INTO vector0_%q_%q (rowid1, rowid2, counter, data) VALUES (?, ?, ?, ?);", table_name, column_name);
-}
-
-static char *generate_quant_table_name (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
-    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "vector0_%q_%q", table_name, column_name);
-}
-
-// MARK: - Vector Context and Options -
-
-void *vector_context_create (void) {
-    vector_context *ctx = (vector_context *)sqlite3_malloc(sizeof(vector_context));
-    if (!ctx) return NULL;
     
-    memset(ctx, 0, sizeof(vector_context));
-    return (void *)ctx;
-}
-
-void vector_context_free (void *p) {
-    if (p) {
-        vector_context *ctx = (vector_context *)p;
-        for (int i=0; i<ctx->table_count; ++i) {
-            if (ctx->tables[i].t_name) sqlite3_free(ctx->tables[i].t_name);
-            if (ctx->tables[i].c_name) sqlite3_free(ctx->tables[i].c_name);
-            if (ctx->tables[i].pk_name) sqlite3_free(ctx->tables[i].pk_name);
-            if (ctx->tables[i].preloaded) sqlite3_free(ctx->tables[i].preloaded);
-        }
-        sqlite3_free(p);
+    if (KEY_MATCH(OPTION_KEY_CASCADE)) {
+        int cascade = (int)strtol(buffer, NULL, 0);
+        if (cascade < 0 || cascade > MAX_CASCADE_FACTOR) return context_result_error(context, SQLITE_ERROR, "Invalid cascade factor: expected an integer between 0 and %d, got '%s'", MAX_CASCADE_FACTOR, buffer);
+        options->cascade = cascade;
+        return true;
     }
-}
-
-table_context *vector_context_lookup (vector_context *ctx, const char *table_name, const char *column_name) {
-    if ((table_name == NULL) || (column_name == NULL)) return NULL;
     
-    for (int i=0; i<ctx->table_count; ++i) {
-        // tname and cname can be NULL after adding vector_cleanup function
-        const char *tname = ctx->tables[i].t_name;
-        const char *cname = ctx->tables[i].c_name;
-        if (tname && cname && (strcasecmp(tname, table_name) == 0) && (strcasecmp(cname, column_name) == 0)) return &ctx->tables[i];
-    }
-    return NULL;
-}
-
-void vector_context_add (sqlite3_context *context, vector_context *ctx, const char *table_name, const char *column_name, vector_options *options) {
-    // check if there is a free slot
-    if (ctx->table_count >= MAX_TABLES) {
-        context_result_error(context, SQLITE_ERROR, "Cannot add table: maximum number of allowed tables reached (%d)", MAX_TABLES);
-        return;
+    if (KEY_MATCH(OPTION_KEY_INDEX)) {
+        int index = index_name_to_type(buffer);
+        if (index == -1) return context_result_error(context, SQLITE_ERROR, "Invalid index type: '%s' is not a recognized index type (supported: ivf, none)", buffer);
+        options->index = (vector_index)index;
+        return true;
     }
     
-    char *t_name = sqlite_strdup(table_name);
-    char *c_name = sqlite_strdup(column_name);
-    if (!t_name || !c_name) {
-        context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to duplicate table or column name");
-        if (t_name) sqlite3_free(t_name);
-        if (c_name) sqlite3_free(c_name);
-        return;
+    if (KEY_MATCH(OPTION_KEY_NLIST)) {
+        int nlist = (int)strtol(buffer, NULL, 0);
+        if (nlist <= 0 || nlist > MAX_IVF_NLIST) return context_result_error(context, SQLITE_ERROR, "Invalid nlist: expected an integer between 1 and %d, got '%s'", MAX_IVF_NLIST, buffer);
+        options->nlist = nlist;
+        return true;
     }
     
-    char *prikey = NULL;
-    sqlite3 *db = sqlite3_context_db_handle(context);
-    bool is_without_rowid = sqlite_table_is_without_rowid(db, table_name);
-    prikey = (is_without_rowid == false) ? sqlite_strdup("rowid") : sqlite_get_int_prikey_column(db, table_name);
-
-    // sanity check primary key
-    if (!prikey) {
-        (is_without_rowid) ? context_result_error(context, SQLITE_ERROR, "WITHOUT ROWID table '%s' must have exactly one PRIMARY KEY column of type INTEGER", table_name) : context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to duplicate rowid column name");
-        sqlite3_free(t_name);
-        sqlite3_free(c_name);
-        return;
+    if (KEY_MATCH(OPTION_KEY_NPROBE)) {
+        int nprobe = (int)strtol(buffer, NULL, 0);
+        if (nprobe <= 0) return context_result_error(context, SQLITE_ERROR, "Invalid nprobe: expected a positive integer, got '%s'", buffer);
+        options->nprobe = nprobe;
+        return true;
     }
     
-    int index = ctx->table_count;
-    ctx->tables[index].t_name = t_name;
-    ctx->tables[index].c_name = c_name;
-    ctx->tables[index].pk_name = prikey;
-    ctx->tables[index].options = *options;
-    ctx->table_count++;
-    
-    sqlite_unserialize(context, &ctx->tables[index]);
-}
-
-void vector_options_init (vector_options *options) {
-    memset(options, 0, sizeof(vector_options));
-    options->v_type = VECTOR_TYPE_F32;
-    options->v_distance = VECTOR_DISTANCE_L2;
-    options->max_memory = DEFAULT_MAX_MEMORY;
-    options->q_type = VECTOR_QUANT_AUTO;
-}
-
-vector_options vector_options_create (void) {
-    vector_options options;
-    vector_options_init(&options);
-    return options;
-}
-
-
-// MARK: - Public -
-
-static int vector_serialize_quantization (sqlite3 *db, const char *table_name, const char *column_name, uint32_t nrows, uint8_t *data, ptrdiff_t data_size, int64_t min_rowid, int64_t max_rowid) {
-    
-    char sql[STATIC_SQL_SIZE];
-    generate_insert_quant_table(table_name, column_name, sql);
+    if (KEY_MATCH(OPTION_KEY_M)) {
+        int m = (int)strtol(buffer, NULL, 0);
+        if (m < 2 || m > MAX_HNSW_M) return context_result_error(context, SQLITE_ERROR, "Invalid M: expected an integer between 2 and %d, got '%s'", MAX_HNSW_M, buffer);
+        options->m = m;
+        return true;
+    }
     
-    sqlite3_stmt *vm = NULL;
-    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
-    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    if (KEY_MATCH(OPTION_KEY_PQM)) {
+        int pq_m = (int)strtol(buffer, NULL, 0);
+        if (pq_m <= 0 || pq_m > MAX_PQ_M) return context_result_error(context, SQLITE_ERROR, "Invalid pq_m: expected an integer between 1 and %d, got '%s'", MAX_PQ_M, buffer);
+        options->pq_m = pq_m;
+        return true;
+    }
     
-    rc = sqlite3_bind_int64(vm, 1, min_rowid);
-    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    if (KEY_MATCH(OPTION_KEY_NBITS)) {
+        int nbits = (int)strtol(buffer, NULL, 0);
+        if (nbits != 4 && nbits != 8) return context_result_error(context, SQLITE_ERROR, "Invalid nbits: expected 4 or 8, got '%s'", buffer);
+        options->nbits = nbits;
+        return true;
+    }
     
-    rc = sqlite3_bind_int64(vm, 2, max_rowid);
-    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    if (KEY_MATCH(OPTION_KEY_CALIBRATION)) {
+        int calibration = calibration_name_to_type(buffer);
+        if (calibration == -1) return context_result_error(context, SQLITE_ERROR, "Invalid calibration: '%s' is not a recognized calibration (supported: global, dimension)", buffer);
+        options->calibration = (vector_calibration)calibration;
+        return true;
+    }
     
-    rc = sqlite3_bind_int(vm, 3, nrows);
-    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    if (KEY_MATCH(OPTION_KEY_PERCENTILE)) {
+        float percentile = strtof(buffer, NULL);
+        if (!(percentile > 50.0f && percentile <= 100.0f)) return context_result_error(context, SQLITE_ERROR, "Invalid percentile: expected a value greater than 50 and up to 100, got '%s'", buffer);
+        options->percentile = (percentile < 100.0f) ? percentile : 0.0f;
+        return true;
+    }
     
-    rc = sqlite3_bind_blob(vm, 4, (const void *)data, (int)data_size, SQLITE_STATIC);
-    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    if (KEY_MATCH(OPTION_KEY_CALIBSAMPLE)) {
+        int64_t calib_sample = (int64_t)strtoll(buffer, NULL, 0);
+        if (calib_sample < 0) return context_result_error(context, SQLITE_ERROR, "Invalid calib_sample: expected a non-negative integer, got '%s'", buffer);
+        options->calib_sample = calib_sample;
+        return true;
+    }
     
-    rc = sqlite3_step(vm);
-    if (rc == SQLITE_DONE) rc = SQLITE_OK;
+    if (KEY_MATCH(OPTION_KEY_AUTOUPDATE)) {
+        int auto_update = (int)strtol(buffer, NULL, 0);
+        options->auto_update = (auto_update != 0);
+        return true;
+    }
     
-vector_serialize_quantization_cleanup:
-    if (rc != SQLITE_OK) printf("Error in vector_serialize_quantization: %s\n", sqlite3_errmsg(db));
-    if (vm) sqlite3_finalize(vm);
-    return rc;
-}
-
-static int vector_rebuild_quantization (sqlite3_context *context, const char *table_name, const char *column_name, table_context *t_ctx, vector_qtype qtype, uint64_t max_memory, uint32_t *count) {
+    if (KEY_MATCH(OPTION_KEY_MMAP)) {
+        int mmap = (int)strtol(buffer, NULL, 0);
+        options->mmap = (mmap != 0);
+        return true;
+    }
     
-    int rc = SQLITE_NOMEM;
-    sqlite3_stmt *vm = NULL;
-    char sql[STATIC_SQL_SIZE];
-    sqlite3 *db = sqlite3_context_db_handle(context);
-    uint32_t tot_processed = 0;
+    if (KEY_MATCH(OPTION_KEY_EF_CONSTRUCTION)) {
+        int ef = (int)strtol(buffer, NULL, 0);
+        if (ef <= 0 || ef > MAX_HNSW_EF) return context_result_error(context, SQLITE_ERROR, "Invalid ef_construction: expected an integer between 1 and %d, got '%s'", MAX_HNSW_EF, buffer);
+        options->ef_construction = ef;
+        return true;
+    }
     
-    const char *pk_name = t_ctx->pk_name;
-    int dim = t_ctx->options.v_dim;
-    vector_type type = t_ctx->options.v_type;
+    if (KEY_MATCH(OPTION_KEY_EF_SEARCH)) {
+        int ef = (int)strtol(buffer, NULL, 0);
+        if (ef <= 0 || ef > MAX_HNSW_EF) return context_result_error(context, SQLITE_ERROR, "Invalid ef_search: expected an integer between 1 and %d, got '%s'", MAX_HNSW_EF, buffer);
+        options->ef_search = ef;
+        return true;
+    }
     
-    // compute size of a single quant, format is: rowid + quantize dimensions
-    size_t quant_bytes = (qtype == VECTOR_QUANT_1BIT) ? ((dim + 7) / 8) : (dim * sizeof(uint8_t));
-    size_t q_size = sizeof(int64_t) + quant_bytes;
-    if (q_size == 0) {
-        sqlite3_result_error(context, "Vector dimension is zero, which is not possible", -1);
-        return SQLITE_MISUSE;
+    if (KEY_MATCH(OPTION_KEY_STATS)) {
+        int stats = (int)strtol(buffer, NULL, 0);
+        options->stats = (stats != 0);
+        return true;
     }
     
-    // max_memory == 0 means use all required memory
-    if (max_memory == 0) {
-        sqlite3_snprintf(sizeof(sql), sql, "SELECT COUNT(*) FROM %q;", table_name);
-        int64_t count = sqlite_read_int64(db, sql);
-        max_memory = (count == 0) ? DEFAULT_MAX_MEMORY : (uint64_t)count * (uint64_t)q_size;
-        if (count <= 0) {
-            // no vectors
-            t_ctx->options.q_type = (qtype == VECTOR_QUANT_AUTO) ? VECTOR_QUANT_U8BIT : qtype;
-            t_ctx->scale = 1.0f;
-            t_ctx->offset = 0.0f;
-            return SQLITE_OK;
-        }
+    if (KEY_MATCH(OPTION_KEY_THREADS)) {
+        int threads = (int)strtol(buffer, NULL, 0);
+        if (threads < 0 || threads > VECTOR_POOL_MAX_THREADS) return context_result_error(context, SQLITE_ERROR, "Invalid threads: expected an integer between 0 and %d, got '%s'", VECTOR_POOL_MAX_THREADS, buffer);
+        options->threads = threads;
+        return true;
     }
     
-    // max number of vectors that fits in max_memory (per batch; force at least 1)
-    uint32_t max_vectors = (uint32_t)(max_memory / (uint64_t)q_size);
-    if (max_vectors == 0) max_vectors = 1;
+    if (KEY_MATCH(OPTION_KEY_DISTANCE)) {
+        vector_distance type = distance_name_to_type(buffer);
+        if (type == 0) return context_result_error(context, SQLITE_ERROR, "Invalid distance name: '%s' is not a recognized or supported distance", buffer);
+        options->v_distance = type;
+        return true;
+    }
+
+    // means ignore unknown keys
+    return true;
+}
+
+typedef struct {
+    vector_options      *options;
+    char                rejected[64];       // first key that cannot be set per query
+} vector_query_options;
+
+static bool vector_query_keyvalue_callback (sqlite3_context *context, void *xdata, const char *key, int key_len, const char *value, int value_len) {
+    // per-query options of the scans: only the keys read at query time, the others are fixed by vector_init and vector_quantize
+    vector_query_options *query = (vector_query_options *)xdata;
+    if (KEY_MATCH(OPTION_KEY_RERANK) || KEY_MATCH(OPTION_KEY_NPROBE) || KEY_MATCH(OPTION_KEY_EF_SEARCH) || KEY_MATCH(OPTION_KEY_THREADS) || KEY_MATCH(OPTION_KEY_STATS) || KEY_MATCH(OPTION_KEY_CASCADE)) {
+        return vector_keyvalue_callback(context, query->options, key, key_len, value, value_len);
+    }
     
-    sqlite3_uint64 out_bytes = (sqlite3_uint64)max_vectors * (sqlite3_uint64)q_size;
-    uint8_t *data = sqlite3_malloc64(out_bytes);
-    uint8_t *original = data;
-    if (!data) goto vector_rebuild_quantization_cleanup;
-        
-    // SELECT rowid, embedding FROM table
-    generate_select_from_table(table_name, column_name, pk_name, sql);
-    rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
-    if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+    int len = (key_len < (int)sizeof(query->rejected) - 1) ? key_len : (int)sizeof(query->rejected) - 1;
+    memcpy(query->rejected, key, len);
+    query->rejected[len] = 0;
+    return false;
+}
+
+static int vector_query_options_parse (sqlite3_vtab *vtab, const char *fname, const char *arg_options, vector_options *options) {
+    // parses the per-query options of a scan into options (the vtab error is set on failure)
+    vector_query_options query = {options, {0}};
+    if (parse_keyvalue_string(NULL, arg_options, vector_query_keyvalue_callback, &query)) return SQLITE_OK;
     
-    // STEP 1
-    // find global min/max across ALL vectors (skip for 1BIT quantization which uses fixed threshold)
-    float min_val = FLT_MAX;
-    float max_val = -FLT_MAX;
-    bool contains_negative = false;
+    if (query.rejected[0]) return sqlite_vtab_set_error(vtab, "%s: option '%s' not allowed per query (supported: rerank, nprobe, ef_search, threads, stats, cascade)", fname, query.rejected);
+    return sqlite_vtab_set_error(vtab, "%s: invalid options '%s'", fname, arg_options);
+}
 
-    if (qtype != VECTOR_QUANT_1BIT) {
-        while (1) {
-            rc = sqlite3_step(vm);
-            if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;}
-            else if (rc != SQLITE_ROW) break;
-            if (sqlite3_column_type(vm, 1) == SQLITE_NULL) continue;
+static inline int nearly_zero_float32 (float x) {
+    return fabsf(x) <= 8.0f * FLT_EPSILON;  // tweak factor for your use
+}
 
-            const void *blob = (float *)sqlite3_column_blob(vm, 1);
-            if (!blob) continue;
+static inline uint32_t vector_random (uint64_t *state) {
+    // deterministic LCG (Knuth MMIX constants): rebuilding the same table always produces the same index
+    *state = (*state * 6364136223846793005ULL) + 1442695040888963407ULL;
+    return (uint32_t)(*state >> 33);
+}
 
-            size_t blob_size = (size_t)sqlite3_column_bytes(vm, 1);
-            size_t need_bytes = vector_bytes_for_dim(type, dim);
-            if (blob_size < need_bytes) {
-                context_result_error(context, SQLITE_ERROR, "Invalid vector blob found at rowid %lld", (long long)sqlite3_column_int64(vm, 0));
-                rc = SQLITE_ERROR;
-                goto vector_rebuild_quantization_cleanup;
-            }
+// MARK: - Distance -
 
-            for (int i = 0; i < dim; ++i) {
-                float val = 0.0f;
-                switch (type) {
-                    case VECTOR_TYPE_F32:
-                        val = ((float *)blob)[i];
-                        break;
-                    case VECTOR_TYPE_F16:
-                        val = float16_to_float32(((uint16_t *)blob)[i]);
-                        break;
-                    case VECTOR_TYPE_BF16:
-                        val = bfloat16_to_float32(((uint16_t *)blob)[i]);
-                        break;
-                    case VECTOR_TYPE_U8:
-                        val = (float)(((uint8_t *)blob)[i]);
-                        break;
-                    case VECTOR_TYPE_I8:
-                        val = (float)(((int8_t *)blob)[i]);
-                        break;
-                    default:
-                        context_result_error(context, SQLITE_ERROR, "Unsupported vector type for 8-bit quantization");
-                        rc = SQLITE_ERROR;
-                        goto vector_rebuild_quantization_cleanup;
-                }
+// With normalized=1 every vector has unit norm, so cosine distance is 1 - dot: a single dot product per pair
+// instead of the dot product and the two norms computed by the cosine kernels (the DOT kernels return -dot).
+static inline float vector_cosine_from_dot (float distance) {
+    float cosine_similarity = -distance;
+    if (cosine_similarity > 1.0f) cosine_similarity = 1.0f;
+    if (cosine_similarity < -1.0f) cosine_similarity = -1.0f;
+    return 1.0f - cosine_similarity;
+}
 
-                if (val < min_val) min_val = val;
-                if (val > max_val) max_val = val;
-                if (val < 0.0) contains_negative = true;
-            }
+static float float32_distance_cosine_normalized (const void *v1, const void *v2, int n) {
+    return vector_cosine_from_dot(dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_F32](v1, v2, n));
+}
+
+static float float16_distance_cosine_normalized (const void *v1, const void *v2, int n) {
+    return vector_cosine_from_dot(dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_F16](v1, v2, n));
+}
+
+static float bfloat16_distance_cosine_normalized (const void *v1, const void *v2, int n) {
+    return vector_cosine_from_dot(dispatch_distance_table[VECTOR_DISTANCE_DOT][VECTOR_TYPE_BF16](v1, v2, n));
+}
+
+static distance_function_t vector_distance_function (const vector_options *options, vector_type vt) {
+    // distance between two original (not quantized) vectors of the column
+    vector_distance vd = options->v_distance;
+    if (vt == VECTOR_TYPE_BIT) vd = VECTOR_DISTANCE_HAMMING;  // Force Hamming for BIT type
+    if (vd == VECTOR_DISTANCE_COSINE && options->v_normalized) {
+        // integer vectors cannot have unit norm, they keep the regular kernels
+        switch (vt) {
+            case VECTOR_TYPE_F32: return float32_distance_cosine_normalized;
+            case VECTOR_TYPE_F16: return float16_distance_cosine_normalized;
+            case VECTOR_TYPE_BF16: return bfloat16_distance_cosine_normalized;
+            default: break;
+        }
+    }
+    return dispatch_distance_table[vd][vt];
+}
+
+static float vector_code_norm (const uint8_t *code, int n, bool is_signed) {
+    // norm of an 8-bit code, rounded exactly like the norms computed by the cosine kernels
+    int64_t norm = 0;
+    if (is_signed) for (int i=0; i<n; ++i) norm += (int64_t)((const int8_t *)code)[i] * ((const int8_t *)code)[i];
+    else for (int i=0; i<n; ++i) norm += (int64_t)code[i] * code[i];
+    return sqrtf((float)norm);
+}
+
+// MARK: - IVF -
+
+static distance_function_t ivf_distance_function (vector_distance distance) {
+    // centroids are float32 means: DOT (unbounded, not a metric) is assigned by direction instead
+    if (distance == VECTOR_DISTANCE_DOT) distance = VECTOR_DISTANCE_COSINE;
+    return dispatch_distance_table[distance][VECTOR_TYPE_F32];
+}
+
+static int ivf_nearest (const float *centroids, int nlist, const float *v, int dim, distance_function_t distance_fn) {
+    int best = 0;
+    float best_distance = INFINITY;
+    for (int i=0; i<nlist; ++i) {
+        float distance = distance_fn((const void *)v, (const void *)(centroids + (size_t)i * dim), dim);
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = i;
         }
     }
+    return best;
+}
 
-    // set proper format
-    if (qtype == VECTOR_QUANT_AUTO) {
-        if (contains_negative == true) qtype = VECTOR_QUANT_S8BIT;
-        else qtype = VECTOR_QUANT_U8BIT;
+static int ivf_train (const float *samples, int nsamples, int dim, int nlist, distance_function_t distance_fn, float *centroids) {
+    // Lloyd's k-means over the reservoir sample
+    float *sums = (float *)sqlite3_malloc64((sqlite3_uint64)nlist * dim * sizeof(float));
+    int *counts = (int *)sqlite3_malloc64((sqlite3_uint64)nlist * sizeof(int));
+    int *order = (int *)sqlite3_malloc64((sqlite3_uint64)nsamples * sizeof(int));
+    if (!sums || !counts || !order) {
+        if (sums) sqlite3_free(sums);
+        if (counts) sqlite3_free(counts);
+        if (order) sqlite3_free(order);
+        return SQLITE_NOMEM;
     }
     
-    // STEP 2
-    // compute scale and offset and set table them to table context standard min-max linear quantization
-    float abs_max = fmaxf(fabsf(min_val), fabsf(max_val)); // only used in VECTOR_QUANT_S8BIT
-    float range = max_val - min_val;
-    float scale;
-    if (qtype == VECTOR_QUANT_U8BIT) {
-        scale = (range > 0.0f) ? (255.0f / range) : 1.0f;
-    } else {
-        scale = (abs_max > 0.0f) ? (127.0f / abs_max) : 1.0f;
+    // initial centroids: nlist distinct samples picked with a partial Fisher-Yates shuffle
+    uint64_t seed = 0x5EED1F0ULL;
+    for (int i=0; i<nsamples; ++i) order[i] = i;
+    for (int i=0; i<nlist; ++i) {
+        int j = i + (int)(vector_random(&seed) % (uint32_t)(nsamples - i));
+        SWAP(int, order[i], order[j]);
+        memcpy(centroids + (size_t)i * dim, samples + (size_t)order[i] * dim, (size_t)dim * sizeof(float));
     }
-    // in the VECTOR_QUANT_S8BIT version I am assuming a symmetric quantization, for asymmetric quantization min_val should be used
-    float offset = (qtype == VECTOR_QUANT_U8BIT) ? min_val : 0.0f;
-    
-    t_ctx->options.q_type = qtype;
-    t_ctx->scale = scale;
-    t_ctx->offset = offset;
-    
-    // restart processing from the beginning
-    rc = sqlite3_reset(vm);
-    if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
     
-    // STEP 3
-    // actual quantization (ONLY 8bit is supported in this version)
-    uint32_t n_processed = 0;
-    int64_t min_rowid = 0, max_rowid = 0;
-    while (1) {
-        rc = sqlite3_step(vm);
-        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;}
-        else if (rc != SQLITE_ROW) break;
-        if (sqlite3_column_type(vm, 1) == SQLITE_NULL) continue;
+    for (int iter=0; iter<IVF_TRAIN_ITERATIONS; ++iter) {
+        memset(sums, 0, (size_t)nlist * dim * sizeof(float));
+        memset(counts, 0, (size_t)nlist * sizeof(int));
         
-        int64_t rowid = (int64_t)sqlite3_column_int64(vm, 0);
-        const void *blob = sqlite3_column_blob(vm, 1);
-        if (!blob) continue;
+        for (int i=0; i<nsamples; ++i) {
+            const float *v = samples + (size_t)i * dim;
+            int list = ivf_nearest(centroids, nlist, v, dim, distance_fn);
+            float *sum = sums + (size_t)list * dim;
+            for (int j=0; j<dim; ++j) sum[j] += v[j];
+            counts[list]++;
+        }
         
-        if (n_processed == 0) min_rowid = rowid;
-        VECTOR_PRINT((void *)blob, type, dim);
-        
-        // copy rowid
-        INT64_TO_INT8PTR(rowid, data);
-        data += sizeof(int64_t);
-        
-        // quantize vector
-        if (qtype == VECTOR_QUANT_1BIT) {
-            // 1-bit quantization: convert source to binary based on type
-            switch (type) {
-                case VECTOR_TYPE_F32: quantize_binary((const float *)blob, data, dim, t_ctx->binary_mean); break;
-                case VECTOR_TYPE_F16: quantize_binary_f16((const uint16_t *)blob, data, dim, false); break;
-                case VECTOR_TYPE_BF16: quantize_binary_bf16((const uint16_t *)blob, data, dim, false); break;
-                case VECTOR_TYPE_U8: quantize_binary_u8((const uint8_t *)blob, data, dim); break;
-                case VECTOR_TYPE_I8: quantize_binary_i8((const int8_t *)blob, data, dim); break;
-                case VECTOR_TYPE_BIT: memcpy(data, blob, (dim + 7) / 8); break; // Already binary
-            }
-        } else {
-            // 8-bit quantization (U8BIT or S8BIT)
-            switch (type) {
-                case VECTOR_TYPE_F32: quantize_float32((const float *)blob, data, offset, scale, dim, qtype); break;
-                case VECTOR_TYPE_F16: quantize_float16((const uint16_t *)blob, data, offset, scale, dim, qtype); break;
-                case VECTOR_TYPE_BF16: quantize_bfloat16((const uint16_t *)blob, data, offset, scale, dim, qtype); break;
-                case VECTOR_TYPE_U8: quantize_u8((const uint8_t *)blob, data, offset, scale, dim, qtype); break;
-                case VECTOR_TYPE_I8: quantize_i8((const int8_t *)blob, data, offset, scale, dim, qtype); break;
-                case VECTOR_TYPE_BIT: memcpy(data, blob, (dim + 7) / 8); break; // BIT to 8-bit: just copy
+        for (int i=0; i<nlist; ++i) {
+            float *centroid = centroids + (size_t)i * dim;
+            if (counts[i] == 0) {
+                // empty list: restart it from a random sample so no posting list is wasted
+                const float *v = samples + (size_t)(vector_random(&seed) % (uint32_t)nsamples) * dim;
+                memcpy(centroid, v, (size_t)dim * sizeof(float));
+                continue;
             }
+            const float *sum = sums + (size_t)i * dim;
+            float inv = 1.0f / (float)counts[i];
+            for (int j=0; j<dim; ++j) centroid[j] = sum[j] * inv;
+        }
+    }
+    
+    sqlite3_free(sums);
+    sqlite3_free(counts);
+    sqlite3_free(order);
+    return SQLITE_OK;
+}
+
+typedef struct {
+    int64_t     rowid;
+    int         list;
+    uint32_t    slot;                       // position of the record before sorting
+} ivf_entry;
+
+static int ivf_entry_compare (const void *a, const void *b) {
+    const ivf_entry *e1 = (const ivf_entry *)a;
+    const ivf_entry *e2 = (const ivf_entry *)b;
+    if (e1->list != e2->list) return (e1->list > e2->list) - (e1->list < e2->list);
+    return (e1->rowid > e2->rowid) - (e1->rowid < e2->rowid);
+}
+
+// MARK: - PQ -
+
+// Product quantization: a vector is split in m sub-vectors of dsub dimensions and every sub-vector is replaced
+// by the index of its closest codeword in a per sub-space codebook of 2^nbits entries (k-means trained).
+// Queries are not quantized: a lookup table with the distance between each query sub-vector and every codeword
+// is built once per query, so the distance to a code is just m table lookups (asymmetric distance computation).
+
+typedef struct {
+    const float     *lut;                   // nbytes x 256 partial distances indexed by code byte
+    const float     *norms;                 // COSINE: nbytes x 256 partial squared norms of the codewords (NULL otherwise)
+    float           qnorm;                  // COSINE: norm of the query
+} pq_query;
+
+static int pq_default_m (int dim) {
+    // sub-vectors of 8 dimensions when possible (768-d -> 96 bytes per code)
+    for (int dsub = 8; dsub > 1; dsub >>= 1) {
+        if (dim % dsub == 0) return dim / dsub;
+    }
+    return dim;
+}
+
+static int pq_train (const float *samples, int nsamples, int dim, pq_codebook *pq) {
+    // one k-means per sub-space, same Lloyd iterations used by the IVF coarse quantizer
+    int ksub = 1 << pq->nbits;
+    int dsub = pq->dsub;
+    int k = (nsamples < ksub) ? nsamples : ksub;
+    distance_function_t distance_fn = dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_F32];
+    
+    float *sub = (float *)sqlite3_malloc64((sqlite3_uint64)nsamples * dsub * sizeof(float));
+    if (!sub) return SQLITE_NOMEM;
+    
+    int rc = SQLITE_OK;
+    for (int j=0; j<pq->m; ++j) {
+        for (int i=0; i<nsamples; ++i) {
+            memcpy(sub + (size_t)i * dsub, samples + (size_t)i * dim + (size_t)j * dsub, (size_t)dsub * sizeof(float));
         }
         
-        #if DEBUG_VECTOR_SERIALIZATION
-        vector_type qprint = (qtype == VECTOR_QUANT_1BIT) ? VECTOR_TYPE_BIT : (qtype == VECTOR_QUANT_U8BIT) ? VECTOR_TYPE_U8 : VECTOR_TYPE_I8;
-        VECTOR_PRINT((void *)data, qprint, dim);
-        #endif
-        
-        data += (qtype == VECTOR_QUANT_1BIT) ? ((dim + 7) / 8) : (dim * sizeof(uint8_t));
-        max_rowid = rowid;
-        ++n_processed;
-        ++tot_processed;
+        float *codebook = pq->codebooks + (size_t)j * ksub * dsub;
+        rc = ivf_train(sub, nsamples, dsub, k, distance_fn, codebook);
+        if (rc != SQLITE_OK) break;
         
-        if (n_processed == max_vectors) {
-            size_t batch_size = data - original;  // compute actual bytes used
-            rc = vector_serialize_quantization(db, table_name, column_name, n_processed, original, batch_size, min_rowid, max_rowid);
-            if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
-            n_processed = 0;
-            data = original;
+        // fewer samples than codewords: the unused codes repeat trained ones
+        for (int c=k; c<ksub; ++c) {
+            memcpy(codebook + (size_t)c * dsub, codebook + (size_t)(c % k) * dsub, (size_t)dsub * sizeof(float));
         }
     }
     
-    // handle remaining vectors
-    if (n_processed > 0 && rc == SQLITE_OK) {
-        size_t batch_size = data - original;
-        rc = vector_serialize_quantization(db, table_name, column_name, n_processed, original, batch_size, min_rowid, max_rowid);
-    }
-    
-vector_rebuild_quantization_cleanup:
-    if (rc != SQLITE_OK) printf("Error in vector_rebuild_quantization: %s\n", sqlite3_errmsg(db));
-    if (original) sqlite3_free(original);
-    if (vm) sqlite3_finalize(vm);
-    if (count) *count = tot_processed;
+    sqlite3_free(sub);
     return rc;
 }
 
-static void vector_quantize_preload (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
-    if (sanity_check_args(context, "vector_quantize_preload", argc, argv, 2, types) == false) return;
+static void pq_encode (const pq_codebook *pq, const float *v, uint8_t *code) {
+    int ksub = 1 << pq->nbits;
+    int dsub = pq->dsub;
+    distance_function_t distance_fn = dispatch_distance_table[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_F32];
+    
+    // 4-bit codes: sub-quantizer 2j goes in the low nibble of byte j, 2j+1 in the high nibble
+    if (pq->nbits == 4) memset(code, 0, pq_code_bytes(pq));
+    for (int j=0; j<pq->m; ++j) {
+        int c = ivf_nearest(pq->codebooks + (size_t)j * ksub * dsub, ksub, v + (size_t)j * dsub, dsub, distance_fn);
+        if (pq->nbits == 8) code[j] = (uint8_t)c;
+        else code[j >> 1] |= (uint8_t)(c << ((j & 1) * 4));
+    }
+}
+
+static inline float pq_lut_sum (const float *lut, const uint8_t *code, int nbytes) {
+    float s0 = 0.0f, s1 = 0.0f, s2 = 0.0f, s3 = 0.0f;
+    int j = 0;
+    for (; j <= nbytes - 4; j += 4) {
+        s0 += lut[(size_t)(j + 0) * 256 + code[j + 0]];
+        s1 += lut[(size_t)(j + 1) * 256 + code[j + 1]];
+        s2 += lut[(size_t)(j + 2) * 256 + code[j + 2]];
+        s3 += lut[(size_t)(j + 3) * 256 + code[j + 3]];
+    }
+    for (; j < nbytes; ++j) s0 += lut[(size_t)j * 256 + code[j]];
+    return (s0 + s1) + (s2 + s3);
+}
+
+static float pq_distance_sum (const void *q, const void *code, int nbytes) {
+    // SQUARED_L2, L1 and DOT are plain sums of the per sub-space terms
+    return pq_lut_sum(((const pq_query *)q)->lut, (const uint8_t *)code, nbytes);
+}
+
+static float pq_distance_l2 (const void *q, const void *code, int nbytes) {
+    float d = pq_lut_sum(((const pq_query *)q)->lut, (const uint8_t *)code, nbytes);
+    return (d > 0.0f) ? sqrtf(d) : 0.0f;
+}
+
+static float pq_distance_cosine (const void *q, const void *code, int nbytes) {
+    const pq_query *query = (const pq_query *)q;
+    float dot = pq_lut_sum(query->lut, (const uint8_t *)code, nbytes);
+    float norm = pq_lut_sum(query->norms, (const uint8_t *)code, nbytes);
     
-    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
-    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    // max distance if one vector is zero
+    if (query->qnorm == 0.0f || norm <= 0.0f) return 1.0f;
     
-    vector_context *v_ctx = (vector_context *)sqlite3_user_data(context);
-    table_context *t_ctx = vector_context_lookup(v_ctx, table_name, column_name);
-    if (!t_ctx) {
-        context_result_error(context, SQLITE_ERROR, "Vector context not found for table '%s' and column '%s'. Ensure that vector_init() has been called before using vector_quantize_preload()", table_name, column_name);
+    float cosine_similarity = dot / (query->qnorm * sqrtf(norm));
+    if (cosine_similarity > 1.0f) cosine_similarity = 1.0f;
+    if (cosine_similarity < -1.0f) cosine_similarity = -1.0f;
+    return 1.0f - cosine_similarity;
+}
+
+static void pq_fold_tables (const float *partial, float *lut, int m, int nbits, int nbytes) {
+    // turn m tables of 2^nbits entries into one 256 entry table per code byte
+    if (nbits == 8) {
+        memcpy(lut, partial, (size_t)m * 256 * sizeof(float));
         return;
     }
     
-    // free previous preload (if any)
-    sqlite3_mutex_enter(qmutex);
-    if (t_ctx->preloaded) {
-        sqlite3_free(t_ctx->preloaded);
-        t_ctx->preloaded = NULL;
-        t_ctx->precounter = 0;
+    // 4-bit: each entry is the sum of the two sub-quantizers packed in the byte (one lookup per pair)
+    for (int j=0; j<nbytes; ++j) {
+        const float *lo = partial + (size_t)(2 * j) * 16;
+        const float *hi = (2 * j + 1 < m) ? partial + (size_t)(2 * j + 1) * 16 : NULL;
+        float *table = lut + (size_t)j * 256;
+        for (int b=0; b<256; ++b) {
+            table[b] = lo[b & 15] + ((hi) ? hi[b >> 4] : 0.0f);
+        }
     }
-    sqlite3_mutex_leave(qmutex);
-    
-    char sql[STATIC_SQL_SIZE];
-    generate_memory_quant_table(table_name, column_name, sql);
-    sqlite3 *db = sqlite3_context_db_handle(context);
-    sqlite3_int64 required = sqlite_read_int64(db, sql);
-    if (required == 0) {
-        context_result_error(context, SQLITE_ERROR, "Unable to read data from database. Ensure that vector_quantize() has been called before using vector_quantize_preload()");
-        return;
+}
+
+static void *pq_query_create (const table_context *t, const void *v1, distance_function_t *distance_fn) {
+    // returns a single allocation (pq_query followed by its tables) to be released with sqlite3_free
+    const pq_codebook *pq = &t->pq;
+    int dim = t->options.v_dim;
+    int m = pq->m;
+    int dsub = pq->dsub;
+    int ksub = 1 << pq->nbits;
+    int nbytes = (int)pq_code_bytes(pq);
+    vector_distance vd = t->options.v_distance;
+    bool cosine = (vd == VECTOR_DISTANCE_COSINE);
+    size_t ntables = (cosine) ? 2 : 1;
+    
+    size_t nfloats = ntables * ((size_t)nbytes * 256 + (size_t)m * ksub) + (size_t)dim;
+    pq_query *query = (pq_query *)sqlite3_malloc64(sizeof(pq_query) + nfloats * sizeof(float));
+    if (!query) return NULL;
+    
+    float *lut = (float *)(query + 1);
+    float *norms = (cosine) ? lut + (size_t)nbytes * 256 : NULL;
+    float *partial = lut + ntables * (size_t)nbytes * 256;
+    float *pnorms = (cosine) ? partial + (size_t)m * ksub : NULL;
+    float *v = partial + ntables * (size_t)m * ksub;
+    vector_to_float32(v1, t->options.v_type, v, dim);
+    
+    float qnorm = 0.0f;
+    for (int i=0; i<dim; ++i) qnorm += v[i] * v[i];
+    
+    for (int j=0; j<m; ++j) {
+        const float *x = v + (size_t)j * dsub;
+        for (int c=0; c<ksub; ++c) {
+            const float *y = pq->codebooks + ((size_t)j * ksub + c) * dsub;
+            float d = 0.0f, n2 = 0.0f;
+            for (int i=0; i<dsub; ++i) {
+                switch (vd) {
+                    case VECTOR_DISTANCE_L1: d += fabsf(x[i] - y[i]); break;
+                    case VECTOR_DISTANCE_DOT:
+                    case VECTOR_DISTANCE_COSINE: d += x[i] * y[i]; n2 += y[i] * y[i]; break;
+                    default: d += (x[i] - y[i]) * (x[i] - y[i]); break;
+                }
+            }
+            partial[(size_t)j * ksub + c] = (vd == VECTOR_DISTANCE_DOT) ? -d : d;
+            if (pnorms) pnorms[(size_t)j * ksub + c] = n2;
+        }
     }
     
-    int counter = 0;
-    void *buffer = (void *)sqlite3_malloc64(required);
-    if (!buffer) {
-        context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to allocate %lld bytes for quant buffer", (long long)required);
-        return;
-    }
+    pq_fold_tables(partial, lut, m, pq->nbits, nbytes);
+    if (cosine) pq_fold_tables(pnorms, norms, m, pq->nbits, nbytes);
     
-    sqlite3_stmt *vm = NULL;
-    generate_select_quant_table(table_name, column_name, sql);
-    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
-    if (rc != SQLITE_OK) {
-        context_result_error(context, rc, "Internal statement error: %s", sqlite3_errmsg(db));
-        sqlite3_finalize(vm);
-        sqlite3_free(buffer);
-        return;
+    query->lut = lut;
+    query->norms = norms;
+    query->qnorm = sqrtf(qnorm);
+    *distance_fn = (vd == VECTOR_DISTANCE_L2) ? pq_distance_l2 : (cosine) ? pq_distance_cosine : pq_distance_sum;
+    return (void *)query;
+}
+
+// MARK: - Calibration -
+
+// Per-dimension calibration: every dimension gets its own scale/offset, so a single outlier dimension no longer
+// crushes the resolution of all the others. Codes of different dimensions are then expressed in different units
+// and cannot be compared by the integer kernels: queries stay in float32 and codes are decoded block by block
+// (value = code / scale + offset) right before the float32 distance kernels.
+
+typedef struct {
+    const float         *x;                 // query vector (float32)
+    const float         *inv_scales;        // v_dim reciprocal scales
+    const float         *offsets;           // v_dim offsets
+    float               qnorm;              // COSINE: norm of the query
+    int                 dim;                // dimensions (the n argument of distance_fn counts bytes of 4-bit codes)
+    bool                is_signed;          // S8BIT or S4BIT codes (U8BIT or U4BIT otherwise)
+    bool                is_packed;          // 4-bit codes, two per byte
+    distance_function_t block_fn;           // float32 kernel applied to every decoded block
+} calib_query;
+
+static int calib_float_compare (const void *a, const void *b) {
+    float f1 = *(const float *)a;
+    float f2 = *(const float *)b;
+    return (f1 > f2) - (f1 < f2);
+}
+
+static void calib_percentile (float *values, size_t n, float percentile, float *lo, float *hi) {
+    // sorts values in place and returns the [100-p, p] percentiles
+    qsort(values, n, sizeof(float), calib_float_compare);
+    double last = (double)(n - 1);
+    *lo = values[(size_t)floor(last * (100.0 - percentile) / 100.0)];
+    *hi = values[(size_t)ceil(last * percentile / 100.0)];
+}
+
+static int calib_clip_range (const float *samples, int nsamples, int dim, float percentile, float *bounds, float *min_val, float *max_val) {
+    // per-dimension calibration fills bounds (dim minimums followed by dim maximums), a global one min_val/max_val
+    size_t n = (bounds) ? (size_t)nsamples : (size_t)nsamples * dim;
+    float *values = (float *)sqlite3_malloc64((sqlite3_uint64)n * sizeof(float));
+    if (!values) return SQLITE_NOMEM;
+    
+    if (bounds) {
+        for (int i=0; i<dim; ++i) {
+            for (int j=0; j<nsamples; ++j) values[j] = samples[(size_t)j * dim + i];
+            calib_percentile(values, n, percentile, &bounds[i], &bounds[dim + i]);
+        }
+    } else {
+        memcpy(values, samples, n * sizeof(float));
+        calib_percentile(values, n, percentile, min_val, max_val);
     }
     
-    int seek = 0;
-    while (1) {
-        rc = sqlite3_step(vm);
-        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;} // return error: rebuild must be call (only if first time run)
-        else if (rc != SQLITE_ROW) {break;}
-        
-        int n = sqlite3_column_int(vm, 0);
-        int bytes = sqlite3_column_bytes(vm, 1);
-        uint8_t *data = (uint8_t *)sqlite3_column_blob(vm, 1);
+    sqlite3_free(values);
+    return SQLITE_OK;
+}
+
+static void calib_finalize (float *qcalib, int dim, vector_qtype qtype) {
+    // turns per-dimension (min, max) bounds into (scale, offset) pairs, in place
+    for (int i=0; i<dim; ++i) {
+        float lo = qcalib[i];
+        float hi = qcalib[dim + i];
+        if (lo > hi) lo = hi = 0.0f;        // no values seen
         
-        // no check here because I am sure quantization was performed only on non NULL data
-        memcpy((uint8_t *)buffer + seek, data, bytes);
-        seek += bytes;
-        counter += n;
+        // codes are decoded with their offset, so signed codes can be centered on the dimension range
+        float range = hi - lo;
+        bool is_unsigned = (qtype == VECTOR_QUANT_U8BIT || qtype == VECTOR_QUANT_U4BIT);
+        float levels = (qtype == VECTOR_QUANT_U8BIT) ? 255.0f : (qtype == VECTOR_QUANT_S8BIT) ? 254.0f : (qtype == VECTOR_QUANT_U4BIT) ? 15.0f : 14.0f;
+        qcalib[i] = (range > 0.0f) ? (levels / range) : 1.0f;
+        qcalib[dim + i] = (is_unsigned) ? lo : lo + range * 0.5f;
     }
-    sqlite3_finalize(vm);
-    
-    if (rc != SQLITE_OK) {
-        sqlite3_free(buffer);
-        context_result_error(context, rc, "vector_quantize_preload failed: %s", sqlite3_errmsg(db));
+}
+
+static void quantize_vector_calibrated (const void *v, uint8_t *q, vector_type type, int dim, vector_qtype qtype, const float *qcalib, float *scratch) {
+    vector_to_float32(v, type, scratch, dim);
+    if (quant_is_4bit(qtype)) {
+        // 4-bit quantization: 8-bit codes at a 4-bit scale, packed block by block
+        bool is_signed = (qtype == VECTOR_QUANT_S4BIT);
+        uint8_t codes[QUANT_NIBBLE_BLOCK];
+        for (int i=0; i<dim; i+=QUANT_NIBBLE_BLOCK) {
+            int n = (dim - i < QUANT_NIBBLE_BLOCK) ? dim - i : QUANT_NIBBLE_BLOCK;
+            if (is_signed) dispatch_quantize_table.f32_to_s8_dims(scratch + i, codes, qcalib + dim + i, qcalib + i, n);
+            else dispatch_quantize_table.f32_to_u8_dims(scratch + i, codes, qcalib + dim + i, qcalib + i, n);
+            quantize_nibbles(codes, q + i / 2, n, is_signed);
+        }
         return;
     }
-    
-    sqlite3_mutex_enter(qmutex);
-    t_ctx->preloaded = buffer;
-    t_ctx->precounter = counter;
-    sqlite3_mutex_leave(qmutex);
+    if (qtype == VECTOR_QUANT_U8BIT) dispatch_quantize_table.f32_to_u8_dims(scratch, q, qcalib + dim, qcalib, dim);
+    else dispatch_quantize_table.f32_to_s8_dims(scratch, q, qcalib + dim, qcalib, dim);
 }
 
-static int vector_quantize (sqlite3_context *context, const char *table_name, const char *column_name, const char *arg_options, bool *was_preloaded) {
-    table_context *t_ctx = vector_context_lookup((vector_context *)sqlite3_user_data(context), table_name, column_name);
-    if (!t_ctx) {
-        context_result_error(context, SQLITE_ERROR, "Vector context not found for table '%s' and column '%s'. Ensure that vector_init() has been called before using vector_quantize()", table_name, column_name);
-        return SQLITE_ERROR;
+static inline void calib_decode (const calib_query *q, const uint8_t *code, int start, int n, float *out) {
+    const float *inv = q->inv_scales + start;
+    const float *off = q->offsets + start;
+    if (q->is_packed) {
+        for (int i=0; i<n; ++i) out[i] = (float)nibble_load(code, start + i, q->is_signed) * inv[i] + off[i];
+    } else if (q->is_signed) {
+        const int8_t *c = (const int8_t *)code + start;
+        for (int i=0; i<n; ++i) out[i] = (float)c[i] * inv[i] + off[i];
+    } else {
+        const uint8_t *c = code + start;
+        for (int i=0; i<n; ++i) out[i] = (float)c[i] * inv[i] + off[i];
     }
-    
-    uint32_t counter = 0;
-    int rc = SQLITE_ERROR;
-    char sql[STATIC_SQL_SIZE];
-    sqlite3 *db = sqlite3_context_db_handle(context);
-    
-    bool savepoint_open = false;
-    rc = sqlite3_exec(db, "SAVEPOINT quantize;", NULL, NULL, NULL);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    savepoint_open = true;
-    
-    generate_drop_quant_table(table_name, column_name, sql);
-    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    
-    generate_create_quant_table(table_name, column_name, sql);
-    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    
-    vector_options options = t_ctx->options; // t_ctx guarantees to exist
-    bool res = parse_keyvalue_string(context, arg_options, vector_keyvalue_callback, &options);
-    if (res == false) {rc = SQLITE_ERROR; goto quantize_cleanup;}
-    
-    sqlite3_mutex_enter(qmutex);
-    rc = vector_rebuild_quantization(context, table_name, column_name, t_ctx, options.q_type, options.max_memory, &counter);
-    sqlite3_mutex_leave(qmutex);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    
-    // serialize quantization options
-    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_QUANTTYPE, t_ctx->options.q_type, 0);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    rc = sqlite_serialize(context, table_name, column_name, SQLITE_FLOAT, OPTION_KEY_QUANTSCALE, 0, t_ctx->scale);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    rc = sqlite_serialize(context, table_name, column_name, SQLITE_FLOAT, OPTION_KEY_QUANTOFFSET, 0, t_ctx->offset);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    
-    rc = sqlite3_exec(db, "RELEASE quantize;", NULL, NULL, NULL);
-    if (rc != SQLITE_OK) goto quantize_cleanup;
-    savepoint_open = false;
-    
-    // success: returns the total number of quantized rows
-    sqlite3_result_int64(context, (sqlite3_int64)counter);
-    if (was_preloaded) *was_preloaded = (t_ctx->preloaded != NULL);
-    return SQLITE_OK;
-    
-quantize_cleanup: {
-        const char *errmsg = sqlite3_errmsg(db);
-        if (savepoint_open) {
-            sqlite3_exec(db, "ROLLBACK TO quantize;", NULL, NULL, NULL);
-            sqlite3_exec(db, "RELEASE quantize;", NULL, NULL, NULL);
-        }
-        
-        sqlite3_result_error(context, errmsg, -1);
-        sqlite3_result_error_code(context, rc);
-        return rc;
+}
+
+static float calib_distance_sum (const void *q, const void *code, int size) {
+    // SQUARED_L2, L1 and DOT are plain sums of the per block terms
+    const calib_query *query = (const calib_query *)q;
+    int dim = query->dim;
+    float block[CALIB_BLOCK];
+    float sum = 0.0f;
+    for (int i=0; i<dim; i+=CALIB_BLOCK) {
+        int n = (dim - i < CALIB_BLOCK) ? dim - i : CALIB_BLOCK;
+        calib_decode(query, (const uint8_t *)code, i, n, block);
+        sum += query->block_fn((const void *)(query->x + i), (const void *)block, n);
     }
+    return sum;
 }
 
-static void vector_quantize3 (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    int types[] = {SQLITE_TEXT, SQLITE_TEXT, SQLITE_TEXT};
-    if (sanity_check_args(context, "vector_quantize", argc, argv, 3, types) == false) return;
-    
-    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
-    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
-    const char *options = (const char *)sqlite3_value_text(argv[2]);
-    
-    bool was_preloaded = false;
-    int rc = vector_quantize(context, table_name, column_name, options, &was_preloaded);
-    if ((rc == SQLITE_OK) && (was_preloaded)) vector_quantize_preload(context, argc, argv);
+static float calib_distance_l2 (const void *q, const void *code, int size) {
+    float d = calib_distance_sum(q, code, size);
+    return (d > 0.0f) ? sqrtf(d) : 0.0f;
 }
 
-static void vector_quantize2 (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
-    if (sanity_check_args(context, "vector_quantize", argc, argv, 2, types) == false) return;
+static float calib_distance_cosine (const void *q, const void *code, int size) {
+    const calib_query *query = (const calib_query *)q;
+    int dim = query->dim;
+    float block[CALIB_BLOCK];
+    float dot = 0.0f, norm = 0.0f;
+    for (int i=0; i<dim; i+=CALIB_BLOCK) {
+        int n = (dim - i < CALIB_BLOCK) ? dim - i : CALIB_BLOCK;
+        calib_decode(query, (const uint8_t *)code, i, n, block);
+        // the DOT kernel returns the negated dot product
+        dot -= query->block_fn((const void *)(query->x + i), (const void *)block, n);
+        norm -= query->block_fn((const void *)block, (const void *)block, n);
+    }
     
-    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
-    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    // max distance if one vector is zero
+    if (query->qnorm == 0.0f || norm <= 0.0f) return 1.0f;
     
-    bool was_preloaded = false;
-    int rc = vector_quantize(context, table_name, column_name, NULL, &was_preloaded);
-    if ((rc == SQLITE_OK) && (was_preloaded)) vector_quantize_preload(context, argc, argv);
+    float cosine_similarity = dot / (query->qnorm * sqrtf(norm));
+    if (cosine_similarity > 1.0f) cosine_similarity = 1.0f;
+    if (cosine_similarity < -1.0f) cosine_similarity = -1.0f;
+    return 1.0f - cosine_similarity;
 }
 
-static void vector_quantize_memory (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
-    if (sanity_check_args(context, "vector_quantize_memory", argc, argv, 2, types) == false) return;
-    
-    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
-    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
-    
-    char sql[STATIC_SQL_SIZE];
-    generate_memory_quant_table(table_name, column_name, sql);
-    
-    sqlite3 *db = sqlite3_context_db_handle(context);
-    sqlite3_int64 memory = sqlite_read_int64(db, sql);
-    sqlite3_result_int64(context, memory);
+static void *calib_query_create (const table_context *t, const void *v1, distance_function_t *distance_fn) {
+    // returns a single allocation (calib_query followed by its arrays) to be released with sqlite3_free
+    int dim = t->options.v_dim;
+    vector_distance vd = t->options.v_distance;
+    calib_query *query = (calib_query *)sqlite3_malloc64(sizeof(calib_query) + (size_t)dim * 3 * sizeof(float));
+    if (!query) return NULL;
+    
+    float *x = (float *)(query + 1);
+    float *inv_scales = x + dim;
+    float *offsets = inv_scales + dim;
+    vector_to_float32(v1, t->options.v_type, x, dim);
+    for (int i=0; i<dim; ++i) inv_scales[i] = 1.0f / t->qcalib[i];
+    memcpy(offsets, t->qcalib + dim, (size_t)dim * sizeof(float));
+    
+    float qnorm = 0.0f;
+    for (int i=0; i<dim; ++i) qnorm += x[i] * x[i];
+    
+    vector_distance block_distance = (vd == VECTOR_DISTANCE_L2) ? VECTOR_DISTANCE_SQUARED_L2 : (vd == VECTOR_DISTANCE_COSINE) ? VECTOR_DISTANCE_DOT : vd;
+    query->x = x;
+    query->inv_scales = inv_scales;
+    query->offsets = offsets;
+    query->qnorm = sqrtf(qnorm);
+    query->dim = dim;
+    query->is_signed = (t->options.q_type == VECTOR_QUANT_S8BIT || t->options.q_type == VECTOR_QUANT_S4BIT);
+    query->is_packed = quant_is_4bit(t->options.q_type);
+    query->block_fn = dispatch_distance_table[block_distance][VECTOR_TYPE_F32];
+    *distance_fn = (vd == VECTOR_DISTANCE_L2) ? calib_distance_l2 : (vd == VECTOR_DISTANCE_COSINE) ? calib_distance_cosine : calib_distance_sum;
+    return (void *)query;
 }
 
-static void vector_quantize_cleanup (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
-    if (sanity_check_args(context, "vector_quantize_cleanup", argc, argv, 2, types) == false) return;
+// MARK: - SQL -
 
-    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
-    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+static char *generate_create_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "CREATE TABLE IF NOT EXISTS vector0_%q_%q (rowid1 INTEGER, rowid2 INTEGER, counter INTEGER, data BLOB, list INTEGER);"
+                            "CREATE INDEX IF NOT EXISTS vector0_%q_%q_list ON vector0_%q_%q (list);", table_name, column_name, table_name, column_name, table_name, column_name);
+}
 
-    vector_context *v_ctx = (vector_context *)sqlite3_user_data(context);
-    table_context *t_ctx = vector_context_lookup(v_ctx, table_name, column_name);
-    if (!t_ctx) return; // if no table context exists then do nothing
+static char *generate_drop_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DROP TABLE IF EXISTS vector0_%q_%q;", table_name, column_name);
+}
 
-    // release any memory used in quantization
-    sqlite3_mutex_enter(qmutex);
-    if (t_ctx->preloaded) {
-        sqlite3_free(t_ctx->preloaded);
-        t_ctx->preloaded = NULL;
-        t_ctx->precounter = 0;
-    }
-    sqlite3_mutex_leave(qmutex);
+static char *generate_select_from_table (const char *table_name, const char *column_name, const char *pk_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT %q, %q FROM %q ORDER BY %q;", pk_name, column_name, table_name, pk_name);
+}
 
-    // drop quant table (if any)
-    char sql[STATIC_SQL_SIZE];
-    sqlite3 *db = sqlite3_context_db_handle(context);
-    generate_drop_quant_table(table_name, column_name, sql);
-    sqlite3_exec(db, sql, NULL, NULL, NULL);
+static char *generate_select_sample_from_table (const char *table_name, const char *column_name, const char *pk_name, int64_t nsample, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT %q, %q FROM %q WHERE %q IN (SELECT %q FROM %q WHERE %q IS NOT NULL ORDER BY random() LIMIT %lld) ORDER BY %q;", pk_name, column_name, table_name, pk_name, pk_name, table_name, column_name, (long long)nsample, pk_name);
 }
 
-// MARK: -
+static char *generate_select_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q;", table_name, column_name);
+}
 
-static void *vector_from_json (sqlite3_context *context, sqlite3_vtab *vtab, vector_type type, const char *json, int *size, int dimension) {
-    char *blob = NULL;
-    
-    // skip leading whitespace
-    SKIP_SPACES(json);
-    
-    // sanity check the JSON start array character
-    if (*json != '[') {
-        return sqlite_common_set_error(context, vtab, SQLITE_ERROR, "Malformed JSON: expected '[' at the beginning of the array");
-    }
-    json++;
+static char *generate_select_quant_list (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE list = ?;", table_name, column_name);
+}
 
-    
-    // count number of commas to estimate (over-estimate) the number of entries in the json
-    int estimated_count = 0;
-    for (const char *p = json; *p; ++p) {
-        if (*p == ',') estimated_count++;
-    }
-    
-    // allocate blob
-    // For BIT type, each JSON element is a single bit, pack 8 per byte
-    size_t item_size = vector_type_to_size(type);
-    size_t alloc = (type == VECTOR_TYPE_BIT) ? ((estimated_count + 1) + 7) / 8 : (estimated_count + 1) * item_size;
-    blob = sqlite3_malloc((int)alloc);
-    if (!blob) {
-        return sqlite_common_set_error(context, vtab, SQLITE_NOMEM, "Out of memory: unable to allocate %lld bytes for BLOB buffer", (long long)alloc);
-    }
-    if (type == VECTOR_TYPE_BIT) {
-        memset(blob, 0, alloc);  // Initialize to zero for bit packing
-    }
+static char *generate_preload_quant_lists (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data, list FROM vector0_%q_%q ORDER BY list, rowid;", table_name, column_name);
+}
 
-    // typed pointers
-    float      *float_blob    = (float *)blob;
-    uint8_t    *uint8_blob    = (uint8_t *)blob;
-    int8_t     *int8_blob     = (int8_t *)blob;
-    uint16_t   *uint16_blob   = (uint16_t *)blob;
-    uint16_t   *bfloat16_blob = (uint16_t *)blob;
-    
-    int count = 0;
-    const char *p = json;
-    while (*p) {
-        // skip whitespace
-        SKIP_SPACES(p);
-        
-        // check for end-of-array character
-        if (*p == ']') break;
-        
-        // parse number
-        char *endptr;
-        double value = strtod(p, &endptr);
-        
-        // sanity check
-        if (p == endptr) {
-            // parsing failed
-            sqlite3_free(blob);
+static char *generate_memory_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT SUM(LENGTH(data)) FROM vector0_%q_%q;", table_name, column_name);
+}
+
+static char *generate_count_quant_base (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT SUM(counter) FROM vector0_%q_%q WHERE list IS NULL OR list > %d;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_insert_quant_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "INSERT INTO vector0_%q_%q (rowid1, rowid2, counter, data, list) VALUES (?, ?, ?, ?, ?);", table_name, column_name);
+}
+
+static char *generate_select_quant_chunks (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data, list FROM vector0_%q_%q;", table_name, column_name);
+}
+
+static char *generate_select_quant_base (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE list IS NULL OR list > %d;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_select_quant_deltas (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE list <= %d;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+// chunk bounds (rowid1, rowid2) restricted to the range bound to ?2 and ?3, the chunks of a filtered scan that
+// cannot hold a matching rowid are skipped without reading their data
+static char *generate_select_quant_table_range (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE rowid2 >= ?2 AND rowid1 <= ?3;", table_name, column_name);
+}
+
+static char *generate_select_quant_list_range (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE list = ?1 AND rowid2 >= ?2 AND rowid1 <= ?3;", table_name, column_name);
+}
+
+static char *generate_select_quant_chunks_range (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data, list FROM vector0_%q_%q WHERE rowid2 >= ?2 AND rowid1 <= ?3;", table_name, column_name);
+}
+
+static char *generate_select_quant_base_range (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE (list IS NULL OR list > %d) AND rowid2 >= ?2 AND rowid1 <= ?3;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_select_quant_deltas_range (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE list <= %d AND rowid2 >= ?2 AND rowid1 <= ?3;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_preload_quant_base_lists (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data, list FROM vector0_%q_%q WHERE list > %d ORDER BY list, rowid;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_delete_quant_delta (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DELETE FROM vector0_%q_%q WHERE list <= %d AND rowid1 = ?;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_base_covers_rowid (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT 1 FROM vector0_%q_%q WHERE (list IS NULL OR list > %d) AND rowid1 <= ?1 AND rowid2 >= ?1 LIMIT 1;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_create_tombstone_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "CREATE TABLE IF NOT EXISTS vector2_%q_%q (id INTEGER PRIMARY KEY);", table_name, column_name);
+}
+
+static char *generate_drop_tombstone_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DROP TABLE IF EXISTS vector2_%q_%q;", table_name, column_name);
+}
+
+static char *generate_insert_tombstone (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "INSERT OR IGNORE INTO vector2_%q_%q (id) VALUES (?);", table_name, column_name);
+}
+
+static char *generate_select_tombstones (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT id FROM vector2_%q_%q ORDER BY id;", table_name, column_name);
+}
+
+static char *generate_clear_tombstones (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DELETE FROM vector2_%q_%q;", table_name, column_name);
+}
+
+static char *generate_select_tombstoned_chunks (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT rowid FROM vector0_%q_%q AS q WHERE (list IS NULL OR list > %d) AND EXISTS (SELECT 1 FROM vector2_%q_%q WHERE id BETWEEN q.rowid1 AND q.rowid2);", table_name, column_name, VECTOR_DELTA_LIST, table_name, column_name);
+}
+
+static char *generate_select_quant_chunk (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data FROM vector0_%q_%q WHERE rowid = ?;", table_name, column_name);
+}
+
+static char *generate_update_quant_chunk (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "UPDATE vector0_%q_%q SET rowid1 = ?2, rowid2 = ?3, counter = ?4, data = ?5 WHERE rowid = ?1;", table_name, column_name);
+}
+
+static char *generate_delete_quant_chunk (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DELETE FROM vector0_%q_%q WHERE rowid = ?;", table_name, column_name);
+}
+
+static char *generate_select_all_deltas (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT counter, data, list FROM vector0_%q_%q WHERE list <= %d ORDER BY list, rowid1;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_delete_all_deltas (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DELETE FROM vector0_%q_%q WHERE list <= %d;", table_name, column_name, VECTOR_DELTA_LIST);
+}
+
+static char *generate_create_triggers (const char *table_name, const char *column_name, const char *pk_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql,
+                            "CREATE TRIGGER IF NOT EXISTS vector_%q_%q_insert AFTER INSERT ON %q BEGIN SELECT vector_quantize_delta('%q', '%q', NULL, NEW.%q, NEW.%q); END;"
+                            "CREATE TRIGGER IF NOT EXISTS vector_%q_%q_update AFTER UPDATE ON %q WHEN OLD.%q IS NOT NEW.%q OR OLD.%q IS NOT NEW.%q BEGIN SELECT vector_quantize_delta('%q', '%q', OLD.%q, NEW.%q, NEW.%q); END;"
+                            "CREATE TRIGGER IF NOT EXISTS vector_%q_%q_delete AFTER DELETE ON %q BEGIN SELECT vector_quantize_delta('%q', '%q', OLD.%q, NULL, NULL); END;",
+                            table_name, column_name, table_name, table_name, column_name, pk_name, column_name,
+                            table_name, column_name, table_name, column_name, column_name, pk_name, pk_name, table_name, column_name, pk_name, pk_name, column_name,
+                            table_name, column_name, table_name, table_name, column_name, pk_name);
+}
+
+static char *generate_drop_triggers (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DROP TRIGGER IF EXISTS vector_%q_%q_insert; DROP TRIGGER IF EXISTS vector_%q_%q_update; DROP TRIGGER IF EXISTS vector_%q_%q_delete;",
+                            table_name, column_name, table_name, column_name, table_name, column_name);
+}
+
+static char *generate_select_generation (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT value FROM _sqliteai_vector WHERE tblname = '%q' AND colname = '%q' AND key = '%s';", table_name, column_name, OPTION_KEY_GENERATION);
+}
+
+static char *generate_create_hnsw_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "CREATE TABLE IF NOT EXISTS vector1_%q_%q (id INTEGER PRIMARY KEY, level INTEGER, neighbors BLOB);", table_name, column_name);
+}
+
+static char *generate_drop_hnsw_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "DROP TABLE IF EXISTS vector1_%q_%q;", table_name, column_name);
+}
+
+static char *generate_insert_hnsw_table (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "INSERT INTO vector1_%q_%q (id, level, neighbors) VALUES (?, ?, ?);", table_name, column_name);
+}
+
+static char *generate_select_hnsw_links (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "SELECT neighbors FROM vector1_%q_%q WHERE id = ?;", table_name, column_name);
+}
+
+static char *generate_hnsw_table_name (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "vector1_%q_%q", table_name, column_name);
+}
+
+static char *generate_quant_table_name (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "vector0_%q_%q", table_name, column_name);
+}
+
+static char *generate_tombstone_table_name (const char *table_name, const char *column_name, char sql[STATIC_SQL_SIZE]) {
+    return sqlite3_snprintf(STATIC_SQL_SIZE, sql, "vector2_%q_%q", table_name, column_name);
+}
+
+// MARK: - Preload Registry -
+
+// Preloaded quantizations are shared by all the connections of the process that opened the same database file.
+// Entries are keyed by (database, table, column) and tagged with the quantization generation they were read from
+// (a random token, so an entry published inside a transaction that rolled back is never matched again).
+// An entry lives as long as it is referenced: table contexts attached to it hold one reference each (one per
+// connection) and every cursor pins the entry it scans, so a rebuild can publish a new generation that readers
+// switch to on their next query while in-flight scans keep reading the previous one.
+
+static vector_preload *preload_registry;    // protected by pmutex
+
+static char *vector_preload_key (sqlite3 *db, const char *table_name, const char *column_name) {
+    // table and column names are case insensitive
+    char *names = sqlite3_mprintf("%s\n%s", table_name, column_name);
+    if (!names) return NULL;
+    for (char *p = names; *p; ++p) *p = (char)tolower((unsigned char)*p);
+    
+    // in-memory and temporary databases are private to their connection
+    const char *filename = sqlite3_db_filename(db, "main");
+    char *key = (filename && filename[0]) ? sqlite3_mprintf("%s\n%s", filename, names) : sqlite3_mprintf("%p\n%s", (void *)db, names);
+    sqlite3_free(names);
+    return key;
+}
+
+static void vector_preload_free (vector_preload *p) {
+    if (p->sidecar) {
+        vector_sidecar_close(p->sidecar);
+        sqlite3_free(p->sidecar);
+    }
+    if (p->buffer) sqlite3_free(p->buffer);
+    if (p->norms) sqlite3_free(p->norms);
+    if (p->lists) sqlite3_free(p->lists);
+    if (p->key) sqlite3_free(p->key);
+    sqlite3_free(p);
+}
+
+static float *vector_preload_norms (const table_context *t, const uint8_t *codes, int counter, size_t code_size) {
+    // COSINE over 8-bit codes: norms of the preloaded codes, so scans compute only the dot product per record
+    // (NULL when they do not apply; a failed allocation only disables the cache)
+    vector_qtype qtype = t->options.q_type;
+    if (t->options.v_distance != VECTOR_DISTANCE_COSINE || t->qcalib || counter <= 0) return NULL;
+    if (qtype != VECTOR_QUANT_U8BIT && qtype != VECTOR_QUANT_S8BIT) return NULL;
+    
+    // cascade: norms of the 8-bit level only
+    size_t level = quant_level_bytes(t->binary_level, t->options.v_dim);
+    float *norms = (float *)sqlite3_malloc64((sqlite3_uint64)counter * sizeof(float));
+    if (!norms) return NULL;
+    for (int i=0; i<counter; ++i) norms[i] = vector_code_norm(codes + (size_t)i * code_size + level, (int)(code_size - level), (qtype == VECTOR_QUANT_S8BIT));
+    return norms;
+}
+
+static vector_preload *vector_preload_find (const char *key, int64_t generation, size_t stride) {
+    // pmutex must be held
+    for (vector_preload *p = preload_registry; p; p = p->next) {
+        if (p->published && p->generation == generation && p->stride == stride && strcmp(p->key, key) == 0) return p;
+    }
+    return NULL;
+}
+
+static vector_preload *vector_preload_lookup (const char *key, int64_t generation, size_t stride) {
+    // returns a new reference to the entry published for key and generation (NULL if none)
+    if (!key) return NULL;
+    
+    sqlite3_mutex_enter(pmutex);
+    vector_preload *p = vector_preload_find(key, generation, stride);
+    if (p) p->refcount++;
+    sqlite3_mutex_leave(pmutex);
+    return p;
+}
+
+static bool vector_preload_exists (const char *key) {
+    // true if some connection preloaded any generation of key (and the quantization was not dropped since)
+    if (!key) return false;
+    
+    bool exists = false;
+    sqlite3_mutex_enter(pmutex);
+    for (vector_preload *p = preload_registry; p && !exists; p = p->next) exists = (p->published && strcmp(p->key, key) == 0);
+    sqlite3_mutex_leave(pmutex);
+    return exists;
+}
+
+static void vector_preload_retain (vector_preload *p) {
+    sqlite3_mutex_enter(pmutex);
+    p->refcount++;
+    sqlite3_mutex_leave(pmutex);
+}
+
+static void vector_preload_release (vector_preload *p) {
+    if (!p) return;
+    
+    sqlite3_mutex_enter(pmutex);
+    bool last = (--p->refcount == 0);
+    if (last) {
+        vector_preload **link = &preload_registry;
+        while (*link && *link != p) link = &(*link)->next;
+        if (*link) *link = p->next;
+    }
+    sqlite3_mutex_leave(pmutex);
+    
+    // the records are freed (or unmapped) outside the lock
+    if (last) vector_preload_free(p);
+}
+
+static vector_preload *vector_preload_publish (vector_preload *p) {
+    // links a new entry with one reference (returned to the caller): entries are searched from the most recently
+    // published one, so it supersedes any other entry of the same key and generation
+    sqlite3_mutex_enter(pmutex);
+    p->refcount = 1;
+    p->published = true;
+    p->next = preload_registry;
+    preload_registry = p;
+    sqlite3_mutex_leave(pmutex);
+    return p;
+}
+
+static void vector_preload_unpublish (const char *key) {
+    // entries of key are no longer found by lookups (connections still attached release them on their next query)
+    if (!key) return;
+    
+    sqlite3_mutex_enter(pmutex);
+    for (vector_preload *p = preload_registry; p; p = p->next) {
+        if (strcmp(p->key, key) == 0) p->published = false;
+    }
+    sqlite3_mutex_leave(pmutex);
+}
+
+static void vector_preload_attach (table_context *t_ctx, vector_preload *p) {
+    // t_ctx takes over the reference to p and drops the one to its previous entry
+    vector_preload *old = t_ctx->preload;
+    t_ctx->preload = p;
+    vector_preload_release(old);
+}
+
+static vector_preload *vector_preload_acquire (table_context *t_ctx, int64_t generation) {
+    // returns a reference to the preload of the current generation (NULL if no connection preloaded it)
+    // a connection attached to an older generation switches to the newest one published by any connection
+    size_t stride = sizeof(int64_t) + quant_code_bytes(t_ctx);
+    vector_preload *p = t_ctx->preload;
+    if (!p || p->generation != generation || p->stride != stride) {
+        p = vector_preload_lookup(t_ctx->preload_key, generation, stride);
+        vector_preload_attach(t_ctx, p);
+    }
+    if (p) vector_preload_retain(p);
+    return p;
+}
+
+// MARK: - Vector Context and Options -
+
+void *vector_context_create (void) {
+    vector_context *ctx = (vector_context *)sqlite3_malloc(sizeof(vector_context));
+    if (!ctx) return NULL;
+    
+    memset(ctx, 0, sizeof(vector_context));
+    vector_pool_retain();
+    return (void *)ctx;
+}
+
+static void hnsw_graph_free (hnsw_graph *g);
+
+void vector_context_free (void *p) {
+    if (p) {
+        vector_context *ctx = (vector_context *)p;
+        for (int i=0; i<ctx->table_count; ++i) {
+            if (ctx->tables[i].t_name) sqlite3_free(ctx->tables[i].t_name);
+            if (ctx->tables[i].c_name) sqlite3_free(ctx->tables[i].c_name);
+            if (ctx->tables[i].pk_name) sqlite3_free(ctx->tables[i].pk_name);
+            vector_preload_attach(&ctx->tables[i], NULL);
+            if (ctx->tables[i].preload_key) sqlite3_free(ctx->tables[i].preload_key);
+            if (ctx->tables[i].ivf_centroids) sqlite3_free(ctx->tables[i].ivf_centroids);
+            if (ctx->tables[i].pq.codebooks) sqlite3_free(ctx->tables[i].pq.codebooks);
+            if (ctx->tables[i].qcalib) sqlite3_free(ctx->tables[i].qcalib);
+            hnsw_graph_free(ctx->tables[i].hnsw);
+        }
+        sqlite3_free(p);
+        vector_pool_release();
+    }
+}
+
+table_context *vector_context_lookup (vector_context *ctx, const char *table_name, const char *column_name) {
+    if ((table_name == NULL) || (column_name == NULL)) return NULL;
+    
+    for (int i=0; i<ctx->table_count; ++i) {
+        // tname and cname can be NULL after adding vector_cleanup function
+        const char *tname = ctx->tables[i].t_name;
+        const char *cname = ctx->tables[i].c_name;
+        if (tname && cname && (strcasecmp(tname, table_name) == 0) && (strcasecmp(cname, column_name) == 0)) return &ctx->tables[i];
+    }
+    return NULL;
+}
+
+void vector_context_add (sqlite3_context *context, vector_context *ctx, const char *table_name, const char *column_name, vector_options *options) {
+    // check if there is a free slot
+    if (ctx->table_count >= MAX_TABLES) {
+        context_result_error(context, SQLITE_ERROR, "Cannot add table: maximum number of allowed tables reached (%d)", MAX_TABLES);
+        return;
+    }
+    
+    char *t_name = sqlite_strdup(table_name);
+    char *c_name = sqlite_strdup(column_name);
+    if (!t_name || !c_name) {
+        context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to duplicate table or column name");
+        if (t_name) sqlite3_free(t_name);
+        if (c_name) sqlite3_free(c_name);
+        return;
+    }
+    
+    char *prikey = NULL;
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    bool is_without_rowid = sqlite_table_is_without_rowid(db, table_name);
+    prikey = (is_without_rowid == false) ? sqlite_strdup("rowid") : sqlite_get_int_prikey_column(db, table_name);
+
+    // sanity check primary key
+    if (!prikey) {
+        (is_without_rowid) ? context_result_error(context, SQLITE_ERROR, "WITHOUT ROWID table '%s' must have exactly one PRIMARY KEY column of type INTEGER", table_name) : context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to duplicate rowid column name");
+        sqlite3_free(t_name);
+        sqlite3_free(c_name);
+        return;
+    }
+    
+    int index = ctx->table_count;
+    ctx->tables[index].t_name = t_name;
+    ctx->tables[index].c_name = c_name;
+    ctx->tables[index].pk_name = prikey;
+    ctx->tables[index].preload_key = vector_preload_key(db, table_name, column_name);
+    ctx->tables[index].options = *options;
+    ctx->table_count++;
+    
+    sqlite_unserialize(db, &ctx->tables[index]);
+}
+
+void vector_options_init (vector_options *options) {
+    memset(options, 0, sizeof(vector_options));
+    options->v_type = VECTOR_TYPE_F32;
+    options->v_distance = VECTOR_DISTANCE_L2;
+    options->max_memory = DEFAULT_MAX_MEMORY;
+    options->q_type = VECTOR_QUANT_AUTO;
+}
+
+vector_options vector_options_create (void) {
+    vector_options options;
+    vector_options_init(&options);
+    return options;
+}
+
+
+// MARK: - Public -
+
+static uint8_t *vector_chunk_encode (int format, uint8_t *records, uint32_t nrows, size_t code_size, size_t *bytes) {
+    // returns the chunk blob of nrows interleaved records: records itself for the interleaved format,
+    // a new buffer (to be freed by the caller) for the split one, NULL if out of memory
+    *bytes = vector_chunk_bytes(format, nrows, code_size);
+    if (format != VECTOR_CHUNK_FORMAT_SPLIT) return records;
+    
+    uint8_t *chunk = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)*bytes + 1);
+    if (!chunk) return NULL;
+    
+    vector_records r = vector_chunk_records(VECTOR_CHUNK_FORMAT_INTERLEAVED, records, (int)nrows, code_size);
+    vector_records_split(&r, chunk);
+    return chunk;
+}
+
+static int vector_serialize_quantization (sqlite3 *db, const char *table_name, const char *column_name, int format, uint32_t nrows, uint8_t *data, ptrdiff_t data_size, int64_t min_rowid, int64_t max_rowid, int list) {
+    // data holds nrows interleaved (rowid, code) records, stored in the chunk format of the table
+    size_t chunk_size = 0;
+    size_t code_size = (nrows > 0) ? (size_t)data_size / nrows - sizeof(int64_t) : 0;
+    uint8_t *chunk = vector_chunk_encode(format, data, nrows, code_size, &chunk_size);
+    if (!chunk) return SQLITE_NOMEM;
+    
+    char sql[STATIC_SQL_SIZE];
+    generate_insert_quant_table(table_name, column_name, sql);
+    
+    sqlite3_stmt *vm = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    
+    rc = sqlite3_bind_int64(vm, 1, min_rowid);
+    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    
+    rc = sqlite3_bind_int64(vm, 2, max_rowid);
+    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    
+    rc = sqlite3_bind_int(vm, 3, nrows);
+    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    
+    rc = sqlite3_bind_blob64(vm, 4, (const void *)chunk, (sqlite3_uint64)chunk_size, SQLITE_STATIC);
+    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    
+    // list is NULL when no IVF index has been built (delta chunks always carry a list <= VECTOR_DELTA_LIST)
+    rc = (list != -1) ? sqlite3_bind_int(vm, 5, list) : sqlite3_bind_null(vm, 5);
+    if (rc != SQLITE_OK) goto vector_serialize_quantization_cleanup;
+    
+    rc = sqlite3_step(vm);
+    if (rc == SQLITE_DONE) rc = SQLITE_OK;
+    
+vector_serialize_quantization_cleanup:
+    if (rc != SQLITE_OK) printf("Error in vector_serialize_quantization: %s\n", sqlite3_errmsg(db));
+    if (vm) sqlite3_finalize(vm);
+    if (chunk != data) sqlite3_free(chunk);
+    return rc;
+}
+
+// vector_rebuild_quantization reads the base table in rounds of up to REBUILD_BATCH_ROWS rows: blobs are copied out of
+// the statement on the calling thread (a connection cannot be stepped from the workers), calibrated, assigned to a
+// posting list or quantized by up to `threads` pool workers, and the finished records are serialized by the calling thread
+
+typedef struct {
+    int64_t         *rowids;
+    uint8_t         *blobs;                 // count blobs of blob_bytes bytes each
+    int             count;
+    int             capacity;
+    size_t          blob_bytes;
+} rebuild_batch;
+
+typedef struct {
+    rebuild_batch   batch;
+    vector_type     type;
+    int             dim;
+    int             nshards;                // allocated shards (threads)
+    int             nactive;                // shards of the current round
+    float           *scratch;               // one float32 vector per shard
+    
+    // calibration: running extremes of every shard (bounds is laid out like qcalib, one copy per shard)
+    float           *shard_min;
+    float           *shard_max;
+    float           *bounds;
+    
+    // quantization: record i of the round is written at out + i * q_size
+    vector_qtype    qtype;
+    float           offset;
+    float           scale;
+    bool            binary_mean;
+    const pq_codebook *pq;
+    const float     *qcalib;
+    size_t          level_bytes;            // cascade: bytes of the 1BIT code that precedes the 8-bit code (0 otherwise)
+    uint8_t         *out;
+    size_t          q_size;
+    
+    // IVF assignment: entry i of the round
+    const float     *centroids;
+    int             nlist;
+    distance_function_t distance_fn;
+    ivf_entry       *entries;
+} rebuild_pipeline;
+
+static int rebuild_pipeline_init (rebuild_pipeline *p, vector_type type, int dim, int threads, bool use_bounds) {
+    memset(p, 0, sizeof(rebuild_pipeline));
+    p->type = type;
+    p->dim = dim;
+    p->nshards = (threads > 1 && vector_pool_is_parallel()) ? threads : 1;
+    
+    p->batch.capacity = REBUILD_BATCH_ROWS;
+    p->batch.blob_bytes = vector_bytes_for_dim(type, dim);
+    p->batch.rowids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)REBUILD_BATCH_ROWS * sizeof(int64_t));
+    p->batch.blobs = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)REBUILD_BATCH_ROWS * p->batch.blob_bytes);
+    p->scratch = (float *)sqlite3_malloc64((sqlite3_uint64)p->nshards * dim * sizeof(float));
+    p->shard_min = (float *)sqlite3_malloc64((sqlite3_uint64)p->nshards * sizeof(float));
+    p->shard_max = (float *)sqlite3_malloc64((sqlite3_uint64)p->nshards * sizeof(float));
+    if (use_bounds) p->bounds = (float *)sqlite3_malloc64((sqlite3_uint64)p->nshards * 2 * dim * sizeof(float));
+    if (!p->batch.rowids || !p->batch.blobs || !p->scratch || !p->shard_min || !p->shard_max || (use_bounds && !p->bounds)) return SQLITE_NOMEM;
+    
+    for (int s=0; s<p->nshards; ++s) {
+        p->shard_min[s] = FLT_MAX;
+        p->shard_max[s] = -FLT_MAX;
+        if (!p->bounds) continue;
+        float *bounds = p->bounds + (size_t)s * 2 * dim;
+        for (int i=0; i<dim; ++i) {
+            bounds[i] = FLT_MAX;
+            bounds[dim + i] = -FLT_MAX;
+        }
+    }
+    return SQLITE_OK;
+}
+
+static void rebuild_pipeline_free (rebuild_pipeline *p) {
+    if (p->batch.rowids) sqlite3_free(p->batch.rowids);
+    if (p->batch.blobs) sqlite3_free(p->batch.blobs);
+    if (p->scratch) sqlite3_free(p->scratch);
+    if (p->shard_min) sqlite3_free(p->shard_min);
+    if (p->shard_max) sqlite3_free(p->shard_max);
+    if (p->bounds) sqlite3_free(p->bounds);
+    memset(p, 0, sizeof(rebuild_pipeline));
+}
+
+static int rebuild_batch_fill (sqlite3_context *context, sqlite3_stmt *vm, rebuild_batch *b, int max_rows, bool *done) {
+    // copies the next (up to max_rows) non-NULL vectors of vm, done is set once the statement is exhausted
+    b->count = 0;
+    if (max_rows > b->capacity) max_rows = b->capacity;
+    while (b->count < max_rows) {
+        int rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {*done = true; break;}
+        if (rc != SQLITE_ROW) return rc;
+        if (sqlite3_column_type(vm, 1) == SQLITE_NULL) continue;
+        
+        const void *blob = sqlite3_column_blob(vm, 1);
+        if (!blob) continue;
+        
+        int64_t rowid = (int64_t)sqlite3_column_int64(vm, 0);
+        if ((size_t)sqlite3_column_bytes(vm, 1) < b->blob_bytes) {
+            context_result_error(context, SQLITE_ERROR, "Invalid vector blob found at rowid %lld", (long long)rowid);
+            return SQLITE_ERROR;
+        }
+        
+        b->rowids[b->count] = rowid;
+        memcpy(b->blobs + (size_t)b->count * b->blob_bytes, blob, b->blob_bytes);
+        ++b->count;
+    }
+    return SQLITE_OK;
+}
+
+static void rebuild_pipeline_run (rebuild_pipeline *p, vector_pool_task task) {
+    // small rounds are not worth the hand-off to the pool
+    int nactive = p->batch.count / REBUILD_MIN_SHARD_ROWS;
+    if (nactive > p->nshards) nactive = p->nshards;
+    if (nactive < 1) nactive = 1;
+    p->nactive = nactive;
+    
+    if (nactive == 1) task(p, 0);
+    else vector_pool_run(nactive, task, p);
+}
+
+static inline void rebuild_shard_range (const rebuild_pipeline *p, int index, int *start, int *end) {
+    *start = (int)((int64_t)p->batch.count * index / p->nactive);
+    *end = (int)((int64_t)p->batch.count * (index + 1) / p->nactive);
+}
+
+static void rebuild_calibrate_task (void *arg, int index) {
+    rebuild_pipeline *p = (rebuild_pipeline *)arg;
+    int dim = p->dim;
+    int start, end;
+    rebuild_shard_range(p, index, &start, &end);
+    
+    float *v = p->scratch + (size_t)index * dim;
+    float *lo = (p->bounds) ? p->bounds + (size_t)index * 2 * dim : NULL;
+    float *hi = (lo) ? lo + dim : NULL;
+    for (int r=start; r<end; ++r) {
+        vector_to_float32(p->batch.blobs + (size_t)r * p->batch.blob_bytes, p->type, v, dim);
+        vector_minmax_f32(v, dim, &p->shard_min[index], &p->shard_max[index]);
+        if (!lo) continue;
+        for (int i=0; i<dim; ++i) {
+            lo[i] = (v[i] < lo[i]) ? v[i] : lo[i];
+            hi[i] = (v[i] > hi[i]) ? v[i] : hi[i];
+        }
+    }
+}
+
+static void rebuild_quantize_task (void *arg, int index) {
+    rebuild_pipeline *p = (rebuild_pipeline *)arg;
+    int start, end;
+    rebuild_shard_range(p, index, &start, &end);
+    
+    float *scratch = p->scratch + (size_t)index * p->dim;
+    for (int r=start; r<end; ++r) {
+        const void *blob = p->batch.blobs + (size_t)r * p->batch.blob_bytes;
+        uint8_t *data = p->out + (size_t)r * p->q_size;
+        INT64_TO_INT8PTR(p->batch.rowids[r], data);
+        data += sizeof(int64_t) + p->level_bytes;
+        
+        if (p->qtype == VECTOR_QUANT_PQ) {
+            vector_to_float32(blob, p->type, scratch, p->dim);
+            pq_encode(p->pq, scratch, data);
+        } else if (p->qcalib) {
+            quantize_vector_calibrated(blob, data, p->type, p->dim, p->qtype, p->qcalib, scratch);
+        } else {
+            quantize_vector(blob, data, p->type, p->dim, p->qtype, p->offset, p->scale, p->binary_mean);
+        }
+        if (p->level_bytes) quantize_code_bits(data, data - p->level_bytes, p->qtype, p->dim);
+    }
+}
+
+static void rebuild_assign_task (void *arg, int index) {
+    rebuild_pipeline *p = (rebuild_pipeline *)arg;
+    int start, end;
+    rebuild_shard_range(p, index, &start, &end);
+    
+    float *v = p->scratch + (size_t)index * p->dim;
+    for (int r=start; r<end; ++r) {
+        vector_to_float32(p->batch.blobs + (size_t)r * p->batch.blob_bytes, p->type, v, p->dim);
+        p->entries[r].rowid = p->batch.rowids[r];
+        p->entries[r].list = ivf_nearest(p->centroids, p->nlist, v, p->dim, p->distance_fn);
+    }
+    
+    // the blobs of the round are quantized now, so the base table is read only once
+    rebuild_quantize_task(arg, index);
+}
+
+static void ivf_records_permute (uint8_t *records, ivf_entry *entries, uint32_t n, size_t q_size, uint8_t *tmp) {
+    // moves record entries[i].slot to position i for every i, in place (one cycle of the permutation at a time)
+    for (uint32_t i=0; i<n; ++i) {
+        if (entries[i].slot == i) continue;
+        
+        memcpy(tmp, records + (size_t)i * q_size, q_size);
+        uint32_t j = i;
+        while (entries[j].slot != i) {
+            uint32_t k = entries[j].slot;
+            memcpy(records + (size_t)j * q_size, records + (size_t)k * q_size, q_size);
+            entries[j].slot = j;
+            j = k;
+        }
+        memcpy(records + (size_t)j * q_size, tmp, q_size);
+        entries[j].slot = j;
+    }
+}
+
+static int vector_rebuild_ivf_spill (sqlite3_context *context, sqlite3_stmt *vm, rebuild_pipeline *pipeline, table_context *t_ctx, ivf_entry *entries, uint8_t *original, uint32_t max_vectors, int64_t nrows, uint32_t *count) {
+    // records of a table larger than max_memory go through a temporary table keyed by (list, rowid): SQLite keeps it
+    // ordered on disk, so it is read back as runs of posting lists without holding every code in memory
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    size_t q_size = pipeline->q_size;
+    sqlite3_stmt *vm_insert = NULL;
+    sqlite3_stmt *vm_read = NULL;
+    
+    int rc = sqlite3_exec(db, VECTOR_SPILL_TABLE " DELETE FROM temp._sqliteai_vector_spill;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto vector_rebuild_ivf_spill_cleanup;
+    
+    rc = sqlite3_prepare_v2(db, "INSERT INTO temp._sqliteai_vector_spill (list, id, data) VALUES (?, ?, ?);", -1, &vm_insert, NULL);
+    if (rc != SQLITE_OK) goto vector_rebuild_ivf_spill_cleanup;
+    
+    int64_t nentries = 0;
+    int batch_rows = (max_vectors < REBUILD_BATCH_ROWS) ? (int)max_vectors : REBUILD_BATCH_ROWS;
+    pipeline->out = original;
+    pipeline->entries = entries;
+    bool done = false;
+    while (!done) {
+        // rows inserted after the initial COUNT(*) are not part of this snapshot
+        int64_t room = nrows - nentries;
+        if (room <= 0) break;
+        rc = rebuild_batch_fill(context, vm, &pipeline->batch, (room < batch_rows) ? (int)room : batch_rows, &done);
+        if (rc != SQLITE_OK) goto vector_rebuild_ivf_spill_cleanup;
+        if (pipeline->batch.count == 0) break;
+        
+        rebuild_pipeline_run(pipeline, rebuild_assign_task);
+        for (int r=0; r<pipeline->batch.count; ++r) {
+            sqlite3_bind_int(vm_insert, 1, entries[r].list);
+            sqlite3_bind_int64(vm_insert, 2, (sqlite3_int64)entries[r].rowid);
+            sqlite3_bind_blob64(vm_insert, 3, original + (size_t)r * q_size, (sqlite3_uint64)q_size, SQLITE_STATIC);
+            rc = sqlite3_step(vm_insert);
+            sqlite3_reset(vm_insert);
+            if (rc != SQLITE_DONE) goto vector_rebuild_ivf_spill_cleanup;
+        }
+        nentries += pipeline->batch.count;
+    }
+    
+    rc = sqlite3_prepare_v2(db, "SELECT list, id, data FROM temp._sqliteai_vector_spill ORDER BY list, id;", -1, &vm_read, NULL);
+    if (rc != SQLITE_OK) goto vector_rebuild_ivf_spill_cleanup;
+    
+    // a chunk never spans two posting lists
+    uint32_t n_processed = 0;
+    int64_t min_rowid = 0, max_rowid = 0;
+    int list = -1;
+    while (1) {
+        rc = sqlite3_step(vm_read);
+        if (rc != SQLITE_ROW && rc != SQLITE_DONE) goto vector_rebuild_ivf_spill_cleanup;
+        
+        bool last = (rc == SQLITE_DONE);
+        int next_list = (last) ? -1 : sqlite3_column_int(vm_read, 0);
+        if (n_processed > 0 && (last || n_processed == max_vectors || next_list != list)) {
+            rc = vector_serialize_quantization(db, t_ctx->t_name, t_ctx->c_name, t_ctx->chunk_format, n_processed, original, (size_t)n_processed * q_size, min_rowid, max_rowid, list);
+            if (rc != SQLITE_OK) goto vector_rebuild_ivf_spill_cleanup;
+            n_processed = 0;
+        }
+        if (last) break;
+        
+        if ((size_t)sqlite3_column_bytes(vm_read, 2) != q_size) {rc = SQLITE_CORRUPT; goto vector_rebuild_ivf_spill_cleanup;}
+        list = next_list;
+        max_rowid = (int64_t)sqlite3_column_int64(vm_read, 1);
+        if (n_processed == 0) min_rowid = max_rowid;
+        memcpy(original + (size_t)n_processed * q_size, sqlite3_column_blob(vm_read, 2), q_size);
+        ++n_processed;
+        if (count) ++(*count);
+    }
+    rc = SQLITE_OK;
+    
+vector_rebuild_ivf_spill_cleanup:
+    if (vm_insert) sqlite3_finalize(vm_insert);
+    if (vm_read) sqlite3_finalize(vm_read);
+    // the (empty) table is kept: it cannot be dropped while the vector_quantize statement is running
+    sqlite3_exec(db, "DELETE FROM temp._sqliteai_vector_spill;", NULL, NULL, NULL);
+    return rc;
+}
+
+static int vector_rebuild_ivf_lists (sqlite3_context *context, sqlite3_stmt *vm, rebuild_pipeline *pipeline, table_context *t_ctx, const float *centroids, int nlist, uint8_t *original, uint32_t max_vectors, int64_t nrows, uint32_t *count) {
+    // vm is the (already reset) SELECT pk, vector statement
+    // step 1: assign every vector to its closest centroid and quantize it in the same pass (on the pipeline workers)
+    // step 2: order the records by (list, rowid) and write each posting list as a run of chunks
+    // the records are ordered in place when the whole table fits in the max_memory buffer, and spilled otherwise
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    size_t q_size = pipeline->q_size;
+    bool in_memory = (nrows <= (int64_t)max_vectors);
+    
+    int rc = SQLITE_NOMEM;
+    int64_t nentries = 0;
+    int64_t nalloc = (in_memory) ? nrows : ((max_vectors < REBUILD_BATCH_ROWS) ? max_vectors : REBUILD_BATCH_ROWS);
+    ivf_entry *entries = (ivf_entry *)sqlite3_malloc64((sqlite3_uint64)(nalloc > 0 ? nalloc : 1) * sizeof(ivf_entry));
+    uint8_t *tmp = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)q_size);
+    if (!entries || !tmp) goto vector_rebuild_ivf_cleanup;
+    
+    pipeline->centroids = centroids;
+    pipeline->nlist = nlist;
+    pipeline->distance_fn = ivf_distance_function(t_ctx->options.v_distance);
+    if (!in_memory) {
+        rc = vector_rebuild_ivf_spill(context, vm, pipeline, t_ctx, entries, original, max_vectors, nrows, count);
+        goto vector_rebuild_ivf_cleanup;
+    }
+    
+    bool done = false;
+    while (!done) {
+        // rows inserted after the initial COUNT(*) are not part of this snapshot
+        int64_t room = nrows - nentries;
+        if (room <= 0) break;
+        rc = rebuild_batch_fill(context, vm, &pipeline->batch, (room < REBUILD_BATCH_ROWS) ? (int)room : REBUILD_BATCH_ROWS, &done);
+        if (rc != SQLITE_OK) goto vector_rebuild_ivf_cleanup;
+        if (pipeline->batch.count == 0) break;
+        
+        pipeline->entries = entries + nentries;
+        pipeline->out = original + (size_t)nentries * q_size;
+        rebuild_pipeline_run(pipeline, rebuild_assign_task);
+        for (int r=0; r<pipeline->batch.count; ++r) entries[nentries + r].slot = (uint32_t)(nentries + r);
+        nentries += pipeline->batch.count;
+    }
+    
+    qsort(entries, (size_t)nentries, sizeof(ivf_entry), ivf_entry_compare);
+    ivf_records_permute(original, entries, (uint32_t)nentries, q_size, tmp);
+    
+    // a chunk never spans two posting lists
+    int64_t first = 0;
+    for (int64_t i=0; i<nentries; ++i) {
+        bool last_of_list = (i + 1 == nentries) || (entries[i + 1].list != entries[i].list);
+        if (!last_of_list) continue;
+        
+        rc = vector_serialize_quantization(db, t_ctx->t_name, t_ctx->c_name, t_ctx->chunk_format, (uint32_t)(i + 1 - first), original + (size_t)first * q_size, (size_t)(i + 1 - first) * q_size, entries[first].rowid, entries[i].rowid, entries[i].list);
+        if (rc != SQLITE_OK) goto vector_rebuild_ivf_cleanup;
+        first = i + 1;
+    }
+    if (count) *count += (uint32_t)nentries;
+    rc = SQLITE_OK;
+    
+vector_rebuild_ivf_cleanup:
+    if (entries) sqlite3_free(entries);
+    if (tmp) sqlite3_free(tmp);
+    return rc;
+}
+
+static int vector_rebuild_quantization (sqlite3_context *context, const char *table_name, const char *column_name, table_context *t_ctx, const vector_options *options, uint32_t *count) {
+    
+    int rc = SQLITE_NOMEM;
+    sqlite3_stmt *vm = NULL;
+    char sql[STATIC_SQL_SIZE];
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    uint32_t tot_processed = 0;
+    uint8_t *original = NULL;
+    float *samples = NULL;
+    float *centroids = NULL;
+    float *qcalib = NULL;
+    sqlite3_stmt *calib_vm = NULL;
+    pq_codebook pq = {0};
+    rebuild_pipeline pipeline = {0};
+    
+    const char *pk_name = t_ctx->pk_name;
+    int dim = t_ctx->options.v_dim;
+    vector_type type = t_ctx->options.v_type;
+    vector_qtype qtype = options->q_type;
+    uint64_t max_memory = options->max_memory;
+    int nlist = options->nlist;
+    int pq_m = options->pq_m;
+    int pq_nbits = options->nbits;
+    
+    // PQ sub-quantizers, like IVF centroids, are trained in float32 space
+    // (options are validated by vector_quantize)
+    bool use_pq = (qtype == VECTOR_QUANT_PQ);
+    if (use_pq) {
+        if (pq_m <= 0) pq_m = pq_default_m(dim);
+        pq.m = pq_m;
+        pq.nbits = (pq_nbits > 0) ? pq_nbits : DEFAULT_PQ_NBITS;
+        pq.dsub = dim / pq_m;
+    }
+    
+    // a new quantization always writes split chunks (tables quantized before keep their layout until rebuilt)
+    t_ctx->chunk_format = VECTOR_CHUNK_FORMAT_SPLIT;
+    
+    // cascade: the 8-bit code of every record is preceded by its 1BIT code (options are validated by vector_quantize)
+    bool use_cascade = (options->cascade > 0 && qtype != VECTOR_QUANT_1BIT && !use_pq && !quant_is_4bit(qtype));
+    size_t level_bytes = quant_level_bytes(use_cascade, dim);
+    
+    // compute size of a single quant, format is: rowid + [1BIT code] + quantize dimensions
+    size_t quant_bytes = quant_bytes_for_dim(qtype, dim, &pq);
+    size_t q_size = sizeof(int64_t) + level_bytes + quant_bytes;
+    if (q_size == 0) {
+        sqlite3_result_error(context, "Vector dimension is zero, which is not possible", -1);
+        return SQLITE_MISUSE;
+    }
+    
+    // IVF centroids are trained in float32 space
+    bool use_ivf = (options->index == VECTOR_INDEX_IVF);
+    
+    // 8-bit and 4-bit codes only: per-dimension bounds and/or percentile clipping (computed over a reservoir sample)
+    bool is_8bit = (qtype != VECTOR_QUANT_1BIT && qtype != VECTOR_QUANT_PQ);
+    bool use_dims = is_8bit && (options->calibration == VECTOR_CALIBRATION_DIMENSION);
+    bool use_clip = is_8bit && (options->percentile > 0.0f);
+    
+    int64_t nrows = -1;
+    if (max_memory == 0 || use_ivf || use_pq || use_clip || options->calib_sample > 0) {
+        sqlite3_snprintf(sizeof(sql), sql, "SELECT COUNT(*) FROM %q;", table_name);
+        nrows = sqlite_read_int64(db, sql);
+    }
+    
+    // max_memory == 0 means use all required memory
+    if (max_memory == 0) {
+        max_memory = (nrows == 0) ? DEFAULT_MAX_MEMORY : (uint64_t)nrows * (uint64_t)q_size;
+        if (nrows <= 0) {
+            // no vectors
+            t_ctx->options.q_type = (qtype == VECTOR_QUANT_AUTO) ? VECTOR_QUANT_U8BIT : (qtype == VECTOR_QUANT_4BIT) ? VECTOR_QUANT_U4BIT : qtype;
+            t_ctx->scale = 1.0f;
+            t_ctx->offset = 0.0f;
+            if (t_ctx->pq.codebooks) sqlite3_free(t_ctx->pq.codebooks);
+            t_ctx->pq = pq;
+            if (t_ctx->qcalib) sqlite3_free(t_ctx->qcalib);
+            t_ctx->qcalib = NULL;
+            t_ctx->binary_level = use_cascade;
+            t_ctx->options.cascade = (use_cascade) ? options->cascade : 0;
+            return SQLITE_OK;
+        }
+    }
+    
+    // IVF: nlist defaults to sqrt(rows) and is capped by the number of training samples
+    int nsamples = 0;
+    if (use_ivf) {
+        if (nrows <= 0) use_ivf = false;
+        else {
+            if (nlist <= 0) nlist = (int)sqrt((double)nrows);
+            if (nlist < 1) nlist = 1;
+            int64_t max_samples = (int64_t)nlist * IVF_SAMPLES_PER_LIST;
+            if (max_samples > IVF_MAX_SAMPLES) max_samples = IVF_MAX_SAMPLES;
+            nsamples = (int)((nrows < max_samples) ? nrows : max_samples);
+            if (nlist > nsamples) nlist = nsamples;
+            
+            centroids = (float *)sqlite3_malloc64((sqlite3_uint64)nlist * dim * sizeof(float));
+            if (!centroids) {rc = SQLITE_NOMEM; goto vector_rebuild_quantization_cleanup;}
+        }
+    }
+    
+    // PQ: every codeword should see about PQ_SAMPLES_PER_CENTROID samples (the reservoir is shared with IVF)
+    if (use_pq && nrows > 0) {
+        int64_t max_samples = (int64_t)(1 << pq.nbits) * PQ_SAMPLES_PER_CENTROID;
+        if (max_samples > PQ_MAX_SAMPLES) max_samples = PQ_MAX_SAMPLES;
+        if (max_samples > nrows) max_samples = nrows;
+        if (max_samples > nsamples) nsamples = (int)max_samples;
+        
+        pq.codebooks = (float *)sqlite3_malloc64((sqlite3_uint64)pq.m * (1 << pq.nbits) * pq.dsub * sizeof(float));
+        if (!pq.codebooks) {rc = SQLITE_NOMEM; goto vector_rebuild_quantization_cleanup;}
+    }
+    
+    // percentile clipping: the calibration range comes from the sample instead of the extreme values
+    int nclip = 0;
+    if (use_clip && nrows > 0) {
+        nclip = (nrows < CALIB_MAX_SAMPLES) ? (int)nrows : CALIB_MAX_SAMPLES;
+        if (nclip > nsamples) nsamples = nclip;
+    }
+    
+    // per-dimension bounds: dim minimums followed by dim maximums, turned into scales and offsets by calib_finalize
+    if (use_dims) {
+        qcalib = (float *)sqlite3_malloc64((sqlite3_uint64)dim * 2 * sizeof(float));
+        if (!qcalib) {rc = SQLITE_NOMEM; goto vector_rebuild_quantization_cleanup;}
+        for (int i=0; i<dim; ++i) {
+            qcalib[i] = FLT_MAX;
+            qcalib[dim + i] = -FLT_MAX;
+        }
+    }
+    
+    if (nsamples > 0) {
+        samples = (float *)sqlite3_malloc64((sqlite3_uint64)nsamples * dim * sizeof(float));
+        if (!samples) {rc = SQLITE_NOMEM; goto vector_rebuild_quantization_cleanup;}
+    }
+    
+    // max number of vectors that fits in max_memory (per batch; force at least 1)
+    uint32_t max_vectors = (uint32_t)(max_memory / (uint64_t)q_size);
+    if (max_vectors == 0) max_vectors = 1;
+    
+    sqlite3_uint64 out_bytes = (sqlite3_uint64)max_vectors * (sqlite3_uint64)q_size;
+    uint8_t *data = sqlite3_malloc64(out_bytes);
+    original = data;
+    if (!data) {rc = SQLITE_NOMEM; goto vector_rebuild_quantization_cleanup;}
+    
+    rc = rebuild_pipeline_init(&pipeline, type, dim, options->threads, use_dims);
+    if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+    pipeline.level_bytes = level_bytes;
+        
+    // SELECT rowid, embedding FROM table
+    generate_select_from_table(table_name, column_name, pk_name, sql);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+    
+    // calib_sample: calibration and training read a random subset of the rows instead of the whole table
+    // (values outside the sampled range are clamped by the quantizer)
+    calib_vm = vm;
+    if (options->calib_sample > 0 && nrows > options->calib_sample) {
+        generate_select_sample_from_table(table_name, column_name, pk_name, options->calib_sample, sql);
+        rc = sqlite3_prepare_v2(db, sql, -1, &calib_vm, NULL);
+        if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+    }
+    
+    // STEP 1
+    // find global min/max across ALL (or the calib_sample) vectors (skip for 1BIT quantization which uses fixed threshold)
+    // when an IVF index or PQ is requested the same pass also collects a reservoir sample for k-means
+    float min_val = FLT_MAX;
+    float max_val = -FLT_MAX;
+    int64_t nseen = 0;
+    uint64_t seed = 0x5A3D1E5ULL;
+    bool use_minmax = (qtype != VECTOR_QUANT_1BIT && qtype != VECTOR_QUANT_PQ);
+
+    if (qtype != VECTOR_QUANT_1BIT || use_ivf) {
+        bool done = false;
+        while (!done) {
+            rc = rebuild_batch_fill(context, calib_vm, &pipeline.batch, REBUILD_BATCH_ROWS, &done);
+            if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+            if (pipeline.batch.count == 0) break;
+            
+            if (samples) {
+                // reservoir sampling (algorithm R), kept on the calling thread so that the sample does not depend on threads
+                for (int r=0; r<pipeline.batch.count; ++r) {
+                    int64_t slot = (nseen < nsamples) ? nseen : (int64_t)(((uint64_t)vector_random(&seed) << 31 | vector_random(&seed)) % (uint64_t)(nseen + 1));
+                    if (slot < nsamples) vector_to_float32(pipeline.batch.blobs + (size_t)r * pipeline.batch.blob_bytes, type, samples + (size_t)slot * dim, dim);
+                    ++nseen;
+                }
+            }
+            if (!use_minmax) continue;
+            
+            if (type == VECTOR_TYPE_BIT) {
+                context_result_error(context, SQLITE_ERROR, "Unsupported vector type for 8-bit quantization");
+                rc = SQLITE_ERROR;
+                goto vector_rebuild_quantization_cleanup;
+            }
+            rebuild_pipeline_run(&pipeline, rebuild_calibrate_task);
+        }
+        
+        // merge the per shard extremes
+        if (use_minmax) {
+            for (int s=0; s<pipeline.nshards; ++s) {
+                if (pipeline.shard_min[s] < min_val) min_val = pipeline.shard_min[s];
+                if (pipeline.shard_max[s] > max_val) max_val = pipeline.shard_max[s];
+                if (!qcalib) continue;
+                const float *bounds = pipeline.bounds + (size_t)s * 2 * dim;
+                for (int i=0; i<dim; ++i) {
+                    if (bounds[i] < qcalib[i]) qcalib[i] = bounds[i];
+                    if (bounds[dim + i] > qcalib[dim + i]) qcalib[dim + i] = bounds[dim + i];
+                }
+            }
+        }
+    }
+    bool contains_negative = (min_val < 0.0f);
+
+    // set proper format
+    if (qtype == VECTOR_QUANT_AUTO) {
+        if (contains_negative == true) qtype = VECTOR_QUANT_S8BIT;
+        else qtype = VECTOR_QUANT_U8BIT;
+    } else if (qtype == VECTOR_QUANT_4BIT) {
+        qtype = (contains_negative) ? VECTOR_QUANT_S4BIT : VECTOR_QUANT_U4BIT;
+    }
+    
+    // rows that were NULL in COUNT(*) leave the reservoir partially filled
+    if (nseen < nsamples) nsamples = (int)nseen;
+    if (nclip > nsamples) nclip = nsamples;
+    
+    // reservoir slots are uniformly random, so the first nclip ones are a uniform sample too
+    if (nclip > 0) {
+        rc = calib_clip_range(samples, nclip, dim, options->percentile, qcalib, &min_val, &max_val);
+        if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+    }
+    if (qcalib) calib_finalize(qcalib, dim, qtype);
+    
+    // STEP 2
+    // compute scale and offset and set table them to table context standard min-max linear quantization
+    float abs_max = fmaxf(fabsf(min_val), fabsf(max_val)); // only used in VECTOR_QUANT_S8BIT and VECTOR_QUANT_S4BIT
+    float range = max_val - min_val;
+    bool is_unsigned = (qtype == VECTOR_QUANT_U8BIT || qtype == VECTOR_QUANT_U4BIT);
+    float levels = (qtype == VECTOR_QUANT_U8BIT) ? 255.0f : (qtype == VECTOR_QUANT_U4BIT) ? 15.0f : (qtype == VECTOR_QUANT_S4BIT) ? 7.0f : 127.0f;
+    float scale;
+    if (is_unsigned) {
+        scale = (range > 0.0f) ? (levels / range) : 1.0f;
+    } else {
+        scale = (abs_max > 0.0f) ? (levels / abs_max) : 1.0f;
+    }
+    // in the signed versions I am assuming a symmetric quantization, for asymmetric quantization min_val should be used
+    float offset = (is_unsigned) ? min_val : 0.0f;
+    if (use_pq) {
+        // unused by PQ codes
+        scale = 1.0f;
+        offset = 0.0f;
+    }
+    
+    t_ctx->options.q_type = qtype;
+    t_ctx->scale = scale;
+    t_ctx->offset = offset;
+    
+    // restart processing from the beginning
+    if (calib_vm != vm) {
+        sqlite3_finalize(calib_vm);
+        calib_vm = vm;
+    }
+    rc = sqlite3_reset(vm);
+    if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+    
+    // no non-NULL vectors to train on
+    if (use_ivf && nseen == 0) use_ivf = false;
+    
+    if (pq.codebooks) {
+        if (nsamples > 0) rc = pq_train(samples, nsamples, dim, &pq);
+        else memset(pq.codebooks, 0, (size_t)pq.m * (1 << pq.nbits) * pq.dsub * sizeof(float));
+        if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+    }
+    
+    // the codes are computed by the pipeline workers, in the IVF assignment pass or in the flat one below
+    pipeline.qtype = qtype;
+    pipeline.offset = offset;
+    pipeline.scale = scale;
+    pipeline.binary_mean = t_ctx->binary_mean;
+    pipeline.pq = &pq;
+    pipeline.qcalib = qcalib;
+    pipeline.q_size = q_size;
+    
+    if (use_ivf) {
+        if (nlist > nsamples) nlist = nsamples;
+        
+        rc = ivf_train(samples, nsamples, dim, nlist, ivf_distance_function(t_ctx->options.v_distance), centroids);
+        if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+        
+        rc = vector_rebuild_ivf_lists(context, vm, &pipeline, t_ctx, centroids, nlist, original, max_vectors, nrows, &tot_processed);
+        goto vector_rebuild_quantization_cleanup;
+    }
+    
+    // STEP 3
+    // actual quantization: every round fills the next slots of the current chunk, which is written once full
+    uint32_t n_processed = 0;
+    int64_t min_rowid = 0, max_rowid = 0;
+    bool done = false;
+    while (!done) {
+        uint32_t room = max_vectors - n_processed;
+        rc = rebuild_batch_fill(context, vm, &pipeline.batch, (room < REBUILD_BATCH_ROWS) ? (int)room : REBUILD_BATCH_ROWS, &done);
+        if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+        if (pipeline.batch.count == 0) break;
+        
+        if (n_processed == 0) min_rowid = pipeline.batch.rowids[0];
+        pipeline.out = original + (size_t)n_processed * q_size;
+        rebuild_pipeline_run(&pipeline, rebuild_quantize_task);
+        
+        max_rowid = pipeline.batch.rowids[pipeline.batch.count - 1];
+        n_processed += (uint32_t)pipeline.batch.count;
+        tot_processed += (uint32_t)pipeline.batch.count;
+        
+        if (n_processed == max_vectors) {
+            rc = vector_serialize_quantization(db, table_name, column_name, t_ctx->chunk_format, n_processed, original, (size_t)n_processed * q_size, min_rowid, max_rowid, -1);
+            if (rc != SQLITE_OK) goto vector_rebuild_quantization_cleanup;
+            n_processed = 0;
+        }
+    }
+    
+    // handle remaining vectors
+    if (n_processed > 0) {
+        rc = vector_serialize_quantization(db, table_name, column_name, t_ctx->chunk_format, n_processed, original, (size_t)n_processed * q_size, min_rowid, max_rowid, -1);
+    }
+    
+vector_rebuild_quantization_cleanup:
+    if (rc != SQLITE_OK) printf("Error in vector_rebuild_quantization: %s\n", sqlite3_errmsg(db));
+    if (rc == SQLITE_OK) {
+        // publish the new coarse quantizer (or drop the previous one when rebuilding a flat layout)
+        if (t_ctx->ivf_centroids) sqlite3_free(t_ctx->ivf_centroids);
+        t_ctx->ivf_centroids = (use_ivf) ? centroids : NULL;
+        t_ctx->ivf_nlist = (use_ivf) ? nlist : 0;
+        t_ctx->options.index = (use_ivf) ? VECTOR_INDEX_IVF : VECTOR_INDEX_NONE;
+        t_ctx->options.nlist = t_ctx->ivf_nlist;
+        if (use_ivf) centroids = NULL;
+        
+        // same for the PQ sub-quantizers (a zeroed codebook when the table is not PQ quantized)
+        if (t_ctx->pq.codebooks) sqlite3_free(t_ctx->pq.codebooks);
+        t_ctx->pq = pq;
+        pq.codebooks = NULL;
+        
+        // same for the per-dimension calibration
+        if (t_ctx->qcalib) sqlite3_free(t_ctx->qcalib);
+        t_ctx->qcalib = qcalib;
+        t_ctx->options.calibration = options->calibration;
+        t_ctx->options.percentile = options->percentile;
+        qcalib = NULL;
+        
+        t_ctx->binary_level = use_cascade;
+        t_ctx->options.cascade = (use_cascade) ? options->cascade : 0;
+    }
+    if (pq.codebooks) sqlite3_free(pq.codebooks);
+    if (qcalib) sqlite3_free(qcalib);
+    if (centroids) sqlite3_free(centroids);
+    if (samples) sqlite3_free(samples);
+    if (original) sqlite3_free(original);
+    if (calib_vm && calib_vm != vm) sqlite3_finalize(calib_vm);
+    if (vm) sqlite3_finalize(vm);
+    rebuild_pipeline_free(&pipeline);
+    if (count) *count = tot_processed;
+    return rc;
+}
+
+static char *vector_sidecar_escape (const char *name) {
+    // quoted identifiers can hold '/', '\', ':' or "..": every byte outside [A-Za-z0-9_] is written as %XX
+    static const char hex[] = "0123456789ABCDEF";
+    char *escaped = (char *)sqlite3_malloc64((sqlite3_uint64)strlen(name) * 3 + 1);
+    if (!escaped) return NULL;
+    
+    char *p = escaped;
+    for (const unsigned char *c = (const unsigned char *)name; *c; ++c) {
+        if ((*c >= 'a' && *c <= 'z') || (*c >= 'A' && *c <= 'Z') || (*c >= '0' && *c <= '9') || *c == '_') {
+            *p++ = (char)*c;
+        } else {
+            *p++ = '%';
+            *p++ = hex[*c >> 4];
+            *p++ = hex[*c & 0x0F];
+        }
+    }
+    *p = 0;
+    return escaped;
+}
+
+static char *vector_sidecar_path (sqlite3 *db, const char *table_name, const char *column_name) {
+    // the sidecar lives next to the file of the database that holds the table (in-memory and temporary databases have none)
+    const char *filename = sqlite_table_filename(db, table_name);
+    if (!filename || filename[0] == 0) return NULL;
+    
+    char *path = NULL;
+    char *table = vector_sidecar_escape(table_name);
+    char *column = vector_sidecar_escape(column_name);
+    if (table && column) path = sqlite3_mprintf("%s-vector0_%s_%s.qbin", filename, table, column);
+    if (table) sqlite3_free(table);
+    if (column) sqlite3_free(column);
+    return path;
+}
+
+static vector_sidecar *vector_sidecar_attach (const char *path, int64_t generation, sqlite3_int64 required, size_t stride, int nlist) {
+    // maps an existing sidecar file, only if it was written from the current quantization
+    vector_sidecar *sidecar = (vector_sidecar *)sqlite3_malloc(sizeof(vector_sidecar));
+    if (!sidecar) return NULL;
+    
+    if (vector_sidecar_open(path, sidecar)) {
+        const vector_sidecar_header *h = &sidecar->header;
+        if (h->generation == generation && h->data_bytes == (uint64_t)required && h->stride == stride && (h->nlist == nlist || h->nlist == 0)) return sidecar;
+        vector_sidecar_close(sidecar);
+    }
+    sqlite3_free(sidecar);
+    return NULL;
+}
+
+static void vector_quantize_preload (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_quantize_preload", argc, argv, (argc == 3) ? 3 : 2, types) == false) return;
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    
+    vector_context *v_ctx = (vector_context *)sqlite3_user_data(context);
+    table_context *t_ctx = vector_context_lookup(v_ctx, table_name, column_name);
+    if (!t_ctx) {
+        context_result_error(context, SQLITE_ERROR, "Vector context not found for table '%s' and column '%s'. Ensure that vector_init() has been called before using vector_quantize_preload()", table_name, column_name);
+        return;
+    }
+    
+    // options (mmap) default to the ones of the previous preload or vector_init
+    vector_options options = t_ctx->options;
+    if (argc == 3 && parse_keyvalue_string(context, (const char *)sqlite3_value_text(argv[2]), vector_keyvalue_callback, &options) == false) return;
+    
+    // quantization parameters are reloaded if another connection rebuilt the quantization
+    char sql[STATIC_SQL_SIZE];
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    generate_select_generation(table_name, column_name, sql);
+    int64_t generation = (int64_t)sqlite_read_int64(db, sql);
+    if (generation != t_ctx->generation) sqlite_unserialize(db, t_ctx);
+    int nlist = t_ctx->ivf_nlist;
+    size_t stride = sizeof(int64_t) + quant_code_bytes(t_ctx);
+    
+    // attach to the records already preloaded by another connection for the current generation (if any),
+    // unless they are not backed the requested way (allocated or memory mapped)
+    vector_preload *shared = vector_preload_lookup(t_ctx->preload_key, generation, stride);
+    if (shared && (shared->sidecar != NULL) != options.mmap) {
+        vector_preload_release(shared);
+        shared = NULL;
+    }
+    if (shared) {
+        vector_preload_attach(t_ctx, shared);
+        t_ctx->options.mmap = options.mmap;
+        return;
+    }
+    
+    // release the previous preload of this connection (if any) before reading the new one
+    vector_preload_attach(t_ctx, NULL);
+    
+    // auto update: only the base chunks are preloaded (deltas are always read from disk)
+    generate_count_quant_base(table_name, column_name, sql);
+    sqlite3_int64 total = sqlite_read_int64(db, sql);
+    if (total <= 0 || total > INT_MAX) {
+        context_result_error(context, SQLITE_ERROR, "Unable to read data from database. Ensure that vector_quantize() has been called before using vector_quantize_preload()");
+        return;
+    }
+    
+    // records are preloaded in the split layout, whatever the format of the chunks they are read from
+    size_t code_size = stride - sizeof(int64_t);
+    sqlite3_int64 required = (sqlite3_int64)vector_chunk_bytes(VECTOR_CHUNK_FORMAT_SPLIT, (size_t)total, code_size);
+    
+    int counter = 0;
+    void *buffer = NULL;
+    uint8_t *codes = NULL;
+    int64_t *rowids = NULL;
+    int64_t *pending = NULL;
+    int *lists = NULL;
+    char *path = NULL;
+    char *tmp_path = NULL;
+    vector_sidecar *sidecar = NULL;
+    vector_sidecar_writer *writer = NULL;
+    vector_preload *preload = NULL;
+    sqlite3_stmt *vm = NULL;
+    int rc = SQLITE_OK;
+    
+    // IVF: posting lists are loaded contiguously and indexed by (start, count) pairs
+    if (nlist > 0) {
+        lists = (int *)sqlite3_malloc64((sqlite3_uint64)nlist * 2 * sizeof(int));
+        if (!lists) {
+            context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to allocate IVF posting list offsets");
+            return;
+        }
+        memset(lists, 0, (size_t)nlist * 2 * sizeof(int));
+    }
+    
+    // mmap: map the sidecar file if it matches the current quantization, otherwise rewrite it while reading the chunks
+    // (when the sidecar cannot be written, e.g. in-memory database or read-only directory, a regular buffer is used)
+    if (options.mmap && vector_sidecar_is_supported()) {
+        path = vector_sidecar_path(db, table_name, column_name);
+        if (path) sidecar = vector_sidecar_attach(path, generation, required, stride, nlist);
+        if (sidecar) {
+            counter = (int)sidecar->header.counter;
+            if (lists && sidecar->lists) memcpy(lists, sidecar->lists, (size_t)nlist * 2 * sizeof(int));
+            else if (lists) {sqlite3_free(lists); lists = NULL;}
+            goto preload_publish;
+        }
+        
+        uint64_t suffix = 0;
+        sqlite3_randomness(sizeof(suffix), &suffix);
+        if (path) tmp_path = sqlite3_mprintf("%s-%016llx.tmp", path, (unsigned long long)suffix);
+        if (tmp_path) writer = vector_sidecar_create(path, tmp_path, nlist);
+    }
+    
+    // the sidecar receives the codes while they are read, the rowids are appended once all the codes are written
+    if (writer) {
+        rowids = pending = (int64_t *)sqlite3_malloc64((sqlite3_uint64)total * sizeof(int64_t));
+        if (!pending) {
+            context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to allocate %lld bytes for preloaded rowids", (long long)(total * sizeof(int64_t)));
+            goto preload_cleanup;
+        }
+    } else {
+        buffer = (void *)sqlite3_malloc64(required + VECTOR_CHUNK_ALIGNMENT);
+        if (!buffer) {
+            context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to allocate %lld bytes for quant buffer", (long long)required);
+            goto preload_cleanup;
+        }
+        codes = (uint8_t *)(((uintptr_t)buffer + VECTOR_CHUNK_ALIGNMENT - 1) & ~(uintptr_t)(VECTOR_CHUNK_ALIGNMENT - 1));
+        rowids = (int64_t *)(codes + vector_chunk_codes_bytes((size_t)total, code_size));
+    }
+    
+    if (t_ctx->options.auto_update) (lists) ? generate_preload_quant_base_lists(table_name, column_name, sql) : generate_select_quant_base(table_name, column_name, sql);
+    else (lists) ? generate_preload_quant_lists(table_name, column_name, sql) : generate_select_quant_table(table_name, column_name, sql);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) {
+        context_result_error(context, rc, "Internal statement error: %s", sqlite3_errmsg(db));
+        goto preload_cleanup;
+    }
+    
+    while (1) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;} // return error: rebuild must be call (only if first time run)
+        else if (rc != SQLITE_ROW) {break;}
+        
+        int n = sqlite3_column_int(vm, 0);
+        size_t bytes = (size_t)sqlite3_column_bytes(vm, 1);
+        const uint8_t *data = (const uint8_t *)sqlite3_column_blob(vm, 1);
+        if (n < 0 || n > total - counter || bytes < vector_chunk_bytes(t_ctx->chunk_format, (size_t)n, code_size)) {rc = SQLITE_CORRUPT; break;}
+        
+        if (lists) {
+            int list = sqlite3_column_int(vm, 2);
+            if ((sqlite3_column_type(vm, 2) != SQLITE_INTEGER) || (list < 0) || (list >= nlist)) {
+                // layout does not match the serialized index: queries fall back to a full scan
+                sqlite3_free(lists);
+                lists = NULL;
+            } else {
+                if (lists[list * 2 + 1] == 0) lists[list * 2] = counter;
+                lists[list * 2 + 1] += n;
+            }
+        }
+        
+        // split chunks are copied with a single memcpy of their codes
+        vector_records records = vector_chunk_records(t_ctx->chunk_format, data, n, code_size);
+        bool contiguous = (records.code_stride == code_size);
+        for (int i = 0; i < n; ++i) rowids[counter + i] = vector_records_rowid(&records, i);
+        if (writer) {
+            bool written = true;
+            if (contiguous) written = vector_sidecar_write(writer, records.codes, (size_t)n * code_size);
+            else for (int i = 0; i < n && written; ++i) written = vector_sidecar_write(writer, vector_records_code(&records, i), code_size);
+            if (!written) {rc = SQLITE_IOERR_WRITE; break;}
+        } else if (contiguous) {
+            memcpy(codes + (size_t)counter * code_size, records.codes, (size_t)n * code_size);
+        } else {
+            for (int i = 0; i < n; ++i) memcpy(codes + (size_t)(counter + i) * code_size, vector_records_code(&records, i), code_size);
+        }
+        counter += n;
+    }
+    
+    if (rc != SQLITE_OK) {
+        context_result_error(context, rc, "vector_quantize_preload failed: %s", sqlite3_errmsg(db));
+        goto preload_cleanup;
+    }
+    
+    // the rowids follow the padded codes of the records actually read
+    size_t codes_bytes = vector_chunk_codes_bytes((size_t)counter, code_size);
+    required = (sqlite3_int64)vector_chunk_bytes(VECTOR_CHUNK_FORMAT_SPLIT, (size_t)counter, code_size);
+    if (writer) {
+        static const uint8_t zero[VECTOR_CHUNK_ALIGNMENT] = {0};
+        bool written = vector_sidecar_write(writer, zero, codes_bytes - (size_t)counter * code_size);
+        if (written) written = vector_sidecar_write(writer, rowids, (size_t)counter * sizeof(int64_t));
+        if (written) written = vector_sidecar_finish(writer, generation, counter, (uint32_t)stride, (const int32_t *)lists);
+        else vector_sidecar_abort(writer);
+        writer = NULL;
+        if (written) sidecar = vector_sidecar_attach(path, generation, required, stride, nlist);
+        if (!sidecar) {
+            rc = SQLITE_IOERR;
+            context_result_error(context, rc, "vector_quantize_preload failed: unable to write the sidecar file '%s'", path);
+            goto preload_cleanup;
+        }
+    } else if (counter < total) {
+        memmove(codes + codes_bytes, rowids, (size_t)counter * sizeof(int64_t));
+    }
+    
+preload_publish:
+    preload = (vector_preload *)sqlite3_malloc(sizeof(vector_preload));
+    if (!preload) {
+        context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to allocate the preload entry");
+        goto preload_cleanup;
+    }
+    memset(preload, 0, sizeof(vector_preload));
+    preload->key = sqlite_strdup(t_ctx->preload_key);
+    if (!preload->key) {
+        sqlite3_free(preload);
+        context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to allocate the preload entry");
+        goto preload_cleanup;
+    }
+    preload->generation = generation;
+    preload->stride = stride;
+    preload->data = (sidecar) ? sidecar->data : codes;
+    preload->buffer = buffer;
+    preload->sidecar = sidecar;
+    preload->counter = counter;
+    preload->norms = vector_preload_norms(t_ctx, preload->data, counter, code_size);
+    preload->lists = lists;
+    preload->lists_count = (lists) ? nlist : 0;
+    buffer = NULL;
+    sidecar = NULL;
+    lists = NULL;
+    
+    // other connections of the process attach to the published entry on their next query
+    vector_preload_attach(t_ctx, vector_preload_publish(preload));
+    t_ctx->options.mmap = options.mmap;
+    
+preload_cleanup:
+    if (vm) sqlite3_finalize(vm);
+    if (writer) vector_sidecar_abort(writer);
+    if (sidecar) {vector_sidecar_close(sidecar); sqlite3_free(sidecar);}
+    if (buffer) sqlite3_free(buffer);
+    if (pending) sqlite3_free(pending);
+    if (lists) sqlite3_free(lists);
+    if (path) sqlite3_free(path);
+    if (tmp_path) sqlite3_free(tmp_path);
+}
+
+// MARK: - Auto Update -
+
+// runs sql with rowid bound to its first parameter (found, if not NULL, reports whether a row was returned)
+static int vector_exec_rowid (sqlite3 *db, const char *sql, int64_t rowid, bool *found) {
+    sqlite3_stmt *vm = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    rc = sqlite3_bind_int64(vm, 1, (sqlite3_int64)rowid);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    rc = sqlite3_step(vm);
+    if (found) *found = (rc == SQLITE_ROW);
+    if (rc == SQLITE_ROW || rc == SQLITE_DONE) rc = SQLITE_OK;
+    
+cleanup:
+    if (vm) sqlite3_finalize(vm);
+    return rc;
+}
+
+static int64_t vector_generation_read (sqlite3 *db, const char *table_name, const char *column_name) {
+    char sql[STATIC_SQL_SIZE];
+    generate_select_generation(table_name, column_name, sql);
+    return (int64_t)sqlite_read_int64(db, sql);
+}
+
+static int vector_generation_next (sqlite3_context *context, table_context *t_ctx) {
+    // every rewrite of the base chunks gets a new generation, so that preloaded buffers, sidecar files and the
+    // parameters loaded by the other connections can detect they are stale. It is a random token rather than a
+    // counter: a rolled back transaction would hand the same number out again, matching records (and sidecars)
+    // built from the rows it discarded
+    int64_t previous = vector_generation_read(sqlite3_context_db_handle(context), t_ctx->t_name, t_ctx->c_name);
+    int64_t generation = 0;
+    while (generation == 0 || generation == previous) {
+        sqlite3_randomness(sizeof(generation), &generation);
+        generation &= INT64_MAX;
+    }
+    int rc = sqlite_serialize(context, t_ctx->t_name, t_ctx->c_name, SQLITE_INTEGER, OPTION_KEY_GENERATION, generation, 0, NULL);
+    if (rc == SQLITE_OK) t_ctx->generation = generation;
+    return rc;
+}
+
+static void vector_tombstones_free (vector_tombstones *dead) {
+    if (dead->rowids) sqlite3_free(dead->rowids);
+    dead->rowids = NULL;
+    dead->count = 0;
+}
+
+static int vector_tombstones_load (sqlite3 *db, const char *table_name, const char *column_name, vector_tombstones *dead) {
+    vector_tombstones_free(dead);
+    
+    char sql[STATIC_SQL_SIZE];
+    generate_select_tombstones(table_name, column_name, sql);
+    sqlite3_stmt *vm = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) {
+        // no tombstone table means no tombstones
+        generate_tombstone_table_name(table_name, column_name, sql);
+        if (!sqlite_table_exists(db, sql)) rc = SQLITE_OK;
+        goto cleanup;
+    }
+    
+    int capacity = 0;
+    while (1) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;}
+        if (rc != SQLITE_ROW) break;
+        
+        if (dead->count == capacity) {
+            int n = (capacity) ? capacity * 2 : 64;
+            int64_t *rowids = (int64_t *)sqlite3_realloc64(dead->rowids, (sqlite3_uint64)n * sizeof(int64_t));
+            if (!rowids) {rc = SQLITE_NOMEM; break;}
+            dead->rowids = rowids;
+            capacity = n;
+        }
+        // ORDER BY id: the array is sorted as required by vector_tombstones_contains
+        dead->rowids[dead->count++] = (int64_t)sqlite3_column_int64(vm, 0);
+    }
+    
+cleanup:
+    if (rc != SQLITE_OK) vector_tombstones_free(dead);
+    if (vm) sqlite3_finalize(vm);
+    return rc;
+}
+
+static void vector_quantize_record (table_context *t_ctx, const void *blob, uint8_t *data, float *scratch) {
+    vector_type type = t_ctx->options.v_type;
+    vector_qtype qtype = t_ctx->options.q_type;
+    int dim = t_ctx->options.v_dim;
+    
+    // cascade: the 1BIT code precedes the 8-bit code it is derived from
+    uint8_t *bits = NULL;
+    if (t_ctx->binary_level) {
+        bits = data;
+        data += quant_level_bytes(true, dim);
+    }
+    
+    if (qtype == VECTOR_QUANT_PQ) {
+        vector_to_float32(blob, type, scratch, dim);
+        pq_encode(&t_ctx->pq, scratch, data);
+    } else if (t_ctx->qcalib) {
+        quantize_vector_calibrated(blob, data, type, dim, qtype, t_ctx->qcalib, scratch);
+    } else {
+        quantize_vector(blob, data, type, dim, qtype, t_ctx->offset, t_ctx->scale, t_ctx->binary_mean);
+    }
+    if (bits) quantize_code_bits(data, bits, qtype, dim);
+}
+
+static int vector_delta_invalidate (sqlite3 *db, table_context *t_ctx, int64_t rowid) {
+    // the record of rowid is no longer valid: drop its delta (if any) and mask its base record (if any)
+    char sql[STATIC_SQL_SIZE];
+    generate_delete_quant_delta(t_ctx->t_name, t_ctx->c_name, sql);
+    int rc = vector_exec_rowid(db, sql, rowid, NULL);
+    if (rc != SQLITE_OK) return rc;
+    
+    bool covered = false;
+    generate_base_covers_rowid(t_ctx->t_name, t_ctx->c_name, sql);
+    rc = vector_exec_rowid(db, sql, rowid, &covered);
+    if (rc != SQLITE_OK || !covered) return rc;
+    
+    generate_insert_tombstone(t_ctx->t_name, t_ctx->c_name, sql);
+    return vector_exec_rowid(db, sql, rowid, NULL);
+}
+
+static void vector_quantize_delta (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    // invoked by the auto_update triggers: vector_quantize_delta(table, column, old_rowid, new_rowid, vector)
+    if (sqlite3_value_type(argv[0]) != SQLITE_TEXT || sqlite3_value_type(argv[1]) != SQLITE_TEXT) {
+        context_result_error(context, SQLITE_ERROR, "vector_quantize_delta: table and column names must be of type TEXT");
+        return;
+    }
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    
+    vector_context *v_ctx = (vector_context *)sqlite3_user_data(context);
+    table_context *t_ctx = vector_context_lookup(v_ctx, table_name, column_name);
+    if (!t_ctx) {
+        context_result_error(context, SQLITE_ERROR, "Vector context not found for table '%s' and column '%s'. Ensure that vector_init() has been called before modifying a table quantized with auto_update=1", table_name, column_name);
+        return;
+    }
+    
+    // quantization parameters are reloaded if another connection rebuilt the quantization: the delta must be
+    // encoded with the qtype, calibration, centroids and codebooks of the current base chunks
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    int64_t generation = vector_generation_read(db, table_name, column_name);
+    if (generation != t_ctx->generation) sqlite_unserialize(db, t_ctx);
+    
+    bool has_old = (sqlite3_value_type(argv[2]) != SQLITE_NULL);
+    bool has_new = (sqlite3_value_type(argv[3]) != SQLITE_NULL);
+    int64_t old_rowid = (int64_t)sqlite3_value_int64(argv[2]);
+    int64_t new_rowid = (int64_t)sqlite3_value_int64(argv[3]);
+    uint8_t *record = NULL;
+    float *scratch = NULL;
+    
+    // INSERT OR REPLACE does not fire the delete trigger of the replaced row, so the new rowid is invalidated too
+    int rc = SQLITE_OK;
+    if (has_old) rc = vector_delta_invalidate(db, t_ctx, old_rowid);
+    if (rc == SQLITE_OK && has_new && (!has_old || new_rowid != old_rowid)) rc = vector_delta_invalidate(db, t_ctx, new_rowid);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    // deleted row or NULL vector: nothing to quantize
+    if (!has_new || sqlite3_value_type(argv[4]) != SQLITE_BLOB) goto cleanup;
+    
+    // PQ quantization of a table without vectors: no codebooks to encode with (a new vector_quantize is required)
+    if (t_ctx->options.q_type == VECTOR_QUANT_PQ && t_ctx->pq.codebooks == NULL) goto cleanup;
+    
+    int dim = t_ctx->options.v_dim;
+    vector_type type = t_ctx->options.v_type;
+    const void *blob = sqlite3_value_blob(argv[4]);
+    if ((size_t)sqlite3_value_bytes(argv[4]) < vector_bytes_for_dim(type, dim)) {
+        context_result_error(context, SQLITE_ERROR, "Invalid vector blob found at rowid %lld", (long long)new_rowid);
+        return;
+    }
+    
+    size_t quant_bytes = quant_code_bytes(t_ctx);
+    record = (uint8_t *)sqlite3_malloc64(sizeof(int64_t) + quant_bytes);
+    scratch = (float *)sqlite3_malloc64((sqlite3_uint64)dim * sizeof(float));
+    if (!record || !scratch) {rc = SQLITE_NOMEM; goto cleanup;}
+    
+    // IVF: the delta belongs to the posting list of the closest centroid
+    int list = -1;
+    if (t_ctx->ivf_centroids) {
+        vector_to_float32(blob, type, scratch, dim);
+        list = ivf_nearest(t_ctx->ivf_centroids, t_ctx->ivf_nlist, scratch, dim, ivf_distance_function(t_ctx->options.v_distance));
+    }
+    
+    INT64_TO_INT8PTR(new_rowid, record);
+    vector_quantize_record(t_ctx, blob, record + sizeof(int64_t), scratch);
+    
+    // single record chunk: flat layout -> VECTOR_DELTA_LIST, IVF list L -> VECTOR_DELTA_LIST - 1 - L
+    rc = vector_serialize_quantization(db, table_name, column_name, t_ctx->chunk_format, 1, record, (ptrdiff_t)(sizeof(int64_t) + quant_bytes), new_rowid, new_rowid, VECTOR_DELTA_LIST - 1 - list);
+    
+cleanup:
+    if (rc != SQLITE_OK) context_result_error(context, rc, "vector_quantize_delta failed: %s", sqlite3_errmsg(db));
+    if (record) sqlite3_free(record);
+    if (scratch) sqlite3_free(scratch);
+}
+
+static int vector_compact_base (sqlite3 *db, table_context *t_ctx, const vector_tombstones *dead, size_t stride) {
+    // rewrites (or deletes) the base chunks that contain at least one tombstoned rowid
+    const char *table_name = t_ctx->t_name;
+    const char *column_name = t_ctx->c_name;
+    sqlite3_stmt *vm = NULL;
+    sqlite3_stmt *vm_read = NULL;
+    sqlite3_stmt *vm_update = NULL;
+    sqlite3_stmt *vm_delete = NULL;
+    int64_t *chunks = NULL;
+    uint8_t *buffer = NULL;
+    uint8_t *chunk = NULL;
+    size_t code_size = stride - sizeof(int64_t);
+    int nchunks = 0, capacity = 0;
+    char sql[STATIC_SQL_SIZE];
+    
+    // chunk ids are collected first so that the table is not modified while it is scanned
+    generate_select_tombstoned_chunks(table_name, column_name, sql);
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    while (1) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;}
+        if (rc != SQLITE_ROW) goto cleanup;
+        
+        if (nchunks == capacity) {
+            int n = (capacity) ? capacity * 2 : 64;
+            int64_t *p = (int64_t *)sqlite3_realloc64(chunks, (sqlite3_uint64)n * sizeof(int64_t));
+            if (!p) {rc = SQLITE_NOMEM; goto cleanup;}
+            chunks = p;
+            capacity = n;
+        }
+        chunks[nchunks++] = (int64_t)sqlite3_column_int64(vm, 0);
+    }
+    if (nchunks == 0) goto cleanup;
+    
+    generate_select_quant_chunk(table_name, column_name, sql);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm_read, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    generate_update_quant_chunk(table_name, column_name, sql);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm_update, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    generate_delete_quant_chunk(table_name, column_name, sql);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm_delete, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    for (int i=0; i<nchunks; ++i) {
+        sqlite3_bind_int64(vm_read, 1, (sqlite3_int64)chunks[i]);
+        rc = sqlite3_step(vm_read);
+        if (rc != SQLITE_ROW) goto cleanup;
+        
+        int counter = sqlite3_column_int(vm_read, 0);
+        const uint8_t *data = (const uint8_t *)sqlite3_column_blob(vm_read, 1);
+        if ((size_t)sqlite3_column_bytes(vm_read, 1) < vector_chunk_bytes(t_ctx->chunk_format, counter, code_size)) {rc = SQLITE_CORRUPT; goto cleanup;}
+        vector_records records = vector_chunk_records(t_ctx->chunk_format, data, counter, code_size);
+        if (buffer) sqlite3_free(buffer);
+        buffer = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)counter * stride + 1);
+        if (!buffer) {rc = SQLITE_NOMEM; goto cleanup;}
+        
+        // keep the records that are still valid (rewritten as interleaved records, encoded when stored)
+        int kept = 0;
+        int64_t min_rowid = INT64_MAX, max_rowid = INT64_MIN;
+        for (int j=0; j<counter; ++j) {
+            int64_t rowid = vector_records_rowid(&records, j);
+            if (vector_tombstones_contains(dead, rowid)) continue;
+            uint8_t *current = buffer + (size_t)kept * stride;
+            INT64_TO_INT8PTR(rowid, current);
+            memcpy(current + sizeof(int64_t), vector_records_code(&records, j), code_size);
+            if (rowid < min_rowid) min_rowid = rowid;
+            if (rowid > max_rowid) max_rowid = rowid;
+            ++kept;
+        }
+        sqlite3_reset(vm_read);
+        
+        size_t chunk_size = 0;
+        chunk = vector_chunk_encode(t_ctx->chunk_format, buffer, (uint32_t)kept, code_size, &chunk_size);
+        if (!chunk) {rc = SQLITE_NOMEM; goto cleanup;}
+        
+        sqlite3_stmt *target = (kept > 0) ? vm_update : vm_delete;
+        sqlite3_bind_int64(target, 1, (sqlite3_int64)chunks[i]);
+        if (kept > 0) {
+            sqlite3_bind_int64(vm_update, 2, (sqlite3_int64)min_rowid);
+            sqlite3_bind_int64(vm_update, 3, (sqlite3_int64)max_rowid);
+            sqlite3_bind_int(vm_update, 4, kept);
+            sqlite3_bind_blob64(vm_update, 5, chunk, (sqlite3_uint64)chunk_size, SQLITE_STATIC);
+        }
+        rc = sqlite3_step(target);
+        sqlite3_reset(target);
+        if (chunk != buffer) sqlite3_free(chunk);
+        chunk = NULL;
+        if (rc != SQLITE_DONE) goto cleanup;
+        rc = SQLITE_OK;
+    }
+    
+cleanup:
+    if (chunk && chunk != buffer) sqlite3_free(chunk);
+    if (buffer) sqlite3_free(buffer);
+    if (chunks) sqlite3_free(chunks);
+    if (vm) sqlite3_finalize(vm);
+    if (vm_read) sqlite3_finalize(vm_read);
+    if (vm_update) sqlite3_finalize(vm_update);
+    if (vm_delete) sqlite3_finalize(vm_delete);
+    return rc;
+}
+
+static int vector_compact_deltas (sqlite3 *db, table_context *t_ctx, size_t stride, uint32_t max_vectors, int64_t *merged) {
+    // moves the delta records into regular chunks of their base list
+    const char *table_name = t_ctx->t_name;
+    const char *column_name = t_ctx->c_name;
+    sqlite3_stmt *vm = NULL;
+    uint8_t *records = NULL;
+    int *lists = NULL;
+    int64_t count = 0, capacity = 0;
+    char sql[STATIC_SQL_SIZE];
+    
+    // deltas are read in memory first: they are deleted before being rewritten as base chunks
+    generate_select_all_deltas(table_name, column_name, sql);
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    while (1) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;}
+        if (rc != SQLITE_ROW) goto cleanup;
+        
+        int counter = sqlite3_column_int(vm, 0);
+        const uint8_t *data = (const uint8_t *)sqlite3_column_blob(vm, 1);
+        int list = VECTOR_DELTA_LIST - 1 - sqlite3_column_int(vm, 2);
+        if ((size_t)sqlite3_column_bytes(vm, 1) < vector_chunk_bytes(t_ctx->chunk_format, counter, stride - sizeof(int64_t))) {rc = SQLITE_CORRUPT; goto cleanup;}
+        if (count + counter > capacity) {
+            int64_t n = (capacity) ? capacity * 2 : 64;
+            while (n < count + counter) n *= 2;
+            uint8_t *p = (uint8_t *)sqlite3_realloc64(records, (sqlite3_uint64)n * stride);
+            if (!p) {rc = SQLITE_NOMEM; goto cleanup;}
+            records = p;
+            int *l = (int *)sqlite3_realloc64(lists, (sqlite3_uint64)n * sizeof(int));
+            if (!l) {rc = SQLITE_NOMEM; goto cleanup;}
+            lists = l;
+            capacity = n;
+        }
+        vector_records r = vector_chunk_records(t_ctx->chunk_format, data, counter, stride - sizeof(int64_t));
+        vector_records_interleave(&r, records + (size_t)count * stride);
+        for (int j=0; j<counter; ++j) lists[count + j] = list;
+        count += counter;
+    }
+    sqlite3_finalize(vm);
+    vm = NULL;
+    if (count == 0) goto cleanup;
+    
+    generate_delete_all_deltas(table_name, column_name, sql);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    // records are grouped by list and sorted by rowid: a chunk never spans two posting lists
+    int64_t start = 0;
+    for (int64_t i=0; i<count; ++i) {
+        int64_t n = i + 1 - start;
+        bool last_of_list = (i + 1 == count) || (lists[i + 1] != lists[i]);
+        if (n < max_vectors && !last_of_list) continue;
+        
+        uint8_t *first = records + (size_t)start * stride;
+        int64_t min_rowid = INT64_FROM_INT8PTR(first);
+        int64_t max_rowid = INT64_FROM_INT8PTR(records + (size_t)i * stride);
+        rc = vector_serialize_quantization(db, table_name, column_name, t_ctx->chunk_format, (uint32_t)n, first, (ptrdiff_t)(n * stride), min_rowid, max_rowid, lists[i]);
+        if (rc != SQLITE_OK) goto cleanup;
+        start = i + 1;
+    }
+    
+cleanup:
+    if (rc == SQLITE_OK && merged) *merged = count;
+    if (records) sqlite3_free(records);
+    if (lists) sqlite3_free(lists);
+    if (vm) sqlite3_finalize(vm);
+    return rc;
+}
+
+static void vector_quantize_compact (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_quantize_compact", argc, argv, 2, types) == false) return;
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    
+    vector_context *v_ctx = (vector_context *)sqlite3_user_data(context);
+    table_context *t_ctx = vector_context_lookup(v_ctx, table_name, column_name);
+    if (!t_ctx) {
+        context_result_error(context, SQLITE_ERROR, "Vector context not found for table '%s' and column '%s'. Ensure that vector_init() has been called before using vector_quantize_compact()", table_name, column_name);
+        return;
+    }
+    
+    char sql[STATIC_SQL_SIZE];
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    generate_quant_table_name(table_name, column_name, sql);
+    if (!sqlite_table_exists(db, sql)) {
+        context_result_error(context, SQLITE_ERROR, "Quantization table not found for table '%s' and column '%s'. Ensure that vector_quantize() has been called before using vector_quantize_compact()", table_name, column_name);
+        return;
+    }
+    
+    size_t stride = sizeof(int64_t) + quant_code_bytes(t_ctx);
+    uint64_t max_memory = (t_ctx->options.max_memory > 0) ? t_ctx->options.max_memory : DEFAULT_MAX_MEMORY;
+    uint32_t max_vectors = (uint32_t)(max_memory / (uint64_t)stride);
+    if (max_vectors == 0) max_vectors = 1;
+    
+    int64_t merged = 0;
+    vector_tombstones dead = {0};
+    bool savepoint_open = false;
+    int rc = sqlite3_exec(db, "SAVEPOINT compact;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto compact_cleanup;
+    savepoint_open = true;
+    
+    // STEP 1: drop the superseded records from the base chunks
+    rc = vector_tombstones_load(db, table_name, column_name, &dead);
+    if (rc != SQLITE_OK) goto compact_cleanup;
+    if (dead.count > 0) {
+        rc = vector_compact_base(db, t_ctx, &dead, stride);
+        if (rc != SQLITE_OK) goto compact_cleanup;
+        
+        generate_clear_tombstones(table_name, column_name, sql);
+        rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+        if (rc != SQLITE_OK) goto compact_cleanup;
+    }
+    
+    // STEP 2: move the delta records into the base chunks
+    rc = vector_compact_deltas(db, t_ctx, stride, max_vectors, &merged);
+    if (rc != SQLITE_OK) goto compact_cleanup;
+    
+    bool changed = (dead.count > 0 || merged > 0);
+    if (changed) {
+        rc = vector_generation_next(context, t_ctx);
+        if (rc != SQLITE_OK) goto compact_cleanup;
+    }
+    
+    rc = sqlite3_exec(db, "RELEASE compact;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto compact_cleanup;
+    savepoint_open = false;
+    vector_tombstones_free(&dead);
+    
+    // success: returns the number of merged delta records (the preloaded records, if any connection uses them, are republished)
+    sqlite3_result_int64(context, (sqlite3_int64)merged);
+    if (changed && (t_ctx->preload || vector_preload_exists(t_ctx->preload_key))) vector_quantize_preload(context, 2, argv);
+    return;
+    
+compact_cleanup: {
+        const char *errmsg = sqlite3_errmsg(db);
+        if (savepoint_open) {
+            sqlite3_exec(db, "ROLLBACK TO compact;", NULL, NULL, NULL);
+            sqlite3_exec(db, "RELEASE compact;", NULL, NULL, NULL);
+        }
+        vector_tombstones_free(&dead);
+        
+        sqlite3_result_error(context, errmsg, -1);
+        sqlite3_result_error_code(context, rc);
+    }
+}
+
+// MARK: -
+
+static int vector_quantize (sqlite3_context *context, const char *table_name, const char *column_name, const char *arg_options, bool *was_preloaded) {
+    table_context *t_ctx = vector_context_lookup((vector_context *)sqlite3_user_data(context), table_name, column_name);
+    if (!t_ctx) {
+        context_result_error(context, SQLITE_ERROR, "Vector context not found for table '%s' and column '%s'. Ensure that vector_init() has been called before using vector_quantize()", table_name, column_name);
+        return SQLITE_ERROR;
+    }
+    
+    uint32_t counter = 0;
+    int rc = SQLITE_ERROR;
+    char sql[STATIC_SQL_SIZE];
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    
+    // parse options first so that the callback error message is not replaced by a generic one
+    vector_options options = t_ctx->options; // t_ctx guarantees to exist
+    bool res = parse_keyvalue_string(context, arg_options, vector_keyvalue_callback, &options);
+    if (res == false) return SQLITE_ERROR;
+    
+    // IVF centroids and PQ codebooks are trained in float32 space
+    bool is_binary = (t_ctx->options.v_type == VECTOR_TYPE_BIT || t_ctx->options.v_distance == VECTOR_DISTANCE_HAMMING);
+    if (options.index == VECTOR_INDEX_IVF && is_binary) {
+        context_result_error(context, SQLITE_ERROR, "IVF index is not supported for BIT vectors or HAMMING distance");
+        return SQLITE_ERROR;
+    }
+    if (options.calibration == VECTOR_CALIBRATION_DIMENSION && is_binary) {
+        context_result_error(context, SQLITE_ERROR, "Per-dimension calibration is not supported for BIT vectors or HAMMING distance");
+        return SQLITE_ERROR;
+    }
+    if (options.q_type == VECTOR_QUANT_PQ) {
+        int dim = t_ctx->options.v_dim;
+        if (is_binary) {
+            context_result_error(context, SQLITE_ERROR, "PQ quantization is not supported for BIT vectors or HAMMING distance");
+            return SQLITE_ERROR;
+        }
+        if (options.pq_m > 0 && (options.pq_m > dim || dim % options.pq_m != 0)) {
+            context_result_error(context, SQLITE_ERROR, "Invalid pq_m for PQ quantization: %d does not divide the vector dimension %d", options.pq_m, dim);
+            return SQLITE_ERROR;
+        }
+    }
+    
+    // the auto_update triggers call vector_quantize_delta, which SQLite refuses to run from an untrusted schema:
+    // every later write to the table would fail with "unsafe use of vector_quantize_delta()"
+    if (options.auto_update && !sqlite_trusted_schema(db)) {
+        context_result_error(context, SQLITE_ERROR, "auto_update=1 requires PRAGMA trusted_schema=ON: its triggers call vector_quantize_delta(), which SQLite does not run from an untrusted schema. Use auto_update=0 and call vector_quantize_compact() or vector_quantize() after writes instead");
+        return SQLITE_ERROR;
+    }
+    
+    bool savepoint_open = false;
+    rc = sqlite3_exec(db, "SAVEPOINT quantize;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    savepoint_open = true;
+    
+    generate_drop_quant_table(table_name, column_name, sql);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    
+    generate_create_quant_table(table_name, column_name, sql);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    
+    sqlite3_mutex_enter(qmutex);
+    rc = vector_rebuild_quantization(context, table_name, column_name, t_ctx, &options, &counter);
+    if (rc == SQLITE_OK && options.nprobe > 0) t_ctx->options.nprobe = options.nprobe;
+    sqlite3_mutex_leave(qmutex);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    
+    // serialize quantization options
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_QUANTTYPE, t_ctx->options.q_type, 0, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_FLOAT, OPTION_KEY_QUANTSCALE, 0, t_ctx->scale, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_FLOAT, OPTION_KEY_QUANTOFFSET, 0, t_ctx->offset, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_NLIST, t_ctx->ivf_nlist, 0, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    if (t_ctx->ivf_centroids) {
+        int64_t centroids_bytes = (int64_t)t_ctx->ivf_nlist * t_ctx->options.v_dim * (int64_t)sizeof(float);
+        rc = sqlite_serialize(context, table_name, column_name, SQLITE_BLOB, OPTION_KEY_IVFCENTROIDS, centroids_bytes, 0, t_ctx->ivf_centroids);
+        if (rc != SQLITE_OK) goto quantize_cleanup;
+    }
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_PQM, t_ctx->pq.m, 0, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_PQNBITS, t_ctx->pq.nbits, 0, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    if (t_ctx->pq.codebooks) {
+        int64_t codebooks_bytes = (int64_t)t_ctx->options.v_dim * (1 << t_ctx->pq.nbits) * (int64_t)sizeof(float);
+        rc = sqlite_serialize(context, table_name, column_name, SQLITE_BLOB, OPTION_KEY_PQCODEBOOKS, codebooks_bytes, 0, t_ctx->pq.codebooks);
+        if (rc != SQLITE_OK) goto quantize_cleanup;
+    }
+    // always written: a NULL value drops the calibration of a previous per-dimension quantization
+    int64_t qcalib_bytes = (t_ctx->qcalib) ? (int64_t)t_ctx->options.v_dim * 2 * (int64_t)sizeof(float) : 0;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_BLOB, OPTION_KEY_QUANTCALIBRATION, qcalib_bytes, 0, t_ctx->qcalib);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_CHUNKFORMAT, t_ctx->chunk_format, 0, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_CASCADE, (t_ctx->binary_level) ? t_ctx->options.cascade : 0, 0, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    
+    // auto update: a fresh quantization starts without deltas and tombstones
+    generate_drop_triggers(table_name, column_name, sql);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    generate_drop_tombstone_table(table_name, column_name, sql);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    if (options.auto_update) {
+        generate_create_tombstone_table(table_name, column_name, sql);
+        rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+        if (rc != SQLITE_OK) goto quantize_cleanup;
+        generate_create_triggers(table_name, column_name, t_ctx->pk_name, sql);
+        rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+        if (rc != SQLITE_OK) goto quantize_cleanup;
+    }
+    t_ctx->options.auto_update = options.auto_update;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_AUTOUPDATE, t_ctx->options.auto_update, 0, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    rc = vector_generation_next(context, t_ctx);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    
+    rc = sqlite3_exec(db, "RELEASE quantize;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto quantize_cleanup;
+    savepoint_open = false;
+    
+    // success: returns the total number of quantized rows
+    sqlite3_result_int64(context, (sqlite3_int64)counter);
+    if (was_preloaded) *was_preloaded = (t_ctx->preload != NULL) || vector_preload_exists(t_ctx->preload_key);
+    return SQLITE_OK;
+    
+quantize_cleanup: {
+        const char *errmsg = sqlite3_errmsg(db);
+        if (savepoint_open) {
+            sqlite3_exec(db, "ROLLBACK TO quantize;", NULL, NULL, NULL);
+            sqlite3_exec(db, "RELEASE quantize;", NULL, NULL, NULL);
+        }
+        
+        sqlite3_result_error(context, errmsg, -1);
+        sqlite3_result_error_code(context, rc);
+        return rc;
+    }
+}
+
+static void vector_quantize3 (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_quantize", argc, argv, 3, types) == false) return;
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    const char *options = (const char *)sqlite3_value_text(argv[2]);
+    
+    bool was_preloaded = false;
+    int rc = vector_quantize(context, table_name, column_name, options, &was_preloaded);
+    if ((rc == SQLITE_OK) && (was_preloaded)) vector_quantize_preload(context, 2, argv);
+}
+
+static void vector_quantize2 (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_quantize", argc, argv, 2, types) == false) return;
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    
+    bool was_preloaded = false;
+    int rc = vector_quantize(context, table_name, column_name, NULL, &was_preloaded);
+    if ((rc == SQLITE_OK) && (was_preloaded)) vector_quantize_preload(context, argc, argv);
+}
+
+static void vector_quantize_memory (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_quantize_memory", argc, argv, 2, types) == false) return;
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    
+    char sql[STATIC_SQL_SIZE];
+    generate_memory_quant_table(table_name, column_name, sql);
+    
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    sqlite3_int64 memory = sqlite_read_int64(db, sql);
+    sqlite3_result_int64(context, memory);
+}
+
+static void vector_quantize_cleanup (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_quantize_cleanup", argc, argv, 2, types) == false) return;
+
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+
+    vector_context *v_ctx = (vector_context *)sqlite3_user_data(context);
+    table_context *t_ctx = vector_context_lookup(v_ctx, table_name, column_name);
+    if (!t_ctx) return; // if no table context exists then do nothing
+
+    // release any memory used in quantization
+    vector_preload_unpublish(t_ctx->preload_key);
+    vector_preload_attach(t_ctx, NULL);
+    sqlite3_mutex_enter(qmutex);
+    if (t_ctx->ivf_centroids) {
+        sqlite3_free(t_ctx->ivf_centroids);
+        t_ctx->ivf_centroids = NULL;
+        t_ctx->ivf_nlist = 0;
+    }
+    sqlite3_mutex_leave(qmutex);
+
+    // drop quant table, auto update triggers and tombstones (if any)
+    char sql[STATIC_SQL_SIZE];
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    generate_drop_quant_table(table_name, column_name, sql);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+    generate_drop_triggers(table_name, column_name, sql);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+    generate_drop_tombstone_table(table_name, column_name, sql);
+    sqlite3_exec(db, sql, NULL, NULL, NULL);
+    t_ctx->options.auto_update = false;
+    
+    // remove the preload sidecar file (if any)
+    char *path = vector_sidecar_path(db, table_name, column_name);
+    vector_sidecar_remove(path);
+    if (path) sqlite3_free(path);
+}
+
+// MARK: - HNSW -
+
+// min-heap of (distance, id) pairs used as the candidate queue of the graph searches
+typedef struct {
+    double              *distance;
+    int64_t             *ids;
+    int                 count;
+    int                 capacity;
+} hnsw_queue;
+
+// open addressing set of visited rowids (layer 0 search runs on rowids read from disk)
+typedef struct {
+    int64_t             *keys;
+    uint8_t             *used;
+    int                 count;
+    int                 capacity;           // always a power of two
+} hnsw_visited;
+
+// in-memory graph: the whole graph while building, only the nodes with level > 0 at query time
+struct hnsw_graph {
+    int                 count;              // number of nodes
+    int                 m;                  // max links on layers >= 1 (2*m on layer 0)
+    size_t              vbytes;             // bytes of a stored vector
+    int                 dist_n;             // element count passed to distance_fn
+    distance_function_t distance_fn;
+    int64_t             *rowids;            // node rowids in ascending order
+    int                 *levels;            // top layer of each node
+    uint8_t             *vectors;           // count x vbytes original vectors
+    int                 **links;            // per node: [n, 2*m slots] for layer 0, then [n, m slots] for each upper layer
+    int                 entry;              // entry point node index
+    int                 max_level;          // level of the entry point
+};
+
+static bool hnsw_queue_push (hnsw_queue *q, double distance, int64_t id) {
+    if (q->count == q->capacity) {
+        int capacity = (q->capacity > 0) ? q->capacity * 2 : 64;
+        double *d = (double *)sqlite3_realloc64(q->distance, (sqlite3_uint64)capacity * sizeof(double));
+        if (!d) return false;
+        q->distance = d;
+        int64_t *ids = (int64_t *)sqlite3_realloc64(q->ids, (sqlite3_uint64)capacity * sizeof(int64_t));
+        if (!ids) return false;
+        q->ids = ids;
+        q->capacity = capacity;
+    }
+    
+    int i = q->count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (q->distance[parent] <= distance) break;
+        q->distance[i] = q->distance[parent];
+        q->ids[i] = q->ids[parent];
+        i = parent;
+    }
+    q->distance[i] = distance;
+    q->ids[i] = id;
+    return true;
+}
+
+static void hnsw_queue_pop (hnsw_queue *q, double *distance, int64_t *id) {
+    *distance = q->distance[0];
+    *id = q->ids[0];
+    
+    int n = --q->count;
+    if (n == 0) return;
+    
+    double d = q->distance[n];
+    int64_t r = q->ids[n];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= n) break;
+        if ((child + 1 < n) && (q->distance[child + 1] < q->distance[child])) ++child;
+        if (q->distance[child] >= d) break;
+        q->distance[i] = q->distance[child];
+        q->ids[i] = q->ids[child];
+        i = child;
+    }
+    q->distance[i] = d;
+    q->ids[i] = r;
+}
+
+static void hnsw_queue_free (hnsw_queue *q) {
+    if (q->distance) sqlite3_free(q->distance);
+    if (q->ids) sqlite3_free(q->ids);
+    memset(q, 0, sizeof(hnsw_queue));
+}
+
+static inline uint64_t hnsw_hash (int64_t key) {
+    // splitmix64 finalizer
+    uint64_t x = (uint64_t)key;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static int hnsw_visited_insert (hnsw_visited *v, int64_t key) {
+    // returns 1 if key was added, 0 if it was already present, -1 on out of memory
+    if ((v->count + 1) * 2 > v->capacity) {
+        int capacity = (v->capacity > 0) ? v->capacity * 2 : 1024;
+        int64_t *keys = (int64_t *)sqlite3_malloc64((sqlite3_uint64)capacity * sizeof(int64_t));
+        uint8_t *used = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)capacity);
+        if (!keys || !used) {
+            if (keys) sqlite3_free(keys);
+            if (used) sqlite3_free(used);
+            return -1;
+        }
+        memset(used, 0, (size_t)capacity);
+        for (int i=0; i<v->capacity; ++i) {
+            if (!v->used[i]) continue;
+            uint64_t j = hnsw_hash(v->keys[i]) & (uint64_t)(capacity - 1);
+            while (used[j]) j = (j + 1) & (uint64_t)(capacity - 1);
+            used[j] = 1;
+            keys[j] = v->keys[i];
+        }
+        if (v->keys) sqlite3_free(v->keys);
+        if (v->used) sqlite3_free(v->used);
+        v->keys = keys;
+        v->used = used;
+        v->capacity = capacity;
+    }
+    
+    uint64_t mask = (uint64_t)(v->capacity - 1);
+    uint64_t j = hnsw_hash(key) & mask;
+    while (v->used[j]) {
+        if (v->keys[j] == key) return 0;
+        j = (j + 1) & mask;
+    }
+    v->used[j] = 1;
+    v->keys[j] = key;
+    v->count++;
+    return 1;
+}
+
+static void hnsw_visited_free (hnsw_visited *v) {
+    if (v->keys) sqlite3_free(v->keys);
+    if (v->used) sqlite3_free(v->used);
+    memset(v, 0, sizeof(hnsw_visited));
+}
+
+static inline int *hnsw_links (const hnsw_graph *g, int node, int level) {
+    int *links = g->links[node];
+    return (level == 0) ? links : links + (2 * g->m + 1) + (level - 1) * (g->m + 1);
+}
+
+static inline int hnsw_capacity (const hnsw_graph *g, int level) {
+    return (level == 0) ? 2 * g->m : g->m;
+}
+
+static inline double hnsw_distance (const hnsw_graph *g, const void *v, int node) {
+    float distance = g->distance_fn(v, (const void *)(g->vectors + (size_t)node * g->vbytes), g->dist_n);
+    return (isnan(distance)) ? FLT_MAX : distance;
+}
+
+static void hnsw_graph_free (hnsw_graph *g) {
+    if (!g) return;
+    if (g->links) {
+        for (int i=0; i<g->count; ++i) if (g->links[i]) sqlite3_free(g->links[i]);
+        sqlite3_free(g->links);
+    }
+    if (g->rowids) sqlite3_free(g->rowids);
+    if (g->levels) sqlite3_free(g->levels);
+    if (g->vectors) sqlite3_free(g->vectors);
+    sqlite3_free(g);
+}
+
+static hnsw_graph *hnsw_graph_create (int count, int m, const vector_options *options) {
+    hnsw_graph *g = (hnsw_graph *)sqlite3_malloc(sizeof(hnsw_graph));
+    if (!g) return NULL;
+    memset(g, 0, sizeof(hnsw_graph));
+    
+    // BIT vectors are always compared with the Hamming distance over their packed bytes
+    vector_type type = options->v_type;
+    int dim = options->v_dim;
+    g->count = count;
+    g->m = m;
+    g->vbytes = vector_bytes_for_dim(type, dim);
+    g->dist_n = (type == VECTOR_TYPE_BIT) ? (int)g->vbytes : dim;
+    g->distance_fn = vector_distance_function(options, type);
+    g->entry = -1;
+    
+    size_t n = (count > 0) ? (size_t)count : 1;
+    g->rowids = (int64_t *)sqlite3_malloc64(n * sizeof(int64_t));
+    g->levels = (int *)sqlite3_malloc64(n * sizeof(int));
+    g->vectors = (uint8_t *)sqlite3_malloc64(n * g->vbytes);
+    g->links = (int **)sqlite3_malloc64(n * sizeof(int *));
+    if (!g->rowids || !g->levels || !g->vectors || !g->links) {
+        if (g->links) {sqlite3_free(g->links); g->links = NULL;}
+        hnsw_graph_free(g);
+        return NULL;
+    }
+    memset(g->links, 0, n * sizeof(int *));
+    return g;
+}
+
+static bool hnsw_graph_alloc_links (hnsw_graph *g, int node, int level) {
+    size_t n = (size_t)(2 * g->m + 1) + (size_t)level * (size_t)(g->m + 1);
+    g->links[node] = (int *)sqlite3_malloc64(n * sizeof(int));
+    if (!g->links[node]) return false;
+    memset(g->links[node], 0, n * sizeof(int));
+    g->levels[node] = level;
+    return true;
+}
+
+static int hnsw_graph_find (const hnsw_graph *g, int64_t rowid) {
+    int lo = 0, hi = g->count - 1;
+    while (lo <= hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (g->rowids[mid] == rowid) return mid;
+        if (g->rowids[mid] < rowid) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1;
+}
+
+static int hnsw_random_level (uint64_t *seed, int m) {
+    // exponentially decaying level distribution with normalization factor 1/ln(M)
+    double u = ((double)vector_random(seed) + 1.0) / 2147483649.0;
+    int level = (int)(-log(u) / log((double)m));
+    return (level > MAX_HNSW_LEVEL) ? MAX_HNSW_LEVEL : level;
+}
+
+static int hnsw_greedy_search (const hnsw_graph *g, const void *v, int node, double *distance, int level) {
+    // ef = 1 descent used on the upper layers
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        const int *links = hnsw_links(g, node, level);
+        for (int i=0; i<links[0]; ++i) {
+            int nb = links[i + 1];
+            double d = hnsw_distance(g, v, nb);
+            if (d < *distance) {
+                *distance = d;
+                node = nb;
+                changed = true;
+            }
+        }
+    }
+    return node;
+}
+
+static int hnsw_search_layer (const hnsw_graph *g, const void *v, int entry, double entry_distance, int level, uint32_t *visited, uint32_t tag, hnsw_queue *candidates, vector_topk *result) {
+    // beam search: on return result holds the ef closest nodes found (ids are node indexes)
+    candidates->count = 0;
+    vector_topk_reset(result);
+    
+    visited[entry] = tag;
+    vector_topk_push(result, entry_distance, entry);
+    if (!hnsw_queue_push(candidates, entry_distance, entry)) return SQLITE_NOMEM;
+    
+    while (candidates->count > 0) {
+        double d;
+        int64_t node;
+        hnsw_queue_pop(candidates, &d, &node);
+        if (d > vector_topk_threshold(result)) break;
+        
+        const int *links = hnsw_links(g, (int)node, level);
+        for (int i=0; i<links[0]; ++i) {
+            int nb = links[i + 1];
+            if (visited[nb] == tag) continue;
+            visited[nb] = tag;
+            
+            double dn = hnsw_distance(g, v, nb);
+            if (vector_topk_push(result, dn, nb) && !hnsw_queue_push(candidates, dn, nb)) return SQLITE_NOMEM;
+        }
+    }
+    return SQLITE_OK;
+}
+
+static int hnsw_select_neighbors (const hnsw_graph *g, const int64_t *ids, const double *distance, int count, int m, int *out) {
+    // heuristic from the HNSW paper: keep a candidate only if it is closer to the base node than
+    // to every neighbor already selected, which spreads links in different directions
+    int n = 0;
+    for (int i=0; i<count && n<m; ++i) {
+        int e = (int)ids[i];
+        const void *ve = (const void *)(g->vectors + (size_t)e * g->vbytes);
+        bool good = true;
+        for (int j=0; j<n; ++j) {
+            double d = hnsw_distance(g, ve, out[j]);
+            if (d < distance[i]) {good = false; break;}
+        }
+        if (good) out[n++] = e;
+    }
+    return n;
+}
+
+static void hnsw_add_link (hnsw_graph *g, int node, int level, int nb, vector_topk *scratch) {
+    int *links = hnsw_links(g, node, level);
+    int capacity = hnsw_capacity(g, level);
+    if (links[0] < capacity) {
+        links[++links[0]] = nb;
+        return;
+    }
+    
+    // list is full: re-select among the current links plus the new one
+    const void *v = (const void *)(g->vectors + (size_t)node * g->vbytes);
+    vector_topk_reset(scratch);
+    for (int i=0; i<links[0]; ++i) vector_topk_push(scratch, hnsw_distance(g, v, links[i + 1]), links[i + 1]);
+    vector_topk_push(scratch, hnsw_distance(g, v, nb), nb);
+    int count = vector_topk_sort(scratch);
+    links[0] = hnsw_select_neighbors(g, scratch->rowids, scratch->distance, count, capacity, links + 1);
+}
+
+static int hnsw_graph_build (hnsw_graph *g, int ef_construction) {
+    int rc = SQLITE_NOMEM;
+    hnsw_queue candidates = {0};
+    uint32_t *visited = (uint32_t *)sqlite3_malloc64((sqlite3_uint64)g->count * sizeof(uint32_t));
+    double *wdistance = (double *)sqlite3_malloc64((sqlite3_uint64)ef_construction * sizeof(double));
+    int64_t *wids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)ef_construction * sizeof(int64_t));
+    double *sdistance = (double *)sqlite3_malloc64((sqlite3_uint64)(2 * g->m + 1) * sizeof(double));
+    int64_t *sids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)(2 * g->m + 1) * sizeof(int64_t));
+    if (!visited || !wdistance || !wids || !sdistance || !sids) goto hnsw_graph_build_cleanup;
+    memset(visited, 0, (size_t)g->count * sizeof(uint32_t));
+    
+    vector_topk result, scratch;
+    vector_topk_init(&result, wdistance, wids, ef_construction);
+    vector_topk_init(&scratch, sdistance, sids, 2 * g->m + 1);
+    
+    uint32_t tag = 0;
+    for (int i=0; i<g->count; ++i) {
+        int level = g->levels[i];
+        const void *v = (const void *)(g->vectors + (size_t)i * g->vbytes);
+        
+        if (g->entry < 0) {
+            g->entry = i;
+            g->max_level = level;
+            continue;
+        }
+        
+        int node = g->entry;
+        double distance = hnsw_distance(g, v, node);
+        for (int l = g->max_level; l > level; --l) node = hnsw_greedy_search(g, v, node, &distance, l);
+        
+        for (int l = (level < g->max_level) ? level : g->max_level; l >= 0; --l) {
+            rc = hnsw_search_layer(g, v, node, distance, l, visited, ++tag, &candidates, &result);
+            if (rc != SQLITE_OK) goto hnsw_graph_build_cleanup;
+            int count = vector_topk_sort(&result);
+            
+            int *links = hnsw_links(g, i, l);
+            links[0] = hnsw_select_neighbors(g, result.rowids, result.distance, count, g->m, links + 1);
+            for (int j=0; j<links[0]; ++j) hnsw_add_link(g, links[j + 1], l, i, &scratch);
+            
+            // closest node found is the entry point of the next layer
+            node = (int)result.rowids[0];
+            distance = result.distance[0];
+        }
+        
+        if (level > g->max_level) {
+            g->entry = i;
+            g->max_level = level;
+        }
+    }
+    rc = SQLITE_OK;
+    
+hnsw_graph_build_cleanup:
+    hnsw_queue_free(&candidates);
+    if (visited) sqlite3_free(visited);
+    if (wdistance) sqlite3_free(wdistance);
+    if (wids) sqlite3_free(wids);
+    if (sdistance) sqlite3_free(sdistance);
+    if (sids) sqlite3_free(sids);
+    return rc;
+}
+
+static int hnsw_graph_serialize (sqlite3 *db, const hnsw_graph *g, const char *table_name, const char *column_name) {
+    // each node row stores, for every layer 0..level, the links count followed by the linked rowids
+    char sql[STATIC_SQL_SIZE];
+    generate_insert_hnsw_table(table_name, column_name, sql);
+    sqlite3_stmt *vm = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) return rc;
+    
+    size_t max_size = ((size_t)(2 * g->m + 1) + (size_t)MAX_HNSW_LEVEL * (size_t)(g->m + 1)) * sizeof(int64_t);
+    uint8_t *blob = (uint8_t *)sqlite3_malloc64(max_size);
+    if (!blob) {sqlite3_finalize(vm); return SQLITE_NOMEM;}
+    
+    for (int i=0; i<g->count; ++i) {
+        uint8_t *p = blob;
+        for (int l=0; l<=g->levels[i]; ++l) {
+            const int *links = hnsw_links(g, i, l);
+            int64_t n = links[0];
+            INT64_TO_INT8PTR(n, p);
+            p += sizeof(int64_t);
+            for (int j=0; j<links[0]; ++j) {
+                int64_t rowid = g->rowids[links[j + 1]];
+                INT64_TO_INT8PTR(rowid, p);
+                p += sizeof(int64_t);
+            }
+        }
+        
+        sqlite3_bind_int64(vm, 1, (sqlite3_int64)g->rowids[i]);
+        sqlite3_bind_int(vm, 2, g->levels[i]);
+        sqlite3_bind_blob(vm, 3, (const void *)blob, (int)(p - blob), SQLITE_STATIC);
+        rc = sqlite3_step(vm);
+        if (rc != SQLITE_DONE) break;
+        rc = SQLITE_OK;
+        sqlite3_reset(vm);
+    }
+    
+    sqlite3_free(blob);
+    sqlite3_finalize(vm);
+    return rc;
+}
+
+static int hnsw_graph_load_upper (sqlite3 *db, table_context *t_ctx, hnsw_graph **result) {
+    // load every node with level > 0 (about count/M nodes) together with its original vector
+    *result = NULL;
+    char sql[STATIC_SQL_SIZE];
+    sqlite3_snprintf(sizeof(sql), sql, "SELECT COUNT(*) FROM vector1_%q_%q WHERE level > 0;", t_ctx->t_name, t_ctx->c_name);
+    int64_t count = sqlite_read_int64(db, sql);
+    if (count <= 0) return SQLITE_OK;
+    
+    int m = (t_ctx->hnsw_m > 0) ? t_ctx->hnsw_m : DEFAULT_HNSW_M;
+    hnsw_graph *g = hnsw_graph_create((int)count, m, &t_ctx->options);
+    if (!g) return SQLITE_NOMEM;
+    
+    sqlite3_stmt *vm = NULL;
+    sqlite3_stmt *vm2 = NULL;
+    uint8_t **blobs = (uint8_t **)sqlite3_malloc64((sqlite3_uint64)count * sizeof(uint8_t *));
+    int *blob_sizes = (int *)sqlite3_malloc64((sqlite3_uint64)count * sizeof(int));
+    int rc = SQLITE_NOMEM;
+    int n = 0;
+    if (!blobs || !blob_sizes) goto hnsw_load_cleanup;
+    memset(blobs, 0, (size_t)count * sizeof(uint8_t *));
+    
+    sqlite3_snprintf(sizeof(sql), sql, "SELECT id, level, neighbors FROM vector1_%q_%q WHERE level > 0 ORDER BY id;", t_ctx->t_name, t_ctx->c_name);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto hnsw_load_cleanup;
+    
+    sqlite3_snprintf(sizeof(sql), sql, "SELECT %q FROM %q WHERE %q = ?;", t_ctx->c_name, t_ctx->t_name, t_ctx->pk_name);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm2, NULL);
+    if (rc != SQLITE_OK) goto hnsw_load_cleanup;
+    
+    while (n < count) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) break;
+        if (rc != SQLITE_ROW) goto hnsw_load_cleanup;
+        
+        int level = sqlite3_column_int(vm, 1);
+        if (level > MAX_HNSW_LEVEL) level = MAX_HNSW_LEVEL;
+        g->rowids[n] = (int64_t)sqlite3_column_int64(vm, 0);
+        blob_sizes[n] = sqlite3_column_bytes(vm, 2);
+        blobs[n] = (uint8_t *)sqlite_memdup(sqlite3_column_blob(vm, 2), blob_sizes[n]);
+        if (!blobs[n] || !hnsw_graph_alloc_links(g, n, level)) {rc = SQLITE_NOMEM; goto hnsw_load_cleanup;}
+        
+        // rows deleted after the build keep a zero vector so the graph stays navigable
+        uint8_t *v = g->vectors + (size_t)n * g->vbytes;
+        memset(v, 0, g->vbytes);
+        sqlite3_bind_int64(vm2, 1, (sqlite3_int64)g->rowids[n]);
+        if (sqlite3_step(vm2) == SQLITE_ROW) {
+            const void *blob = sqlite3_column_blob(vm2, 0);
+            if (blob && (size_t)sqlite3_column_bytes(vm2, 0) >= g->vbytes) memcpy(v, blob, g->vbytes);
+        }
+        sqlite3_reset(vm2);
+        ++n;
+    }
+    g->count = n;
+    
+    // convert upper layer rowids to node indexes (layer 0 links are read from disk at query time)
+    for (int i=0; i<n; ++i) {
+        const uint8_t *p = blobs[i];
+        const uint8_t *end = blobs[i] + blob_sizes[i];
+        for (int l=0; l<=g->levels[i] && p + sizeof(int64_t) <= end; ++l) {
+            int64_t nlinks = INT64_FROM_INT8PTR(p);
+            p += sizeof(int64_t);
+            if (nlinks < 0 || (size_t)(end - p) < (size_t)nlinks * sizeof(int64_t)) break;
+            if (l > 0) {
+                int *links = hnsw_links(g, i, l);
+                for (int64_t j=0; j<nlinks && links[0] < g->m; ++j) {
+                    int idx = hnsw_graph_find(g, INT64_FROM_INT8PTR(p + j * sizeof(int64_t)));
+                    if (idx >= 0) links[++links[0]] = idx;
+                }
+            }
+            p += (size_t)nlinks * sizeof(int64_t);
+        }
+    }
+    
+    g->entry = hnsw_graph_find(g, t_ctx->hnsw_entry);
+    g->max_level = (g->entry >= 0) ? g->levels[g->entry] : 0;
+    rc = (g->entry >= 0) ? SQLITE_OK : SQLITE_CORRUPT;
+    
+hnsw_load_cleanup:
+    if (vm) sqlite3_finalize(vm);
+    if (vm2) sqlite3_finalize(vm2);
+    if (blobs) {
+        for (int i=0; i<count; ++i) if (blobs[i]) sqlite3_free(blobs[i]);
+        sqlite3_free(blobs);
+    }
+    if (blob_sizes) sqlite3_free(blob_sizes);
+    if (rc == SQLITE_OK) *result = g;
+    else hnsw_graph_free(g);
+    return rc;
+}
+
+static int vector_hnsw_load (sqlite3_context *context, table_context *t_ctx, hnsw_graph **result, int m) {
+    // read every vector of the table in rowid order
+    *result = NULL;
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    char sql[STATIC_SQL_SIZE];
+    sqlite3_snprintf(sizeof(sql), sql, "SELECT COUNT(*) FROM %q WHERE %q IS NOT NULL;", t_ctx->t_name, t_ctx->c_name);
+    int64_t count = sqlite_read_int64(db, sql);
+    if (count < 0 || count > INT_MAX) {
+        context_result_error(context, SQLITE_ERROR, "Unable to count the vectors of table '%s'", t_ctx->t_name);
+        return SQLITE_ERROR;
+    }
+    
+    vector_options *options = &t_ctx->options;
+    hnsw_graph *g = hnsw_graph_create((int)count, m, options);
+    if (!g) {
+        context_result_error(context, SQLITE_NOMEM, "Out of memory: unable to allocate HNSW graph for %lld vectors", (long long)count);
+        return SQLITE_NOMEM;
+    }
+    
+    sqlite3_stmt *vm = NULL;
+    generate_select_from_table(t_ctx->t_name, t_ctx->c_name, t_ctx->pk_name, sql);
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto hnsw_load_all_cleanup;
+    
+    uint64_t seed = 0x4E5F3A1DULL;
+    int n = 0;
+    while (n < count) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;}
+        if (rc != SQLITE_ROW) goto hnsw_load_all_cleanup;
+        
+        const void *blob = sqlite3_column_blob(vm, 1);
+        if (!blob) continue;
+        if ((size_t)sqlite3_column_bytes(vm, 1) < g->vbytes) {
+            context_result_error(context, SQLITE_ERROR, "Invalid vector blob found at rowid %lld", (long long)sqlite3_column_int64(vm, 0));
+            rc = SQLITE_ERROR;
+            goto hnsw_load_all_cleanup;
+        }
+        
+        g->rowids[n] = (int64_t)sqlite3_column_int64(vm, 0);
+        memcpy(g->vectors + (size_t)n * g->vbytes, blob, g->vbytes);
+        if (!hnsw_graph_alloc_links(g, n, hnsw_random_level(&seed, m))) {rc = SQLITE_NOMEM; goto hnsw_load_all_cleanup;}
+        ++n;
+    }
+    g->count = n;
+    rc = SQLITE_OK;
+    
+hnsw_load_all_cleanup:
+    if (vm) sqlite3_finalize(vm);
+    if (rc == SQLITE_OK) *result = g;
+    else hnsw_graph_free(g);
+    return rc;
+}
+
+static void vector_hnsw_build (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_hnsw_build", argc, argv, argc, types) == false) return;
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    const char *arg_options = (argc == 3) ? (const char *)sqlite3_value_text(argv[2]) : NULL;
+    
+    table_context *t_ctx = vector_context_lookup((vector_context *)sqlite3_user_data(context), table_name, column_name);
+    if (!t_ctx) {
+        context_result_error(context, SQLITE_ERROR, "Vector context not found for table '%s' and column '%s'. Ensure that vector_init() has been called before using vector_hnsw_build()", table_name, column_name);
+        return;
+    }
+    
+    vector_options options = t_ctx->options;
+    if (parse_keyvalue_string(context, arg_options, vector_keyvalue_callback, &options) == false) return;
+    int m = (options.m > 0) ? options.m : DEFAULT_HNSW_M;
+    if (m < 2 || m > MAX_HNSW_M) {
+        context_result_error(context, SQLITE_ERROR, "Invalid M: expected an integer between 2 and %d, got %d", MAX_HNSW_M, m);
+        return;
+    }
+    int ef_construction = (options.ef_construction > 0) ? options.ef_construction : DEFAULT_HNSW_EF_CONSTRUCTION;
+    if (ef_construction < m) ef_construction = m;
+    
+    // build the whole graph in memory, then persist it
+    hnsw_graph *g = NULL;
+    int rc = vector_hnsw_load(context, t_ctx, &g, m);
+    if (rc != SQLITE_OK) return; // error already set
+    
+    rc = hnsw_graph_build(g, ef_construction);
+    if (rc != SQLITE_OK) {
+        hnsw_graph_free(g);
+        context_result_error(context, rc, "Out of memory while building the HNSW graph");
+        return;
+    }
+    
+    char sql[STATIC_SQL_SIZE];
+    sqlite3 *db = sqlite3_context_db_handle(context);
+    int64_t entry = (g->entry >= 0) ? g->rowids[g->entry] : 0;
+    bool savepoint_open = false;
+    rc = sqlite3_exec(db, "SAVEPOINT hnsw_build;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    savepoint_open = true;
+    
+    generate_drop_hnsw_table(table_name, column_name, sql);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    
+    generate_create_hnsw_table(table_name, column_name, sql);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    
+    rc = hnsw_graph_serialize(db, g, table_name, column_name);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_HNSWCOUNT, g->count, 0, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_HNSWENTRY, entry, 0, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_HNSWLEVEL, g->max_level, 0, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    rc = sqlite_serialize(context, table_name, column_name, SQLITE_INTEGER, OPTION_KEY_M, m, 0, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    
+    rc = sqlite3_exec(db, "RELEASE hnsw_build;", NULL, NULL, NULL);
+    if (rc != SQLITE_OK) goto hnsw_build_cleanup;
+    savepoint_open = false;
+    
+    // upper layers are reloaded on the next query
+    sqlite3_mutex_enter(qmutex);
+    hnsw_graph_free(t_ctx->hnsw);
+    t_ctx->hnsw = NULL;
+    t_ctx->hnsw_count = g->count;
+    t_ctx->hnsw_entry = entry;
+    t_ctx->hnsw_level = g->max_level;
+    t_ctx->hnsw_m = m;
+    if (options.ef_search > 0) t_ctx->options.ef_search = options.ef_search;
+    sqlite3_mutex_leave(qmutex);
+    
+    sqlite3_result_int64(context, (sqlite3_int64)g->count);
+    
+hnsw_build_cleanup:
+    if (rc != SQLITE_OK) {
+        const char *errmsg = sqlite3_errmsg(db);
+        sqlite3_result_error(context, errmsg, -1);
+        sqlite3_result_error_code(context, rc);
+        if (savepoint_open) {
+            sqlite3_exec(db, "ROLLBACK TO hnsw_build;", NULL, NULL, NULL);
+            sqlite3_exec(db, "RELEASE hnsw_build;", NULL, NULL, NULL);
+        }
+    }
+    hnsw_graph_free(g);
+}
+
+// MARK: -
+
+static void *vector_from_json (sqlite3_context *context, sqlite3_vtab *vtab, vector_type type, const char *json, int *size, int dimension) {
+    char *blob = NULL;
+    
+    // skip leading whitespace
+    SKIP_SPACES(json);
+    
+    // sanity check the JSON start array character
+    if (*json != '[') {
+        return sqlite_common_set_error(context, vtab, SQLITE_ERROR, "Malformed JSON: expected '[' at the beginning of the array");
+    }
+    json++;
+
+    
+    // count number of commas to estimate (over-estimate) the number of entries in the json
+    int estimated_count = 0;
+    for (const char *p = json; *p; ++p) {
+        if (*p == ',') estimated_count++;
+    }
+    
+    // allocate blob
+    // For BIT type, each JSON element is a single bit, pack 8 per byte
+    size_t item_size = vector_type_to_size(type);
+    size_t alloc = (type == VECTOR_TYPE_BIT) ? ((estimated_count + 1) + 7) / 8 : (estimated_count + 1) * item_size;
+    blob = sqlite3_malloc((int)alloc);
+    if (!blob) {
+        return sqlite_common_set_error(context, vtab, SQLITE_NOMEM, "Out of memory: unable to allocate %lld bytes for BLOB buffer", (long long)alloc);
+    }
+    if (type == VECTOR_TYPE_BIT) {
+        memset(blob, 0, alloc);  // Initialize to zero for bit packing
+    }
+
+    // typed pointers
+    float      *float_blob    = (float *)blob;
+    uint8_t    *uint8_blob    = (uint8_t *)blob;
+    int8_t     *int8_blob     = (int8_t *)blob;
+    uint16_t   *uint16_blob   = (uint16_t *)blob;
+    uint16_t   *bfloat16_blob = (uint16_t *)blob;
+    
+    int count = 0;
+    const char *p = json;
+    while (*p) {
+        // skip whitespace
+        SKIP_SPACES(p);
+        
+        // check for end-of-array character
+        if (*p == ']') break;
+        
+        // parse number
+        char *endptr;
+        double value = strtod(p, &endptr);
+        
+        // sanity check
+        if (p == endptr) {
+            // parsing failed
+            sqlite3_free(blob);
             return sqlite_common_set_error(context, vtab, SQLITE_ERROR, "Malformed JSON: expected a number at position %d (found '%c')", (int)(p - json) + 1, *p ? *p : '?');
         }
         
@@ -1882,34 +5175,392 @@ static void vector_as_f16 (sqlite3_context *context, int argc, sqlite3_value **a
     vector_as_type(context, VECTOR_TYPE_F16, argc, argv);
 }
 
-static void vector_as_bf16 (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    vector_as_type(context, VECTOR_TYPE_BF16, argc, argv);
+static void vector_as_bf16 (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    vector_as_type(context, VECTOR_TYPE_BF16, argc, argv);
+}
+
+static void vector_as_u8 (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    vector_as_type(context, VECTOR_TYPE_U8, argc, argv);
+}
+
+static void vector_as_i8 (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    vector_as_type(context, VECTOR_TYPE_I8, argc, argv);
+}
+
+static void vector_as_bit (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    vector_as_type(context, VECTOR_TYPE_BIT, argc, argv);
+}
+
+// MARK: - Modules -
+static int vFullScanCursorNext (sqlite3_vtab_cursor *cur);
+static int vStreamScanCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size);
+static int vStreamQuantCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size);
+
+static inline vector_stats *vCursorStats (vFullScanCursor *c) {
+    // counters of the current scan (NULL if not collected)
+    #if VECTOR_STATS
+    return (c->options.stats) ? &c->stats : NULL;
+    #else
+    return NULL;
+    #endif
+}
+
+static void vCursorStatsFlush (vFullScanCursor *c) {
+    // adds the counters of the last scan to the ones of its table
+    #if VECTOR_STATS
+    if (c->table) vector_stats_add(&c->table->stats, &c->stats);
+    memset(&c->stats, 0, sizeof(vector_stats));
+    #endif
+}
+
+static int vQuantScanPrepare (vFullScan *vtab, table_context *t_ctx, const char *fname, vector_tombstones *dead, vector_preload **preload) {
+    // common setup of the scans of the quantized records (the vtab error is set on failure)
+    const char *table_name = t_ctx->t_name;
+    const char *column_name = t_ctx->c_name;
+    char buffer[STATIC_SQL_SIZE];
+    char *name = generate_quant_table_name(table_name, column_name, buffer);
+    if (!name || !sqlite_table_exists(vtab->db, name)) {
+        return sqlite_vtab_set_error(&vtab->base, "Quantization table not found for table '%s' and column '%s'. Ensure that vector_quantize() has been called before using %s()", table_name, column_name, fname);
+    }
+    
+    // quantization parameters are reloaded if another connection rebuilt the quantization
+    int64_t generation = vector_generation_read(vtab->db, table_name, column_name);
+    if (generation != t_ctx->generation) sqlite_unserialize(vtab->db, t_ctx);
+    vector_preload_release(*preload);
+    *preload = NULL;
+    
+    // auto update: base records superseded by a delta (or deleted) are masked by the tombstones
+    vector_tombstones_free(dead);
+    if (t_ctx->options.auto_update) {
+        int rc = vector_tombstones_load(vtab->db, table_name, column_name, dead);
+        if (rc != SQLITE_OK) return sqlite_vtab_set_error(&vtab->base, "%s: unable to load tombstones (%s)", fname, sqlite3_errmsg(vtab->db));
+    }
+    
+    // records preloaded (by any connection) from the current generation are pinned until the cursor is closed
+    // or filtered again, so that a concurrent rebuild never frees them during the scan
+    *preload = vector_preload_acquire(t_ctx, generation);
+    return SQLITE_OK;
+}
+
+static int vector_rowid_compare (const void *a, const void *b) {
+    int64_t r1 = *(const int64_t *)a;
+    int64_t r2 = *(const int64_t *)b;
+    return (r1 > r2) - (r1 < r2);
+}
+
+// MARK: - Rowid Filter -
+
+// Rowid constraints (=, IN, >, >=, <, <=) on the id column are pushed down by vFullScanBestIndex: idxStr holds one
+// VECTOR_ROWID_OP_* character per constraint, whose value follows the positional arguments in argv. Together with the
+// optional allow-list argument they are turned into a vector_rowid_filter applied before any distance is computed,
+// so the k rows returned are the k nearest among the matching rows (and not the matching rows among the k nearest).
+// Streaming scans also receive the distance < and <= constraints in idxStr (see vCursorDistanceBound).
+
+#define VECTOR_ROWID_OP_EQ                          '='
+#define VECTOR_ROWID_OP_IN                          'i'         // IN list processed all-at-once (see sqlite3_vtab_in)
+#define VECTOR_ROWID_OP_GT                          '>'
+#define VECTOR_ROWID_OP_GE                          'g'
+#define VECTOR_ROWID_OP_LT                          '<'
+#define VECTOR_ROWID_OP_LE                          'l'
+#define VECTOR_DISTANCE_OP_LT                       'd'
+#define VECTOR_DISTANCE_OP_LE                       'D'
+
+static inline bool vector_op_is_distance (char op) {
+    return (op == VECTOR_DISTANCE_OP_LT || op == VECTOR_DISTANCE_OP_LE);
+}
+
+static void vector_rowid_filter_free (vector_rowid_filter *filter) {
+    if (filter->rowids) sqlite3_free(filter->rowids);
+    if (filter->slots) sqlite3_free(filter->slots);
+    filter->rowids = NULL;
+    filter->slots = NULL;
+    filter->count = 0;
+    filter->lo = INT64_MIN;
+    filter->hi = INT64_MAX;
+    filter->active = false;
+}
+
+static void vector_rowid_filter_clear (vector_rowid_filter *filter) {
+    // the filter matches nothing (bounds stay empty whatever constraint is applied next)
+    filter->lo = INT64_MAX;
+    filter->hi = INT64_MIN;
+}
+
+static bool vector_rowid_from_value (sqlite3_value *value, int64_t *rowid) {
+    // false if value cannot be equal to a rowid
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_INTEGER:
+            *rowid = (int64_t)sqlite3_value_int64(value);
+            return true;
+        case SQLITE_FLOAT: {
+            double d = sqlite3_value_double(value);
+            if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0) || d != floor(d)) return false;
+            *rowid = (int64_t)d;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void vector_rowid_filter_bound (vector_rowid_filter *filter, char op, sqlite3_value *value) {
+    // integers are exact, reals are rounded towards the matching rowids, NULL matches nothing,
+    // TEXT and BLOB values sort after every number (so only the upper bounds are always satisfied)
+    bool lower = (op == VECTOR_ROWID_OP_GT || op == VECTOR_ROWID_OP_GE);
+    int64_t bound = 0;
+    switch (sqlite3_value_type(value)) {
+        case SQLITE_INTEGER: {
+            int64_t i = (int64_t)sqlite3_value_int64(value);
+            if ((op == VECTOR_ROWID_OP_GT && i == INT64_MAX) || (op == VECTOR_ROWID_OP_LT && i == INT64_MIN)) {vector_rowid_filter_clear(filter); return;}
+            bound = (op == VECTOR_ROWID_OP_GT) ? i + 1 : (op == VECTOR_ROWID_OP_LT) ? i - 1 : i;
+            break;
+        }
+        case SQLITE_FLOAT: {
+            double d = sqlite3_value_double(value);
+            if (isnan(d)) {vector_rowid_filter_clear(filter); return;}
+            double r = (op == VECTOR_ROWID_OP_GT) ? floor(d) + 1.0 : (op == VECTOR_ROWID_OP_GE) ? ceil(d) : (op == VECTOR_ROWID_OP_LT) ? ceil(d) - 1.0 : floor(d);
+            if (r >= 9223372036854775808.0) {if (lower) vector_rowid_filter_clear(filter); return;}
+            if (r < -9223372036854775808.0) {if (!lower) vector_rowid_filter_clear(filter); return;}
+            bound = (int64_t)r;
+            break;
+        }
+        case SQLITE_NULL:
+            vector_rowid_filter_clear(filter);
+            return;
+        default:
+            if (lower) vector_rowid_filter_clear(filter);
+            return;
+    }
+    
+    if (lower && bound > filter->lo) filter->lo = bound;
+    if (!lower && bound < filter->hi) filter->hi = bound;
+}
+
+static int vector_rowid_filter_restrict (vector_rowid_filter *filter, int64_t *rowids, int count) {
+    // intersects the allow-list with count rowids (rowids is consumed)
+    qsort(rowids, (size_t)count, sizeof(int64_t), vector_rowid_compare);
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        if (n > 0 && rowids[n - 1] == rowids[i]) continue;
+        rowids[n++] = rowids[i];
+    }
+    
+    if (filter->rowids) {
+        int m = 0;
+        for (int i = 0, j = 0; i < filter->count && j < n;) {
+            if (filter->rowids[i] < rowids[j]) ++i;
+            else if (filter->rowids[i] > rowids[j]) ++j;
+            else {filter->rowids[m++] = filter->rowids[i]; ++i; ++j;}
+        }
+        sqlite3_free(rowids);
+        filter->count = m;
+    } else {
+        filter->rowids = rowids;
+        filter->count = n;
+    }
+    return SQLITE_OK;
+}
+
+static int vector_rowid_filter_list (vector_rowid_filter *filter, char op, sqlite3_value *value) {
+    // rowids of an equality or of the values of an IN list
+    int capacity = 1, count = 0;
+    int64_t *rowids = (int64_t *)sqlite3_malloc64(capacity * sizeof(int64_t));
+    if (!rowids) return SQLITE_NOMEM;
+    
+    if (op == VECTOR_ROWID_OP_EQ) {
+        if (vector_rowid_from_value(value, &rowids[0])) count = 1;
+        return vector_rowid_filter_restrict(filter, rowids, count);
+    }
+    
+    sqlite3_value *item = NULL;
+    int rc;
+    for (rc = sqlite3_vtab_in_first(value, &item); rc == SQLITE_OK && item; rc = sqlite3_vtab_in_next(value, &item)) {
+        int64_t rowid;
+        if (!vector_rowid_from_value(item, &rowid)) continue;
+        if (count == capacity) {
+            int64_t *p = (int64_t *)sqlite3_realloc64(rowids, (sqlite3_uint64)capacity * 2 * sizeof(int64_t));
+            if (!p) {sqlite3_free(rowids); return SQLITE_NOMEM;}
+            rowids = p;
+            capacity *= 2;
+        }
+        rowids[count++] = rowid;
+    }
+    if (rc != SQLITE_OK && rc != SQLITE_DONE) {
+        sqlite3_free(rowids);
+        return rc;
+    }
+    return vector_rowid_filter_restrict(filter, rowids, count);
+}
+
+static int vector_rowid_filter_allow (sqlite3 *db, vector_rowid_filter *filter, sqlite3_value *value, char **error) {
+    // the allow-list argument: a BLOB of int64 rowids (in native byte order) or the name of a table or view
+    // whose first column holds the rowids (NULL means no allow-list)
+    int type = sqlite3_value_type(value);
+    if (type == SQLITE_NULL) return SQLITE_OK;
+    
+    if (type == SQLITE_BLOB) {
+        int bytes = sqlite3_value_bytes(value);
+        if (bytes % sizeof(int64_t) != 0) {
+            *error = sqlite3_mprintf("the allow-list BLOB size (%d bytes) is not a multiple of 8", bytes);
+            return SQLITE_ERROR;
+        }
+        int count = bytes / (int)sizeof(int64_t);
+        int64_t *rowids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)(count + 1) * sizeof(int64_t));
+        if (!rowids) return SQLITE_NOMEM;
+        if (count > 0) memcpy(rowids, sqlite3_value_blob(value), (size_t)bytes);
+        return vector_rowid_filter_restrict(filter, rowids, count);
+    }
+    
+    if (type != SQLITE_TEXT) {
+        *error = sqlite3_mprintf("the allow-list must be a BLOB of rowids or the name of a table");
+        return SQLITE_ERROR;
+    }
+    
+    char *sql = sqlite3_mprintf("SELECT * FROM \"%w\";", (const char *)sqlite3_value_text(value));
+    if (!sql) return SQLITE_NOMEM;
+    
+    sqlite3_stmt *vm = NULL;
+    int64_t *rowids = NULL;
+    int capacity = 0, count = 0;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) {
+        *error = sqlite3_mprintf("unable to read the allow-list '%s' (%s)", (const char *)sqlite3_value_text(value), sqlite3_errmsg(db));
+        goto allow_cleanup;
+    }
+    
+    while ((rc = sqlite3_step(vm)) == SQLITE_ROW) {
+        int64_t rowid;
+        if (!vector_rowid_from_value(sqlite3_column_value(vm, 0), &rowid)) continue;
+        if (count == capacity) {
+            capacity = (capacity) ? capacity * 2 : 1024;
+            int64_t *p = (int64_t *)sqlite3_realloc64(rowids, (sqlite3_uint64)capacity * sizeof(int64_t));
+            if (!p) {rc = SQLITE_NOMEM; goto allow_cleanup;}
+            rowids = p;
+        }
+        rowids[count++] = rowid;
+    }
+    if (rc != SQLITE_DONE) goto allow_cleanup;
+    
+    if (!rowids) rowids = (int64_t *)sqlite3_malloc64(sizeof(int64_t));
+    if (!rowids) {rc = SQLITE_NOMEM; goto allow_cleanup;}
+    rc = vector_rowid_filter_restrict(filter, rowids, count);
+    rowids = NULL;
+    
+allow_cleanup:
+    if (vm) sqlite3_finalize(vm);
+    if (rowids) sqlite3_free(rowids);
+    sqlite3_free(sql);
+    return rc;
+}
+
+static void vector_rowid_filter_finalize (vector_rowid_filter *filter) {
+    // the allow-list is trimmed to the bounds, and the bounds tightened to the allow-list
+    if (!filter->rowids || filter->lo > filter->hi) return;
+    int first = 0, last = filter->count;
+    while (first < last && filter->rowids[first] < filter->lo) ++first;
+    while (last > first && filter->rowids[last - 1] > filter->hi) --last;
+    if (first > 0) memmove(filter->rowids, filter->rowids + first, (size_t)(last - first) * sizeof(int64_t));
+    filter->count = last - first;
+    
+    if (filter->count == 0) {vector_rowid_filter_clear(filter); return;}
+    filter->lo = filter->rowids[0];
+    filter->hi = filter->rowids[filter->count - 1];
+    
+    // the set is at most half full, its empty slots hold a rowid outside the bounds (no set if there is none)
+    if (filter->lo == INT64_MIN && filter->hi == INT64_MAX) return;
+    uint64_t nslots = 16;
+    while (nslots < (uint64_t)filter->count * 2) nslots *= 2;
+    if (filter->slots) sqlite3_free(filter->slots);
+    filter->slots = (int64_t *)sqlite3_malloc64((sqlite3_uint64)nslots * sizeof(int64_t));
+    if (!filter->slots) return;
+    
+    filter->mask = nslots - 1;
+    filter->empty = (filter->lo > INT64_MIN) ? filter->lo - 1 : filter->hi + 1;
+    for (uint64_t i = 0; i < nslots; ++i) filter->slots[i] = filter->empty;
+    for (int j = 0; j < filter->count; ++j) {
+        uint64_t i = vector_rowid_hash(filter->rowids[j]) & filter->mask;
+        while (filter->slots[i] != filter->empty) i = (i + 1) & filter->mask;
+        filter->slots[i] = filter->rowids[j];
+    }
 }
 
-static void vector_as_u8 (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    vector_as_type(context, VECTOR_TYPE_U8, argc, argv);
+static int vector_rowid_filter_build (sqlite3 *db, vector_rowid_filter *filter, const char *ops, sqlite3_value **argv, sqlite3_value *allow, char **error) {
+    // ops and argv describe the pushed down rowid constraints (see vFullScanBestIndex), allow is the allow-list argument (if any)
+    vector_rowid_filter_free(filter);
+    int nops = (ops) ? (int)strlen(ops) : 0;
+    
+    int rc = SQLITE_OK;
+    int nrowid = 0;
+    for (int i = 0; i < nops && rc == SQLITE_OK; ++i) {
+        if (vector_op_is_distance(ops[i])) continue;
+        if (ops[i] == VECTOR_ROWID_OP_EQ || ops[i] == VECTOR_ROWID_OP_IN) rc = vector_rowid_filter_list(filter, ops[i], argv[i]);
+        else vector_rowid_filter_bound(filter, ops[i], argv[i]);
+        ++nrowid;
+    }
+    if (rc == SQLITE_OK && allow) rc = vector_rowid_filter_allow(db, filter, allow, error);
+    if (rc != SQLITE_OK) return rc;
+    
+    filter->active = (nrowid > 0) || (allow && sqlite3_value_type(allow) != SQLITE_NULL);
+    vector_rowid_filter_finalize(filter);
+    return SQLITE_OK;
 }
 
-static void vector_as_i8 (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    vector_as_type(context, VECTOR_TYPE_I8, argc, argv);
+static void vCursorDistanceBound (vFullScanCursor *c, const char *ops, sqlite3_value **argv) {
+    // the tightest of the distance < and <= constraints pushed down (see vFullScanBestIndex): NULL matches nothing,
+    // TEXT and BLOB values sort after every number so they match everything, large integers are left to SQLite
+    c->bounded = false;
+    c->bound_inclusive = true;
+    c->bound = INFINITY;
+    
+    int nops = (ops) ? (int)strlen(ops) : 0;
+    for (int i = 0; i < nops; ++i) {
+        if (!vector_op_is_distance(ops[i])) continue;
+        bool inclusive = (ops[i] == VECTOR_DISTANCE_OP_LE);
+        double value;
+        switch (sqlite3_value_type(argv[i])) {
+            case SQLITE_INTEGER: {
+                sqlite3_int64 n = sqlite3_value_int64(argv[i]);
+                if (n > (1LL << 53) || n < -(1LL << 53)) continue;
+                value = (double)n;
+                break;
+            }
+            case SQLITE_FLOAT: value = sqlite3_value_double(argv[i]); break;
+            case SQLITE_NULL: value = -INFINITY; inclusive = false; break;
+            default: continue;
+        }
+        if (value < c->bound || (value == c->bound && !inclusive)) {
+            c->bound = value;
+            c->bound_inclusive = inclusive;
+        }
+        c->bounded = true;
+    }
 }
 
-static void vector_as_bit (sqlite3_context *context, int argc, sqlite3_value **argv) {
-    vector_as_type(context, VECTOR_TYPE_BIT, argc, argv);
+static void vCursorStreamReset (vFullScanCursor *c) {
+    // releases the state of the previous streaming scan (the cursor can be filtered again, e.g. in a join)
+    if (c->stream.vector) sqlite3_free(c->stream.vector);
+    if (c->stream.vm) sqlite3_finalize(c->stream.vm);
+    if (c->stream.staging) sqlite3_free(c->stream.staging);
+    memset(&c->stream, 0, sizeof(c->stream));
 }
 
-// MARK: - Modules -
-static int vFullScanCursorNext (sqlite3_vtab_cursor *cur);
-static int vStreamScanCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size);
-static int vStreamQuantCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size);
+// MARK: -
 
 static int vCursorFilterCommon (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv, const char *fname, vcursor_run_callback run_callback, vcursor_sort_callback sort_callback, vcursor_run_callback stream_callback, bool quantized) {
 
     vFullScanCursor *c = (vFullScanCursor *)cur;
     vFullScan *vtab = (vFullScan *)cur->pVtab;
-
-    if (argc != 3 && argc != 4) {
-        return sqlite_vtab_set_error(&vtab->base, "%s expects 3 or 4 arguments, but %d were provided", fname, argc);
+    vCursorStatsFlush(c);
+    vCursorStreamReset(c);
+
+    // the values of the pushed down rowid constraints follow the positional arguments
+    sqlite3_value **rowid_argv = argv + argc;
+    if (idxStr) {
+        argc -= (int)strlen(idxStr);
+        rowid_argv = argv + argc;
+    }
+    
+    if (argc < 3 || argc > 6) {
+        return sqlite_vtab_set_error(&vtab->base, "%s expects 3, 4, 5 or 6 arguments, but %d were provided", fname, argc);
     }
 
     bool is_streaming = (argc == 3);
@@ -1934,6 +5585,14 @@ static int vCursorFilterCommon (sqlite3_vtab_cursor *cur, int idxNum, const char
                 if (actual_type != SQLITE_INTEGER)
                     return sqlite_vtab_set_error(&vtab->base, "%s: argument %d must be of type INTEGER (got %s)", fname, (i+1), sqlite_type_name(actual_type));
                 break;
+            case 4:
+                if (actual_type != SQLITE_TEXT)
+                    return sqlite_vtab_set_error(&vtab->base, "%s: argument %d must be of type TEXT (got %s)", fname, (i+1), sqlite_type_name(actual_type));
+                break;
+            case 5:
+                if ((actual_type != SQLITE_TEXT) && (actual_type != SQLITE_BLOB) && (actual_type != SQLITE_NULL))
+                    return sqlite_vtab_set_error(&vtab->base, "%s: argument %d must be of type TEXT, BLOB or NULL (got %s)", fname, (i+1), sqlite_type_name(actual_type));
+                break;
         }
     }
     
@@ -1945,6 +5604,26 @@ static int vCursorFilterCommon (sqlite3_vtab_cursor *cur, int idxNum, const char
         return sqlite_vtab_set_error(&vtab->base, "%s: unable to retrieve context", fname);
     }
     
+    // per-query options (if any) override the ones set in vector_init
+    c->options = t_ctx->options;
+    if (argc >= 5) {
+        const char *arg_options = (const char *)sqlite3_value_text(argv[4]);
+        int rc = vector_query_options_parse(&vtab->base, fname, arg_options, &c->options);
+        if (rc != SQLITE_OK) return rc;
+    }
+    vector_stats *stats = vCursorStats(c);
+    VECTOR_STATS_ADD(stats, scans, 1);
+    
+    // rowid constraints and allow-list (if any)
+    char *error = NULL;
+    int frc = vector_rowid_filter_build(vtab->db, &c->filter, idxStr, rowid_argv, (argc == 6) ? argv[5] : NULL, &error);
+    if (frc != SQLITE_OK) {
+        if (!error) return frc;
+        sqlite_vtab_set_error(&vtab->base, "%s: %s", fname, error);
+        sqlite3_free(error);
+        return SQLITE_ERROR;
+    }
+    
     const void *vector = NULL;
     bool vector_allocated = false;
     int vsize = 0;
@@ -1961,17 +5640,27 @@ static int vCursorFilterCommon (sqlite3_vtab_cursor *cur, int idxNum, const char
     VECTOR_PRINT((void*)vector, t_ctx->options.v_type, t_ctx->options.v_dim);
     
     if (quantized) {
-        char buffer[STATIC_SQL_SIZE];
-        char *name = generate_quant_table_name(table_name, column_name, buffer);
-        if (!name || !sqlite_table_exists(vtab->db, name)) {
-            sqlite_vtab_set_error(&vtab->base, "Quantization table not found for table '%s' and column '%s'. Ensure that vector_quantize() has been called before using vector_quantize_scan()", table_name, column_name);
+        int rc = vQuantScanPrepare(vtab, t_ctx, fname, &c->dead, &c->preload);
+        if (rc != SQLITE_OK) {
             if (vector_allocated) sqlite3_free((void *)vector);
-            return SQLITE_ERROR;
+            return rc;
+        }
+        if (c->preload) VECTOR_STATS_ADD(stats, preload_hits, 1);
+        else VECTOR_STATS_ADD(stats, preload_misses, 1);
+        
+        // PQ quantization of a table without vectors: no codebooks and no codes to scan
+        if (t_ctx->options.q_type == VECTOR_QUANT_PQ && t_ctx->pq.codebooks == NULL) {
+            if (vector_allocated) sqlite3_free((void *)vector);
+            c->table = t_ctx;
+            c->stream.is_eof = 1;
+            c->row_index = c->row_count = 0;
+            return SQLITE_OK;
         }
     }
 
     c->table = t_ctx;
     if (is_streaming) {
+        vCursorDistanceBound(c, idxStr, rowid_argv);
         int rc = stream_callback(vtab->db, c, vector, vsize);
         if (vector_allocated) sqlite3_free((void *)vector);
         if (rc != SQLITE_OK) return rc;
@@ -1984,514 +5673,1730 @@ static int vCursorFilterCommon (sqlite3_vtab_cursor *cur, int idxNum, const char
         if (vector_allocated) sqlite3_free((void *)vector);
         return SQLITE_DONE;
     }
+    if (k < 0) {
+        if (vector_allocated) sqlite3_free((void *)vector);
+        return sqlite_vtab_set_error(&vtab->base, "%s: k must be a positive integer (got %d)", fname, k);
+    }
+
+    // when reranking the quantized pass collects k*rerank candidates
+    int slots = k;
+    if (quantized && c->options.rerank > 0) {
+        int64_t n = (int64_t)k * (int64_t)c->options.rerank;
+        slots = (n > INT_MAX / (int)sizeof(double)) ? INT_MAX / (int)sizeof(double) : (int)n;
+    }
+    
+    if (c->capacity < slots) {
+        c->capacity = 0;
+        if (c->rowids) sqlite3_free(c->rowids);
+        c->rowids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)slots * sizeof(int64_t));
+        if (c->rowids == NULL) {
+            if (vector_allocated) sqlite3_free((void *)vector);
+            return SQLITE_NOMEM;
+        }
+
+        if (c->distance) sqlite3_free(c->distance);
+        c->distance = (double *)sqlite3_malloc64((sqlite3_uint64)slots * sizeof(double));
+        if (c->distance == NULL) {
+            if (vector_allocated) sqlite3_free((void *)vector);
+            return SQLITE_NOMEM;
+        }
+        c->capacity = slots;
+    }
+
+    vector_topk_init(&c->topk, c->distance, c->rowids, slots);
+    c->k = k;
+    c->row_index = 0;
+    c->row_count = 0;
+
+    int rc = run_callback(vtab->db, c, vector, vsize);
+    if (vector_allocated) sqlite3_free((void *)vector);
+    c->row_count = sort_callback(c);
+
+    #if 0
+    for (int i=0; i<c->row_count; ++i) {
+        printf("%lld\t%f\n", (long long)c->rowids[i], c->distance[i]);
+    }
+    #endif
+
+    return rc;
+}
+
+static int vFullScanConnect (sqlite3 *db, void *pAux, int argc, const char *const *argv, sqlite3_vtab **ppVtab, char **pzErr) {
+    // https://www.sqlite.org/vtab.html#table_valued_functions
+    int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(tbl hidden, vector hidden, k hidden, memidx hidden, options hidden, filter hidden, id, distance);");
+    if (rc != SQLITE_OK) return rc;
+    
+    vFullScan *vtab = (vFullScan *)sqlite3_malloc(sizeof(vFullScan));
+    if (!vtab) return SQLITE_NOMEM;
+    
+    memset(vtab, 0, sizeof(vFullScan));
+    vtab->db = db;
+    vtab->ctx = (vector_context *)pAux;
+    
+    *ppVtab = (sqlite3_vtab *)vtab;
+    return SQLITE_OK;
+}
+
+static int vFullScanDisconnect (sqlite3_vtab *pVtab) {
+    vFullScan *vtab = (vFullScan *)pVtab;
+    sqlite3_free(vtab);
+    return SQLITE_OK;
+}
+
+static int vFullScanBestIndex (sqlite3_vtab *tab, sqlite3_index_info *pIdxInfo) {
+    // With positional args to the table-valued function:
+    //   3 args: f('tbl','col',vector)      → columns 0,1,2 constrained (streaming)
+    //   4 args: f('tbl','col',vector,k)    → columns 0,1,2,3 constrained (top-k)
+    //   5 args: f('tbl','col',vector,k,options) → columns 0,1,2,3,4 constrained (top-k with per-query options)
+    // Column 2 (K) always receives the vector blob (positional arg 2).
+    // Column 3 (MEMIDX) receives the actual k integer only with 4 args.
+    // So top-k mode is determined by whether MEMIDX is constrained, not K.
+    //   6 args: f('tbl','col',vector,k,options,allow) → column 5 (FILTER) receives the allow-list.
+    // Rowid constraints are appended after the positional args (see vector_rowid_filter_build).
+    bool has_topk = false;
+    int nargs = 0;
+
+    const struct sqlite3_index_constraint *pConstraint = pIdxInfo->aConstraint;
+    for(int i=0; i<pIdxInfo->nConstraint; i++, pConstraint++){
+        if( pConstraint->op != SQLITE_INDEX_CONSTRAINT_EQ ) continue;
+        // an argument bound to a table not scanned yet (e.g. a correlated query vector): the plan with that table
+        // in the outer loop is the only valid one
+        if( pConstraint->usable == 0 ){
+            if( pConstraint->iColumn >= VECTOR_COLUMN_IDX && pConstraint->iColumn <= VECTOR_COLUMN_FILTER ) return SQLITE_CONSTRAINT;
+            continue;
+        }
+        if( pConstraint->iColumn >= VECTOR_COLUMN_IDX && pConstraint->iColumn <= VECTOR_COLUMN_FILTER && pConstraint->iColumn >= nargs ) nargs = pConstraint->iColumn + 1;
+        switch( pConstraint->iColumn ){
+            case VECTOR_COLUMN_IDX:
+                pIdxInfo->aConstraintUsage[i].argvIndex = 1;
+                pIdxInfo->aConstraintUsage[i].omit = 1;
+                break;
+            case VECTOR_COLUMN_VECTOR:
+                pIdxInfo->aConstraintUsage[i].argvIndex = 2;
+                pIdxInfo->aConstraintUsage[i].omit = 1;
+                break;
+            case VECTOR_COLUMN_K:
+                pIdxInfo->aConstraintUsage[i].argvIndex = 3;
+                pIdxInfo->aConstraintUsage[i].omit = 1;
+                break;
+            case VECTOR_COLUMN_MEMIDX:
+                has_topk = true;
+                pIdxInfo->aConstraintUsage[i].argvIndex = 4;
+                pIdxInfo->aConstraintUsage[i].omit = 1;
+                break;
+            case VECTOR_COLUMN_OPTIONS:
+                pIdxInfo->aConstraintUsage[i].argvIndex = 5;
+                pIdxInfo->aConstraintUsage[i].omit = 1;
+                break;
+            case VECTOR_COLUMN_FILTER:
+                pIdxInfo->aConstraintUsage[i].argvIndex = 6;
+                pIdxInfo->aConstraintUsage[i].omit = 1;
+                break;
+        }
+    }
+    
+    // rowid constraints: = (and IN lists, received all-at-once) need sqlite3_vtab_in (SQLite 3.38.0)
+    // distance constraints: < and <= let a streaming scan skip the rows SQLite would reject without returning them
+    // (omit is not set, SQLite still checks the rows returned)
+    char ops[VECTOR_MAX_ROWID_CONSTRAINTS + 1];
+    int nops = 0;
+    bool has_in = (sqlite3_libversion_number() >= 3038000);
+    pConstraint = pIdxInfo->aConstraint;
+    for(int i=0; i<pIdxInfo->nConstraint && nops<VECTOR_MAX_ROWID_CONSTRAINTS; i++, pConstraint++){
+        if( pConstraint->usable == 0 ) continue;
+        char op = 0;
+        if( pConstraint->iColumn == VECTOR_COLUMN_DISTANCE ){
+            if (has_topk) continue;
+            if (pConstraint->op == SQLITE_INDEX_CONSTRAINT_LT) op = VECTOR_DISTANCE_OP_LT;
+            else if (pConstraint->op == SQLITE_INDEX_CONSTRAINT_LE) op = VECTOR_DISTANCE_OP_LE;
+        } else if( pConstraint->iColumn == VECTOR_COLUMN_ROWID || pConstraint->iColumn < 0 ){
+            switch( pConstraint->op ){
+                case SQLITE_INDEX_CONSTRAINT_EQ:
+                    if (has_in) op = (sqlite3_vtab_in(pIdxInfo, i, 1)) ? VECTOR_ROWID_OP_IN : VECTOR_ROWID_OP_EQ;
+                    break;
+                case SQLITE_INDEX_CONSTRAINT_GT: op = VECTOR_ROWID_OP_GT; break;
+                case SQLITE_INDEX_CONSTRAINT_GE: op = VECTOR_ROWID_OP_GE; break;
+                case SQLITE_INDEX_CONSTRAINT_LT: op = VECTOR_ROWID_OP_LT; break;
+                case SQLITE_INDEX_CONSTRAINT_LE: op = VECTOR_ROWID_OP_LE; break;
+            }
+        }
+        if (op == 0) continue;
+        ops[nops++] = op;
+        pIdxInfo->aConstraintUsage[i].argvIndex = nargs + nops;
+        pIdxInfo->aConstraintUsage[i].omit = !vector_op_is_distance(op);
+    }
+    if (nops > 0) {
+        ops[nops] = 0;
+        pIdxInfo->idxStr = sqlite3_mprintf("%s", ops);
+        if (!pIdxInfo->idxStr) return SQLITE_NOMEM;
+        pIdxInfo->needToFreeIdxStr = 1;
+    }
+
+    if (has_topk) {
+        // top-k mode: 4 positional args, argv[3] has the k integer
+        // a plan restricted by rowid constraints is made expensive, so that a rowid joined to another table
+        // does not turn the single top-k scan into one scan per joined row
+        pIdxInfo->estimatedCost = (nops > 0) ? 1e6 : (double)1;
+        pIdxInfo->estimatedRows = 100;
+        pIdxInfo->orderByConsumed = 1;
+        pIdxInfo->idxNum = 1;
+    } else {
+        // streaming mode: 3 positional args, no sorting guaranteed
+        pIdxInfo->estimatedCost = 1e8;
+        pIdxInfo->estimatedRows = 100000;
+        pIdxInfo->idxNum = 2;
+    }
+
+    return SQLITE_OK;
+}
+
+static int vFullScanCursorOpen (sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor){
+    vFullScanCursor *c = (vFullScanCursor *)sqlite3_malloc(sizeof(vFullScanCursor));
+    if (!c) return SQLITE_NOMEM;
+    
+    memset(c, 0, sizeof(vFullScanCursor));
+    *ppCursor = (sqlite3_vtab_cursor *)c;
+    return SQLITE_OK;
+}
+
+static int vFullScanCursorClose (sqlite3_vtab_cursor *cur){
+    vFullScanCursor *c = (vFullScanCursor *)cur;
+    vCursorStatsFlush(c);
+    if (c->rowids) sqlite3_free(c->rowids);
+    if (c->distance) sqlite3_free(c->distance);
+    vCursorStreamReset(c);
+    vector_tombstones_free(&c->dead);
+    vector_rowid_filter_free(&c->filter);
+    vector_preload_release(c->preload);
+    sqlite3_free(c);
+    return SQLITE_OK;
+}
+
+static inline void vStreamPush (vFullScanCursor *c, float distance, int64_t rowid) {
+    // appends a row to the block unless the distance constraint (if any) rejects it (NaN is rejected like NULL)
+    if (nearly_zero_float32(distance)) distance = 0.0f;
+    if (c->bounded && !((c->bound_inclusive) ? (double)distance <= c->bound : (double)distance < c->bound)) return;
+    
+    int i = c->stream.block_count++;
+    c->stream.block_distances[i] = distance;
+    c->stream.block_rowids[i] = rowid;
+}
+
+static void vStreamScanRecords (vFullScanCursor *c, const vector_records *records, int start, int n, int dist_n, const vector_rowid_filter *filter, const vector_tombstones *dead) {
+    // distances of the records [start, start + n) with n <= SCAN_DISTANCE_BLOCK (same steps as vScanRecords)
+    const void *v = c->stream.vector;
+    const size_t code_stride = records->code_stride;
+    const uint8_t *base = records->codes + ((size_t)start * code_stride);
+    distance_function_t distance_fn = c->stream.distance_fn;
+    vector_stats *stats = vCursorStats(c);
+    
+    float block[SCAN_DISTANCE_BLOCK];
+    bool skip[SCAN_DISTANCE_BLOCK] = {false};
+    int nskip = 0;
+    if (filter) {
+        for (int i = 0; i < n; ++i) {
+            skip[i] = !vector_rowid_filter_contains(filter, vector_records_rowid(records, start + i));
+            nskip += skip[i];
+        }
+        if (nskip == n) return;
+    }
+    
+    VECTOR_STATS_KERNEL_BEGIN(stats);
+    if (c->stream.batch_fn && nskip == 0) {
+        c->stream.batch_fn(v, (const void *)base, code_stride, n, dist_n, block);
+    } else {
+        for (int i = 0; i < n; ++i) block[i] = (skip[i]) ? 0.0f : distance_fn(v, (const void *)(base + ((size_t)i * code_stride)), dist_n);
+    }
+    VECTOR_STATS_KERNEL_END(stats);
+    VECTOR_STATS_ADD(stats, rows_scanned, n - nskip);
+    VECTOR_STATS_ADD(stats, bytes_touched, (size_t)(n - nskip) * records->code_size);
+    
+    for (int i = 0; i < n; ++i) {
+        if (skip[i]) continue;
+        int64_t rowid = vector_records_rowid(records, start + i);
+        if (dead && vector_tombstones_contains(dead, rowid)) continue;
+        vStreamPush(c, block[i], rowid);
+    }
+}
+
+static int vStreamFillRows (vFullScanCursor *c) {
+    // full scan: reads up to SCAN_DISTANCE_BLOCK rows, whose vectors are compared as they are read
+    // or copied and compared together by the batch kernel
+    sqlite3_stmt *vm = c->stream.vm;
+    int dimension = c->stream.vdim;
+    vector_type vt = c->table->options.v_type;
+    int dist_size = (vt == VECTOR_TYPE_BIT) ? ((dimension + 7) / 8) : dimension;
+    size_t expected_bytes = vector_bytes_for_dim(vt, dimension);
+    size_t total_stride = sizeof(int64_t) + expected_bytes;
+    uint8_t *staging = c->stream.staging;
+    vector_stats *stats = vCursorStats(c);
+    
+    int staged = 0;
+    for (int nread = 0; nread < SCAN_DISTANCE_BLOCK; ++nread) {
+        int rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {c->stream.exhausted = true; break;}
+        if (rc != SQLITE_ROW) return rc;
+        
+        // skip rows outside the rowid filter (and NULL values)
+        int64_t rowid = (int64_t)sqlite3_column_int64(vm, 0);
+        if (c->filter.active && !vector_rowid_filter_contains(&c->filter, rowid)) continue;
+        if (sqlite3_column_type(vm, 1) == SQLITE_NULL) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
+        
+        const void *v2 = sqlite3_column_blob(vm, 1);
+        if (v2 == NULL) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
+        
+        // skip undersized blobs
+        if ((size_t)sqlite3_column_bytes(vm, 1) < expected_bytes) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
+        
+        if (staging) {
+            uint8_t *record = staging + ((size_t)staged++ * total_stride);
+            INT64_TO_INT8PTR(rowid, record);
+            memcpy(record + sizeof(int64_t), v2, expected_bytes);
+            continue;
+        }
+        
+        VECTOR_STATS_KERNEL_BEGIN(stats);
+        float distance = c->stream.distance_fn(c->stream.vector, v2, dist_size);
+        VECTOR_STATS_KERNEL_END(stats);
+        VECTOR_STATS_ADD(stats, rows_scanned, 1);
+        VECTOR_STATS_ADD(stats, bytes_touched, expected_bytes);
+        vStreamPush(c, distance, rowid);
+    }
+    
+    if (staged > 0) {
+        vector_records records = vector_chunk_records(VECTOR_CHUNK_FORMAT_INTERLEAVED, staging, staged, expected_bytes);
+        vStreamScanRecords(c, &records, 0, staged, dist_size, NULL, NULL);
+    }
+    return SQLITE_OK;
+}
+
+static int vStreamFillRecords (vFullScanCursor *c) {
+    // quantized scan: the next block of records of the current chunk (the preloaded buffer, if any, and then
+    // the chunks read from disk, if any), a new chunk is read only when the current one has been consumed
+    if (c->stream.dindex >= c->stream.dcounter) {
+        sqlite3_stmt *vm = c->stream.vm;
+        if (vm == NULL) {c->stream.exhausted = true; return SQLITE_OK;}
+        
+        int rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {c->stream.exhausted = true; return SQLITE_OK;}
+        else if (rc != SQLITE_ROW) return rc;
+        
+        const size_t vector_size = (size_t)c->stream.vsize;
+        const size_t code_size = c->stream.code_offset + vector_size;
+        int counter = sqlite3_column_int(vm, 0);
+        const uint8_t *data = (const uint8_t *)sqlite3_column_blob(vm, 1);
+        if (counter <= 0 || (size_t)sqlite3_column_bytes(vm, 1) < vector_chunk_bytes(c->table->chunk_format, (size_t)counter, code_size)) counter = 0;
+        if (counter > 0) VECTOR_STATS_ADD(vCursorStats(c), chunks_read, 1);
+        vector_records chunk = vector_chunk_records(c->table->chunk_format, data, counter, code_size);
+        c->stream.records  = vector_records_level(&chunk, c->stream.code_offset, vector_size);
+        c->stream.dcounter = counter;
+        c->stream.dindex   = 0; // reset index for the new chunk
+        
+        // only the records of base chunks can be superseded by a delta
+        c->stream.masked = (c->dead.count > 0) && (sqlite3_column_count(vm) == 3) && (sqlite3_column_type(vm, 2) == SQLITE_NULL || sqlite3_column_int(vm, 2) > VECTOR_DELTA_LIST);
+        return SQLITE_OK;
+    }
+    
+    // no NULL vectors here by construction
+    int start = c->stream.dindex;
+    int n = (c->stream.dcounter - start < SCAN_DISTANCE_BLOCK) ? c->stream.dcounter - start : SCAN_DISTANCE_BLOCK;
+    c->stream.dindex += n;
+    vStreamScanRecords(c, &c->stream.records, start, n, c->stream.vsize, (c->filter.active) ? &c->filter : NULL, (c->stream.masked) ? &c->dead : NULL);
+    return SQLITE_OK;
+}
+
+static int vFullScanCursorNext (sqlite3_vtab_cursor *cur){
+    vFullScanCursor *c = (vFullScanCursor *)cur;
+
+    // non-streaming flow
+    if (!c->is_streaming) { c->row_index++; return SQLITE_OK; }
+
+    // streaming flow: the block is refilled when consumed, so rows rejected by the filters never reach SQLite
+    while (c->stream.block_index >= c->stream.block_count) {
+        if (c->stream.exhausted) { c->stream.is_eof = 1; return SQLITE_OK; }
+        c->stream.block_index = c->stream.block_count = 0;
+        int rc = (c->is_quantized) ? vStreamFillRecords(c) : vStreamFillRows(c);
+        if (rc != SQLITE_OK) return rc;
+    }
+    
+    int i = c->stream.block_index++;
+    c->stream.distance = c->stream.block_distances[i];
+    c->stream.rowid = c->stream.block_rowids[i];
+    return SQLITE_OK;
+}
+
+
+static int vFullScanCursorEof (sqlite3_vtab_cursor *cur){
+    vFullScanCursor *c = (vFullScanCursor *)cur;
+    return (c->is_streaming) ? c->stream.is_eof : (c->row_index == c->row_count);
+}
+
+static int vFullScanCursorColumn (sqlite3_vtab_cursor *cur, sqlite3_context *context, int iCol) {
+    vFullScanCursor *c = (vFullScanCursor *)cur;
+    if (iCol == VECTOR_COLUMN_ROWID) {
+        sqlite3_result_int64(context, (c->is_streaming) ? (sqlite3_int64)c->stream.rowid : (sqlite3_int64)c->rowids[c->row_index]);
+    } else if (iCol == VECTOR_COLUMN_DISTANCE) {
+        sqlite3_result_double(context, (c->is_streaming) ? c->stream.distance : c->distance[c->row_index]);
+    }
+    return SQLITE_OK;
+}
 
-    if (c->row_count != k) {
-        if (c->rowids) sqlite3_free(c->rowids);
-        c->rowids = (int64_t *)sqlite3_malloc(k * sizeof(int64_t));
-        if (c->rowids == NULL) {
-            if (vector_allocated) sqlite3_free((void *)vector);
-            return SQLITE_NOMEM;
-        }
+static int vFullScanCursorRowid (sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+    vFullScanCursor *c = (vFullScanCursor *)cur;
+    *pRowid = (c->is_streaming) ? (sqlite3_int64)c->stream.rowid : (sqlite_int64)c->rowids[c->row_index];
+    return SQLITE_OK;
+}
 
-        if (c->distance) sqlite3_free(c->distance);
-        c->distance = (double *)sqlite3_malloc(k * sizeof(double));
-        if (c->distance == NULL) {
-            if (vector_allocated) sqlite3_free((void *)vector);
-            return SQLITE_NOMEM;
-        }
-    }
+static int vFullScanSortSlots (vFullScanCursor *c) {
+    // returns the number of valid (sorted) entries
+    return vector_topk_sort(&c->topk);
+}
 
-    memset(c->rowids, 0, k * sizeof(int64_t));
-    for (int i=0; i<k; ++i) c->distance[i] = INFINITY;
+// MARK: - Parallel Scan -
 
-    c->size = 0;
-    c->row_index = 0;
-    c->row_count = k;
+// A scan works on a vector_records view (interleaved or split chunks, see vector-chunk.h).
+// With threads=N every chunk of records is split into up to N contiguous shards scanned on the worker pool,
+// each shard feeding a private top-k collector. Collectors are merged into the cursor one when the scan completes:
+// since candidates are totally ordered by (distance, rowid) the merged set is exactly the single-threaded one.
 
-    int rc = run_callback(vtab->db, c, vector, vsize);
-    if (vector_allocated) sqlite3_free((void *)vector);
-    int count = sort_callback(c);
-    c->row_count -= count;
+typedef struct {
+    vector_topk         topk;               // private collector (lives for the whole scan)
+    const void          *v;                 // query vector
+    vector_records      records;            // records of the shard
+    int                 dist_n;             // n argument of distance_fn
+    distance_function_t distance_fn;
+    distance_batch_function_t batch_fn;     // same distance over a block of records (NULL if not available)
+    float               qnorm;              // norm of the query when records carry cached norms
+    const vector_tombstones *dead;          // records to skip (NULL if none)
+    const vector_rowid_filter *filter;      // records to scan (NULL for all)
+    vector_stats        stats;              // private counters (lives for the whole scan)
+    bool                collect;            // true if stats is collected
+} vscan_shard;
 
-    #if 0
-    for (int i=0; i<c->row_count; ++i) {
-        printf("%lld\t%f\n", (long long)c->rowids[i], c->distance[i]);
+typedef struct {
+    vscan_shard         *shards;
+    int                 nshards;            // 0 means single-threaded scan
+    double              *distance;          // backing storage of the shard collectors
+    int64_t             *rowids;
+} vscan_parallel;
+
+static void vScanRecords (vector_topk *topk, const void *v, const vector_records *records, int dist_n, distance_function_t distance_fn, distance_batch_function_t batch_fn, float qnorm, const vector_tombstones *dead, const vector_rowid_filter *filter, vector_stats *stats) {
+    const uint8_t *codes = records->codes;
+    const size_t code_stride = records->code_stride;
+    const float *norms = records->norms;
+    const int count = records->count;
+    
+    // cache the current threshold to avoid repeated memory accesses
+    double current_max = vector_topk_threshold(topk);
+    
+    // distances are computed a block at a time by the batch kernel (one call per block instead of one per record)
+    float block[SCAN_DISTANCE_BLOCK];
+    bool skip[SCAN_DISTANCE_BLOCK] = {false};
+    for (int start = 0; start < count; start += SCAN_DISTANCE_BLOCK) {
+        int n = (count - start < SCAN_DISTANCE_BLOCK) ? count - start : SCAN_DISTANCE_BLOCK;
+        const uint8_t *base = codes + ((size_t)start * code_stride);
+        
+        // filtered scan: the rowids are read first and only the matching records are compared with the query
+        int nskip = 0;
+        if (filter) {
+            for (int i = 0; i < n; ++i) {
+                skip[i] = !vector_rowid_filter_contains(filter, vector_records_rowid(records, start + i));
+                nskip += skip[i];
+            }
+            if (nskip == n) continue;
+        }
+        
+        VECTOR_STATS_KERNEL_BEGIN(stats);
+        if (batch_fn && nskip == 0) {
+            batch_fn(v, (const void *)base, code_stride, n, dist_n, block);
+        } else {
+            for (int i = 0; i < n; ++i) block[i] = (skip[i]) ? 0.0f : distance_fn(v, (const void *)(base + ((size_t)i * code_stride)), dist_n);
+        }
+        VECTOR_STATS_KERNEL_END(stats);
+        VECTOR_STATS_ADD(stats, rows_scanned, n - nskip);
+        VECTOR_STATS_ADD(stats, bytes_touched, (size_t)(n - nskip) * records->code_size);
+        
+        // cached norms: the kernels computed -dot, cosine is finished here exactly like the cosine kernels do
+        if (norms) {
+            for (int i = 0; i < n; ++i) {
+                float norm = norms[start + i];
+                block[i] = (qnorm == 0.0f || norm == 0.0f) ? 1.0f : vector_cosine_from_dot(block[i] / (qnorm * norm));
+            }
+        }
+        
+        for (int i = 0; i < n; ++i) {
+            if (skip[i]) continue;
+            float dist = block[i];
+            if (nearly_zero_float32(dist)) dist = 0.0;
+            
+            if (dist <= current_max) {
+                // rowids (and tombstones) are read only for the records that would enter the collector
+                int64_t rowid = vector_records_rowid(records, start + i);
+                if (dead && vector_tombstones_contains(dead, rowid)) continue;
+                if (vector_topk_push(topk, dist, rowid)) VECTOR_STATS_ADD(stats, heap_updates, 1);
+                current_max = vector_topk_threshold(topk);
+            }
+        }
     }
-    #endif
+}
 
-    return rc;
+static void vScanShardTask (void *arg, int index) {
+    vscan_shard *s = ((vscan_shard *)arg) + index;
+    vScanRecords(&s->topk, s->v, &s->records, s->dist_n, s->distance_fn, s->batch_fn, s->qnorm, s->dead, s->filter, (s->collect) ? &s->stats : NULL);
 }
 
-static int vFullScanConnect (sqlite3 *db, void *pAux, int argc, const char *const *argv, sqlite3_vtab **ppVtab, char **pzErr) {
-    // https://www.sqlite.org/vtab.html#table_valued_functions
-    int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(tbl hidden, vector hidden, k hidden, memidx hidden, id, distance);");
-    if (rc != SQLITE_OK) return rc;
+static int vScanParallelInit (vscan_parallel *p, int threads, int capacity) {
+    memset(p, 0, sizeof(vscan_parallel));
+    if (threads <= 1 || capacity <= 0 || !vector_pool_is_parallel()) return SQLITE_OK;
+    
+    p->shards = (vscan_shard *)sqlite3_malloc64((sqlite3_uint64)threads * sizeof(vscan_shard));
+    p->distance = (double *)sqlite3_malloc64((sqlite3_uint64)threads * capacity * sizeof(double));
+    p->rowids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)threads * capacity * sizeof(int64_t));
+    if (!p->shards || !p->distance || !p->rowids) {
+        if (p->shards) sqlite3_free(p->shards);
+        if (p->distance) sqlite3_free(p->distance);
+        if (p->rowids) sqlite3_free(p->rowids);
+        memset(p, 0, sizeof(vscan_parallel));
+        return SQLITE_NOMEM;
+    }
     
-    vFullScan *vtab = (vFullScan *)sqlite3_malloc(sizeof(vFullScan));
-    if (!vtab) return SQLITE_NOMEM;
+    memset(p->shards, 0, (size_t)threads * sizeof(vscan_shard));
+    for (int i=0; i<threads; ++i) {
+        vector_topk_init(&p->shards[i].topk, p->distance + (size_t)i * capacity, p->rowids + (size_t)i * capacity, capacity);
+    }
+    p->nshards = threads;
+    return SQLITE_OK;
+}
+
+static void vScanParallelChunk (vFullScanCursor *c, vscan_parallel *p, const void *v, const vector_records *records, int dist_n, distance_function_t distance_fn, distance_batch_function_t batch_fn, float qnorm, const vector_tombstones *dead) {
+    // records outside the rowid filter of the cursor (if any) are skipped
+    const vector_rowid_filter *filter = (c->filter.active) ? &c->filter : NULL;
+    vector_stats *stats = vCursorStats(c);
+    
+    // small chunks are not worth the hand-off to the pool
+    int count = records->count;
+    int nshards = count / SCAN_MIN_SHARD_RECORDS;
+    if (nshards > p->nshards) nshards = p->nshards;
+    if (nshards <= 1) {
+        vScanRecords(&c->topk, v, records, dist_n, distance_fn, batch_fn, qnorm, dead, filter, stats);
+        return;
+    }
     
-    memset(vtab, 0, sizeof(vFullScan));
-    vtab->db = db;
-    vtab->ctx = (vector_context *)pAux;
+    int per_shard = count / nshards;
+    int remainder = count % nshards;
+    int start = 0;
+    for (int i=0; i<nshards; ++i) {
+        vscan_shard *s = &p->shards[i];
+        int n = per_shard + ((i < remainder) ? 1 : 0);
+        s->v = v;
+        s->records = vector_records_slice(records, start, n);
+        s->dist_n = dist_n;
+        s->distance_fn = distance_fn;
+        s->batch_fn = batch_fn;
+        s->qnorm = qnorm;
+        s->dead = dead;
+        s->filter = filter;
+        s->collect = (stats != NULL);
+        start += n;
+    }
     
-    *ppVtab = (sqlite3_vtab *)vtab;
-    return SQLITE_OK;
+    vector_pool_run(nshards, vScanShardTask, p->shards);
 }
 
-static int vFullScanDisconnect (sqlite3_vtab *pVtab) {
-    vFullScan *vtab = (vFullScan *)pVtab;
-    sqlite3_free(vtab);
-    return SQLITE_OK;
+static void vScanParallelFinalize (vFullScanCursor *c, vscan_parallel *p) {
+    // merge the shard collectors into the cursor one and release them
+    for (int i=0; i<p->nshards; ++i) {
+        vector_topk *t = &p->shards[i].topk;
+        for (int j=0; j<t->count; ++j) {
+            vector_topk_push(&c->topk, t->distance[j], t->rowids[j]);
+        }
+        #if VECTOR_STATS
+        vector_stats_add(&c->stats, &p->shards[i].stats);
+        #endif
+    }
+    
+    if (p->shards) sqlite3_free(p->shards);
+    if (p->distance) sqlite3_free(p->distance);
+    if (p->rowids) sqlite3_free(p->rowids);
+    memset(p, 0, sizeof(vscan_parallel));
 }
 
-static int vFullScanBestIndex (sqlite3_vtab *tab, sqlite3_index_info *pIdxInfo) {
-    // With positional args to the table-valued function:
-    //   3 args: f('tbl','col',vector)      → columns 0,1,2 constrained (streaming)
-    //   4 args: f('tbl','col',vector,k)    → columns 0,1,2,3 constrained (top-k)
-    // Column 2 (K) always receives the vector blob (positional arg 2).
-    // Column 3 (MEMIDX) receives the actual k integer only with 4 args.
-    // So top-k mode is determined by whether MEMIDX is constrained, not K.
-    bool has_topk = false;
+// MARK: -
 
-    const struct sqlite3_index_constraint *pConstraint = pIdxInfo->aConstraint;
-    for(int i=0; i<pIdxInfo->nConstraint; i++, pConstraint++){
-        if( pConstraint->usable == 0 ) continue;
-        if( pConstraint->op != SQLITE_INDEX_CONSTRAINT_EQ ) continue;
-        switch( pConstraint->iColumn ){
-            case VECTOR_COLUMN_IDX:
-                pIdxInfo->aConstraintUsage[i].argvIndex = 1;
-                pIdxInfo->aConstraintUsage[i].omit = 1;
-                break;
-            case VECTOR_COLUMN_VECTOR:
-                pIdxInfo->aConstraintUsage[i].argvIndex = 2;
-                pIdxInfo->aConstraintUsage[i].omit = 1;
-                break;
-            case VECTOR_COLUMN_K:
-                pIdxInfo->aConstraintUsage[i].argvIndex = 3;
-                pIdxInfo->aConstraintUsage[i].omit = 1;
-                break;
-            case VECTOR_COLUMN_MEMIDX:
-                has_topk = true;
-                pIdxInfo->aConstraintUsage[i].argvIndex = 4;
-                pIdxInfo->aConstraintUsage[i].omit = 1;
-                break;
+static int vFullScanRunParallel (sqlite3 *db, vFullScanCursor *c, const void *v1, sqlite3_stmt *vm, vscan_parallel *p, size_t expected_bytes, int dist_size, distance_function_t distance_fn) {
+    // a connection cannot be stepped from several threads: rows are read here in batches of
+    // (rowid, vector) records and only the distance computation is spread across the pool
+    const size_t total_stride = sizeof(int64_t) + expected_bytes;
+    size_t batch = SCAN_BATCH_BYTES / total_stride;
+    if (batch < (size_t)p->nshards * SCAN_MIN_SHARD_RECORDS) batch = (size_t)p->nshards * SCAN_MIN_SHARD_RECORDS;
+    
+    uint8_t *records = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)(batch * total_stride));
+    if (!records) return SQLITE_NOMEM;
+    
+    int rc = SQLITE_OK;
+    int count = 0;
+    vector_stats *stats = vCursorStats(c);
+    while (1) {
+        rc = sqlite3_step(vm);
+        if (rc != SQLITE_ROW) break;
+        if (sqlite3_column_type(vm, 1) == SQLITE_NULL) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
+        
+        const void *v2 = sqlite3_column_blob(vm, 1);
+        if (v2 == NULL) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
+        if ((size_t)sqlite3_column_bytes(vm, 1) < expected_bytes) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
+        
+        uint8_t *record = records + ((size_t)count * total_stride);
+        int64_t rowid = (int64_t)sqlite3_column_int64(vm, 0);
+        INT64_TO_INT8PTR(rowid, record);
+        memcpy(record + sizeof(int64_t), v2, expected_bytes);
+        
+        if (++count == (int)batch) {
+            vector_records r = vector_chunk_records(VECTOR_CHUNK_FORMAT_INTERLEAVED, records, count, expected_bytes);
+            vScanParallelChunk(c, p, v1, &r, dist_size, distance_fn, NULL, 0.0f, NULL);
+            count = 0;
         }
     }
-
-    if (has_topk) {
-        // top-k mode: 4 positional args, argv[3] has the k integer
-        pIdxInfo->estimatedCost = (double)1;
-        pIdxInfo->estimatedRows = 100;
-        pIdxInfo->orderByConsumed = 1;
-        pIdxInfo->idxNum = 1;
-    } else {
-        // streaming mode: 3 positional args, no sorting guaranteed
-        pIdxInfo->estimatedCost = 1e8;
-        pIdxInfo->estimatedRows = 100000;
-        pIdxInfo->idxNum = 2;
+    
+    if (rc == SQLITE_DONE) {
+        vector_records r = vector_chunk_records(VECTOR_CHUNK_FORMAT_INTERLEAVED, records, count, expected_bytes);
+        if (count > 0) vScanParallelChunk(c, p, v1, &r, dist_size, distance_fn, NULL, 0.0f, NULL);
+        rc = SQLITE_OK;
     }
-
-    return SQLITE_OK;
+    
+    sqlite3_free(records);
+    return rc;
 }
 
-static int vFullScanCursorOpen (sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor){
-    vFullScanCursor *c = (vFullScanCursor *)sqlite3_malloc(sizeof(vFullScanCursor));
-    if (!c) return SQLITE_NOMEM;
+static int vFullScanPrepare (sqlite3 *db, vFullScanCursor *c, sqlite3_stmt **vm) {
+    // rows of the base table, restricted to the bounds of the rowid filter (a range seek of the primary key)
+    const char *pk_name = c->table->pk_name;
+    const char *col_name = c->table->c_name;
+    const char *table_name = c->table->t_name;
+    bool filtered = c->filter.active;
     
-    memset(c, 0, sizeof(vFullScanCursor));
-    *ppCursor = (sqlite3_vtab_cursor *)c;
-    return SQLITE_OK;
+    char *sql = (filtered) ? sqlite3_mprintf("SELECT %q, %q FROM %q WHERE %q BETWEEN ?1 AND ?2;", pk_name, col_name, table_name, pk_name) : sqlite3_mprintf("SELECT %q, %q FROM %q;", pk_name, col_name, table_name);
+    if (!sql) return SQLITE_NOMEM;
+    
+    int rc = sqlite3_prepare_v2(db, sql, -1, vm, NULL);
+    sqlite3_free(sql);
+    if (rc != SQLITE_OK) return rc;
+    
+    if (filtered) {
+        rc = sqlite3_bind_int64(*vm, 1, (sqlite3_int64)c->filter.lo);
+        if (rc == SQLITE_OK) rc = sqlite3_bind_int64(*vm, 2, (sqlite3_int64)c->filter.hi);
+    }
+    return rc;
 }
 
-static int vFullScanCursorClose (sqlite3_vtab_cursor *cur){
-    vFullScanCursor *c = (vFullScanCursor *)cur;
-    if (c->rowids) sqlite3_free(c->rowids);
-    if (c->distance) sqlite3_free(c->distance);
-    if (c->stream.vector) sqlite3_free(c->stream.vector);
-    if (c->stream.vm) sqlite3_finalize(c->stream.vm);
-    sqlite3_free(c);
-    return SQLITE_OK;
-}
+static int vFullScanRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
+    int dimension = c->table->options.v_dim;
+    vscan_parallel parallel = {0};
+    const vector_rowid_filter *filter = (c->filter.active) ? &c->filter : NULL;
+    vector_stats *stats = vCursorStats(c);
+    
+    sqlite3_stmt *vm = NULL;
+    int rc = vFullScanPrepare(db, c, &vm);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    // compute distance function
+    vector_type vt = c->table->options.v_type;
+    distance_function_t distance_fn = vector_distance_function(&c->table->options, vt);
+    int dist_size = (vt == VECTOR_TYPE_BIT) ? ((dimension + 7) / 8) : dimension;
 
-static int vFullScanCursorNext (sqlite3_vtab_cursor *cur){
-    vFullScanCursor *c = (vFullScanCursor *)cur;
+    size_t expected_bytes = vector_bytes_for_dim(vt, dimension);
+    
+    rc = vScanParallelInit(&parallel, c->options.threads, c->topk.capacity);
+    if (rc != SQLITE_OK) goto cleanup;
+    if (parallel.nshards > 0) {
+        rc = vFullScanRunParallel(db, c, v1, vm, &parallel, expected_bytes, dist_size, distance_fn);
+        goto cleanup;
+    }
 
-    // non-streaming flow
-    if (!c->is_streaming) { c->row_index++; return SQLITE_OK; }
+    while (1) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; goto cleanup;}
+        if (rc != SQLITE_ROW) goto cleanup;
+        if (filter && !vector_rowid_filter_contains(filter, (int64_t)sqlite3_column_int64(vm, 0))) continue;
+        if (sqlite3_column_type(vm, 1) == SQLITE_NULL) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
 
-    // streaming flow
-    sqlite3_stmt *vm = c->stream.vm;
-    void *v1 = c->stream.vector;
-    int dimension = c->stream.vdim;
-    distance_function_t distance_fn = c->stream.distance_fn;
+        float *v2 = (float *)sqlite3_column_blob(vm, 1);
+        if (v2 == NULL) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
+        if ((size_t)sqlite3_column_bytes(vm, 1) < expected_bytes) {VECTOR_STATS_ADD(stats, rows_skipped, 1); continue;}
 
-    // FULL-SCAN
-    if (!c->is_quantized) {
-        // For BIT type, use byte count instead of dimension
-        vector_type vt = c->table->options.v_type;
-        int dist_size = (vt == VECTOR_TYPE_BIT) ? ((dimension + 7) / 8) : dimension;
-        size_t expected_bytes = vector_bytes_for_dim(vt, dimension);
-        while (1) {
-            int rc = sqlite3_step(vm);
-            if (rc == SQLITE_DONE) { c->stream.is_eof = 1; return SQLITE_OK; }
-            else if (rc != SQLITE_ROW) return rc;
+        VECTOR_STATS_KERNEL_BEGIN(stats);
+        float distance = distance_fn((const void *)v1, (const void *)v2, dist_size);
+        VECTOR_STATS_KERNEL_END(stats);
+        VECTOR_STATS_ADD(stats, rows_scanned, 1);
+        VECTOR_STATS_ADD(stats, bytes_touched, expected_bytes);
+        if (nearly_zero_float32(distance)) distance = 0.0;
+        VECTOR_PRINT((void*)v2, vt, dimension);
+        
+        if (distance <= vector_topk_threshold(&c->topk)) {
+            if (vector_topk_push(&c->topk, distance, (int64_t)sqlite3_column_int64(vm, 0))) VECTOR_STATS_ADD(stats, heap_updates, 1);
+        }
+    }
+    
+cleanup:
+    vScanParallelFinalize(c, &parallel);
+    if (vm) sqlite3_finalize(vm);
+    return rc;
+}
+
+static int vFullScanCursorFilter (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    return vCursorFilterCommon(cur, idxNum, idxStr, argc, argv, "vector_full_scan", vFullScanRun, vFullScanSortSlots, vStreamScanCursorRun, false);
+}
 
-            // skip NULL values
-            if (sqlite3_column_type(vm, 1) == SQLITE_NULL) continue;
+// MARK: -
 
-            const float *v2 = (const float *)sqlite3_column_blob(vm, 1);
-            if (v2 == NULL) continue;
+static distance_function_t vQuantDistanceFunction (vector_qtype qtype, vector_distance vd, distance_batch_function_t *batch_fn) {
+    vector_type vt = (qtype == VECTOR_QUANT_U8BIT) ? VECTOR_TYPE_U8 : VECTOR_TYPE_I8;
+    if (qtype == VECTOR_QUANT_U4BIT) vt = VECTOR_TYPE_U4;
+    if (qtype == VECTOR_QUANT_S4BIT) vt = VECTOR_TYPE_I4;
+    if (qtype == VECTOR_QUANT_1BIT) {
+        // in case of 1BIT quantization force distance to alway be hamming
+        vt = VECTOR_TYPE_BIT;
+        vd = VECTOR_DISTANCE_HAMMING;
+    }
+    if (batch_fn) *batch_fn = dispatch_distance_batch_table[vd][vt];
+    return dispatch_distance_table[vd][vt];
+}
 
-            // skip undersized blobs
-            if ((size_t)sqlite3_column_bytes(vm, 1) < expected_bytes) continue;
+static int vQuantProbeLists (table_context *t, const void *v1, int nprobe, int *probes) {
+    // select the nprobe posting lists whose centroids are closest to the query (in ascending distance order)
+    int dim = t->options.v_dim;
+    int nlist = t->ivf_nlist;
+    
+    float *v = (float *)sqlite3_malloc64((sqlite3_uint64)dim * sizeof(float));
+    double *distance = (double *)sqlite3_malloc64((sqlite3_uint64)nprobe * sizeof(double));
+    int64_t *lists = (int64_t *)sqlite3_malloc64((sqlite3_uint64)nprobe * sizeof(int64_t));
+    if (!v || !distance || !lists) {
+        if (v) sqlite3_free(v);
+        if (distance) sqlite3_free(distance);
+        if (lists) sqlite3_free(lists);
+        return -1;
+    }
+    
+    vector_to_float32(v1, t->options.v_type, v, dim);
+    distance_function_t distance_fn = ivf_distance_function(t->options.v_distance);
+    
+    vector_topk topk;
+    vector_topk_init(&topk, distance, lists, nprobe);
+    for (int i=0; i<nlist; ++i) {
+        // NaN distances (zero centroids with cosine) still have to be reachable
+        float d = distance_fn((const void *)v, (const void *)(t->ivf_centroids + (size_t)i * dim), dim);
+        vector_topk_push(&topk, isnan(d) ? FLT_MAX : d, i);
+    }
+    int count = vector_topk_sort(&topk);
+    for (int i=0; i<count; ++i) probes[i] = (int)lists[i];
+    
+    sqlite3_free(v);
+    sqlite3_free(distance);
+    sqlite3_free(lists);
+    return count;
+}
 
-            float distance = distance_fn((const void *)v1, (const void *)v2, dist_size);
-            if (nearly_zero_float32(distance)) distance = 0.0f;
+static bool vQuantCachedNorms (const table_context *t, const vector_preload *preload) {
+    // true if a scan of the preloaded records can use the cached norms of the codes (see vector_preload_norms)
+    vector_qtype qtype = t->options.q_type;
+    if (!preload || !preload->norms || t->qcalib || t->options.v_distance != VECTOR_DISTANCE_COSINE) return false;
+    return (qtype == VECTOR_QUANT_U8BIT || qtype == VECTOR_QUANT_S8BIT);
+}
 
-            c->stream.distance = distance;
-            c->stream.rowid = (int64_t)sqlite3_column_int64(vm, 0);
-            return SQLITE_OK;
+// codes compared by a quantized scan: the whole code of every record, or one of the levels of a cascaded quantization
+typedef struct {
+    vector_qtype        qtype;              // quantization of the compared codes (1BIT for the first pass of a cascade)
+    size_t              code_size;          // bytes of the code of a record (every level)
+    size_t              offset;             // position of the compared codes inside the code of a record
+    size_t              size;               // bytes of the compared codes (n argument of distance_fn)
+    distance_function_t distance_fn;
+    distance_batch_function_t batch_fn;     // NULL if not available
+} vquant_level;
+
+static int vQuantRunMemory (vFullScanCursor *c, vscan_parallel *p, const void *v, const vquant_level *level, const int *probes, int nprobe, const vector_tombstones *dead) {
+    // preloaded records are always in the split layout
+    vector_records all = vector_chunk_records(VECTOR_CHUNK_FORMAT_SPLIT, c->preload->data, c->preload->counter, level->code_size);
+    vector_records records = vector_records_level(&all, level->offset, level->size);
+    size_t vector_size = level->size;
+    distance_function_t distance_fn = level->distance_fn;
+    distance_batch_function_t batch_fn = level->batch_fn;
+    
+    // COSINE over 8-bit codes with cached norms: only the dot product is computed per record
+    float qnorm = 0.0f;
+    vector_qtype qtype = level->qtype;
+    if (qtype != VECTOR_QUANT_1BIT && vQuantCachedNorms(c->table, c->preload)) {
+        records.norms = c->preload->norms;
+        qnorm = vector_code_norm((const uint8_t *)v, (int)vector_size, (qtype == VECTOR_QUANT_S8BIT));
+        distance_fn = vQuantDistanceFunction(qtype, VECTOR_DISTANCE_DOT, &batch_fn);
+    }
+    
+    // IVF: scan only the probed posting lists (offsets must describe the current index)
+    const int *lists = c->preload->lists;
+    if (probes && lists && c->preload->lists_count == c->table->ivf_nlist) {
+        for (int i = 0; i < nprobe; ++i) {
+            int start = lists[probes[i] * 2];
+            int count = lists[probes[i] * 2 + 1];
+            if (count <= 0) continue;
+            vector_records list = vector_records_slice(&records, start, count);
+            vScanParallelChunk(c, p, v, &list, (int)vector_size, distance_fn, batch_fn, qnorm, dead);
         }
+        return SQLITE_OK;
     }
+    
+    vScanParallelChunk(c, p, v, &records, (int)vector_size, distance_fn, batch_fn, qnorm, dead);
+    return SQLITE_OK;
+}
 
-    // QUANTIZATION sizes
-    const size_t rowid_size = sizeof(int64_t);
-    const size_t vector_size = (size_t)c->stream.vsize;  // correctly set by caller for 1-bit or 8-bit
-    const size_t total_stride = rowid_size + vector_size;
-
-    // QUANTIZED IN-MEMORY
-    if (vm == NULL) {
-        if ((c->is_quantized == false) || (c->stream.data == NULL)) return SQLITE_MISUSE;
+static int vQuantRunChunks (sqlite3 *db, vFullScanCursor *c, vscan_parallel *p, const char *sql, const int *probes, int nprobe, const void *v, const vquant_level *level, const vector_tombstones *dead) {
+    sqlite3_stmt *vm = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto vquant_chunks_cleanup;
+    
+    // filtered scan: the *_range statements skip the chunks whose rowids are outside the filter bounds
+    if (c->filter.active) {
+        rc = sqlite3_bind_int64(vm, 2, (sqlite3_int64)c->filter.lo);
+        if (rc == SQLITE_OK) rc = sqlite3_bind_int64(vm, 3, (sqlite3_int64)c->filter.hi);
+        if (rc != SQLITE_OK) goto vquant_chunks_cleanup;
+    }
+    
+    // one round per probed posting list, or a single round over the whole statement
+    const int format = c->table->chunk_format;
+    int nrounds = (probes) ? nprobe : 1;
+    for (int round = 0; round < nrounds; ++round) {
+        if (probes) {
+            sqlite3_reset(vm);
+            rc = sqlite3_bind_int(vm, 1, probes[round]);
+            if (rc != SQLITE_OK) goto vquant_chunks_cleanup;
+        }
+        
+        while (1) {
+            rc = sqlite3_step(vm);
+            if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;} // return error: rebuild must be call (only if first time run)
+            else if (rc != SQLITE_ROW) goto vquant_chunks_cleanup;
+            
+            int counter = sqlite3_column_int(vm, 0);
+            const uint8_t *data = (const uint8_t *)sqlite3_column_blob(vm, 1);
+            if (counter <= 0 || (size_t)sqlite3_column_bytes(vm, 1) < vector_chunk_bytes(format, (size_t)counter, level->code_size)) continue;
+            VECTOR_STATS_ADD(vCursorStats(c), chunks_read, 1);
+            vector_records chunk = vector_chunk_records(format, data, counter, level->code_size);
+            vector_records records = vector_records_level(&chunk, level->offset, level->size);
+            vScanParallelChunk(c, p, v, &records, (int)level->size, level->distance_fn, level->batch_fn, 0.0f, dead);
+        }
+    }
+    
+    rc = SQLITE_OK;
+    
+vquant_chunks_cleanup:
+    if (rc != SQLITE_OK) printf("Error in vector_rebuild_quantization: %s\n", sqlite3_errmsg(db));
+    if (vm) sqlite3_finalize(vm);
+    return rc;
+}
 
-        // EOF if we've already consumed all items
-        if (c->stream.dindex >= c->stream.dcounter) {
-            c->stream.is_eof = 1;
-            return SQLITE_OK;
+static int vQuantRerankTopk (sqlite3 *db, table_context *t, vector_topk *topk, int k, const void *v1) {
+    // re-score the candidates collected by the quantized pass using the original vectors
+    // and keep only the k best ones (in the same collector storage)
+    int count = topk->count;
+    if (count == 0) return SQLITE_OK;
+    
+    int64_t *candidates = (int64_t *)sqlite3_malloc64((sqlite3_uint64)count * sizeof(int64_t));
+    if (!candidates) return SQLITE_NOMEM;
+    memcpy(candidates, topk->rowids, (size_t)count * sizeof(int64_t));
+    
+    // visit candidates in rowid order to maximize b-tree page locality
+    qsort(candidates, (size_t)count, sizeof(int64_t), vector_rowid_compare);
+    
+    const char *pk_name = t->pk_name;
+    const char *col_name = t->c_name;
+    const char *table_name = t->t_name;
+    int dimension = t->options.v_dim;
+    
+    vector_type vt = t->options.v_type;
+    distance_function_t distance_fn = vector_distance_function(&t->options, vt);
+    int dist_size = (vt == VECTOR_TYPE_BIT) ? ((dimension + 7) / 8) : dimension;
+    size_t expected_bytes = vector_bytes_for_dim(vt, dimension);
+    
+    vector_topk_init(topk, topk->distance, topk->rowids, k);
+    
+    char sql[STATIC_SQL_SIZE];
+    sqlite3_snprintf(sizeof(sql), sql, "SELECT %q FROM %q WHERE %q = ?;", col_name, table_name, pk_name);
+    sqlite3_stmt *vm = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto vquant_rerank_cleanup;
+    
+    for (int i = 0; i < count; ++i) {
+        sqlite3_bind_int64(vm, 1, (sqlite3_int64)candidates[i]);
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_ROW) {
+            const void *v2 = sqlite3_column_blob(vm, 0);
+            if (v2 && (size_t)sqlite3_column_bytes(vm, 0) >= expected_bytes) {
+                float distance = distance_fn(v1, v2, dist_size);
+                if (nearly_zero_float32(distance)) distance = 0.0;
+                vector_topk_push(topk, distance, candidates[i]);
+            }
+        } else if (rc != SQLITE_DONE) {
+            // rows deleted after vector_quantize are simply skipped
+            goto vquant_rerank_cleanup;
         }
+        sqlite3_reset(vm);
+    }
+    rc = SQLITE_OK;
+    
+vquant_rerank_cleanup:
+    if (vm) sqlite3_finalize(vm);
+    sqlite3_free(candidates);
+    return rc;
+}
 
-        const uint8_t *data = (const uint8_t *)c->stream.data;
-        size_t i = (size_t)c->stream.dindex;
+static int vQuantRerank (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
+    return vQuantRerankTopk(db, c->table, &c->topk, c->k, v1);
+}
 
-        const uint8_t *current_data = data + (i * total_stride);
-        const uint8_t *vector_data  = current_data + rowid_size;
+static uint8_t *vQuantQueryCreate (table_context *t, const void *v1, distance_function_t *distance_fn, distance_batch_function_t *batch_fn) {
+    // returns the query in the quantized domain: a quantized vector, the ADC lookup tables for PQ or a float32 query for per-dimension calibrated codes
+    // (batch kernels exist only for quantized vectors, batch_fn is set to NULL otherwise)
+    if (batch_fn) *batch_fn = NULL;
+    int dimension = t->options.v_dim;
+    vector_qtype qtype = t->options.q_type;
+    if (qtype == VECTOR_QUANT_PQ) return (uint8_t *)pq_query_create(t, v1, distance_fn);
+    if (t->qcalib) return (uint8_t *)calib_query_create(t, v1, distance_fn);
+    
+    uint8_t *v = (uint8_t *)sqlite3_malloc64(quant_bytes_for_dim(qtype, dimension, &t->pq));
+    if (!v) return NULL;
+    
+    quantize_vector(v1, v, t->options.v_type, dimension, qtype, t->offset, t->scale, t->binary_mean);
+    *distance_fn = vQuantDistanceFunction(qtype, t->options.v_distance, batch_fn);
+    return v;
+}
 
-        
-        // no NULL vectors here by construction
-        float distance = distance_fn((const void *)v1, (const void *)vector_data, c->stream.vsize);
-        if (nearly_zero_float32(distance)) distance = 0.0f;
+static uint8_t *vQuantQueryBits (table_context *t, const void *v1) {
+    // cascade: the 1BIT code of the query, derived from its 8-bit code exactly like the ones of the records
+    int dimension = t->options.v_dim;
+    vector_qtype qtype = t->options.q_type;
+    size_t level = quant_level_bytes(true, dimension);
+    
+    uint8_t *bits = (uint8_t *)sqlite3_malloc64(level + (sqlite3_uint64)dimension);
+    float *scratch = (t->qcalib) ? (float *)sqlite3_malloc64((sqlite3_uint64)dimension * sizeof(float)) : NULL;
+    if (!bits || (t->qcalib && !scratch)) {
+        if (bits) sqlite3_free(bits);
+        if (scratch) sqlite3_free(scratch);
+        return NULL;
+    }
+    
+    uint8_t *code = bits + level;
+    if (t->qcalib) quantize_vector_calibrated(v1, code, t->options.v_type, dimension, qtype, t->qcalib, scratch);
+    else quantize_vector(v1, code, t->options.v_type, dimension, qtype, t->offset, t->scale, t->binary_mean);
+    quantize_code_bits(code, bits, qtype, dimension);
+    
+    if (scratch) sqlite3_free(scratch);
+    return bits;
+}
 
-        c->stream.distance = distance;
-        c->stream.rowid    = INT64_FROM_INT8PTR(current_data);
-        c->stream.dindex++;
-        return SQLITE_OK;
+static int vQuantRunPass (sqlite3 *db, vFullScanCursor *c, const void *v, const vquant_level *level, const int *probes, int nprobe) {
+    // compares the query with the codes of level of every record (inside the probed lists and the rowid filter, if any)
+    vscan_parallel parallel;
+    if (vScanParallelInit(&parallel, c->options.threads, c->topk.capacity) != SQLITE_OK) return SQLITE_NOMEM;
+    
+    // auto update: tombstones mask the base records of changed rows, their new records live in delta chunks
+    const vector_tombstones *dead = (c->dead.count > 0) ? &c->dead : NULL;
+    bool auto_update = c->table->options.auto_update;
+    const char *t_name = c->table->t_name;
+    const char *c_name = c->table->c_name;
+    char sql[STATIC_SQL_SIZE];
+    int rc = SQLITE_OK;
+    
+    bool filtered = c->filter.active;
+    if (c->preload) {
+        rc = vQuantRunMemory(c, &parallel, v, level, probes, nprobe, dead);
+    } else {
+        if (probes) (filtered) ? generate_select_quant_list_range(t_name, c_name, sql) : generate_select_quant_list(t_name, c_name, sql);
+        else if (auto_update) (filtered) ? generate_select_quant_base_range(t_name, c_name, sql) : generate_select_quant_base(t_name, c_name, sql);
+        else (filtered) ? generate_select_quant_table_range(t_name, c_name, sql) : generate_select_quant_table(t_name, c_name, sql);
+        rc = vQuantRunChunks(db, c, &parallel, sql, probes, nprobe, v, level, dead);
+    }
+    
+    // delta chunks are never preloaded and always scanned (whatever the probed lists)
+    if (rc == SQLITE_OK && auto_update) {
+        (filtered) ? generate_select_quant_deltas_range(t_name, c_name, sql) : generate_select_quant_deltas(t_name, c_name, sql);
+        rc = vQuantRunChunks(db, c, &parallel, sql, NULL, 0, v, level, NULL);
     }
+    
+    vScanParallelFinalize(c, &parallel);
+    return rc;
+}
 
-    // QUANTIZED FROM DISK (chunked)
-    if (c->stream.dcounter == 0) {
-        int rc = sqlite3_step(vm);
-        if (rc == SQLITE_DONE) { c->stream.is_eof = 1; return SQLITE_OK; }
-        else if (rc != SQLITE_ROW) return rc;
+static int vQuantRunCascade (sqlite3 *db, vFullScanCursor *c, const void *v1, const void *v, const vquant_level *level, const int *probes, int nprobe) {
+    // first pass: the Hamming distance over the 1BIT codes collects the k*cascade best candidates,
+    // second pass: only the 8-bit codes of the candidates are compared with the query (level)
+    table_context *t = c->table;
+    vquant_level bits_level = *level;
+    bits_level.qtype = VECTOR_QUANT_1BIT;
+    bits_level.offset = 0;
+    bits_level.size = level->offset;
+    bits_level.distance_fn = vQuantDistanceFunction(VECTOR_QUANT_1BIT, t->options.v_distance, &bits_level.batch_fn);
+    
+    int64_t n = (int64_t)c->topk.capacity * (int64_t)c->options.cascade;
+    int slots = (n > INT_MAX / (int)sizeof(double)) ? INT_MAX / (int)sizeof(double) : (int)n;
+    uint8_t *bits = vQuantQueryBits(t, v1);
+    double *distance = (double *)sqlite3_malloc64((sqlite3_uint64)slots * sizeof(double));
+    int64_t *rowids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)slots * sizeof(int64_t));
+    vector_rowid_filter candidates = {0};
+    int rc = SQLITE_NOMEM;
+    if (!bits || !distance || !rowids) goto vquant_cascade_cleanup;
+    
+    // the cursor collector is swapped with the larger one of the first pass
+    vector_topk topk = c->topk;
+    vector_topk_init(&c->topk, distance, rowids, slots);
+    rc = vQuantRunPass(db, c, bits, &bits_level, probes, nprobe);
+    int count = c->topk.count;
+    c->topk = topk;
+    if (rc != SQLITE_OK || count == 0) goto vquant_cascade_cleanup;
+    
+    // the candidates already satisfy the rowid filter of the cursor, so they replace it for the second pass
+    vector_rowid_filter_free(&candidates);
+    rc = vector_rowid_filter_restrict(&candidates, rowids, count);
+    rowids = NULL;
+    if (rc != SQLITE_OK) goto vquant_cascade_cleanup;
+    vector_rowid_filter_finalize(&candidates);
+    candidates.active = true;
+    
+    vector_rowid_filter filter = c->filter;
+    c->filter = candidates;
+    rc = vQuantRunPass(db, c, v, level, probes, nprobe);
+    c->filter = filter;
+    
+vquant_cascade_cleanup:
+    vector_rowid_filter_free(&candidates);
+    if (bits) sqlite3_free(bits);
+    if (distance) sqlite3_free(distance);
+    if (rowids) sqlite3_free(rowids);
+    return rc;
+}
 
-        c->stream.dcounter = sqlite3_column_int(vm, 0);
-        c->stream.data     = (uint8_t *)sqlite3_column_blob(vm, 1);
-        c->stream.dindex   = 0; // reset index for the new chunk
+static int vQuantRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
+    table_context *t = c->table;
+    int dimension = t->options.v_dim;
+    vector_qtype qtype = t->options.q_type;
+    
+    // quantize target vector (compared with the 8-bit level of a cascaded quantization)
+    vquant_level level = {0};
+    uint8_t *v = vQuantQueryCreate(t, v1, &level.distance_fn, &level.batch_fn);
+    if (!v) return SQLITE_NOMEM;
+    level.qtype = qtype;
+    level.offset = quant_level_bytes(t->binary_level, dimension);
+    level.size = quant_bytes_for_dim(qtype, dimension, &t->pq);
+    level.code_size = level.offset + level.size;
+    
+    // IVF: restrict the scan to the nprobe closest posting lists (nprobe >= nlist is an exhaustive scan)
+    int *probes = NULL;
+    int nprobe = (c->options.nprobe > 0) ? c->options.nprobe : DEFAULT_IVF_NPROBE;
+    if (t->ivf_centroids && nprobe < t->ivf_nlist) {
+        probes = (int *)sqlite3_malloc64((sqlite3_uint64)nprobe * sizeof(int));
+        if (!probes) {sqlite3_free(v); return SQLITE_NOMEM;}
+        nprobe = vQuantProbeLists(t, v1, nprobe, probes);
+        if (nprobe < 0) {sqlite3_free(v); sqlite3_free(probes); return SQLITE_NOMEM;}
     }
 
-    const uint8_t *data = (const uint8_t *)c->stream.data;
-    size_t i = (size_t)c->stream.dindex;
-
-    const uint8_t *current_data = data + (i * total_stride);
-    const uint8_t *vector_data  = current_data + rowid_size;
+    #if DEBUG_VECTOR_SERIALIZATION
+    vector_type qprint = (qtype == VECTOR_QUANT_1BIT) ? VECTOR_TYPE_BIT : (qtype == VECTOR_QUANT_U8BIT) ? VECTOR_TYPE_U8 : VECTOR_TYPE_I8;
+    if (qtype != VECTOR_QUANT_PQ && !quant_is_4bit(qtype)) VECTOR_PRINT((void*)v, qprint, dimension);
+    #endif
+    
+    // cascade=0 compares the query with the 8-bit codes of every record
+    int rc;
+    if (t->binary_level && c->options.cascade > 0) rc = vQuantRunCascade(db, c, v1, v, &level, probes, nprobe);
+    else rc = vQuantRunPass(db, c, v, &level, probes, nprobe);
+    
+    if (v) sqlite3_free(v);
+    if (probes) sqlite3_free(probes);
+    if (rc == SQLITE_OK && c->options.rerank > 0) rc = vQuantRerank(db, c, v1, v1size);
+    return rc;
+}
 
-    float distance = distance_fn((const void *)v1, (const void *)vector_data, c->stream.vsize);
-    if (nearly_zero_float32(distance)) distance = 0.0f;
+static int vQuantCursorFilter (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    return vCursorFilterCommon(cur, idxNum, idxStr, argc, argv, "vector_quantize_scan", vQuantRun, vFullScanSortSlots, vStreamQuantCursorRun, true);
+}
 
-    c->stream.distance = distance;
-    c->stream.rowid    = INT64_FROM_INT8PTR(current_data);
-    c->stream.dindex++;
+// MARK: - Batch Scan -
 
-    if (c->stream.dindex == c->stream.dcounter) {
-        // finished current chunk; force reload on next call
-        c->stream.dcounter = 0;
-        c->stream.data = NULL; // clear stale pointer to blob memory
-    }
+// vector_quantize_scan_batch(table, column, queries, nq, k [, options]) answers nq top-k queries in a single pass over
+// the quantized records. Records are walked in tiles of about SCAN_QUERY_TILE_BYTES of codes and every tile is compared
+// with all the queries before moving to the next one (the blocking of a matrix product), so a code is brought into the
+// cache once per tile instead of once per query. Every query keeps its own collector: its rows are the ones returned by
+// vector_quantize_scan with the same arguments. With threads=N the queries (not the records) are split across the pool,
+// so no collector is shared between tasks.
 
-    return SQLITE_OK;
-}
+typedef struct {
+    uint8_t             *v;                 // query in the quantized domain (see vQuantQueryCreate)
+    float               qnorm;              // norm of the quantized query (cached norms only)
+    vector_topk         topk;               // sorted once the scan completes
+    vector_stats        stats;              // private counters (added to the table ones when the scan completes)
+} vbatch_query;
 
+typedef struct {
+    sqlite3_vtab_cursor base;               // Base class - must be first
+    table_context       *table;
+    vector_options      options;            // table options overridden by the optional per-query options argument
+    vector_tombstones   dead;               // tombstones loaded when the scan starts
+    vector_preload      *preload;           // preloaded records pinned for the whole scan (NULL = chunks read from disk)
+    
+    vbatch_query        *queries;
+    int                 nq;
+    int64_t             *rowids;            // nq x slots backing storage of the collectors
+    double              *distance;
+    int                 query_index;        // current row: query and position in its sorted collector
+    int                 row_index;
+} vBatchScanCursor;
 
-static int vFullScanCursorEof (sqlite3_vtab_cursor *cur){
-    vFullScanCursor *c = (vFullScanCursor *)cur;
-    return (c->is_streaming) ? c->stream.is_eof : (c->row_index == c->row_count);
+// a set of records compared with a subset of the queries
+typedef struct {
+    vbatch_query        *queries;
+    const int           *subset;            // indexes of the queries of the round
+    int                 nsubset;
+    int                 nparts;             // the subset is split into nparts contiguous parts (one task each)
+    vector_records      records;
+    int                 dist_n;
+    size_t              code_offset;        // cascade: bytes of the 1BIT code that precedes the compared 8-bit code (0 otherwise)
+    distance_function_t distance_fn;
+    distance_batch_function_t batch_fn;
+    const vector_tombstones *dead;          // records to skip (NULL if none)
+    bool                collect;            // true if the query counters are collected
+} vbatch_round;
+
+static inline vector_stats *vBatchScanStats (vBatchScanCursor *c) {
+    // counters of the scanned table (NULL if not collected), only updated by the thread that steps the cursor
+    #if VECTOR_STATS
+    return (c->options.stats && c->table) ? &c->table->stats : NULL;
+    #else
+    return NULL;
+    #endif
 }
 
-static int vFullScanCursorColumn (sqlite3_vtab_cursor *cur, sqlite3_context *context, int iCol) {
-    vFullScanCursor *c = (vFullScanCursor *)cur;
-    if (iCol == VECTOR_COLUMN_ROWID) {
-        sqlite3_result_int64(context, (c->is_streaming) ? (sqlite3_int64)c->stream.rowid : (sqlite3_int64)c->rowids[c->row_index]);
-    } else if (iCol == VECTOR_COLUMN_DISTANCE) {
-        sqlite3_result_double(context, (c->is_streaming) ? c->stream.distance : c->distance[c->row_index]);
+static void vBatchScanPart (vbatch_round *r, int first, int last) {
+    int count = r->records.count;
+    int tile = (int)(SCAN_QUERY_TILE_BYTES / r->records.code_size) / SCAN_DISTANCE_BLOCK * SCAN_DISTANCE_BLOCK;
+    if (tile < SCAN_DISTANCE_BLOCK) tile = SCAN_DISTANCE_BLOCK;
+    
+    for (int start = 0; start < count; start += tile) {
+        vector_records records = vector_records_slice(&r->records, start, (count - start < tile) ? count - start : tile);
+        for (int i = first; i < last; ++i) {
+            vbatch_query *q = &r->queries[r->subset[i]];
+            vScanRecords(&q->topk, q->v, &records, r->dist_n, r->distance_fn, r->batch_fn, q->qnorm, r->dead, NULL, (r->collect) ? &q->stats : NULL);
+        }
     }
-    return SQLITE_OK;
 }
 
-static int vFullScanCursorRowid (sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
-    vFullScanCursor *c = (vFullScanCursor *)cur;
-    *pRowid = (c->is_streaming) ? (sqlite3_int64)c->stream.rowid : (sqlite_int64)c->rowids[c->row_index];
-    return SQLITE_OK;
+static void vBatchScanTask (void *arg, int index) {
+    vbatch_round *r = (vbatch_round *)arg;
+    int first = (int)((int64_t)r->nsubset * index / r->nparts);
+    int last = (int)((int64_t)r->nsubset * (index + 1) / r->nparts);
+    vBatchScanPart(r, first, last);
 }
 
-static inline int vFullScanFindMaxIndex (double *values, int n) {
-    int max_idx = 0;
-    if (n <= 32) {
-        // use simple version
-        for (int i = 1; i < n; ++i) {
-            if (values[i] > values[max_idx]) {max_idx = i;}
-        }
-        return max_idx;
-    }
+static void vBatchScanRound (vbatch_round *r, int threads) {
+    if (r->records.count <= 0 || r->nsubset <= 0) return;
     
-    // use unrolled version
-    double max_val = values[0];
-    int i = 1;
+    // small rounds are not worth the hand-off to the pool
+    int nparts = (threads < r->nsubset) ? threads : r->nsubset;
+    if (r->records.count < SCAN_MIN_SHARD_RECORDS || !vector_pool_is_parallel()) nparts = 1;
+    if (nparts <= 1) {
+        vBatchScanPart(r, 0, r->nsubset);
+        return;
+    }
     
-    // unroll loop in blocks of 4
-    for (; i + 3 < n; i += 4) {
-        if (values[i] > max_val) {max_val = values[i]; max_idx = i;}
-        if (values[i + 1] > max_val) {max_val = values[i + 1]; max_idx = i + 1;}
-        if (values[i + 2] > max_val) {max_val = values[i + 2]; max_idx = i + 2;}
-        if (values[i + 3] > max_val) {max_val = values[i + 3]; max_idx = i + 3;}
+    r->nparts = nparts;
+    vector_pool_run(nparts, vBatchScanTask, r);
+}
+
+static int vBatchScanChunks (sqlite3 *db, vBatchScanCursor *c, const char *sql, int list, vbatch_round *r) {
+    // every chunk returned by sql (bound to list if not negative) is one round
+    sqlite3_stmt *vm = NULL;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    if (rc != SQLITE_OK) goto vbatch_chunks_cleanup;
+    if (list >= 0) {
+        rc = sqlite3_bind_int(vm, 1, list);
+        if (rc != SQLITE_OK) goto vbatch_chunks_cleanup;
     }
     
-    // process remaining elements
-    for (; i < n; ++i) {
-        if (values[i] > max_val) {max_val = values[i]; max_idx = i;}
+    const int format = c->table->chunk_format;
+    size_t vector_size = (size_t)r->dist_n;
+    size_t code_size = r->code_offset + vector_size;
+    while (1) {
+        rc = sqlite3_step(vm);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;}
+        else if (rc != SQLITE_ROW) goto vbatch_chunks_cleanup;
+        
+        int counter = sqlite3_column_int(vm, 0);
+        const uint8_t *data = (const uint8_t *)sqlite3_column_blob(vm, 1);
+        if (counter <= 0 || (size_t)sqlite3_column_bytes(vm, 1) < vector_chunk_bytes(format, (size_t)counter, code_size)) continue;
+        VECTOR_STATS_ADD(vBatchScanStats(c), chunks_read, 1);
+        vector_records chunk = vector_chunk_records(format, data, counter, code_size);
+        r->records = vector_records_level(&chunk, r->code_offset, vector_size);
+        vBatchScanRound(r, c->options.threads);
     }
-    return max_idx;
+    
+vbatch_chunks_cleanup:
+    if (vm) sqlite3_finalize(vm);
+    return rc;
 }
 
-static int vFullScanSortSlots (vFullScanCursor *c) {
-    int     counter = 0;
-    int     row_count = c->row_count;
-    double  *distance = c->distance;
-    int64_t *rowids = c->rowids;
-    
-    for (int i = 0; i < row_count - 1; ++i) {
-        if (distance[i] == INFINITY) ++counter;
-        for (int j = i + 1; j < row_count; ++j) {
-            if (distance[j] < distance[i]) {
-                SWAP(double, distance[i], distance[j]);
-                SWAP(int64_t, rowids[i], rowids[j]);
+static int vBatchScanRun (sqlite3 *db, vBatchScanCursor *c, const uint8_t *vectors, size_t vbytes, int k) {
+    table_context *t = c->table;
+    vector_qtype qtype = t->options.q_type;
+    const size_t vector_size = quant_bytes_for_dim(qtype, t->options.v_dim, &t->pq);
+    const int nq = c->nq;
+    
+    // every query is quantized (or gets its lookup tables) exactly as in vector_quantize_scan
+    distance_function_t distance_fn = NULL;
+    distance_batch_function_t batch_fn = NULL;
+    for (int i=0; i<nq; ++i) {
+        c->queries[i].v = vQuantQueryCreate(t, (const void *)(vectors + (size_t)i * vbytes), &distance_fn, &batch_fn);
+        if (!c->queries[i].v) return SQLITE_NOMEM;
+    }
+    
+    // COSINE over preloaded 8-bit codes with cached norms: only the dot product is computed per record
+    bool cached = vQuantCachedNorms(t, c->preload);
+    distance_function_t dot_fn = NULL;
+    distance_batch_function_t dot_batch_fn = NULL;
+    if (cached) {
+        dot_fn = vQuantDistanceFunction(qtype, VECTOR_DISTANCE_DOT, &dot_batch_fn);
+        for (int i=0; i<nq; ++i) c->queries[i].qnorm = vector_code_norm(c->queries[i].v, (int)vector_size, (qtype == VECTOR_QUANT_S8BIT));
+    }
+    
+    // IVF: queries are grouped by probed posting list (members[starts[l]..starts[l+1]) probe list l),
+    // so that every list is walked once for all the queries that probe it
+    int nlist = t->ivf_nlist;
+    int nprobe = (c->options.nprobe > 0) ? c->options.nprobe : DEFAULT_IVF_NPROBE;
+    bool probed = (t->ivf_centroids && nprobe < nlist);
+    size_t nmembers = (probed) ? (size_t)nq * nprobe : (size_t)nq;
+    int *members = (int *)sqlite3_malloc64((sqlite3_uint64)nmembers * sizeof(int));
+    int *probes = (probed) ? (int *)sqlite3_malloc64((sqlite3_uint64)nq * nprobe * sizeof(int)) : NULL;
+    int *starts = (probed) ? (int *)sqlite3_malloc64((sqlite3_uint64)(nlist + 1) * sizeof(int)) : NULL;
+    int rc = SQLITE_NOMEM;
+    if (!members || (probed && (!probes || !starts))) goto vbatch_run_cleanup;
+    
+    if (probed) {
+        memset(starts, 0, (size_t)(nlist + 1) * sizeof(int));
+        for (int i=0; i<nq; ++i) {
+            int *p = probes + (size_t)i * nprobe;
+            int n = vQuantProbeLists(t, (const void *)(vectors + (size_t)i * vbytes), nprobe, p);
+            if (n < 0) goto vbatch_run_cleanup;
+            for (int j=0; j<nprobe; ++j) {
+                if (j >= n) p[j] = -1;
+                else starts[p[j] + 1]++;
+            }
+        }
+        for (int l=0; l<nlist; ++l) starts[l + 1] += starts[l];
+        int *fill = (int *)sqlite3_malloc64((sqlite3_uint64)nlist * sizeof(int));
+        if (!fill) goto vbatch_run_cleanup;
+        memcpy(fill, starts, (size_t)nlist * sizeof(int));
+        for (int i=0; i<nq; ++i) {
+            for (int j=0; j<nprobe; ++j) {
+                int l = probes[(size_t)i * nprobe + j];
+                if (l >= 0) members[fill[l]++] = i;
             }
         }
+        sqlite3_free(fill);
+    } else {
+        for (int i=0; i<nq; ++i) members[i] = i;
     }
     
-    if (distance[row_count-1] == INFINITY) ++counter;
-    return counter;
-}
-
-static int vFullScanRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
-    const char *pk_name = c->table->pk_name;
-    const char *col_name = c->table->c_name;
-    const char *table_name = c->table->t_name;
-    int dimension = c->table->options.v_dim;
+    vbatch_round round = {0};
+    round.queries = c->queries;
+    round.dist_n = (int)vector_size;
+    round.code_offset = quant_level_bytes(t->binary_level, t->options.v_dim);
+    round.distance_fn = distance_fn;
+    round.batch_fn = batch_fn;
+    round.dead = (c->dead.count > 0) ? &c->dead : NULL;
+    round.collect = (vBatchScanStats(c) != NULL);
+    rc = SQLITE_OK;
     
-    char *sql = sqlite3_mprintf("SELECT %q, %q FROM %q;", pk_name, col_name, table_name);
-    if (!sql) return SQLITE_NOMEM;
+    if (c->preload) {
+        // preloaded records are always in the split layout
+        vector_records all = vector_chunk_records(VECTOR_CHUNK_FORMAT_SPLIT, c->preload->data, c->preload->counter, round.code_offset + vector_size);
+        vector_records records = vector_records_level(&all, round.code_offset, vector_size);
+        if (cached) {
+            records.norms = c->preload->norms;
+            round.distance_fn = dot_fn;
+            round.batch_fn = dot_batch_fn;
+        }
+        
+        // IVF: scan only the probed posting lists (offsets must describe the current index)
+        const int *lists = c->preload->lists;
+        if (probed && lists && c->preload->lists_count == nlist) {
+            for (int l=0; l<nlist; ++l) {
+                if (starts[l + 1] == starts[l] || lists[l * 2 + 1] <= 0) continue;
+                round.records = vector_records_slice(&records, lists[l * 2], lists[l * 2 + 1]);
+                round.subset = members + starts[l];
+                round.nsubset = starts[l + 1] - starts[l];
+                vBatchScanRound(&round, c->options.threads);
+            }
+        } else {
+            if (probed) for (int i=0; i<nq; ++i) members[i] = i;
+            round.records = records;
+            round.subset = members;
+            round.nsubset = nq;
+            vBatchScanRound(&round, c->options.threads);
+        }
+        round.distance_fn = distance_fn;
+        round.batch_fn = batch_fn;
+    } else {
+        char sql[STATIC_SQL_SIZE];
+        if (probed) {
+            generate_select_quant_list(t->t_name, t->c_name, sql);
+            for (int l=0; l<nlist && rc == SQLITE_OK; ++l) {
+                if (starts[l + 1] == starts[l]) continue;
+                round.subset = members + starts[l];
+                round.nsubset = starts[l + 1] - starts[l];
+                rc = vBatchScanChunks(db, c, sql, l, &round);
+            }
+        } else {
+            if (t->options.auto_update) generate_select_quant_base(t->t_name, t->c_name, sql);
+            else generate_select_quant_table(t->t_name, t->c_name, sql);
+            round.subset = members;
+            round.nsubset = nq;
+            rc = vBatchScanChunks(db, c, sql, -1, &round);
+        }
+    }
     
-    sqlite3_stmt *vm = NULL;
-    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
-    if (rc != SQLITE_OK) goto cleanup;
+    // delta chunks are never preloaded and always scanned by every query
+    if (rc == SQLITE_OK && t->options.auto_update) {
+        char sql[STATIC_SQL_SIZE];
+        generate_select_quant_deltas(t->t_name, t->c_name, sql);
+        for (int i=0; i<nq; ++i) members[i] = i;
+        round.subset = members;
+        round.nsubset = nq;
+        round.dead = NULL;
+        rc = vBatchScanChunks(db, c, sql, -1, &round);
+    }
     
-    // compute distance function
-    vector_distance vd = c->table->options.v_distance;
-    vector_type vt = c->table->options.v_type;
-    if (vt == VECTOR_TYPE_BIT) vd = VECTOR_DISTANCE_HAMMING;  // Force Hamming for BIT type
-    distance_function_t distance_fn = dispatch_distance_table[vd][vt];
-    int dist_size = (vt == VECTOR_TYPE_BIT) ? ((dimension + 7) / 8) : dimension;
+    for (int i=0; i<nq && rc == SQLITE_OK; ++i) {
+        if (c->options.rerank > 0) rc = vQuantRerankTopk(db, t, &c->queries[i].topk, k, (const void *)(vectors + (size_t)i * vbytes));
+        vector_topk_sort(&c->queries[i].topk);
+    }
+    
+    #if VECTOR_STATS
+    if (round.collect) {
+        for (int i=0; i<nq; ++i) vector_stats_add(&t->stats, &c->queries[i].stats);
+    }
+    #endif
+    
+vbatch_run_cleanup:
+    if (members) sqlite3_free(members);
+    if (probes) sqlite3_free(probes);
+    if (starts) sqlite3_free(starts);
+    return rc;
+}
 
-    size_t expected_bytes = vector_bytes_for_dim(vt, dimension);
+static void vBatchScanCursorReset (vBatchScanCursor *c) {
+    for (int i=0; i<c->nq; ++i) {
+        if (c->queries[i].v) sqlite3_free(c->queries[i].v);
+    }
+    if (c->queries) sqlite3_free(c->queries);
+    if (c->rowids) sqlite3_free(c->rowids);
+    if (c->distance) sqlite3_free(c->distance);
+    c->queries = NULL;
+    c->rowids = NULL;
+    c->distance = NULL;
+    c->nq = 0;
+    c->query_index = 0;
+    c->row_index = 0;
+}
 
+static uint8_t *vBatchScanParseQueries (vFullScan *vtab, table_context *t, const char *json, int nq, size_t vbytes) {
+    // JSON array of nq vectors, returned as nq contiguous blobs of vbytes bytes
+    uint8_t *vectors = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)nq * vbytes);
+    if (!vectors) {
+        sqlite_vtab_set_error(&vtab->base, "Out of memory: unable to allocate %d query vectors", nq);
+        return NULL;
+    }
+    
+    const char *p = json;
+    SKIP_SPACES(p);
+    if (*p++ != '[') goto parse_error;
+    
+    int count = 0;
     while (1) {
-        rc = sqlite3_step(vm);
-        if (rc == SQLITE_DONE) {rc = SQLITE_OK; goto cleanup;}
-        if (rc != SQLITE_ROW) goto cleanup;
-        if (sqlite3_column_type(vm, 1) == SQLITE_NULL) continue;
-
-        float *v2 = (float *)sqlite3_column_blob(vm, 1);
-        if (v2 == NULL) continue;
-        if ((size_t)sqlite3_column_bytes(vm, 1) < expected_bytes) continue;
-
-        float distance = distance_fn((const void *)v1, (const void *)v2, dist_size);
-        if (nearly_zero_float32(distance)) distance = 0.0;
-        VECTOR_PRINT((void*)v2, vt, dimension);
+        SKIP_SPACES(p);
+        if (*p == ']' && count > 0) break;
+        if (*p != '[' || count == nq) goto parse_error;
         
-        if (distance < c->distance[c->max_index]) {
-            c->distance[c->max_index] = distance;
-            c->rowids[c->max_index] = (int64_t)sqlite3_column_int64(vm, 0);
-            c->max_index = vFullScanFindMaxIndex(c->distance, c->row_count);
-        }
+        // every vector is parsed on its own copy (vector_from_json sizes its buffer on the rest of the string)
+        const char *end = strchr(p, ']');
+        if (!end) goto parse_error;
+        char *item = sqlite3_mprintf("%.*s", (int)(end - p + 1), p);
+        if (!item) goto parse_error;
+        int size = 0;
+        void *v = vector_from_json(NULL, &vtab->base, t->options.v_type, item, &size, t->options.v_dim);
+        sqlite3_free(item);
+        if (!v) {sqlite3_free(vectors); return NULL;}   // error already set inside vector_from_json
+        memcpy(vectors + (size_t)count * vbytes, v, vbytes);
+        sqlite3_free(v);
+        ++count;
+        
+        p = end + 1;
+        SKIP_SPACES(p);
+        if (*p == ',') ++p;
     }
     
-cleanup:
-    if (sql) sqlite3_free(sql);
-    if (vm) sqlite3_finalize(vm);
-    return rc;
+    if (count != nq) {
+        sqlite_vtab_set_error(&vtab->base, "vector_quantize_scan_batch: expected %d query vectors but found %d", nq, count);
+        sqlite3_free(vectors);
+        return NULL;
+    }
+    return vectors;
+    
+parse_error:
+    sqlite_vtab_set_error(&vtab->base, "vector_quantize_scan_batch: queries must be a JSON array of %d vectors", nq);
+    sqlite3_free(vectors);
+    return NULL;
 }
 
-static int vFullScanCursorFilter (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
-    return vCursorFilterCommon(cur, idxNum, idxStr, argc, argv, "vector_full_scan", vFullScanRun, vFullScanSortSlots, vStreamScanCursorRun, false);
+static int vBatchScanCursorFilter (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    const char *fname = "vector_quantize_scan_batch";
+    vBatchScanCursor *c = (vBatchScanCursor *)cur;
+    vFullScan *vtab = (vFullScan *)cur->pVtab;
+    vBatchScanCursorReset(c);
+    
+    if (argc < 5 || argc > 6) {
+        return sqlite_vtab_set_error(&vtab->base, "%s expects 5 or 6 arguments, but %d were provided", fname, argc);
+    }
+    
+    // SQLITE_TEXT, SQLITE_TEXT, SQLITE_BLOB or SQLITE_TEXT, SQLITE_INTEGER, SQLITE_INTEGER, SQLITE_TEXT
+    for (int i=0; i<argc; ++i) {
+        int actual_type = sqlite3_value_type(argv[i]);
+        bool valid = (i == 2) ? (actual_type == SQLITE_BLOB || actual_type == SQLITE_TEXT) : (i == 3 || i == 4) ? (actual_type == SQLITE_INTEGER) : (actual_type == SQLITE_TEXT);
+        if (!valid) {
+            const char *expected = (i == 2) ? "BLOB or TEXT" : (i == 3 || i == 4) ? "INTEGER" : "TEXT";
+            return sqlite_vtab_set_error(&vtab->base, "%s: argument %d must be of type %s (got %s)", fname, (i+1), expected, sqlite_type_name(actual_type));
+        }
+    }
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    table_context *t_ctx = vector_context_lookup(vtab->ctx, table_name, column_name);
+    if (!t_ctx) {
+        return sqlite_vtab_set_error(&vtab->base, "%s: unable to retrieve context", fname);
+    }
+    
+    // per-query options (if any) override the ones set in vector_init
+    c->options = t_ctx->options;
+    if (argc == 6) {
+        const char *arg_options = (const char *)sqlite3_value_text(argv[5]);
+        int rc = vector_query_options_parse(&vtab->base, fname, arg_options, &c->options);
+        if (rc != SQLITE_OK) return rc;
+    }
+    
+    int nq = sqlite3_value_int(argv[3]);
+    int k = sqlite3_value_int(argv[4]);
+    if (nq <= 0) return sqlite_vtab_set_error(&vtab->base, "%s: nq must be a positive integer (got %d)", fname, nq);
+    if (k <= 0) return sqlite_vtab_set_error(&vtab->base, "%s: k must be a positive integer (got %d)", fname, k);
+    
+    // queries: nq vectors of the column type, concatenated in a BLOB or as a JSON array
+    size_t vbytes = vector_bytes_for_dim(t_ctx->options.v_type, t_ctx->options.v_dim);
+    const uint8_t *vectors = NULL;
+    uint8_t *parsed = NULL;
+    if (sqlite3_value_type(argv[2]) == SQLITE_TEXT) {
+        vectors = parsed = vBatchScanParseQueries(vtab, t_ctx, (const char *)sqlite3_value_text(argv[2]), nq, vbytes);
+        if (!parsed) return SQLITE_ERROR;
+    } else {
+        vectors = (const uint8_t *)sqlite3_value_blob(argv[2]);
+        if (!vectors || (sqlite3_uint64)sqlite3_value_bytes(argv[2]) != (sqlite3_uint64)nq * vbytes) {
+            return sqlite_vtab_set_error(&vtab->base, "%s: queries must be a BLOB of %d vectors of %d bytes (got %d bytes)", fname, nq, (int)vbytes, sqlite3_value_bytes(argv[2]));
+        }
+    }
+    
+    int rc = vQuantScanPrepare(vtab, t_ctx, fname, &c->dead, &c->preload);
+    if (rc != SQLITE_OK) goto vbatch_filter_cleanup;
+    c->table = t_ctx;
+    VECTOR_STATS_ADD(vBatchScanStats(c), scans, 1);
+    if (c->preload) VECTOR_STATS_ADD(vBatchScanStats(c), preload_hits, 1);
+    else VECTOR_STATS_ADD(vBatchScanStats(c), preload_misses, 1);
+    
+    // PQ quantization of a table without vectors: no codebooks and no codes to scan
+    if (t_ctx->options.q_type == VECTOR_QUANT_PQ && t_ctx->pq.codebooks == NULL) goto vbatch_filter_cleanup;
+    
+    // when reranking the quantized pass collects k*rerank candidates
+    int slots = k;
+    if (c->options.rerank > 0) {
+        int64_t n = (int64_t)k * (int64_t)c->options.rerank;
+        slots = (n > INT_MAX / (int)sizeof(double)) ? INT_MAX / (int)sizeof(double) : (int)n;
+    }
+    
+    rc = SQLITE_NOMEM;
+    c->queries = (vbatch_query *)sqlite3_malloc64((sqlite3_uint64)nq * sizeof(vbatch_query));
+    c->rowids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)nq * slots * sizeof(int64_t));
+    c->distance = (double *)sqlite3_malloc64((sqlite3_uint64)nq * slots * sizeof(double));
+    if (!c->queries || !c->rowids || !c->distance) goto vbatch_filter_cleanup;
+    
+    memset(c->queries, 0, (size_t)nq * sizeof(vbatch_query));
+    for (int i=0; i<nq; ++i) {
+        vector_topk_init(&c->queries[i].topk, c->distance + (size_t)i * slots, c->rowids + (size_t)i * slots, slots);
+    }
+    c->nq = nq;
+    
+    rc = vBatchScanRun(vtab->db, c, vectors, vbytes, k);
+    
+vbatch_filter_cleanup:
+    if (parsed) sqlite3_free(parsed);
+    if (rc != SQLITE_OK) {
+        vBatchScanCursorReset(c);
+        return rc;
+    }
+    
+    // position on the first row (queries without results are skipped)
+    while (c->query_index < c->nq && c->queries[c->query_index].topk.count == 0) c->query_index++;
+    return SQLITE_OK;
 }
 
-// MARK: -
+static int vBatchScanConnect (sqlite3 *db, void *pAux, int argc, const char *const *argv, sqlite3_vtab **ppVtab, char **pzErr) {
+    int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(tbl hidden, col hidden, queries hidden, nq hidden, k hidden, options hidden, query_idx, id, distance);");
+    if (rc != SQLITE_OK) return rc;
+    
+    vFullScan *vtab = (vFullScan *)sqlite3_malloc(sizeof(vFullScan));
+    if (!vtab) return SQLITE_NOMEM;
+    
+    memset(vtab, 0, sizeof(vFullScan));
+    vtab->db = db;
+    vtab->ctx = (vector_context *)pAux;
+    
+    *ppVtab = (sqlite3_vtab *)vtab;
+    return SQLITE_OK;
+}
 
-static int vQuantRunMemory(vFullScanCursor *c, uint8_t *v, vector_qtype qtype, int dim) {
-    const int counter = c->table->precounter;
-    const uint8_t *data = c->table->preloaded;
-    const size_t rowid_size = sizeof(int64_t);
-    const size_t vector_size = (qtype == VECTOR_QUANT_1BIT) ? ((dim + 7) / 8) : (dim * sizeof(uint8_t));
-    const size_t total_stride = rowid_size + vector_size;
+static int vBatchScanBestIndex (sqlite3_vtab *tab, sqlite3_index_info *pIdxInfo) {
+    // the five first hidden columns are required (options is optional) and are passed in column order
+    int args[VECTOR_BATCH_COLUMN_OPTIONS + 1];
+    for (int i=0; i<=VECTOR_BATCH_COLUMN_OPTIONS; ++i) args[i] = -1;
+    
+    const struct sqlite3_index_constraint *pConstraint = pIdxInfo->aConstraint;
+    for (int i=0; i<pIdxInfo->nConstraint; i++, pConstraint++) {
+        if (pConstraint->usable == 0 || pConstraint->op != SQLITE_INDEX_CONSTRAINT_EQ) continue;
+        if (pConstraint->iColumn >= 0 && pConstraint->iColumn <= VECTOR_BATCH_COLUMN_OPTIONS) args[pConstraint->iColumn] = i;
+    }
+    
+    int argc = 0;
+    for (int col=0; col<=VECTOR_BATCH_COLUMN_OPTIONS; ++col) {
+        if (args[col] < 0) {
+            if (col < VECTOR_BATCH_COLUMN_OPTIONS) return SQLITE_CONSTRAINT;
+            continue;
+        }
+        pIdxInfo->aConstraintUsage[args[col]].argvIndex = ++argc;
+        pIdxInfo->aConstraintUsage[args[col]].omit = 1;
+    }
+    
+    // rows are returned by ascending query_idx and then by ascending distance
+    bool sorted = (pIdxInfo->nOrderBy > 0 && pIdxInfo->nOrderBy <= 2);
+    for (int i=0; i<pIdxInfo->nOrderBy && sorted; ++i) {
+        int column = (i == 0) ? VECTOR_BATCH_COLUMN_QUERY : VECTOR_BATCH_COLUMN_DISTANCE;
+        sorted = (pIdxInfo->aOrderBy[i].iColumn == column && !pIdxInfo->aOrderBy[i].desc);
+    }
+    pIdxInfo->orderByConsumed = sorted;
+    pIdxInfo->estimatedCost = (double)1;
+    pIdxInfo->estimatedRows = 1000;
+    return SQLITE_OK;
+}
 
-    double *distance = c->distance;
-    int64_t *rowids = (int64_t *)c->rowids;
-    int max_index = c->max_index;
-    double current_max = distance[max_index];
+static int vBatchScanCursorOpen (sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor) {
+    vBatchScanCursor *c = (vBatchScanCursor *)sqlite3_malloc(sizeof(vBatchScanCursor));
+    if (!c) return SQLITE_NOMEM;
+    
+    memset(c, 0, sizeof(vBatchScanCursor));
+    *ppCursor = (sqlite3_vtab_cursor *)c;
+    return SQLITE_OK;
+}
 
-    // compute distance function
-    vector_distance vd = c->table->options.v_distance;
-    vector_type vt = (qtype == VECTOR_QUANT_U8BIT) ? VECTOR_TYPE_U8 : VECTOR_TYPE_I8;
-    if (qtype == VECTOR_QUANT_1BIT) {
-        vt = VECTOR_TYPE_BIT;
-        vd = VECTOR_DISTANCE_HAMMING;
-    }
-    distance_function_t distance_fn = dispatch_distance_table[vd][vt];
+static int vBatchScanCursorClose (sqlite3_vtab_cursor *cur) {
+    vBatchScanCursor *c = (vBatchScanCursor *)cur;
+    vBatchScanCursorReset(c);
+    vector_tombstones_free(&c->dead);
+    vector_preload_release(c->preload);
+    sqlite3_free(c);
+    return SQLITE_OK;
+}
 
-    for (int i = 0; i < counter; ++i) {
-        const uint8_t *current_data = data + (i * total_stride);
-        const uint8_t *vector_data = current_data + rowid_size;
+static int vBatchScanCursorNext (sqlite3_vtab_cursor *cur) {
+    vBatchScanCursor *c = (vBatchScanCursor *)cur;
+    if (++c->row_index < c->queries[c->query_index].topk.count) return SQLITE_OK;
+    
+    c->row_index = 0;
+    do {c->query_index++;} while (c->query_index < c->nq && c->queries[c->query_index].topk.count == 0);
+    return SQLITE_OK;
+}
 
-        float dist = distance_fn((const void *)v, (const void *)vector_data, (int)vector_size);
-        if (nearly_zero_float32(dist)) dist = 0.0;
-        
-        if (dist < current_max) {
-            distance[max_index] = dist;
-            rowids[max_index] = INT64_FROM_INT8PTR(current_data);
+static int vBatchScanCursorEof (sqlite3_vtab_cursor *cur) {
+    vBatchScanCursor *c = (vBatchScanCursor *)cur;
+    return (c->query_index >= c->nq);
+}
 
-            // Recompute max index efficiently
-            max_index = vFullScanFindMaxIndex(distance, c->row_count);
-            current_max = distance[max_index];
-        }
+static int vBatchScanCursorColumn (sqlite3_vtab_cursor *cur, sqlite3_context *context, int iCol) {
+    vBatchScanCursor *c = (vBatchScanCursor *)cur;
+    const vector_topk *topk = &c->queries[c->query_index].topk;
+    if (iCol == VECTOR_BATCH_COLUMN_QUERY) {
+        sqlite3_result_int(context, c->query_index);
+    } else if (iCol == VECTOR_BATCH_COLUMN_ROWID) {
+        sqlite3_result_int64(context, (sqlite3_int64)topk->rowids[c->row_index]);
+    } else if (iCol == VECTOR_BATCH_COLUMN_DISTANCE) {
+        sqlite3_result_double(context, topk->distance[c->row_index]);
     }
+    return SQLITE_OK;
+}
 
-    c->max_index = max_index;
+static int vBatchScanCursorRowid (sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+    vBatchScanCursor *c = (vBatchScanCursor *)cur;
+    *pRowid = (sqlite_int64)c->queries[c->query_index].topk.rowids[c->row_index];
     return SQLITE_OK;
 }
 
-static int vQuantRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
-    // quantize target vector
-    int dimension = c->table->options.v_dim;
-    vector_qtype qtype = c->table->options.q_type;
-    size_t alloc_size = (qtype == VECTOR_QUANT_1BIT) ? ((dimension + 7) / 8) : (dimension * sizeof(int8_t));
-    uint8_t *v = (uint8_t *)sqlite3_malloc64(alloc_size);
-    if (!v) return SQLITE_NOMEM;
-    
-    // quantize vector
-    float offset = c->table->offset;
-    float scale = c->table->scale;
-    vector_type type = c->table->options.v_type;
 
-    if (qtype == VECTOR_QUANT_1BIT) {
-        // 1-bit quantization: convert source to binary based on type
-        switch (type) {
-            case VECTOR_TYPE_F32: quantize_binary((const float *)v1, v, dimension, c->table->binary_mean); break;
-            case VECTOR_TYPE_F16: quantize_binary_f16((const uint16_t *)v1, v, dimension, false); break;
-            case VECTOR_TYPE_BF16: quantize_binary_bf16((const uint16_t *)v1, v, dimension, false); break;
-            case VECTOR_TYPE_U8: quantize_binary_u8((const uint8_t *)v1, v, dimension); break;
-            case VECTOR_TYPE_I8: quantize_binary_i8((const int8_t *)v1, v, dimension); break;
-            case VECTOR_TYPE_BIT: memcpy(v, v1, (dimension + 7) / 8); break; // Already binary
-        }
-    } else {
-        // 8-bit quantization (U8BIT or S8BIT)
-        switch (type) {
-            case VECTOR_TYPE_F32: quantize_float32((const float *)v1, v, offset, scale, dimension, qtype); break;
-            case VECTOR_TYPE_F16: quantize_float16((const uint16_t *)v1, v, offset, scale, dimension, qtype); break;
-            case VECTOR_TYPE_BF16: quantize_bfloat16((const uint16_t *)v1, v, offset, scale, dimension, qtype); break;
-            case VECTOR_TYPE_U8: quantize_u8((const uint8_t *)v1, v, offset, scale, dimension, qtype); break;
-            case VECTOR_TYPE_I8: quantize_i8((const int8_t *)v1, v, offset, scale, dimension, qtype); break;
-            case VECTOR_TYPE_BIT: memcpy(v, v1, (dimension + 7) / 8); break; // BIT to 8-bit: just copy
+// MARK: -
+
+static double vHnswRowDistance (sqlite3_stmt *vm, int64_t rowid, const void *v, const hnsw_graph *g) {
+    // distance between v and the original vector of rowid (INFINITY if the row is gone)
+    double distance = INFINITY;
+    sqlite3_bind_int64(vm, 1, (sqlite3_int64)rowid);
+    if (sqlite3_step(vm) == SQLITE_ROW) {
+        const void *blob = sqlite3_column_blob(vm, 0);
+        if (blob && (size_t)sqlite3_column_bytes(vm, 0) >= g->vbytes) {
+            float d = g->distance_fn(v, blob, g->dist_n);
+            if (nearly_zero_float32(d)) d = 0.0;
+            distance = (isnan(d)) ? FLT_MAX : d;
         }
     }
+    sqlite3_reset(vm);
+    return distance;
+}
 
-    if (c->table->preloaded) {
-        int rc = vQuantRunMemory(c, v, qtype, dimension);
-        if (v) sqlite3_free(v);
-        return rc;
-    }
-    #if DEBUG_VECTOR_SERIALIZATION
-    vector_type qprint = (qtype == VECTOR_QUANT_1BIT) ? VECTOR_TYPE_BIT : (qtype == VECTOR_QUANT_U8BIT) ? VECTOR_TYPE_U8 : VECTOR_TYPE_I8;
-    VECTOR_PRINT((void*)v, qprint, dimension);
-    #endif
-    
-    char sql[STATIC_SQL_SIZE];
-    generate_select_quant_table(c->table->t_name, c->table->c_name, sql);
-    sqlite3_stmt *vm = NULL;
-    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
-    if (rc != SQLITE_OK) goto vquant_run_cleanup;
+static int vHnswRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
+    table_context *t = c->table;
+    if (t->hnsw_count == 0) return SQLITE_OK;
     
-    // precompute constants
-    const size_t rowid_size = sizeof(int64_t);
-    const size_t vector_size = (qtype == VECTOR_QUANT_1BIT) ? ((dimension + 7) / 8) : (dimension * sizeof(uint8_t));
-    const size_t total_stride = rowid_size + vector_size;
+    // upper layers are loaded once and shared by every query on this table
+    int rc = SQLITE_OK;
+    sqlite3_mutex_enter(qmutex);
+    if (!t->hnsw && t->hnsw_level > 0) {
+        hnsw_graph *upper = NULL;
+        rc = hnsw_graph_load_upper(db, t, &upper);
+        t->hnsw = upper;
+    }
+    sqlite3_mutex_leave(qmutex);
+    if (rc != SQLITE_OK) return rc;
     
-    // compute distance function
-    vector_distance vd = c->table->options.v_distance;
-    vector_type vt = (qtype == VECTOR_QUANT_U8BIT) ? VECTOR_TYPE_U8 : VECTOR_TYPE_I8;
-    if (qtype == VECTOR_QUANT_1BIT) {
-        // in case of 1BIT quantization force distance to alway be hamming
-        vt = VECTOR_TYPE_BIT;
-        vd = VECTOR_DISTANCE_HAMMING;
+    // graph used only for its distance settings when there are no upper layers
+    hnsw_graph *g = t->hnsw;
+    hnsw_graph local = {0};
+    if (!g) {
+        vector_type vt = t->options.v_type;
+        local.vbytes = vector_bytes_for_dim(vt, t->options.v_dim);
+        local.dist_n = (vt == VECTOR_TYPE_BIT) ? (int)local.vbytes : t->options.v_dim;
+        local.distance_fn = vector_distance_function(&t->options, vt);
+        g = &local;
     }
-    distance_function_t distance_fn = dispatch_distance_table[vd][vt];
+    if ((size_t)v1size < g->vbytes) return SQLITE_MISUSE;
     
-    while (1) {
-        rc = sqlite3_step(vm);
-        if (rc == SQLITE_DONE) {rc = SQLITE_OK; break;} // return error: rebuild must be call (only if first time run)
-        else if (rc != SQLITE_ROW) goto vquant_run_cleanup;
+    char sql[STATIC_SQL_SIZE];
+    sqlite3_stmt *vm_links = NULL;
+    sqlite3_stmt *vm_vector = NULL;
+    hnsw_queue candidates = {0};
+    hnsw_visited visited = {0};
+    int ef = (c->options.ef_search > 0) ? c->options.ef_search : DEFAULT_HNSW_EF_SEARCH;
+    if (ef < c->k) ef = c->k;
+    double *wdistance = (double *)sqlite3_malloc64((sqlite3_uint64)ef * sizeof(double));
+    int64_t *wids = (int64_t *)sqlite3_malloc64((sqlite3_uint64)ef * sizeof(int64_t));
+    if (!wdistance || !wids) {rc = SQLITE_NOMEM; goto vhnsw_run_cleanup;}
+    
+    generate_select_hnsw_links(t->t_name, t->c_name, sql);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm_links, NULL);
+    if (rc != SQLITE_OK) goto vhnsw_run_cleanup;
+    
+    sqlite3_snprintf(sizeof(sql), sql, "SELECT %q FROM %q WHERE %q = ?;", t->c_name, t->t_name, t->pk_name);
+    rc = sqlite3_prepare_v2(db, sql, -1, &vm_vector, NULL);
+    if (rc != SQLITE_OK) goto vhnsw_run_cleanup;
+    
+    // STEP 1: greedy descent through the in-memory upper layers
+    int64_t entry = t->hnsw_entry;
+    double distance;
+    if (g->count > 0) {
+        int node = g->entry;
+        distance = hnsw_distance(g, v1, node);
+        for (int l = g->max_level; l > 0; --l) node = hnsw_greedy_search(g, v1, node, &distance, l);
+        entry = g->rowids[node];
+    }
+    distance = vHnswRowDistance(vm_vector, entry, v1, g);
+    
+    // STEP 2: beam search of width ef on layer 0, reading links and vectors from disk
+    vector_topk result;
+    vector_topk_init(&result, wdistance, wids, ef);
+    vector_topk_push(&result, distance, entry);
+    if (hnsw_visited_insert(&visited, entry) < 0 || !hnsw_queue_push(&candidates, distance, entry)) {rc = SQLITE_NOMEM; goto vhnsw_run_cleanup;}
+    
+    while (candidates.count > 0) {
+        int64_t node;
+        hnsw_queue_pop(&candidates, &distance, &node);
+        if (distance > vector_topk_threshold(&result)) break;
         
-        int counter = sqlite3_column_int(vm, 0);
-        uint8_t *data = (uint8_t *)sqlite3_column_blob(vm, 1);
+        sqlite3_bind_int64(vm_links, 1, (sqlite3_int64)node);
+        rc = sqlite3_step(vm_links);
+        if (rc == SQLITE_DONE) {rc = SQLITE_OK; sqlite3_reset(vm_links); continue;}
+        if (rc != SQLITE_ROW) goto vhnsw_run_cleanup;
+        
+        // layer 0 is the first section of the links blob
+        const uint8_t *p = (const uint8_t *)sqlite3_column_blob(vm_links, 0);
+        int bytes = sqlite3_column_bytes(vm_links, 0);
+        int64_t nlinks = (p && bytes >= (int)sizeof(int64_t)) ? INT64_FROM_INT8PTR(p) : 0;
+        if (nlinks < 0 || (int64_t)(bytes - sizeof(int64_t)) < nlinks * (int64_t)sizeof(int64_t)) nlinks = 0;
         
-        // cache the maximum value to avoid repeated memory accesses
-        double current_max_distance = c->distance[c->max_index];
+        // copy the links out before the statement is reused
+        int64_t links[2 * MAX_HNSW_M];
+        if (nlinks > 2 * MAX_HNSW_M) nlinks = 2 * MAX_HNSW_M;
+        for (int64_t i=0; i<nlinks; ++i) links[i] = INT64_FROM_INT8PTR(p + (i + 1) * sizeof(int64_t));
+        sqlite3_reset(vm_links);
         
-        for (int i=0; i<counter; ++i) {
-            const uint8_t *current_data = data + (i * total_stride);
-            const uint8_t *vector_data = current_data + rowid_size;
-            float distance = distance_fn((const void *)v, (const void *)vector_data, (int)vector_size);
-            if (nearly_zero_float32(distance)) distance = 0.0;
-            VECTOR_PRINT((void*)vector_data, vt, dimension);
+        for (int64_t i=0; i<nlinks; ++i) {
+            int inserted = hnsw_visited_insert(&visited, links[i]);
+            if (inserted < 0) {rc = SQLITE_NOMEM; goto vhnsw_run_cleanup;}
+            if (inserted == 0) continue;
             
-            if (distance < current_max_distance) {
-                c->distance[c->max_index] = distance;
-                c->rowids[c->max_index] = INT64_FROM_INT8PTR(current_data);
-                c->max_index = vFullScanFindMaxIndex(c->distance, c->row_count);
-                current_max_distance = c->distance[c->max_index]; // update cached max
-            }
+            double dn = vHnswRowDistance(vm_vector, links[i], v1, g);
+            if (!(dn < INFINITY)) continue;
+            if (vector_topk_push(&result, dn, links[i]) && !hnsw_queue_push(&candidates, dn, links[i])) {rc = SQLITE_NOMEM; goto vhnsw_run_cleanup;}
         }
     }
-    
     rc = SQLITE_OK;
     
-vquant_run_cleanup:
-    if (rc != SQLITE_OK) printf("Error in vector_rebuild_quantization: %s\n", sqlite3_errmsg(db));
-    if (vm) sqlite3_finalize(vm);
-    if (v) sqlite3_free(v);
+    // keep the k best among the ef candidates (restricted to the rowid filter, if any)
+    for (int i=0; i<result.count; ++i) {
+        if (c->filter.active && !vector_rowid_filter_contains(&c->filter, result.rowids[i])) continue;
+        vector_topk_push(&c->topk, result.distance[i], result.rowids[i]);
+    }
+    
+vhnsw_run_cleanup:
+    if (vm_links) sqlite3_finalize(vm_links);
+    if (vm_vector) sqlite3_finalize(vm_vector);
+    if (wdistance) sqlite3_free(wdistance);
+    if (wids) sqlite3_free(wids);
+    hnsw_queue_free(&candidates);
+    hnsw_visited_free(&visited);
     return rc;
 }
 
-
-static int vQuantCursorFilter (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
-    return vCursorFilterCommon(cur, idxNum, idxStr, argc, argv, "vector_quantize_scan", vQuantRun, vFullScanSortSlots, vStreamQuantCursorRun, true);
+static int vHnswCursorFilter (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    vFullScan *vtab = (vFullScan *)cur->pVtab;
+    
+    // a graph search has no streaming mode
+    if (argc == 3) return sqlite_vtab_set_error(&vtab->base, "vector_hnsw_scan requires the k argument");
+    
+    if (argc >= 2 && sqlite3_value_type(argv[0]) == SQLITE_TEXT && sqlite3_value_type(argv[1]) == SQLITE_TEXT) {
+        const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+        const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+        table_context *t_ctx = vector_context_lookup(vtab->ctx, table_name, column_name);
+        
+        char buffer[STATIC_SQL_SIZE];
+        char *name = generate_hnsw_table_name(table_name, column_name, buffer);
+        if (t_ctx && (!name || !sqlite_table_exists(vtab->db, name))) {
+            return sqlite_vtab_set_error(&vtab->base, "HNSW index not found for table '%s' and column '%s'. Ensure that vector_hnsw_build() has been called before using vector_hnsw_scan()", table_name, column_name);
+        }
+    }
+    
+    return vCursorFilterCommon(cur, idxNum, idxStr, argc, argv, "vector_hnsw_scan", vHnswRun, vFullScanSortSlots, NULL, false);
 }
 
 static int vStreamScanCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
@@ -2499,41 +7404,39 @@ static int vStreamScanCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1
     void *v = sqlite_memdup(v1, v1size);
     if (!v) return SQLITE_NOMEM;
     
-    const char *pk_name = c->table->pk_name;
-    const char *col_name = c->table->c_name;
-    const char *table_name = c->table->t_name;
     int dimension = c->table->options.v_dim;
     
     c->stream.vector = (void *)v;
     c->stream.vsize = v1size;
     c->stream.vdim = dimension;
     
-    char *sql = sqlite3_mprintf("SELECT %q, %q FROM %q;", pk_name, col_name, table_name);
-    if (!sql) return SQLITE_NOMEM;
-    
     sqlite3_stmt *vm = NULL;
-    int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
+    int rc = vFullScanPrepare(db, c, &vm);
     if (rc != SQLITE_OK) goto cleanup;
     
     // compute distance function
-    vector_distance vd = c->table->options.v_distance;
     vector_type vt = c->table->options.v_type;
-    if (vt == VECTOR_TYPE_BIT) vd = VECTOR_DISTANCE_HAMMING;  // Force Hamming for BIT type
-    distance_function_t distance_fn = dispatch_distance_table[vd][vt];
+    distance_function_t distance_fn = vector_distance_function(&c->table->options, vt);
+    
+    // rows are staged for the batch kernel of the same distance (integer and BIT vectors)
+    vector_distance vd = (vt == VECTOR_TYPE_BIT) ? VECTOR_DISTANCE_HAMMING : c->table->options.v_distance;
+    if (dispatch_distance_table[vd][vt] == distance_fn && dispatch_distance_batch_table[vd][vt]) {
+        size_t total_stride = sizeof(int64_t) + vector_bytes_for_dim(vt, dimension);
+        c->stream.staging = (uint8_t *)sqlite3_malloc64((sqlite3_uint64)SCAN_DISTANCE_BLOCK * total_stride);
+        if (!c->stream.staging) {rc = SQLITE_NOMEM; goto cleanup;}
+        c->stream.batch_fn = dispatch_distance_batch_table[vd][vt];
+    }
 
     c->stream.distance_fn = distance_fn;
     c->stream.vm = vm;
-
-    if (sql) sqlite3_free(sql);
     return SQLITE_OK;
 
 cleanup:
-    if (sql) sqlite3_free(sql);
     if (vm) sqlite3_finalize(vm);
     return rc;
 }
 
-static int vStreamQuantCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
+static int vStreamQuantizeQuery (vFullScanCursor *c, const void *v1) {
     // quantize input vector
     int dimension = c->table->options.v_dim;
     vector_qtype qtype = c->table->options.q_type;
@@ -2572,31 +7475,67 @@ static int vStreamQuantCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v
     c->stream.vsize = (qtype == VECTOR_QUANT_1BIT) ? (int)((dimension + 7) / 8) : (int)(dimension * sizeof(int8_t));
     c->stream.vdim = dimension;
     
-    // compute distance function
-    vector_distance vd = c->table->options.v_distance;
-    vector_type vt = (qtype == VECTOR_QUANT_U8BIT) ? VECTOR_TYPE_U8 : VECTOR_TYPE_I8;
-    if (qtype == VECTOR_QUANT_1BIT) {
-        // in case of 1BIT quantization force distance to always be hamming
-        vt = VECTOR_TYPE_BIT;
-        vd = VECTOR_DISTANCE_HAMMING;
+    // compute distance function (and the batch kernel of the same distance)
+    c->stream.distance_fn = vQuantDistanceFunction(qtype, c->table->options.v_distance, &c->stream.batch_fn);
+    return SQLITE_OK;
+}
+
+static int vStreamQuantCursorRun (sqlite3 *db, vFullScanCursor *c, const void *v1, int v1size) {
+    int dimension = c->table->options.v_dim;
+    vector_qtype qtype = c->table->options.q_type;
+    
+    if (qtype == VECTOR_QUANT_PQ || c->table->qcalib || quant_is_4bit(qtype)) {
+        // ADC lookup tables, float32 query decoding per-dimension calibrated codes or packed 4-bit codes
+        c->stream.vector = vQuantQueryCreate(c->table, v1, &c->stream.distance_fn, &c->stream.batch_fn);
+        if (!c->stream.vector) return SQLITE_NOMEM;
+        c->stream.vsize = (int)quant_bytes_for_dim(qtype, dimension, &c->table->pq);
+        c->stream.vdim = dimension;
+    } else {
+        int rc = vStreamQuantizeQuery(c, v1);
+        if (rc != SQLITE_OK) return rc;
     }
-    distance_function_t distance_fn = dispatch_distance_table[vd][vt];
-    c->stream.distance_fn = distance_fn;
+    
+    c->stream.dindex = 0;
+    c->stream.dcounter = 0;
+    memset(&c->stream.records, 0, sizeof(vector_records));
+    c->stream.masked = false;
+    
+    // cascade: rows are not ranked, so only the 8-bit level is compared
+    c->stream.code_offset = quant_level_bytes(c->table->binary_level, dimension);
     
     // check if quant representation was preloaded
-    if (c->table->preloaded) {
-        c->stream.dindex = 0;
-        c->stream.data = c->table->preloaded;
-        c->stream.dcounter = c->table->precounter;
-        return SQLITE_OK;
+    bool auto_update = c->table->options.auto_update;
+    bool filtered = c->filter.active;
+    const char *t_name = c->table->t_name;
+    const char *c_name = c->table->c_name;
+    char sql[STATIC_SQL_SIZE];
+    if (c->preload) {
+        vector_records all = vector_chunk_records(VECTOR_CHUNK_FORMAT_SPLIT, c->preload->data, c->preload->counter, c->stream.code_offset + (size_t)c->stream.vsize);
+        c->stream.records = vector_records_level(&all, c->stream.code_offset, (size_t)c->stream.vsize);
+        c->stream.dcounter = c->preload->counter;
+        c->stream.masked = (c->dead.count > 0);
+        
+        // auto update: the delta chunks follow the preloaded base records
+        if (!auto_update) return SQLITE_OK;
+        (filtered) ? generate_select_quant_deltas_range(t_name, c_name, sql) : generate_select_quant_deltas(t_name, c_name, sql);
+    } else if (auto_update) {
+        // the list column tells base chunks (masked by the tombstones) from delta chunks
+        (filtered) ? generate_select_quant_chunks_range(t_name, c_name, sql) : generate_select_quant_chunks(t_name, c_name, sql);
+    } else {
+        (filtered) ? generate_select_quant_table_range(t_name, c_name, sql) : generate_select_quant_table(t_name, c_name, sql);
     }
     
-    char sql[STATIC_SQL_SIZE];
-    generate_select_quant_table(c->table->t_name, c->table->c_name, sql);
     sqlite3_stmt *vm = NULL;
     int rc = sqlite3_prepare_v2(db, sql, -1, &vm, NULL);
     if (rc != SQLITE_OK) goto cleanup;
     
+    // filtered scan: chunks outside the filter bounds are skipped by the *_range statements
+    if (filtered) {
+        rc = sqlite3_bind_int64(vm, 2, (sqlite3_int64)c->filter.lo);
+        if (rc == SQLITE_OK) rc = sqlite3_bind_int64(vm, 3, (sqlite3_int64)c->filter.hi);
+        if (rc != SQLITE_OK) goto cleanup;
+    }
+    
     c->stream.vm = vm;
     return SQLITE_OK;
     
@@ -2605,6 +7544,138 @@ cleanup:
     return rc;
 }
 
+// MARK: - Statistics -
+
+// vector_stats: one row per table and column with the counters of the scans run with stats=1
+// (no rows when compiled with VECTOR_STATS_DISABLED)
+#define VECTOR_STATS_COLUMN_TBL                     0
+#define VECTOR_STATS_COLUMN_COL                     1
+#define VECTOR_STATS_COLUMN_SCANS                   2
+#define VECTOR_STATS_COLUMN_ROWS_SCANNED            3
+#define VECTOR_STATS_COLUMN_ROWS_SKIPPED            4
+#define VECTOR_STATS_COLUMN_CHUNKS_READ             5
+#define VECTOR_STATS_COLUMN_BYTES_TOUCHED           6
+#define VECTOR_STATS_COLUMN_KERNEL_NS               7
+#define VECTOR_STATS_COLUMN_HEAP_UPDATES            8
+#define VECTOR_STATS_COLUMN_PRELOAD_HITS            9
+#define VECTOR_STATS_COLUMN_PRELOAD_MISSES          10
+
+typedef struct {
+    sqlite3_vtab_cursor base;               // Base class - must be first
+    int                 index;              // current entry of the tables array
+} vStatsCursor;
+
+static int vStatsSkip (vector_context *ctx, int index) {
+    // returns the first valid table entry starting at index (tables removed by vector_cleanup have no name)
+    #if VECTOR_STATS
+    while (index < ctx->table_count && (!ctx->tables[index].t_name || !ctx->tables[index].c_name)) index++;
+    return index;
+    #else
+    return ctx->table_count;
+    #endif
+}
+
+static int vStatsConnect (sqlite3 *db, void *pAux, int argc, const char *const *argv, sqlite3_vtab **ppVtab, char **pzErr) {
+    int rc = sqlite3_declare_vtab(db, "CREATE TABLE x(tbl, col, scans, rows_scanned, rows_skipped, chunks_read, bytes_touched, kernel_ns, heap_updates, preload_hits, preload_misses);");
+    if (rc != SQLITE_OK) return rc;
+    
+    vFullScan *vtab = (vFullScan *)sqlite3_malloc(sizeof(vFullScan));
+    if (!vtab) return SQLITE_NOMEM;
+    
+    memset(vtab, 0, sizeof(vFullScan));
+    vtab->db = db;
+    vtab->ctx = (vector_context *)pAux;
+    
+    *ppVtab = (sqlite3_vtab *)vtab;
+    return SQLITE_OK;
+}
+
+static int vStatsBestIndex (sqlite3_vtab *tab, sqlite3_index_info *pIdxInfo) {
+    // at most MAX_TABLES rows, always fully scanned
+    pIdxInfo->estimatedCost = (double)MAX_TABLES;
+    pIdxInfo->estimatedRows = MAX_TABLES;
+    return SQLITE_OK;
+}
+
+static int vStatsCursorOpen (sqlite3_vtab *pVtab, sqlite3_vtab_cursor **ppCursor) {
+    vStatsCursor *c = (vStatsCursor *)sqlite3_malloc(sizeof(vStatsCursor));
+    if (!c) return SQLITE_NOMEM;
+    
+    memset(c, 0, sizeof(vStatsCursor));
+    *ppCursor = (sqlite3_vtab_cursor *)c;
+    return SQLITE_OK;
+}
+
+static int vStatsCursorClose (sqlite3_vtab_cursor *cur) {
+    sqlite3_free(cur);
+    return SQLITE_OK;
+}
+
+static int vStatsCursorFilter (sqlite3_vtab_cursor *cur, int idxNum, const char *idxStr, int argc, sqlite3_value **argv) {
+    vStatsCursor *c = (vStatsCursor *)cur;
+    vFullScan *vtab = (vFullScan *)cur->pVtab;
+    c->index = vStatsSkip(vtab->ctx, 0);
+    return SQLITE_OK;
+}
+
+static int vStatsCursorNext (sqlite3_vtab_cursor *cur) {
+    vStatsCursor *c = (vStatsCursor *)cur;
+    vFullScan *vtab = (vFullScan *)cur->pVtab;
+    c->index = vStatsSkip(vtab->ctx, c->index + 1);
+    return SQLITE_OK;
+}
+
+static int vStatsCursorEof (sqlite3_vtab_cursor *cur) {
+    vStatsCursor *c = (vStatsCursor *)cur;
+    vFullScan *vtab = (vFullScan *)cur->pVtab;
+    return (c->index >= vtab->ctx->table_count);
+}
+
+static int vStatsCursorColumn (sqlite3_vtab_cursor *cur, sqlite3_context *context, int iCol) {
+    vStatsCursor *c = (vStatsCursor *)cur;
+    vFullScan *vtab = (vFullScan *)cur->pVtab;
+    const table_context *t = &vtab->ctx->tables[c->index];
+    const vector_stats *stats = &t->stats;
+    
+    switch (iCol) {
+        case VECTOR_STATS_COLUMN_TBL: sqlite3_result_text(context, t->t_name, -1, SQLITE_TRANSIENT); break;
+        case VECTOR_STATS_COLUMN_COL: sqlite3_result_text(context, t->c_name, -1, SQLITE_TRANSIENT); break;
+        case VECTOR_STATS_COLUMN_SCANS: sqlite3_result_int64(context, stats->scans); break;
+        case VECTOR_STATS_COLUMN_ROWS_SCANNED: sqlite3_result_int64(context, stats->rows_scanned); break;
+        case VECTOR_STATS_COLUMN_ROWS_SKIPPED: sqlite3_result_int64(context, stats->rows_skipped); break;
+        case VECTOR_STATS_COLUMN_CHUNKS_READ: sqlite3_result_int64(context, stats->chunks_read); break;
+        case VECTOR_STATS_COLUMN_BYTES_TOUCHED: sqlite3_result_int64(context, stats->bytes_touched); break;
+        case VECTOR_STATS_COLUMN_KERNEL_NS: sqlite3_result_int64(context, stats->kernel_ns); break;
+        case VECTOR_STATS_COLUMN_HEAP_UPDATES: sqlite3_result_int64(context, stats->heap_updates); break;
+        case VECTOR_STATS_COLUMN_PRELOAD_HITS: sqlite3_result_int64(context, stats->preload_hits); break;
+        case VECTOR_STATS_COLUMN_PRELOAD_MISSES: sqlite3_result_int64(context, stats->preload_misses); break;
+    }
+    return SQLITE_OK;
+}
+
+static int vStatsCursorRowid (sqlite3_vtab_cursor *cur, sqlite_int64 *pRowid) {
+    vStatsCursor *c = (vStatsCursor *)cur;
+    *pRowid = (sqlite_int64)c->index;
+    return SQLITE_OK;
+}
+
+static void vector_stats_reset (sqlite3_context *context, int argc, sqlite3_value **argv) {
+    // without arguments the counters of every table are cleared, otherwise the ones of the given table and column
+    vector_context *v_ctx = (vector_context *)sqlite3_user_data(context);
+    if (argc == 0) {
+        for (int i=0; i<v_ctx->table_count; ++i) memset(&v_ctx->tables[i].stats, 0, sizeof(vector_stats));
+        return;
+    }
+    
+    int types[] = {SQLITE_TEXT, SQLITE_TEXT};
+    if (sanity_check_args(context, "vector_stats_reset", argc, argv, 2, types) == false) return;
+    
+    const char *table_name = (const char *)sqlite3_value_text(argv[0]);
+    const char *column_name = (const char *)sqlite3_value_text(argv[1]);
+    table_context *t_ctx = vector_context_lookup(v_ctx, table_name, column_name);
+    if (t_ctx) memset(&t_ctx->stats, 0, sizeof(vector_stats));
+}
+
 // ---------------------------
 
 static sqlite3_module vFullScanModule = {
@@ -2663,6 +7734,90 @@ static sqlite3_module vQuantScanModule = {
   /* xIntegrity  */ 0
 };
 
+static sqlite3_module vBatchScanModule = {
+  /* iVersion    */ 0,
+  /* xCreate     */ 0,
+  /* xConnect    */ vBatchScanConnect,
+  /* xBestIndex  */ vBatchScanBestIndex,
+  /* xDisconnect */ vFullScanDisconnect,
+  /* xDestroy    */ 0,
+  /* xOpen       */ vBatchScanCursorOpen,
+  /* xClose      */ vBatchScanCursorClose,
+  /* xFilter     */ vBatchScanCursorFilter,
+  /* xNext       */ vBatchScanCursorNext,
+  /* xEof        */ vBatchScanCursorEof,
+  /* xColumn     */ vBatchScanCursorColumn,
+  /* xRowid      */ vBatchScanCursorRowid,
+  /* xUpdate     */ 0,
+  /* xBegin      */ 0,
+  /* xSync       */ 0,
+  /* xCommit     */ 0,
+  /* xRollback   */ 0,
+  /* xFindMethod */ 0,
+  /* xRename     */ 0,
+  /* xSavepoint  */ 0,
+  /* xRelease    */ 0,
+  /* xRollbackTo */ 0,
+  /* xShadowName */ 0,
+  /* xIntegrity  */ 0
+};
+
+static sqlite3_module vHnswScanModule = {
+  /* iVersion    */ 0,
+  /* xCreate     */ 0,
+  /* xConnect    */ vFullScanConnect,
+  /* xBestIndex  */ vFullScanBestIndex,
+  /* xDisconnect */ vFullScanDisconnect,
+  /* xDestroy    */ 0,
+  /* xOpen       */ vFullScanCursorOpen,
+  /* xClose      */ vFullScanCursorClose,
+  /* xFilter     */ vHnswCursorFilter, 
+  /* xNext       */ vFullScanCursorNext,
+  /* xEof        */ vFullScanCursorEof,
+  /* xColumn     */ vFullScanCursorColumn,
+  /* xRowid      */ vFullScanCursorRowid,
+  /* xUpdate     */ 0,
+  /* xBegin      */ 0,
+  /* xSync       */ 0,
+  /* xCommit     */ 0,
+  /* xRollback   */ 0,
+  /* xFindMethod */ 0,
+  /* xRename     */ 0,
+  /* xSavepoint  */ 0,
+  /* xRelease    */ 0,
+  /* xRollbackTo */ 0,
+  /* xShadowName */ 0,
+  /* xIntegrity  */ 0
+};
+
+static sqlite3_module vStatsModule = {
+  /* iVersion    */ 0,
+  /* xCreate     */ 0,
+  /* xConnect    */ vStatsConnect,
+  /* xBestIndex  */ vStatsBestIndex,
+  /* xDisconnect */ vFullScanDisconnect,
+  /* xDestroy    */ 0,
+  /* xOpen       */ vStatsCursorOpen,
+  /* xClose      */ vStatsCursorClose,
+  /* xFilter     */ vStatsCursorFilter,
+  /* xNext       */ vStatsCursorNext,
+  /* xEof        */ vStatsCursorEof,
+  /* xColumn     */ vStatsCursorColumn,
+  /* xRowid      */ vStatsCursorRowid,
+  /* xUpdate     */ 0,
+  /* xBegin      */ 0,
+  /* xSync       */ 0,
+  /* xCommit     */ 0,
+  /* xRollback   */ 0,
+  /* xFindMethod */ 0,
+  /* xRename     */ 0,
+  /* xSavepoint  */ 0,
+  /* xRelease    */ 0,
+  /* xRollbackTo */ 0,
+  /* xShadowName */ 0,
+  /* xIntegrity  */ 0
+};
+
 // MARK: -
 
 static void vector_init (sqlite3_context *context, int argc, sqlite3_value **argv) {
@@ -2742,6 +7897,7 @@ SQLITE_VECTOR_API int sqlite3_vector_init (sqlite3 *db, char **pzErrMsg, const s
     
     // get an app global static mutex
     qmutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP1);
+    pmutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP2);
     
     // init internal distance functions (do not force CPU)
     init_distance_functions(false);
@@ -2783,10 +7939,27 @@ SQLITE_VECTOR_API int sqlite3_vector_init (sqlite3 *db, char **pzErrMsg, const s
     rc = sqlite3_create_function(db, "vector_quantize_preload", 2, SQLITE_UTF8, ctx, vector_quantize_preload, NULL, NULL);
     if (rc != SQLITE_OK) goto cleanup;
     
+    rc = sqlite3_create_function(db, "vector_quantize_preload", 3, SQLITE_UTF8, ctx, vector_quantize_preload, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
     // table_name, column_name
     rc = sqlite3_create_function(db, "vector_quantize_cleanup", 2, SQLITE_UTF8, ctx, vector_quantize_cleanup, NULL, NULL);
     if (rc != SQLITE_OK) goto cleanup;
     
+    rc = sqlite3_create_function(db, "vector_quantize_compact", 2, SQLITE_UTF8, ctx, vector_quantize_compact, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    rc = sqlite3_create_function(db, "vector_quantize_delta", 5, SQLITE_UTF8, ctx, vector_quantize_delta, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    // table_name, column_name, options
+    rc = sqlite3_create_function(db, "vector_hnsw_build", 3, SQLITE_UTF8, ctx, vector_hnsw_build, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    // table_name, column_name
+    rc = sqlite3_create_function(db, "vector_hnsw_build", 2, SQLITE_UTF8, ctx, vector_hnsw_build, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    
     rc = sqlite3_create_function(db, "vector_as_f32", 1, SQLITE_UTF8, ctx, vector_as_f32, NULL, NULL);
     if (rc != SQLITE_OK) goto cleanup;
     rc = sqlite3_create_function(db, "vector_as_f32", 2, SQLITE_UTF8, ctx, vector_as_f32, NULL, NULL);
@@ -2822,6 +7995,20 @@ SQLITE_VECTOR_API int sqlite3_vector_init (sqlite3 *db, char **pzErrMsg, const s
     
     rc = sqlite3_create_module(db, "vector_quantize_scan", &vQuantScanModule, ctx);
     if (rc != SQLITE_OK) goto cleanup;
+    
+    rc = sqlite3_create_module(db, "vector_hnsw_scan", &vHnswScanModule, ctx);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    rc = sqlite3_create_module(db, "vector_quantize_scan_batch", &vBatchScanModule, ctx);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    rc = sqlite3_create_module(db, "vector_stats", &vStatsModule, ctx);
+    if (rc != SQLITE_OK) goto cleanup;
+    
+    rc = sqlite3_create_function(db, "vector_stats_reset", 0, SQLITE_UTF8, ctx, vector_stats_reset, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
+    rc = sqlite3_create_function(db, "vector_stats_reset", 2, SQLITE_UTF8, ctx, vector_stats_reset, NULL, NULL);
+    if (rc != SQLITE_OK) goto cleanup;
 
     // backward-compat aliases: _stream modules merged into main modules in 0.9.80
     rc = sqlite3_create_module(db, "vector_full_scan_stream", &vFullScanModule, ctx);
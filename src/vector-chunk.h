@@ -0,0 +1,115 @@
+//
+//  vector-chunk.h
+//  sqlitevector
+//
+//  Record layouts of the quantized chunks and of the preloaded buffers
+//
+
+#ifndef __VECTOR_CHUNK__
+#define __VECTOR_CHUNK__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// A chunk stores count records, each made of an int64 rowid and a code of code_size bytes.
+//   VECTOR_CHUNK_FORMAT_INTERLEAVED: count x (rowid, code)
+//   VECTOR_CHUNK_FORMAT_SPLIT:       count codes | zero padding up to a multiple of VECTOR_CHUNK_ALIGNMENT | count rowids
+// The split layout keeps the codes contiguous, so a scan streams only code bytes and reads the rowid of the few
+// records that enter the top-k. Codes are aligned to VECTOR_CHUNK_ALIGNMENT whenever the chunk itself is
+// (preloaded buffers and sidecar files), and the rowid array is always 8-byte aligned relative to the chunk.
+// Rowids are stored in native byte order.
+#define VECTOR_CHUNK_FORMAT_INTERLEAVED     1       // chunks written before the split format existed
+#define VECTOR_CHUNK_FORMAT_SPLIT           2
+#define VECTOR_CHUNK_ALIGNMENT              64
+
+// read-only view over count records of a chunk, whatever its layout
+typedef struct {
+    const uint8_t   *codes;                 // code of the first record
+    const uint8_t   *rowids;                // rowid of the first record
+    size_t          code_stride;            // bytes between two consecutive codes
+    size_t          rowid_stride;           // bytes between two consecutive rowids
+    size_t          code_size;              // bytes of a code
+    const float     *norms;                 // cached norm of each code (NULL if not cached, never stored in a chunk)
+    int             count;
+} vector_records;
+
+static inline size_t vector_chunk_codes_bytes (size_t count, size_t code_size) {
+    // space taken by the codes of a split chunk (padding included)
+    size_t n = count * code_size;
+    return (n + VECTOR_CHUNK_ALIGNMENT - 1) / VECTOR_CHUNK_ALIGNMENT * VECTOR_CHUNK_ALIGNMENT;
+}
+
+static inline size_t vector_chunk_bytes (int format, size_t count, size_t code_size) {
+    if (format == VECTOR_CHUNK_FORMAT_SPLIT) return vector_chunk_codes_bytes(count, code_size) + count * sizeof(int64_t);
+    return count * (sizeof(int64_t) + code_size);
+}
+
+static inline vector_records vector_chunk_records (int format, const uint8_t *data, int count, size_t code_size) {
+    vector_records r;
+    r.count = count;
+    r.code_size = code_size;
+    r.norms = NULL;
+    if (format == VECTOR_CHUNK_FORMAT_SPLIT) {
+        r.codes = data;
+        r.rowids = data + vector_chunk_codes_bytes((size_t)count, code_size);
+        r.code_stride = code_size;
+        r.rowid_stride = sizeof(int64_t);
+    } else {
+        r.codes = data + sizeof(int64_t);
+        r.rowids = data;
+        r.code_stride = sizeof(int64_t) + code_size;
+        r.rowid_stride = sizeof(int64_t) + code_size;
+    }
+    return r;
+}
+
+static inline vector_records vector_records_slice (const vector_records *r, int start, int count) {
+    vector_records s = *r;
+    s.codes += (size_t)start * r->code_stride;
+    s.rowids += (size_t)start * r->rowid_stride;
+    if (s.norms) s.norms += start;
+    s.count = count;
+    return s;
+}
+
+static inline vector_records vector_records_level (const vector_records *r, size_t offset, size_t size) {
+    // view over the size bytes found at offset of every code (one level of a cascaded quantization)
+    vector_records s = *r;
+    s.codes += offset;
+    s.code_size = size;
+    return s;
+}
+
+static inline const uint8_t *vector_records_code (const vector_records *r, int i) {
+    return r->codes + (size_t)i * r->code_stride;
+}
+
+static inline int64_t vector_records_rowid (const vector_records *r, int i) {
+    int64_t rowid;
+    memcpy(&rowid, r->rowids + (size_t)i * r->rowid_stride, sizeof(rowid));
+    return rowid;
+}
+
+// writes the records in the interleaved layout (dst holds vector_chunk_bytes(VECTOR_CHUNK_FORMAT_INTERLEAVED, ...))
+static inline void vector_records_interleave (const vector_records *r, uint8_t *dst) {
+    for (int i = 0; i < r->count; ++i) {
+        memcpy(dst, r->rowids + (size_t)i * r->rowid_stride, sizeof(int64_t));
+        memcpy(dst + sizeof(int64_t), r->codes + (size_t)i * r->code_stride, r->code_size);
+        dst += sizeof(int64_t) + r->code_size;
+    }
+}
+
+// writes the records in the split layout (dst holds vector_chunk_bytes(VECTOR_CHUNK_FORMAT_SPLIT, ...))
+static inline void vector_records_split (const vector_records *r, uint8_t *dst) {
+    size_t codes_bytes = vector_chunk_codes_bytes((size_t)r->count, r->code_size);
+    uint8_t *rowids = dst + codes_bytes;
+    for (int i = 0; i < r->count; ++i) {
+        memcpy(dst + (size_t)i * r->code_size, r->codes + (size_t)i * r->code_stride, r->code_size);
+        memcpy(rowids + (size_t)i * sizeof(int64_t), r->rowids + (size_t)i * r->rowid_stride, sizeof(int64_t));
+    }
+    size_t used = (size_t)r->count * r->code_size;
+    memset(dst + used, 0, codes_bytes - used);
+}
+
+#endif
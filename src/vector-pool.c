@@ -0,0 +1,216 @@
+//
+//  vector-pool.c
+//  sqlitevector
+//
+//  Persistent worker pool used to split a scan into shards
+//
+
+#include "vector-pool.h"
+#include <stddef.h>
+#include <string.h>
+
+#if defined(SQLITE_WASM_EXTRA_INIT) || defined(VECTOR_POOL_DISABLED)
+#define VECTOR_POOL_THREADS         0
+#else
+#define VECTOR_POOL_THREADS         1
+#endif
+
+#if VECTOR_POOL_THREADS
+#ifdef _WIN32
+#include <windows.h>
+typedef SRWLOCK                     pool_mutex_t;
+typedef CONDITION_VARIABLE          pool_cond_t;
+typedef HANDLE                      pool_thread_t;
+#define POOL_MUTEX_INIT             SRWLOCK_INIT
+#define POOL_COND_INIT              CONDITION_VARIABLE_INIT
+#define pool_lock(_m)               AcquireSRWLockExclusive(_m)
+#define pool_unlock(_m)             ReleaseSRWLockExclusive(_m)
+#define pool_wait(_c, _m)           SleepConditionVariableSRW(_c, _m, INFINITE, 0)
+#define pool_broadcast(_c)          WakeAllConditionVariable(_c)
+#else
+#include <pthread.h>
+typedef pthread_mutex_t             pool_mutex_t;
+typedef pthread_cond_t              pool_cond_t;
+typedef pthread_t                   pool_thread_t;
+#define POOL_MUTEX_INIT             PTHREAD_MUTEX_INITIALIZER
+#define POOL_COND_INIT              PTHREAD_COND_INITIALIZER
+#define pool_lock(_m)               pthread_mutex_lock(_m)
+#define pool_unlock(_m)             pthread_mutex_unlock(_m)
+#define pool_wait(_c, _m)           pthread_cond_wait(_c, _m)
+#define pool_broadcast(_c)          pthread_cond_broadcast(_c)
+#endif
+
+typedef struct pool_job {
+    vector_pool_task    task;
+    void                *arg;
+    int                 ntasks;
+    int                 next;               // next task index to hand out
+    int                 pending;            // tasks not yet completed
+    struct pool_job     *link;              // next job with tasks left to hand out
+} pool_job;
+
+static struct {
+    pool_mutex_t        mutex;
+    pool_cond_t         work;               // signaled when a job is queued or the pool is stopping
+    pool_cond_t         done;               // signaled when a job completes
+    pool_thread_t       threads[VECTOR_POOL_MAX_THREADS];
+    int                 nthreads;
+    pool_job            *jobs;              // FIFO of jobs with tasks left to hand out
+    int                 refcount;
+    int                 stopping;
+} pool = {.mutex = POOL_MUTEX_INIT, .work = POOL_COND_INIT, .done = POOL_COND_INIT};
+
+// MARK: - Internals -
+
+static void pool_job_remove (pool_job *job) {
+    pool_job **p = &pool.jobs;
+    while (*p && *p != job) p = &(*p)->link;
+    if (*p) *p = job->link;
+}
+
+static int pool_job_take (pool_job *job) {
+    // called with the mutex held: returns the next index of job and dequeues it once fully handed out
+    int index = job->next++;
+    if (job->next == job->ntasks) pool_job_remove(job);
+    return index;
+}
+
+static void pool_job_complete (pool_job *job) {
+    // called with the mutex held
+    if (--job->pending == 0) pool_broadcast(&pool.done);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI pool_worker (LPVOID unused) {
+#else
+static void *pool_worker (void *unused) {
+#endif
+    pool_lock(&pool.mutex);
+    while (1) {
+        while (!pool.stopping && !pool.jobs) pool_wait(&pool.work, &pool.mutex);
+        if (pool.stopping) break;
+        
+        pool_job *job = pool.jobs;
+        int index = pool_job_take(job);
+        pool_unlock(&pool.mutex);
+        job->task(job->arg, index);
+        pool_lock(&pool.mutex);
+        pool_job_complete(job);
+    }
+    pool_unlock(&pool.mutex);
+    return 0;
+}
+
+static void pool_start_workers (int count) {
+    // called with the mutex held: threads created while a stop is joining would never be joined
+    while (pool.stopping) pool_wait(&pool.done, &pool.mutex);
+    if (count > VECTOR_POOL_MAX_THREADS) count = VECTOR_POOL_MAX_THREADS;
+    while (pool.nthreads < count) {
+        #ifdef _WIN32
+        HANDLE thread = CreateThread(NULL, 0, pool_worker, NULL, 0, NULL);
+        if (thread == NULL) break;
+        pool.threads[pool.nthreads++] = thread;
+        #else
+        if (pthread_create(&pool.threads[pool.nthreads], NULL, pool_worker, NULL) != 0) break;
+        pool.nthreads++;
+        #endif
+    }
+}
+
+static void pool_stop_workers (void) {
+    // the join list is taken under the mutex, so workers started after the stop belong to the next one
+    pool_thread_t threads[VECTOR_POOL_MAX_THREADS];
+    
+    pool_lock(&pool.mutex);
+    while (pool.stopping) pool_wait(&pool.done, &pool.mutex);
+    int nthreads = pool.nthreads;
+    memcpy(threads, pool.threads, sizeof(pool_thread_t) * nthreads);
+    pool.nthreads = 0;
+    pool.stopping = 1;
+    pool_broadcast(&pool.work);
+    pool_unlock(&pool.mutex);
+    
+    for (int i=0; i<nthreads; ++i) {
+        #ifdef _WIN32
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+        #else
+        pthread_join(threads[i], NULL);
+        #endif
+    }
+    
+    // done also wakes the callers waiting in pool_start_workers
+    pool_lock(&pool.mutex);
+    pool.stopping = 0;
+    pool_broadcast(&pool.done);
+    pool_unlock(&pool.mutex);
+}
+
+// MARK: - Public -
+
+void vector_pool_run (int ntasks, vector_pool_task task, void *arg) {
+    if (ntasks <= 0) return;
+    if (ntasks == 1) {
+        task(arg, 0);
+        return;
+    }
+    
+    pool_job job = {task, arg, ntasks, 0, ntasks, NULL};
+    
+    pool_lock(&pool.mutex);
+    pool_start_workers(ntasks - 1);
+    pool_job **tail = &pool.jobs;
+    while (*tail) tail = &(*tail)->link;
+    *tail = &job;
+    pool_broadcast(&pool.work);
+    
+    // the caller works on its own job until every index has been handed out
+    while (job.next < job.ntasks) {
+        int index = pool_job_take(&job);
+        pool_unlock(&pool.mutex);
+        task(arg, index);
+        pool_lock(&pool.mutex);
+        pool_job_complete(&job);
+    }
+    while (job.pending > 0) pool_wait(&pool.done, &pool.mutex);
+    pool_unlock(&pool.mutex);
+}
+
+void vector_pool_retain (void) {
+    pool_lock(&pool.mutex);
+    pool.refcount++;
+    pool_unlock(&pool.mutex);
+}
+
+void vector_pool_release (void) {
+    pool_lock(&pool.mutex);
+    int last = (--pool.refcount == 0) && (pool.nthreads > 0);
+    pool_unlock(&pool.mutex);
+    
+    // workers must be gone before the library can be unloaded
+    if (last) pool_stop_workers();
+}
+
+bool vector_pool_is_parallel (void) {
+    return true;
+}
+
+#else
+
+// MARK: - Single-threaded fallback -
+
+void vector_pool_run (int ntasks, vector_pool_task task, void *arg) {
+    for (int i=0; i<ntasks; ++i) task(arg, i);
+}
+
+void vector_pool_retain (void) {
+}
+
+void vector_pool_release (void) {
+}
+
+bool vector_pool_is_parallel (void) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,30 @@
+//
+//  vector-pool.h
+//  sqlitevector
+//
+//  Persistent worker pool used to split a scan into shards
+//
+
+#ifndef __VECTOR_POOL__
+#define __VECTOR_POOL__
+
+#include <stdbool.h>
+
+#define VECTOR_POOL_MAX_THREADS     64
+
+// task(arg, index) is invoked once for every index in [0, ntasks)
+typedef void (*vector_pool_task)(void *arg, int index);
+
+// runs ntasks tasks on the pool and blocks until all of them have completed
+// the calling thread executes tasks too, so the call always makes progress even if no worker can be started
+void vector_pool_run (int ntasks, vector_pool_task task, void *arg);
+
+// the pool lives as long as at least one reference is held (one per database connection):
+// worker threads are started lazily by vector_pool_run and joined when the last reference is released
+void vector_pool_retain (void);
+void vector_pool_release (void);
+
+// true if the current build can run tasks in parallel
+bool vector_pool_is_parallel (void);
+
+#endif
@@ -0,0 +1,348 @@
+//
+//  vector-sidecar.c
+//  sqlitevector
+//
+//  On-disk sidecar file of the preloaded quantized data, mapped read-only
+//
+
+#include "vector-sidecar.h"
+#include "vector-chunk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(SQLITE_WASM_EXTRA_INIT) || defined(VECTOR_SIDECAR_DISABLED)
+#define VECTOR_SIDECAR_MMAP         0
+#else
+#define VECTOR_SIDECAR_MMAP         1
+#endif
+
+#if VECTOR_SIDECAR_MMAP
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#endif
+
+#define SIDECAR_HASH_SEED           0xcbf29ce484222325ULL
+#define SIDECAR_HASH_PRIME          0x100000001b3ULL
+
+// streaming 64-bit FNV-1a over 8-byte words (any split of the input gives the same result)
+typedef struct {
+    uint64_t        h;
+    uint64_t        total;
+    uint8_t         tail[8];
+    int             ntail;
+} sidecar_hash;
+
+struct vector_sidecar_writer {
+    FILE            *f;
+    char            *path;
+    char            *tmp_path;
+    int             nlist;
+    uint64_t        data_offset;
+    uint64_t        data_bytes;
+    sidecar_hash    hash;
+};
+
+// MARK: - Checksum -
+
+static inline uint64_t sidecar_load64 (const uint8_t *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static void sidecar_hash_init (sidecar_hash *s) {
+    s->h = SIDECAR_HASH_SEED;
+    s->total = 0;
+    s->ntail = 0;
+}
+
+static void sidecar_hash_update (sidecar_hash *s, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    uint64_t h = s->h;
+    s->total += size;
+
+    if (s->ntail > 0) {
+        while (size > 0 && s->ntail < 8) {s->tail[s->ntail++] = *p++; --size;}
+        if (s->ntail < 8) {s->h = h; return;}
+        h = (h ^ sidecar_load64(s->tail)) * SIDECAR_HASH_PRIME;
+        s->ntail = 0;
+    }
+
+    for (; size >= 8; p += 8, size -= 8) h = (h ^ sidecar_load64(p)) * SIDECAR_HASH_PRIME;
+    while (size > 0 && s->ntail < 8) {s->tail[s->ntail++] = *p++; --size;}
+    s->h = h;
+}
+
+static uint64_t sidecar_hash_final (sidecar_hash *s) {
+    uint64_t h = s->h;
+    for (int i=0; i<s->ntail; ++i) h = (h ^ s->tail[i]) * SIDECAR_HASH_PRIME;
+    return (h ^ s->total) * SIDECAR_HASH_PRIME;
+}
+
+static uint64_t sidecar_header_checksum (const vector_sidecar_header *header, const int32_t *lists) {
+    vector_sidecar_header h = *header;
+    h.header_checksum = 0;
+
+    sidecar_hash hash;
+    sidecar_hash_init(&hash);
+    sidecar_hash_update(&hash, &h, sizeof(h));
+    if (lists) sidecar_hash_update(&hash, lists, (size_t)header->nlist * 2 * sizeof(int32_t));
+    return sidecar_hash_final(&hash);
+}
+
+static uint64_t sidecar_records_checksum (const vector_sidecar *s) {
+    sidecar_hash hash;
+    sidecar_hash_init(&hash);
+    sidecar_hash_update(&hash, s->data, (size_t)s->header.data_bytes);
+    if (s->lists) sidecar_hash_update(&hash, s->lists, (size_t)s->header.nlist * 2 * sizeof(int32_t));
+    return sidecar_hash_final(&hash);
+}
+
+static uint64_t sidecar_data_offset (int nlist) {
+    uint64_t end = sizeof(vector_sidecar_header) + (uint64_t)nlist * 2 * sizeof(int32_t);
+    return (end + VECTOR_SIDECAR_ALIGNMENT - 1) / VECTOR_SIDECAR_ALIGNMENT * VECTOR_SIDECAR_ALIGNMENT;
+}
+
+static char *sidecar_strdup (const char *s) {
+    size_t len = strlen(s) + 1;
+    char *p = (char *)malloc(len);
+    if (p) memcpy(p, s, len);
+    return p;
+}
+
+// MARK: - Writer -
+
+vector_sidecar_writer *vector_sidecar_create (const char *path, const char *tmp_path, int nlist) {
+    if (!vector_sidecar_is_supported() || !path || !tmp_path || nlist < 0) return NULL;
+
+    vector_sidecar_writer *w = (vector_sidecar_writer *)calloc(1, sizeof(vector_sidecar_writer));
+    if (!w) return NULL;
+
+    w->path = sidecar_strdup(path);
+    w->tmp_path = sidecar_strdup(tmp_path);
+    w->nlist = nlist;
+    w->data_offset = sidecar_data_offset(nlist);
+    sidecar_hash_init(&w->hash);
+    if (!w->path || !w->tmp_path) goto abort_create;
+
+    w->f = fopen(tmp_path, "wb");
+    if (!w->f) goto abort_create;
+
+    // header and list pairs are written by vector_sidecar_finish, reserve their space (zero filled)
+    static const uint8_t zero[VECTOR_SIDECAR_ALIGNMENT] = {0};
+    for (uint64_t left = w->data_offset; left > 0;) {
+        size_t n = (left > sizeof(zero)) ? sizeof(zero) : (size_t)left;
+        if (fwrite(zero, 1, n, w->f) != n) goto abort_create;
+        left -= n;
+    }
+    return w;
+
+abort_create:
+    vector_sidecar_abort(w);
+    return NULL;
+}
+
+bool vector_sidecar_write (vector_sidecar_writer *w, const void *data, size_t size) {
+    if (size == 0) return true;
+    if (fwrite(data, 1, size, w->f) != size) return false;
+    sidecar_hash_update(&w->hash, data, size);
+    w->data_bytes += size;
+    return true;
+}
+
+static bool sidecar_rename (const char *from, const char *to) {
+    #ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+    #else
+    return rename(from, to) == 0;
+    #endif
+}
+
+bool vector_sidecar_finish (vector_sidecar_writer *w, int64_t generation, int64_t counter, uint32_t stride, const int32_t *lists) {
+    bool result = false;
+    // without lists (IVF layout not usable) the reserved space is left zero filled
+    int nlist = (lists) ? w->nlist : 0;
+    size_t lists_bytes = (size_t)nlist * 2 * sizeof(int32_t);
+    if (stride <= sizeof(int64_t) || counter < 0) goto finish_cleanup;
+    if (vector_chunk_bytes(VECTOR_CHUNK_FORMAT_SPLIT, (size_t)counter, stride - sizeof(int64_t)) != w->data_bytes) goto finish_cleanup;
+    if (lists_bytes > 0) sidecar_hash_update(&w->hash, lists, lists_bytes);
+
+    vector_sidecar_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VECTOR_SIDECAR_MAGIC, sizeof(header.magic));
+    header.version = VECTOR_SIDECAR_VERSION;
+    header.header_size = (uint32_t)sizeof(vector_sidecar_header);
+    header.stride = stride;
+    header.nlist = nlist;
+    header.generation = generation;
+    header.counter = counter;
+    header.data_offset = w->data_offset;
+    header.data_bytes = w->data_bytes;
+    header.checksum = sidecar_hash_final(&w->hash);
+    header.header_checksum = sidecar_header_checksum(&header, (nlist > 0) ? lists : NULL);
+
+    if (fseek(w->f, 0, SEEK_SET) != 0) goto finish_cleanup;
+    if (fwrite(&header, 1, sizeof(header), w->f) != sizeof(header)) goto finish_cleanup;
+    if (lists_bytes > 0 && fwrite(lists, 1, lists_bytes, w->f) != lists_bytes) goto finish_cleanup;
+
+    int rc = fclose(w->f);
+    w->f = NULL;
+    if (rc != 0) goto finish_cleanup;
+
+    // the records are verified once, before the file becomes visible (opening it only checks the header)
+    vector_sidecar written;
+    if (!vector_sidecar_open(w->tmp_path, &written)) goto finish_cleanup;
+    bool valid = (sidecar_records_checksum(&written) == written.header.checksum);
+    vector_sidecar_close(&written);
+    if (!valid) goto finish_cleanup;
+
+    result = sidecar_rename(w->tmp_path, w->path);
+
+finish_cleanup:
+    if (!result) {
+        vector_sidecar_abort(w);
+        return false;
+    }
+    free(w->path);
+    free(w->tmp_path);
+    free(w);
+    return true;
+}
+
+void vector_sidecar_abort (vector_sidecar_writer *w) {
+    if (!w) return;
+    if (w->f) fclose(w->f);
+    if (w->tmp_path) remove(w->tmp_path);
+    free(w->path);
+    free(w->tmp_path);
+    free(w);
+}
+
+// MARK: - Reader -
+
+static bool sidecar_validate (vector_sidecar *s) {
+    if (s->map_size < sizeof(vector_sidecar_header)) return false;
+
+    vector_sidecar_header *header = &s->header;
+    memcpy(header, s->map, sizeof(vector_sidecar_header));
+    if (memcmp(header->magic, VECTOR_SIDECAR_MAGIC, sizeof(header->magic)) != 0) return false;
+    if (header->version != VECTOR_SIDECAR_VERSION || header->header_size != sizeof(vector_sidecar_header)) return false;
+    if (header->nlist < 0 || header->counter < 0 || header->stride <= sizeof(int64_t)) return false;
+    if (header->data_offset % VECTOR_SIDECAR_ALIGNMENT != 0 || header->data_offset < sidecar_data_offset(header->nlist)) return false;
+    if ((uint64_t)header->counter > (uint64_t)SIZE_MAX / header->stride) return false;
+    if (header->data_bytes != vector_chunk_bytes(VECTOR_CHUNK_FORMAT_SPLIT, (size_t)header->counter, header->stride - sizeof(int64_t))) return false;
+    if (header->data_offset + header->data_bytes != (uint64_t)s->map_size) return false;
+
+    const uint8_t *base = (const uint8_t *)s->map;
+    s->data = base + header->data_offset;
+    s->lists = (header->nlist > 0) ? (const int32_t *)(base + sizeof(vector_sidecar_header)) : NULL;
+
+    // the records themselves are not read here, so a cold open touches only the first pages of the file
+    return sidecar_header_checksum(header, s->lists) == header->header_checksum;
+}
+
+#if VECTOR_SIDECAR_MMAP
+
+static bool sidecar_map (const char *path, vector_sidecar *s) {
+    #ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || (uint64_t)size.QuadPart > (uint64_t)SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);      // the mapping keeps the file open
+    if (mapping == NULL) return false;
+
+    void *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (map == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    s->map = map;
+    s->map_size = (size_t)size.QuadPart;
+    s->handle = (void *)mapping;
+    return true;
+    #else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > (uint64_t)SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);              // the mapping keeps the file open
+    if (map == MAP_FAILED) return false;
+
+    s->map = map;
+    s->map_size = (size_t)st.st_size;
+    s->handle = NULL;
+    return true;
+    #endif
+}
+
+static void sidecar_unmap (vector_sidecar *s) {
+    #ifdef _WIN32
+    if (s->map) UnmapViewOfFile(s->map);
+    if (s->handle) CloseHandle((HANDLE)s->handle);
+    #else
+    if (s->map) munmap(s->map, s->map_size);
+    #endif
+}
+
+bool vector_sidecar_is_supported (void) {
+    return true;
+}
+
+#else
+
+static bool sidecar_map (const char *path, vector_sidecar *s) {
+    (void)path;
+    (void)s;
+    return false;
+}
+
+static void sidecar_unmap (vector_sidecar *s) {
+    (void)s;
+}
+
+bool vector_sidecar_is_supported (void) {
+    return false;
+}
+
+#endif
+
+bool vector_sidecar_open (const char *path, vector_sidecar *s) {
+    memset(s, 0, sizeof(vector_sidecar));
+    if (!path || !sidecar_map(path, s)) return false;
+
+    if (!sidecar_validate(s)) {
+        vector_sidecar_close(s);
+        return false;
+    }
+    return true;
+}
+
+void vector_sidecar_close (vector_sidecar *s) {
+    sidecar_unmap(s);
+    memset(s, 0, sizeof(vector_sidecar));
+}
+
+bool vector_sidecar_remove (const char *path) {
+    return (path) && (remove(path) == 0);
+}
@@ -0,0 +1,68 @@
+//
+//  vector-sidecar.h
+//  sqlitevector
+//
+//  On-disk sidecar file of the preloaded quantized data, mapped read-only
+//
+
+#ifndef __VECTOR_SIDECAR__
+#define __VECTOR_SIDECAR__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define VECTOR_SIDECAR_MAGIC        "SQVQUANT"
+#define VECTOR_SIDECAR_VERSION      3               // 2: records in the split chunk layout, 3: header checksum
+#define VECTOR_SIDECAR_ALIGNMENT    4096            // records start on a page boundary
+
+// File layout:
+//   header (72 bytes) | IVF (start, count) int32 pairs (nlist * 8 bytes) | padding | records
+// Records are stored as a single chunk in the split layout of vector-chunk.h (all the codes, padded,
+// then all the rowids) and start at data_offset, the first multiple of VECTOR_SIDECAR_ALIGNMENT after
+// the space reserved for the list pairs (a list-less file may keep that space zero filled). The checksum
+// covers the records followed by the list pairs and is verified once, after writing: opening a file only
+// checks header_checksum (the header with that field zeroed, then the list pairs), so no record page is
+// touched before the first scan. Values are stored in native byte order.
+typedef struct {
+    char            magic[8];               // VECTOR_SIDECAR_MAGIC
+    uint32_t        version;                // VECTOR_SIDECAR_VERSION
+    uint32_t        header_size;            // sizeof(vector_sidecar_header)
+    uint32_t        stride;                 // bytes per record (rowid and code)
+    int32_t         nlist;                  // number of IVF list pairs (0 for a flat layout)
+    int64_t         generation;             // quantization generation the records were read from
+    int64_t         counter;                // number of records
+    uint64_t        data_offset;            // offset of the first record
+    uint64_t        data_bytes;             // split layout size of counter records
+    uint64_t        checksum;               // records and list pairs
+    uint64_t        header_checksum;        // header and list pairs
+} vector_sidecar_header;
+
+// read-only view of a valid sidecar file
+typedef struct {
+    vector_sidecar_header   header;
+    const uint8_t           *data;          // records (inside the mapping)
+    const int32_t           *lists;         // IVF list pairs (inside the mapping, NULL if nlist is 0)
+    void                    *map;           // mapping base address
+    size_t                  map_size;
+    void                    *handle;        // platform mapping handle (Windows only)
+} vector_sidecar;
+
+typedef struct vector_sidecar_writer vector_sidecar_writer;
+
+// writes a new sidecar into tmp_path and atomically renames it to path once complete
+// (readers never observe a partially written file); returns NULL if the file cannot be created
+vector_sidecar_writer *vector_sidecar_create (const char *path, const char *tmp_path, int nlist);
+bool vector_sidecar_write (vector_sidecar_writer *w, const void *data, size_t size);
+bool vector_sidecar_finish (vector_sidecar_writer *w, int64_t generation, int64_t counter, uint32_t stride, const int32_t *lists);
+void vector_sidecar_abort (vector_sidecar_writer *w);
+
+// maps path read-only and validates its header, size and header checksum (false if missing or invalid)
+bool vector_sidecar_open (const char *path, vector_sidecar *s);
+void vector_sidecar_close (vector_sidecar *s);
+bool vector_sidecar_remove (const char *path);
+
+// true if the current build can memory map files
+bool vector_sidecar_is_supported (void);
+
+#endif
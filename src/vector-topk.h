@@ -0,0 +1,124 @@
+//
+//  vector-topk.h
+//  sqlitevector
+//
+//  Bounded top-k collector shared by the scan modules
+//
+
+#ifndef __VECTOR_TOPK__
+#define __VECTOR_TOPK__
+
+#include <math.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Bounded top-k collector: a binary max-heap over (distance, rowid) pairs.
+// The root always holds the worst retained candidate, so rejecting a candidate costs one
+// comparison and accepting one costs O(log k). Candidates are ordered by distance and then
+// by rowid, so the retained set does not depend on scan order.
+// Storage is owned by the caller (two parallel arrays of at least capacity entries).
+typedef struct {
+    double          *distance;              // heap-ordered distances
+    int64_t         *rowids;                // rowid associated to each distance slot
+    int             capacity;               // k
+    int             count;                  // number of valid entries
+} vector_topk;
+
+static inline void vector_topk_init (vector_topk *t, double *distance, int64_t *rowids, int capacity) {
+    t->distance = distance;
+    t->rowids = rowids;
+    t->capacity = capacity;
+    t->count = 0;
+}
+
+static inline void vector_topk_reset (vector_topk *t) {
+    t->count = 0;
+}
+
+// returns true if (d1, r1) must be ranked after (d2, r2)
+static inline bool vector_topk_worse (double d1, int64_t r1, double d2, int64_t r2) {
+    return (d1 > d2) || (d1 == d2 && r1 > r2);
+}
+
+// distance a new candidate must not exceed to have a chance to enter the collector
+static inline double vector_topk_threshold (const vector_topk *t) {
+    return (t->count < t->capacity) ? INFINITY : t->distance[0];
+}
+
+static inline void vector_topk_sift_down (vector_topk *t, int i, int n) {
+    double *distance = t->distance;
+    int64_t *rowids = t->rowids;
+    double d = distance[i];
+    int64_t r = rowids[i];
+
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= n) break;
+        if ((child + 1 < n) && vector_topk_worse(distance[child + 1], rowids[child + 1], distance[child], rowids[child])) ++child;
+        if (!vector_topk_worse(distance[child], rowids[child], d, r)) break;
+        distance[i] = distance[child];
+        rowids[i] = rowids[child];
+        i = child;
+    }
+
+    distance[i] = d;
+    rowids[i] = r;
+}
+
+static inline void vector_topk_sift_up (vector_topk *t, int i) {
+    double *distance = t->distance;
+    int64_t *rowids = t->rowids;
+    double d = distance[i];
+    int64_t r = rowids[i];
+
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!vector_topk_worse(d, r, distance[parent], rowids[parent])) break;
+        distance[i] = distance[parent];
+        rowids[i] = rowids[parent];
+        i = parent;
+    }
+
+    distance[i] = d;
+    rowids[i] = r;
+}
+
+// offer a candidate; returns true if it was retained
+// non finite distances (NaN, +Inf) are never retained
+static inline bool vector_topk_push (vector_topk *t, double distance, int64_t rowid) {
+    if (!(distance < INFINITY)) return false;
+
+    if (t->count < t->capacity) {
+        int i = t->count++;
+        t->distance[i] = distance;
+        t->rowids[i] = rowid;
+        vector_topk_sift_up(t, i);
+        return true;
+    }
+
+    if (t->capacity == 0) return false;
+    if (!vector_topk_worse(t->distance[0], t->rowids[0], distance, rowid)) return false;
+
+    // replace-top
+    t->distance[0] = distance;
+    t->rowids[0] = rowid;
+    vector_topk_sift_down(t, 0, t->count);
+    return true;
+}
+
+// in-place heap-sort: on return the first count entries are sorted by ascending distance
+// (the collector is no longer a heap afterwards, call vector_topk_reset before reusing it)
+static inline int vector_topk_sort (vector_topk *t) {
+    for (int n = t->count - 1; n > 0; --n) {
+        double d = t->distance[0];
+        int64_t r = t->rowids[0];
+        t->distance[0] = t->distance[n];
+        t->rowids[0] = t->rowids[n];
+        t->distance[n] = d;
+        t->rowids[n] = r;
+        vector_topk_sift_down(t, 0, n);
+    }
+    return t->count;
+}
+
+#endif
@@ -13,6 +13,9 @@
 #include <math.h>
 #include "sqlite3.h"
 #include "sqlite-vector.h"
+#include "vector-chunk.h"
+#include "vector-sidecar.h"
+#include "distance-cpu.h"
 
 /* ---------- Test infrastructure ---------- */
 
@@ -640,6 +643,2235 @@ static void test_distance_functions_hamming(sqlite3 *db) {
     }
 }
 
+/* ---------- Helpers: larger pseudo-random tables ---------- */
+
+/* Deterministic LCG so results are reproducible across runs and platforms. */
+static unsigned int rnd_state = 12345;
+static float rnd_float(void) {
+    rnd_state = rnd_state * 1103515245u + 12345u;
+    return (float)((rnd_state >> 8) & 0xFFFF) / 65535.0f * 2.0f - 1.0f;
+}
+
+static void rnd_json(char *buf, size_t size, int dim) {
+    size_t off = 0;
+    off += snprintf(buf + off, size - off, "[");
+    for (int j = 0; j < dim; j++) {
+        off += snprintf(buf + off, size - off, "%s%.4f", j ? ", " : "", rnd_float());
+    }
+    snprintf(buf + off, size - off, "]");
+}
+
+/* Creates `tbl` with `n` random f32 vectors of dimension `dim` and calls vector_init. */
+static int setup_random_table(sqlite3 *db, const char *tbl, const char *distance, int dim, int n) {
+    char sql[8192], json[4096];
+
+    snprintf(sql, sizeof(sql), "CREATE TABLE \"%s\" (id INTEGER PRIMARY KEY, v BLOB);", tbl);
+    if (exec_sql(db, sql) != SQLITE_OK) return -1;
+
+    exec_sql(db, "BEGIN;");
+    for (int i = 0; i < n; i++) {
+        rnd_json(json, sizeof(json), dim);
+        snprintf(sql, sizeof(sql), "INSERT INTO \"%s\" (id, v) VALUES (%d, vector_as_f32('%s'));", tbl, i + 1, json);
+        if (exec_sql(db, sql) != SQLITE_OK) { exec_sql(db, "ROLLBACK;"); return -1; }
+    }
+    exec_sql(db, "COMMIT;");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_init('%s', 'v', 'type=f32,dimension=%d,distance=%s');", tbl, dim, distance);
+    return (exec_sql(db, sql) == SQLITE_OK) ? 0 : -1;
+}
+
+/* Runs `sql` and stores (column 0, column 1) as (id, distance); returns the row count or -1. */
+static int collect_rows(sqlite3 *db, const char *sql, long long *ids, double *distances, int max) {
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+        printf("  SQL error: %s\n  Statement: %s\n", sqlite3_errmsg(db), sql);
+        return -1;
+    }
+
+    int count = 0, rc;
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count < max) {
+            ids[count] = sqlite3_column_int64(stmt, 0);
+            distances[count] = sqlite3_column_double(stmt, 1);
+        }
+        count++;
+    }
+    if (rc != SQLITE_DONE) {
+        printf("  SQL error: %s\n  Statement: %s\n", sqlite3_errmsg(db), sql);
+        count = -1;
+    }
+    sqlite3_finalize(stmt);
+    return count;
+}
+
+/* ---------- Test: top-k collector against a sorted streaming scan ---------- */
+
+static void test_topk_large_k(sqlite3 *db) {
+    const char *tbl = "ttopk";
+    const int n = 300, dim = 8;
+    char sql[1024], msg[256], query[512];
+    static long long ids[512], ref_ids[512];
+    static double dist[512], ref_dist[512];
+
+    printf("\n=== top-k collector ===\n");
+    rnd_state = 777;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "top-k setup");
+        return;
+    }
+    rnd_json(query, sizeof(query), dim);
+
+    const char *modules[] = {"vector_full_scan", "vector_quantize_scan", "vector_quantize_scan"};
+    const int ks[] = {1, 7, 64, 299, 300, 500};
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v');", tbl);
+    exec_sql(db, sql);
+
+    for (int m = 0; m < 3; m++) {
+        if (m == 2) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+            exec_sql(db, sql);
+        }
+        const char *label = (m == 2) ? "vector_quantize_scan/preload" : modules[m];
+
+        snprintf(sql, sizeof(sql),
+                 "SELECT rowid, distance FROM %s('%s', 'v', '%s') ORDER BY distance, rowid;",
+                 modules[m], tbl, query);
+        int nref = collect_rows(db, sql, ref_ids, ref_dist, 512);
+        snprintf(msg, sizeof(msg), "%s streaming reference returns all rows", label);
+        ASSERT(nref == n, msg);
+        if (nref != n) continue;
+
+        for (size_t i = 0; i < sizeof(ks) / sizeof(ks[0]); i++) {
+            int k = ks[i];
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s', %d);", modules[m], tbl, query, k);
+            int count = collect_rows(db, sql, ids, dist, 512);
+            int expected = (k < n) ? k : n;
+            snprintf(msg, sizeof(msg), "%s k=%d returns %d rows (got %d)", label, k, expected, count);
+            ASSERT(count == expected, msg);
+            if (count != expected) continue;
+
+            int same = 1;
+            for (int j = 0; j < count; j++) {
+                if (ids[j] != ref_ids[j] || dist[j] != ref_dist[j]) same = 0;
+            }
+            snprintf(msg, sizeof(msg), "%s k=%d matches sorted streaming scan", label, k);
+            ASSERT(same, msg);
+        }
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_full_scan('%s', 'v', '%s', -1);", tbl, query);
+    ASSERT(collect_rows(db, sql, ids, dist, 512) == -1, "negative k is rejected");
+}
+
+/* ---------- Test: exact reranking of quantized top-k ---------- */
+
+static int count_common_ids(const long long *a, int na, const long long *b, int nb) {
+    int common = 0;
+    for (int i = 0; i < na; i++) {
+        for (int j = 0; j < nb; j++) {
+            if (a[i] == b[j]) { common++; break; }
+        }
+    }
+    return common;
+}
+
+static void test_quantize_rerank(sqlite3 *db) {
+    const char *tbl = "trerank";
+    const int n = 400, dim = 16, k = 10;
+    char sql[2048], msg[256], query[512];
+    long long exact_ids[16], ids[16];
+    double exact_dist[16], dist[16];
+
+    printf("\n=== vector_quantize_scan rerank ===\n");
+    rnd_state = 4242;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "rerank setup");
+        return;
+    }
+    rnd_json(query, sizeof(query), dim);
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=1BIT');", tbl);
+    exec_sql(db, sql);
+
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    int nexact = collect_rows(db, sql, exact_ids, exact_dist, 16);
+    ASSERT(nexact == k, "rerank reference full scan returns k rows");
+
+    for (int preload = 0; preload < 2; preload++) {
+        const char *mode = preload ? "preload" : "disk";
+        if (preload) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+            exec_sql(db, sql);
+        }
+
+        /* candidate pool covers the whole table: results must match the exact full scan */
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'rerank=%d');", tbl, query, k, n / k);
+        int count = collect_rows(db, sql, ids, dist, 16);
+        int same = (count == nexact);
+        for (int i = 0; same && i < count; i++) same = (ids[i] == exact_ids[i] && dist[i] == exact_dist[i]);
+        snprintf(msg, sizeof(msg), "rerank over all rows matches vector_full_scan (%s)", mode);
+        ASSERT(same, msg);
+
+        /* small factor: recall can only improve over the plain quantized ranking */
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl, query, k);
+        int nplain = collect_rows(db, sql, ids, dist, 16);
+        int plain_recall = count_common_ids(ids, nplain, exact_ids, nexact);
+
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'rerank=4');", tbl, query, k);
+        count = collect_rows(db, sql, ids, dist, 16);
+        snprintf(msg, sizeof(msg), "rerank=4 returns k rows (%s)", mode);
+        ASSERT(count == k, msg);
+
+        int sorted = 1;
+        for (int i = 1; i < count; i++) if (dist[i] < dist[i - 1]) sorted = 0;
+        snprintf(msg, sizeof(msg), "rerank=4 distances sorted (%s)", mode);
+        ASSERT(sorted, msg);
+
+        int rerank_recall = count_common_ids(ids, count, exact_ids, nexact);
+        snprintf(msg, sizeof(msg), "rerank=4 recall >= plain recall (%d vs %d, %s)", rerank_recall, plain_recall, mode);
+        ASSERT(rerank_recall >= plain_recall, msg);
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_quantize_scan('%s', 'v', '%s', %d, 'rerank=-1');", tbl, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "invalid rerank factor is rejected");
+
+    /* options fixed by vector_init and vector_quantize cannot be changed per query */
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_quantize_scan('%s', 'v', '%s', %d, 'distance=DOT,qtype=1BIT,dimension=4');", tbl, query, k);
+    int rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    ASSERT(rc != SQLITE_OK && strstr(sqlite3_errmsg(db), "'distance' not allowed per query") != NULL, "column options are rejected per query");
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_quantize_scan_batch('%s', 'v', '%s', 1, %d, 'rerank=2,qtype=1BIT');", tbl, query, k);
+    rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    ASSERT(rc != SQLITE_OK && strstr(sqlite3_errmsg(db), "'qtype' not allowed per query") != NULL, "quantization options are rejected per batch query");
+}
+
+/* ---------- Test: IVF coarse-partitioned quantized index ---------- */
+
+static void test_quantize_ivf(sqlite3 *db) {
+    const char *tbl = "tivf";
+    const int n = 600, dim = 16, k = 10, nlist = 16;
+    char sql[2048], msg[256], query[512];
+    long long flat_ids[16], exact_ids[16], ids[16];
+    double flat_dist[16], exact_dist[16], dist[16];
+
+    printf("\n=== vector_quantize IVF index ===\n");
+    rnd_state = 777;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "ivf setup");
+        return;
+    }
+    rnd_json(query, sizeof(query), dim);
+
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    int nexact = collect_rows(db, sql, exact_ids, exact_dist, 16);
+
+    /* flat quantized reference */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    int nflat = collect_rows(db, sql, flat_ids, flat_dist, 16);
+    ASSERT(nflat == k, "flat quantized reference returns k rows");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,index=ivf,nlist=%d'), 0;", tbl, nlist);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == n, "vector_quantize with index=ivf quantizes every row");
+
+    snprintf(sql, sizeof(sql), "SELECT COUNT(DISTINCT list), 0 FROM vector0_%s_v;", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] > 1 && ids[0] <= nlist, "posting lists are stored in the quant table");
+
+    for (int preload = 0; preload < 2; preload++) {
+        const char *mode = preload ? "preload" : "disk";
+        if (preload) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+            exec_sql(db, sql);
+        }
+
+        /* probing every list is an exhaustive scan over the same codes */
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=%d');", tbl, query, k, nlist);
+        int count = collect_rows(db, sql, ids, dist, 16);
+        int same = (count == nflat);
+        for (int i = 0; same && i < count; i++) same = (ids[i] == flat_ids[i] && dist[i] == flat_dist[i]);
+        snprintf(msg, sizeof(msg), "nprobe=nlist matches the flat quantized scan (%s)", mode);
+        ASSERT(same, msg);
+
+        /* partial probe: still k sorted rows and a reasonable recall */
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4');", tbl, query, k);
+        count = collect_rows(db, sql, ids, dist, 16);
+        snprintf(msg, sizeof(msg), "nprobe=4 returns k rows (%s)", mode);
+        ASSERT(count == k, msg);
+
+        int sorted = 1;
+        for (int i = 1; i < count; i++) if (dist[i] < dist[i - 1]) sorted = 0;
+        snprintf(msg, sizeof(msg), "nprobe=4 distances sorted (%s)", mode);
+        ASSERT(sorted, msg);
+
+        int recall = count_common_ids(ids, count, exact_ids, nexact);
+        snprintf(msg, sizeof(msg), "nprobe=4 recall@%d >= %d/%d (got %d, %s)", k, k / 2, k, recall, mode);
+        ASSERT(recall >= k / 2, msg);
+
+        /* nprobe combined with rerank */
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=%d,rerank=%d');", tbl, query, k, nlist, n / k);
+        count = collect_rows(db, sql, ids, dist, 16);
+        same = (count == nexact);
+        for (int i = 0; same && i < count; i++) same = (ids[i] == exact_ids[i] && dist[i] == exact_dist[i]);
+        snprintf(msg, sizeof(msg), "IVF with full probe and rerank matches vector_full_scan (%s)", mode);
+        ASSERT(same, msg);
+    }
+
+    /* the coarse quantizer is persisted next to scale/offset */
+    snprintf(sql, sizeof(sql), "SELECT length(value), 0 FROM _sqliteai_vector WHERE tblname='%s' AND key='ivf_centroids';", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == (long long)(nlist * dim * sizeof(float)), "IVF centroids are serialized");
+
+    /* a table larger than max_memory spills its records to a temporary table: same posting lists, smaller chunks */
+    long long ref_ids[16];
+    double ref_dist[16];
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4');", tbl, query, k);
+    int nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,index=ivf,nlist=%d,max_memory=%d'), 0;", tbl, nlist, 20 * (8 + dim));
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == n, "spilled IVF build quantizes every row");
+    snprintf(sql, sizeof(sql), "SELECT COUNT(*), MAX(counter) FROM vector0_%s_v;", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] > nlist && dist[0] <= 20, "spilled IVF build honors max_memory");
+    snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM vector0_%s_v a JOIN vector0_%s_v b ON a.list = b.list AND a.rowid < b.rowid AND b.rowid1 <= a.rowid2;", tbl, tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == 0, "spilled posting lists are written in rowid order");
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4');", tbl, query, k);
+    int count = collect_rows(db, sql, ids, dist, 16);
+    int same = (nref == k && count == nref);
+    for (int i = 0; same && i < count; i++) same = (ids[i] == ref_ids[i] && dist[i] == ref_dist[i]);
+    ASSERT(same, "spilled IVF build matches the in-memory one");
+    ASSERT(collect_rows(db, "SELECT COUNT(*), 0 FROM temp._sqliteai_vector_spill;", ids, dist, 16) == 1 && ids[0] == 0, "spilled records are released");
+
+    /* rebuilding without index drops the IVF layout */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,index=none');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=1');", tbl, query, k);
+    count = collect_rows(db, sql, ids, dist, 16);
+    same = (count == nflat);
+    for (int i = 0; same && i < count; i++) same = (ids[i] == flat_ids[i] && dist[i] == flat_dist[i]);
+    ASSERT(same, "index=none restores the flat layout");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'index=hnsw');", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "unknown index type is rejected");
+}
+
+/* ---------- Test: HNSW graph index ---------- */
+
+static void test_hnsw_scan(sqlite3 *db) {
+    const char *tbl = "thnsw";
+    const int n = 1000, dim = 16, k = 10;
+    char sql[2048], msg[256], query[512];
+    long long exact_ids[16], ids[16];
+    double exact_dist[16], dist[16];
+
+    printf("\n=== vector_hnsw_scan ===\n");
+    rnd_state = 31337;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "hnsw setup");
+        return;
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_hnsw_scan('%s', 'v', '[0]', 10);", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "vector_hnsw_scan before vector_hnsw_build is rejected");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_hnsw_build('%s', 'v', 'M=8,ef_construction=64'), 0;", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == n, "vector_hnsw_build indexes every row");
+
+    snprintf(sql, sizeof(sql), "SELECT COUNT(*), MAX(level) FROM vector1_%s_v;", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == n && dist[0] >= 1, "graph nodes and upper layers are persisted");
+
+    int total_recall = 0, exhaustive_ok = 1;
+    const int nqueries = 5;
+    for (int q = 0; q < nqueries; q++) {
+        rnd_json(query, sizeof(query), dim);
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+        int nexact = collect_rows(db, sql, exact_ids, exact_dist, 16);
+
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_hnsw_scan('%s', 'v', '%s', %d);", tbl, query, k);
+        int count = collect_rows(db, sql, ids, dist, 16);
+        snprintf(msg, sizeof(msg), "vector_hnsw_scan returns k sorted rows (query %d)", q);
+        int sorted = (count == k);
+        for (int i = 1; sorted && i < count; i++) if (dist[i] < dist[i - 1]) sorted = 0;
+        ASSERT(sorted, msg);
+        total_recall += count_common_ids(ids, count, exact_ids, nexact);
+
+        /* a beam as wide as the table visits the whole connected graph */
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_hnsw_scan('%s', 'v', '%s', %d, 'ef_search=%d');", tbl, query, k, n);
+        count = collect_rows(db, sql, ids, dist, 16);
+        for (int i = 0; i < count; i++) if (count != nexact || ids[i] != exact_ids[i] || dist[i] != exact_dist[i]) exhaustive_ok = 0;
+    }
+    snprintf(msg, sizeof(msg), "default ef_search recall@%d >= 0.9 (got %d/%d)", k, total_recall, nqueries * k);
+    ASSERT(total_recall * 10 >= nqueries * k * 9, msg);
+    ASSERT(exhaustive_ok, "ef_search=n matches vector_full_scan exactly");
+
+    /* rebuilding replaces the graph and the in-memory upper layers */
+    snprintf(sql, sizeof(sql), "SELECT vector_hnsw_build('%s', 'v', 'M=4'), 0;", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == n, "vector_hnsw_build can be called again");
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_hnsw_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == k, "vector_hnsw_scan after rebuild returns k rows");
+
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_hnsw_scan('%s', 'v', '%s');", tbl, query);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "vector_hnsw_scan without k is rejected");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_hnsw_build('%s', 'v', 'M=1');", tbl);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "invalid M is rejected");
+}
+
+/* ---------- Test: multi-threaded partitioned scan ---------- */
+
+static int same_rows(const long long *ids1, const double *dist1, int n1, const long long *ids2, const double *dist2, int n2) {
+    if (n1 != n2 || n1 <= 0) return 0;
+    for (int i = 0; i < n1; i++) if (ids1[i] != ids2[i] || dist1[i] != dist2[i]) return 0;
+    return 1;
+}
+
+static void test_parallel_scan(sqlite3 *db) {
+    const char *tbl = "tpar";
+    const int n = 1500, dim = 8, k = 40;
+    char sql[2048], msg[256], query[512];
+    long long ref_ids[64], ids[64];
+    double ref_dist[64], dist[64];
+
+    printf("\n=== threads=N partitioned scan ===\n");
+    rnd_state = 4242;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "parallel setup");
+        return;
+    }
+    /* duplicate every vector so that many candidates tie on distance and only the rowid breaks the tie */
+    snprintf(sql, sizeof(sql), "INSERT INTO \"%s\" (v) SELECT v FROM \"%s\";", tbl, tbl);
+    exec_sql(db, sql);
+    rnd_json(query, sizeof(query), dim);
+
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+    ASSERT(nref == k, "single-threaded full scan returns k rows");
+    for (int threads = 2; threads <= 8; threads *= 2) {
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d, 'threads=%d');", tbl, query, k, threads);
+        int count = collect_rows(db, sql, ids, dist, 64);
+        snprintf(msg, sizeof(msg), "full scan with threads=%d matches threads=1", threads);
+        ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+    }
+
+    const char *layouts[] = {"qtype=UINT8", "qtype=UINT8,index=ivf,nlist=4"};
+    for (int l = 0; l < 2; l++) {
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, layouts[l]);
+        exec_sql(db, sql);
+        for (int preload = 0; preload < 2; preload++) {
+            if (preload) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                exec_sql(db, sql);
+            }
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=2');", tbl, query, k);
+            nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=2,threads=4');", tbl, query, k);
+            int count = collect_rows(db, sql, ids, dist, 64);
+            snprintf(msg, sizeof(msg), "quantized scan with threads=4 matches threads=1 (%s, %s)", layouts[l], preload ? "preload" : "disk");
+            ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+        }
+    }
+
+    /* threads set in vector_init is the table default, a per-query value overrides it */
+    exec_sql(db, "CREATE TABLE tpar2 (id INTEGER PRIMARY KEY, v BLOB);");
+    snprintf(sql, sizeof(sql), "INSERT INTO tpar2 SELECT id, v FROM \"%s\";", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_init('tpar2', 'v', 'type=f32,dimension=%d,distance=L2,threads=4');", dim);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('tpar2', 'v', '%s', %d, 'threads=1');", query, k);
+    nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('tpar2', 'v', '%s', %d);", query, k);
+    int count = collect_rows(db, sql, ids, dist, 64);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "table level threads matches threads=1");
+
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_full_scan('%s', 'v', '%s', %d, 'threads=1000');", tbl, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == -1, "invalid threads value is rejected");
+}
+
+/* ---------- Test: product quantization ---------- */
+
+static void test_quantize_pq(sqlite3 *db) {
+    const char *distances[] = {"L2", "COSINE", "DOT", "L1"};
+    const int n = 1000, dim = 32, k = 10, nqueries = 5;
+    char sql[4096], msg[256], query[1024], tbl[32];
+    long long exact_ids[16], ids[16];
+    double exact_dist[16], dist[16];
+
+    printf("\n=== vector_quantize PQ ===\n");
+    for (int d = 0; d < 4; d++) {
+        snprintf(tbl, sizeof(tbl), "tpq_%s", distances[d]);
+        rnd_state = 9001 + d;
+        if (setup_random_table(db, tbl, distances[d], dim, n) != 0) {
+            ASSERT(0, "pq setup");
+            return;
+        }
+
+        /* 1BIT reference: same query set, recall measured against the exact scan */
+        int recall_1bit = 0, recall_pq8 = 0, recall_pq4 = 0, sorted = 1, rerank_ok = 1;
+        unsigned int state = rnd_state;
+        for (int pass = 0; pass < 3; pass++) {
+            const char *qopts = (pass == 0) ? "qtype=1BIT" : (pass == 1) ? "qtype=PQ,pq_m=16,nbits=8" : "qtype=PQ,pq_m=16,nbits=4";
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, qopts);
+            exec_sql(db, sql);
+            rnd_state = state;
+            for (int q = 0; q < nqueries; q++) {
+                rnd_json(query, sizeof(query), dim);
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+                int nexact = collect_rows(db, sql, exact_ids, exact_dist, 16);
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl, query, k);
+                int count = collect_rows(db, sql, ids, dist, 16);
+                for (int i = 1; i < count; i++) if (dist[i] < dist[i - 1]) sorted = 0;
+                int recall = count_common_ids(ids, count, exact_ids, nexact);
+                if (pass == 0) recall_1bit += recall;
+                else if (pass == 1) recall_pq8 += recall;
+                else recall_pq4 += recall;
+
+                if (pass == 1 && q == 0) {
+                    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'rerank=%d');", tbl, query, k, n / k);
+                    count = collect_rows(db, sql, ids, dist, 16);
+                    for (int i = 0; i < count; i++) if (count != nexact || ids[i] != exact_ids[i] || dist[i] != exact_dist[i]) rerank_ok = 0;
+                }
+            }
+        }
+
+        snprintf(msg, sizeof(msg), "PQ scan returns sorted distances (%s)", distances[d]);
+        ASSERT(sorted, msg);
+        snprintf(msg, sizeof(msg), "PQ nbits=8 recall beats 1BIT (%s: %d vs %d)", distances[d], recall_pq8, recall_1bit);
+        ASSERT(recall_pq8 >= recall_1bit && recall_pq8 * 10 >= nqueries * k * 6, msg);
+        snprintf(msg, sizeof(msg), "PQ nbits=4 recall is reasonable (%s: %d/%d)", distances[d], recall_pq4, nqueries * k);
+        ASSERT(recall_pq4 * 10 >= nqueries * k * 4, msg);
+        snprintf(msg, sizeof(msg), "PQ with full rerank matches vector_full_scan (%s)", distances[d]);
+        ASSERT(rerank_ok, msg);
+    }
+
+    /* code size: one byte per sub-quantizer with nbits=8, two codes per byte with nbits=4 */
+    const char *tbl2 = "tpq_L2";
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=PQ,pq_m=8,nbits=8');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT SUM(length(data)) / SUM(counter), 0 FROM vector0_%s_v;", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == 8 + 8, "PQ pq_m=8 nbits=8 stores 8 bytes per vector");
+    snprintf(sql, sizeof(sql), "SELECT length(value), 0 FROM _sqliteai_vector WHERE tblname='%s' AND key='pq_codebooks';", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == (long long)(dim * 256 * sizeof(float)), "PQ codebooks are serialized");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=PQ,pq_m=8,nbits=4');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT SUM(length(data)) / SUM(counter), 0 FROM vector0_%s_v;", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == 8 + 4, "PQ pq_m=8 nbits=4 stores 4 bytes per vector");
+    /* M is the HNSW links per node: it does not change the number of sub-quantizers */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=PQ,M=16,nbits=8');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT SUM(length(data)) / SUM(counter), 0 FROM vector0_%s_v;", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == 8 + dim / 8, "PQ ignores the HNSW M option");
+
+    /* streaming, preload and disk scans share the same ADC distances */
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl2, query, k);
+    int ndisk = collect_rows(db, sql, exact_ids, exact_dist, 16);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan_stream('%s', 'v', '%s') ORDER BY distance, rowid LIMIT %d;", tbl2, query, k);
+    int count = collect_rows(db, sql, ids, dist, 16);
+    int same = (count == ndisk);
+    for (int i = 0; same && i < count; i++) same = (ids[i] == exact_ids[i] && dist[i] == exact_dist[i]);
+    ASSERT(same, "PQ streaming scan matches top-k scan");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl2, query, k);
+    count = collect_rows(db, sql, ids, dist, 16);
+    same = (count == ndisk);
+    for (int i = 0; same && i < count; i++) same = (ids[i] == exact_ids[i] && dist[i] == exact_dist[i]);
+    ASSERT(same, "PQ preloaded scan matches disk scan");
+
+    /* IVF lists hold PQ codes too */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=PQ,pq_m=16,index=ivf,nlist=8');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4');", tbl2, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == k, "PQ codes inside IVF posting lists");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=PQ,pq_m=5');", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "PQ pq_m must divide the dimension");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=PQ,nbits=3');", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "invalid nbits is rejected");
+}
+
+/* ---------- Test: per-dimension calibration ---------- */
+
+/* Random vectors in [-1, 1] except dimension 0, a large almost constant value (an "outlier" dimension).
+   Row `spike` (if > 0) also gets an extreme value in dimension 1. */
+static int setup_outlier_table(sqlite3 *db, const char *tbl, const char *distance, int dim, int n, int spike) {
+    char sql[8192], json[4096];
+
+    snprintf(sql, sizeof(sql), "CREATE TABLE \"%s\" (id INTEGER PRIMARY KEY, v BLOB);", tbl);
+    if (exec_sql(db, sql) != SQLITE_OK) return -1;
+
+    exec_sql(db, "BEGIN;");
+    for (int i = 0; i < n; i++) {
+        size_t off = 0;
+        off += snprintf(json + off, sizeof(json) - off, "[%.4f", 40.0f + rnd_float() * 0.01f);
+        for (int j = 1; j < dim; j++) {
+            float x = (j == 1 && i + 1 == spike) ? 500.0f : rnd_float();
+            off += snprintf(json + off, sizeof(json) - off, ", %.4f", x);
+        }
+        snprintf(json + off, sizeof(json) - off, "]");
+        snprintf(sql, sizeof(sql), "INSERT INTO \"%s\" (id, v) VALUES (%d, vector_as_f32('%s'));", tbl, i + 1, json);
+        if (exec_sql(db, sql) != SQLITE_OK) { exec_sql(db, "ROLLBACK;"); return -1; }
+    }
+    exec_sql(db, "COMMIT;");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_init('%s', 'v', 'type=f32,dimension=%d,distance=%s');", tbl, dim, distance);
+    return (exec_sql(db, sql) == SQLITE_OK) ? 0 : -1;
+}
+
+/* Average recall@k of vector_quantize_scan against vector_full_scan over `nqueries` outlier-shaped queries. */
+static int outlier_recall(sqlite3 *db, const char *tbl, int dim, int k, int nqueries, unsigned int seed) {
+    char sql[4096], query[1024];
+    long long exact_ids[16], ids[16];
+    double exact_dist[16], dist[16];
+    int recall = 0;
+
+    rnd_state = seed;
+    for (int q = 0; q < nqueries; q++) {
+        size_t off = 0;
+        off += snprintf(query + off, sizeof(query) - off, "[%.4f", 40.0f + rnd_float() * 0.01f);
+        for (int j = 1; j < dim; j++) off += snprintf(query + off, sizeof(query) - off, ", %.4f", rnd_float());
+        snprintf(query + off, sizeof(query) - off, "]");
+
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+        int nexact = collect_rows(db, sql, exact_ids, exact_dist, 16);
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl, query, k);
+        int count = collect_rows(db, sql, ids, dist, 16);
+        recall += count_common_ids(ids, count, exact_ids, nexact);
+    }
+    return recall;
+}
+
+static void test_quantize_calibration(sqlite3 *db) {
+    const char *distances[] = {"L2", "COSINE", "DOT"};
+    const int n = 500, dim = 16, k = 10, nqueries = 5;
+    char sql[4096], msg[256], query[1024], tbl[32];
+    long long ids[16], ids2[16];
+    double dist[16], dist2[16];
+
+    printf("\n=== vector_quantize calibration ===\n");
+    for (int d = 0; d < 3; d++) {
+        snprintf(tbl, sizeof(tbl), "tcalib_%s", distances[d]);
+        rnd_state = 7007 + d;
+        if (setup_outlier_table(db, tbl, distances[d], dim, n, 0) != 0) {
+            ASSERT(0, "calibration setup");
+            return;
+        }
+
+        int recall[2][2];
+        for (int q = 0; q < 2; q++) {
+            for (int c = 0; c < 2; c++) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=%s,calibration=%s');", tbl, q ? "INT8" : "UINT8", c ? "dimension" : "global");
+                exec_sql(db, sql);
+                recall[q][c] = outlier_recall(db, tbl, dim, k, nqueries, 31337);
+            }
+            snprintf(msg, sizeof(msg), "per-dimension calibration improves %s recall (%s: %d vs %d)", q ? "INT8" : "UINT8", distances[d], recall[q][1], recall[q][0]);
+            ASSERT(recall[q][1] > recall[q][0] && recall[q][1] * 10 >= nqueries * k * 9, msg);
+        }
+    }
+
+    /* one extreme value stretches the min/max range of its dimension: percentile clipping ignores it */
+    const char *tbl2 = "tcalib_spike";
+    rnd_state = 5150;
+    if (setup_outlier_table(db, tbl2, "L2", dim, n, 77) != 0) {
+        ASSERT(0, "calibration spike setup");
+        return;
+    }
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,calibration=dimension');", tbl2);
+    exec_sql(db, sql);
+    int recall_minmax = outlier_recall(db, tbl2, dim, k, nqueries, 4711);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,calibration=dimension,percentile=99.5');", tbl2);
+    exec_sql(db, sql);
+    int recall_clip = outlier_recall(db, tbl2, dim, k, nqueries, 4711);
+    snprintf(msg, sizeof(msg), "percentile clipping improves recall with an extreme value (%d vs %d)", recall_clip, recall_minmax);
+    ASSERT(recall_clip > recall_minmax, msg);
+
+    snprintf(sql, sizeof(sql), "SELECT length(value), 0 FROM _sqliteai_vector WHERE tblname='%s' AND key='qcalibration';", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == (long long)(dim * 2 * sizeof(float)), "per-dimension scales and offsets are serialized");
+
+    /* streaming and preloaded scans decode the same codes */
+    rnd_state = 99;
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl2, query, k);
+    int ndisk = collect_rows(db, sql, ids, dist, 16);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan_stream('%s', 'v', '%s') ORDER BY distance, rowid LIMIT %d;", tbl2, query, k);
+    int count = collect_rows(db, sql, ids2, dist2, 16);
+    int same = (count == ndisk);
+    for (int i = 0; same && i < count; i++) same = (ids[i] == ids2[i] && dist[i] == dist2[i]);
+    ASSERT(same, "calibrated streaming scan matches top-k scan");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl2, query, k);
+    count = collect_rows(db, sql, ids2, dist2, 16);
+    same = (count == ndisk);
+    for (int i = 0; same && i < count; i++) same = (ids[i] == ids2[i] && dist[i] == dist2[i]);
+    ASSERT(same, "calibrated preloaded scan matches disk scan");
+
+    /* IVF posting lists hold calibrated codes too */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'calibration=dimension,index=ivf,nlist=8');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=8');", tbl2, query, k);
+    ASSERT(collect_rows(db, sql, ids2, dist2, 16) == k, "calibrated codes inside IVF posting lists");
+
+    /* back to a global calibration: the serialized per-dimension one is dropped */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'calibration=global');", tbl2);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT count(*), 0 FROM _sqliteai_vector WHERE tblname='%s' AND key='qcalibration' AND value IS NOT NULL;", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == 1 && ids[0] == 0, "global calibration drops per-dimension scales");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'calibration=column');", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "invalid calibration is rejected");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'percentile=40');", tbl2);
+    ASSERT(collect_rows(db, sql, ids, dist, 16) == -1, "invalid percentile is rejected");
+}
+
+/* ---------- Test: auto_update triggers and compaction ---------- */
+
+static long long query_int(sqlite3 *db, const char *sql) {
+    long long value[1] = {-1};
+    double unused[1];
+    return (collect_rows(db, sql, value, unused, 1) == 1) ? value[0] : -1;
+}
+
+/* Streams every quantized record: returns the number of rows, *distinct is set when no rowid repeats and no deleted row shows up. */
+static int auto_update_stream(sqlite3 *db, const char *tbl, const char *query, int deleted, int *distinct) {
+    static long long ids[1024];
+    static double dist[1024];
+    char sql[1024];
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s') ORDER BY rowid;", tbl, query);
+    int count = collect_rows(db, sql, ids, dist, 1024);
+    *distinct = (count > 0 && count <= 1024);
+    for (int i = 0; *distinct && i < count; i++) {
+        if ((i > 0 && ids[i] == ids[i - 1]) || ids[i] <= deleted) *distinct = 0;
+    }
+    return count;
+}
+
+static void test_auto_update(sqlite3 *db) {
+    const char *tbl = "tauto";
+    const int n = 300, dim = 8, k = 10;
+    char sql[4096], msg[256], query[512], json[512];
+    long long ids[64], ref_ids[64], before_ids[64];
+    double dist[64], ref_dist[64], before_dist[64];
+
+    printf("\n=== auto_update ===\n");
+    rnd_state = 8118;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "auto_update setup");
+        return;
+    }
+    rnd_json(query, sizeof(query), dim);
+
+    const char *layouts[] = {"qtype=UINT8,auto_update=1", "qtype=INT8,index=ivf,nlist=4,auto_update=1"};
+    for (int l = 0; l < 2; l++) {
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, layouts[l]);
+        ASSERT(exec_sql(db, sql) == SQLITE_OK, "vector_quantize with auto_update=1");
+        snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM sqlite_master WHERE type = 'trigger' AND tbl_name = '%s';", tbl);
+        ASSERT(query_int(db, sql) == 3, "auto_update installs the insert, update and delete triggers");
+
+        /* deletes, updates, inserts, a replaced row and a row moved onto the query vector */
+        exec_sql(db, "BEGIN;");
+        snprintf(sql, sizeof(sql), "DELETE FROM \"%s\" WHERE id <= 20;", tbl);
+        exec_sql(db, sql);
+        for (int i = 21; i <= 40; i++) {
+            rnd_json(json, sizeof(json), dim);
+            snprintf(sql, sizeof(sql), "UPDATE \"%s\" SET v = vector_as_f32('%s') WHERE id = %d;", tbl, json, i);
+            exec_sql(db, sql);
+        }
+        for (int i = 0; i < 30; i++) {
+            rnd_json(json, sizeof(json), dim);
+            snprintf(sql, sizeof(sql), "INSERT INTO \"%s\" (v) VALUES (vector_as_f32('%s'));", tbl, json);
+            exec_sql(db, sql);
+        }
+        rnd_json(json, sizeof(json), dim);
+        snprintf(sql, sizeof(sql), "INSERT OR REPLACE INTO \"%s\" (id, v) VALUES (60, vector_as_f32('%s'));", tbl, json);
+        exec_sql(db, sql);
+        snprintf(sql, sizeof(sql), "UPDATE \"%s\" SET v = vector_as_f32('%s') WHERE id = 50;", tbl, query);
+        exec_sql(db, sql);
+        exec_sql(db, "COMMIT;");
+
+        snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM \"%s\";", tbl);
+        int live = (int)query_int(db, sql);
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+        int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+
+        for (int preload = 0; preload < 2; preload++) {
+            const char *mode = preload ? "preload" : "disk";
+            if (preload) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                exec_sql(db, sql);
+            }
+
+            int distinct = 0;
+            int count = auto_update_stream(db, tbl, query, 20, &distinct);
+            snprintf(msg, sizeof(msg), "streaming scan sees every live row exactly once (%s, %s)", layouts[l], mode);
+            ASSERT(count == live && distinct, msg);
+
+            /* k * rerank covers the whole table: the exact pass must match a full scan */
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4,rerank=50');", tbl, query, k);
+            count = collect_rows(db, sql, ids, dist, 64);
+            snprintf(msg, sizeof(msg), "reranked top-k matches vector_full_scan after changes (%s, %s)", layouts[l], mode);
+            ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4');", tbl, query, k);
+            count = collect_rows(db, sql, ids, dist, 64);
+            snprintf(msg, sizeof(msg), "updated row is found through its delta (%s, %s)", layouts[l], mode);
+            ASSERT(count == k && ids[0] == 50, msg);
+        }
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4');", tbl, query, k);
+        int nbefore = collect_rows(db, sql, before_ids, before_dist, 64);
+
+        /* compaction folds deltas and tombstones into the base chunks without changing results */
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize_compact('%s', 'v'), 0;", tbl);
+        /* 20 updates, 30 inserts, the replaced row and row 50 (already on the query vector in the second round) */
+        ASSERT(query_int(db, sql) == 20 + 30 + 1 + (l == 0), "vector_quantize_compact returns the number of merged deltas");
+        snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM vector2_%s_v;", tbl);
+        ASSERT(query_int(db, sql) == 0, "compaction clears the tombstones");
+        snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM vector0_%s_v WHERE list <= -2;", tbl);
+        ASSERT(query_int(db, sql) == 0, "compaction removes the delta chunks");
+        snprintf(sql, sizeof(sql), "SELECT SUM(counter), 0 FROM vector0_%s_v;", tbl);
+        ASSERT(query_int(db, sql) == live, "base chunks hold exactly the live rows after compaction");
+
+        /* the preloaded buffer has been refreshed by the compaction */
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=4');", tbl, query, k);
+        int count = collect_rows(db, sql, ids, dist, 64);
+        snprintf(msg, sizeof(msg), "compaction does not change the quantized top-k (%s)", layouts[l]);
+        ASSERT(same_rows(ids, dist, count, before_ids, before_dist, nbefore), msg);
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize_compact('%s', 'v'), 0;", tbl);
+        ASSERT(query_int(db, sql) == 0, "compacting twice merges nothing");
+    }
+
+    /* auto_update is kept by a new quantization unless it is turned off (vector_quantize_cleanup always removes it) */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM sqlite_master WHERE type = 'trigger' AND tbl_name = '%s';", tbl);
+    ASSERT(query_int(db, sql) == 3, "a new quantization keeps auto_update");
+
+    /* an untrusted schema cannot call vector_quantize_delta from the triggers: auto_update=1 is refused, auto_update=0 works */
+    exec_sql(db, "PRAGMA trusted_schema=OFF;");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8');", tbl);
+    int rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
+    ASSERT(rc != SQLITE_OK && strstr(sqlite3_errmsg(db), "trusted_schema") != NULL, "auto_update=1 is refused when trusted_schema is OFF");
+    snprintf(sql, sizeof(sql), "INSERT INTO \"%s\" (v) VALUES (vector_as_f32('[0, 0, 0, 0, 0, 0, 0, 0]'));", tbl);
+    ASSERT(sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK, "writes through the auto_update triggers fail when trusted_schema is OFF");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,auto_update=0');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM sqlite_master WHERE type = 'trigger' AND tbl_name = '%s';", tbl);
+    ASSERT(query_int(db, sql) == 0, "quantization without auto_update drops the triggers");
+    exec_sql(db, "PRAGMA trusted_schema=ON;");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'auto_update=1');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_cleanup('%s', 'v');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT COUNT(*), 0 FROM sqlite_master WHERE name IN ('vector2_%s_v', 'vector_%s_v_insert', 'vector_%s_v_update', 'vector_%s_v_delete');", tbl, tbl, tbl, tbl);
+    ASSERT(query_int(db, sql) == 0, "vector_quantize_cleanup drops the triggers and the tombstones");
+    snprintf(sql, sizeof(sql), "DELETE FROM \"%s\" WHERE id = 100;", tbl);
+    ASSERT(exec_sql(db, sql) == SQLITE_OK, "table is writable after vector_quantize_cleanup");
+}
+
+/* ---------- Test: memory mapped preload sidecar ---------- */
+
+static int file_exists(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f) fclose(f);
+    return f != NULL;
+}
+
+/* Flips (or reads back) the byte at `offset` of `path`; returns the previous value or -1. */
+static int file_flip_byte(const char *path, long offset, int flip) {
+    FILE *f = fopen(path, "r+b");
+    if (!f) return -1;
+    int value = -1;
+    if (fseek(f, offset, SEEK_SET) == 0 && (value = fgetc(f)) != EOF && flip) {
+        fseek(f, offset, SEEK_SET);
+        fputc(value ^ 0xFF, f);
+    }
+    fclose(f);
+    return value;
+}
+
+static sqlite3 *open_file_db(const char *path) {
+    sqlite3 *db = NULL;
+    if (sqlite3_open(path, &db) != SQLITE_OK || sqlite3_vector_init(db, NULL, NULL) != SQLITE_OK) {
+        sqlite3_close(db);
+        return NULL;
+    }
+    return db;
+}
+
+static void test_preload_mmap(sqlite3 *memdb) {
+    const char *path = "test_vector_mmap.db";
+    const char *sidecar = "test_vector_mmap.db-vector0_tmm_v.qbin";
+    const int n = 600, dim = 16, k = 10;
+    char sql[2048], query[1024];
+    long long ref_ids[16], ids[16];
+    double ref_dist[16], dist[16];
+
+    printf("\n=== vector_quantize_preload mmap ===\n");
+    remove(path);
+    remove(sidecar);
+    sqlite3 *db = open_file_db(path);
+    rnd_state = 9119;
+    if (!db || setup_random_table(db, "tmm", "L2", dim, n) != 0) {
+        ASSERT(0, "mmap setup");
+        sqlite3_close(db);
+        return;
+    }
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('tmm', 'v', '%s', %d, 'nprobe=2');", query, k);
+
+    const char *layouts[] = {"qtype=UINT8", "qtype=INT8,index=ivf,nlist=8"};
+    for (int l = 0; l < 2; l++) {
+        char q[256];
+        snprintf(q, sizeof(q), "SELECT vector_quantize('tmm', 'v', '%s');", layouts[l]);
+        exec_sql(db, q);
+        exec_sql(db, "SELECT vector_quantize_preload('tmm', 'v', 'mmap=0');");
+        int nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+
+        ASSERT(exec_sql(db, "SELECT vector_quantize_preload('tmm', 'v', 'mmap=1');") == SQLITE_OK, "preload with mmap=1");
+        ASSERT(file_exists(sidecar), "mmap preload writes the sidecar file next to the database");
+        int count = collect_rows(db, sql, ids, dist, 16);
+        snprintf(q, sizeof(q), "mapped preload matches the allocated preload (%s)", layouts[l]);
+        ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), q);
+    }
+
+    /* a new connection (no preload left in the process) maps the existing file, and a corrupted header or list is detected
+       and rewritten (the records are verified once, when the file is written, so opening it does not read them) */
+    sqlite3_close(db);
+    db = open_file_db(path);
+    snprintf(sql + 1024, 1024, "SELECT vector_init('tmm', 'v', 'type=f32,dimension=%d,distance=L2,mmap=1');", dim);
+    exec_sql(db, sql + 1024);
+    long offset = (long)sizeof(vector_sidecar_header) + 4;     /* count of the first IVF list */
+    int original = file_flip_byte(sidecar, offset, 1);
+    ASSERT(exec_sql(db, "SELECT vector_quantize_preload('tmm', 'v');") == SQLITE_OK, "new connection preloads with mmap=1 from vector_init");
+    ASSERT(original >= 0 && file_flip_byte(sidecar, offset, 0) == original, "corrupted sidecar is detected and rewritten");
+    int count = collect_rows(db, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, k), "new connection returns the same results");
+
+    /* a new quantization invalidates the sidecar: the reload rewrites it */
+    exec_sql(db, "SELECT vector_quantize('tmm', 'v', 'qtype=UINT8');");
+    exec_sql(db, "SELECT vector_quantize_preload('tmm', 'v', 'mmap=0');");
+    int nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+    exec_sql(db, "SELECT vector_quantize_preload('tmm', 'v', 'mmap=1');");
+    exec_sql(db, "SELECT vector_quantize('tmm', 'v', 'qtype=INT8');");
+    exec_sql(db, "SELECT vector_quantize('tmm', 'v', 'qtype=UINT8');");
+    count = collect_rows(db, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "sidecar follows a new quantization");
+
+    /* a sidecar written inside a transaction that rolls back is not used by the next quantization, nor by a new process */
+    exec_sql(db, "BEGIN; UPDATE tmm SET v = (SELECT v FROM tmm WHERE id = 1) WHERE id > 1;");
+    exec_sql(db, "SELECT vector_quantize('tmm', 'v', 'qtype=UINT8');");
+    exec_sql(db, "SELECT vector_quantize_preload('tmm', 'v', 'mmap=1');");
+    exec_sql(db, "ROLLBACK;");
+    exec_sql(db, "SELECT vector_quantize('tmm', 'v', 'qtype=UINT8');");
+    count = collect_rows(db, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "preload of a rolled back quantization is not reused");
+    sqlite3_close(db);
+    db = open_file_db(path);
+    exec_sql(db, sql + 1024);
+    exec_sql(db, "SELECT vector_quantize_preload('tmm', 'v');");
+    count = collect_rows(db, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "sidecar of a rolled back quantization is not mapped");
+
+    exec_sql(db, "SELECT vector_quantize_cleanup('tmm', 'v');");
+    ASSERT(!file_exists(sidecar), "vector_quantize_cleanup removes the sidecar file");
+
+    /* identifiers are escaped before they become part of the sidecar path (only [A-Za-z0-9_] is kept) */
+    const char *escaped = "test_vector_mmap.db-vector0_t%24x_v%241.qbin";
+    exec_sql(db, "CREATE TABLE \"t$x\" (id INTEGER PRIMARY KEY, \"v$1\" BLOB);");
+    exec_sql(db, "INSERT INTO \"t$x\" (\"v$1\") VALUES (vector_as_f32('[1, 2, 3, 4]')), (vector_as_f32('[4, 3, 2, 1]'));");
+    exec_sql(db, "SELECT vector_init('t$x', 'v$1', 'type=f32,dimension=4,distance=L2');");
+    exec_sql(db, "SELECT vector_quantize('t$x', 'v$1');");
+    ASSERT(exec_sql(db, "SELECT vector_quantize_preload('t$x', 'v$1', 'mmap=1');") == SQLITE_OK && file_exists(escaped), "sidecar path escapes the table and column names");
+    count = collect_rows(db, "SELECT rowid, distance FROM vector_quantize_scan('t$x', 'v$1', '[1, 2, 3, 4]', 1);", ids, dist, 16);
+    ASSERT(count == 1 && ids[0] == 1, "escaped sidecar is scanned");
+    exec_sql(db, "SELECT vector_quantize_cleanup('t$x', 'v$1');");
+    ASSERT(!file_exists(escaped), "vector_quantize_cleanup removes the escaped sidecar file");
+    sqlite3_close(db);
+    remove(path);
+
+    /* databases without a file fall back to a regular buffer */
+    exec_sql(memdb, "CREATE TABLE tmm_mem (id INTEGER PRIMARY KEY, v BLOB);");
+    exec_sql(memdb, "INSERT INTO tmm_mem (v) VALUES (vector_as_f32('[1, 2, 3, 4]')), (vector_as_f32('[4, 3, 2, 1]'));");
+    exec_sql(memdb, "SELECT vector_init('tmm_mem', 'v', 'type=f32,dimension=4,distance=L2');");
+    exec_sql(memdb, "SELECT vector_quantize('tmm_mem', 'v');");
+    ASSERT(exec_sql(memdb, "SELECT vector_quantize_preload('tmm_mem', 'v', 'mmap=1');") == SQLITE_OK, "mmap=1 on an in-memory database falls back to a buffer");
+    count = collect_rows(memdb, "SELECT rowid, distance FROM vector_quantize_scan('tmm_mem', 'v', '[1, 2, 3, 4]', 1);", ids, dist, 16);
+    ASSERT(count == 1 && ids[0] == 1, "fallback preload is used by vector_quantize_scan");
+}
+
+/* ---------- Test: preloads shared by the connections of the process ---------- */
+
+static void test_preload_shared(void) {
+    const char *path = "test_vector_shared.db";
+    const int n = 500, dim = 16, k = 10;
+    char sql[2048], stream[2048], query[1024], init[256];
+    long long ref_ids[16], ids[16];
+    double ref_dist[16], dist[16];
+
+    printf("\n=== vector_quantize_preload shared across connections ===\n");
+    remove(path);
+    sqlite3 *db1 = open_file_db(path);
+    rnd_state = 4242;
+    if (!db1 || setup_random_table(db1, "tsh", "L2", dim, n) != 0) {
+        ASSERT(0, "shared preload setup");
+        sqlite3_close(db1);
+        return;
+    }
+    /* WAL: a connection can rebuild while another one has a scan in flight */
+    exec_sql(db1, "PRAGMA journal_mode=WAL;");
+    exec_sql(db1, "SELECT vector_quantize('tsh', 'v', 'qtype=UINT8');");
+    sqlite3 *db2 = open_file_db(path);
+    snprintf(init, sizeof(init), "SELECT vector_init('tsh', 'v', 'type=f32,dimension=%d,distance=L2');", dim);
+    exec_sql(db2, init);
+
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('tsh', 'v', '%s', %d);", query, k);
+    snprintf(stream, sizeof(stream), "SELECT rowid, distance FROM vector_quantize_scan_stream('tsh', 'v', '%s');", query);
+    int nref = collect_rows(db2, sql, ref_ids, ref_dist, 16);
+
+    /* db2 never calls vector_quantize_preload: once db1 preloads, db2 scans the shared records (the chunks are no longer read) */
+    ASSERT(exec_sql(db1, "SELECT vector_quantize_preload('tsh', 'v');") == SQLITE_OK, "first connection preloads");
+    exec_sql(db1, "SAVEPOINT hide; DELETE FROM vector0_tsh_v;");
+    int count = collect_rows(db1, sql, ids, dist, 16);
+    ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), "preloading connection scans its records");
+    exec_sql(db1, "ROLLBACK TO hide; RELEASE hide;");
+    exec_sql(db2, "SAVEPOINT hide; DELETE FROM vector0_tsh_v;");
+    count = collect_rows(db2, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "second connection attaches to the shared preload");
+    exec_sql(db2, "ROLLBACK TO hide; RELEASE hide;");
+
+    /* a rebuild publishes a new generation while a scan of the previous one is in flight */
+    sqlite3_stmt *vm = NULL;
+    int streamed = 0;
+    if (sqlite3_prepare_v2(db2, stream, -1, &vm, NULL) == SQLITE_OK) {
+        while (streamed < n / 2 && sqlite3_step(vm) == SQLITE_ROW) streamed++;
+    }
+    ASSERT(exec_sql(db1, "SELECT vector_quantize('tsh', 'v', 'qtype=INT8');") == SQLITE_OK, "rebuild while a scan is in flight");
+    while (vm && sqlite3_step(vm) == SQLITE_ROW) streamed++;
+    sqlite3_finalize(vm);
+    ASSERT(streamed == n, "in-flight scan completes on the previous generation");
+
+    nref = collect_rows(db1, sql, ref_ids, ref_dist, 16);
+    count = collect_rows(db2, sql, ids, dist, 16);
+    ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), "second connection switches to the new generation");
+    exec_sql(db2, "SAVEPOINT hide; DELETE FROM vector0_tsh_v;");
+    count = collect_rows(db2, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "new generation is shared too");
+    exec_sql(db2, "ROLLBACK TO hide; RELEASE hide;");
+
+    /* a preload published inside a transaction that rolls back is never attached by a later rebuild */
+    exec_sql(db1, "BEGIN; UPDATE tsh SET v = (SELECT v FROM tsh WHERE id = 1) WHERE id > 1;");
+    exec_sql(db1, "SELECT vector_quantize('tsh', 'v', 'qtype=INT8');");
+    exec_sql(db1, "SELECT vector_quantize_preload('tsh', 'v');");
+    exec_sql(db1, "ROLLBACK;");
+    exec_sql(db1, "SELECT vector_quantize('tsh', 'v', 'qtype=INT8');");
+    count = collect_rows(db2, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "rebuild after a rollback does not attach the rolled back preload");
+    count = collect_rows(db1, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "rebuilding connection does not attach it either");
+
+    /* without any preload left both connections read the chunks again */
+    exec_sql(db1, "SELECT vector_quantize_cleanup('tsh', 'v');");
+    exec_sql(db1, "SELECT vector_quantize('tsh', 'v', 'qtype=UINT8');");
+    ASSERT(query_int(db2, "SELECT count(*) FROM vector_quantize_scan_stream('tsh', 'v', '[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]');") == n, "cleanup drops the shared preload");
+    exec_sql(db2, "SAVEPOINT hide; DELETE FROM vector0_tsh_v;");
+    ASSERT(query_int(db2, "SELECT count(*) FROM vector_quantize_scan_stream('tsh', 'v', '[0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0]');") == 0, "chunks are read once no preload is published");
+    exec_sql(db2, "ROLLBACK TO hide; RELEASE hide;");
+
+    sqlite3_close(db2);
+    sqlite3_close(db1);
+    remove(path);
+}
+
+/* ---------- Test: auto_update deltas after another connection rebuilt the quantization ---------- */
+
+static void test_auto_update_shared(void) {
+    const char *path = "test_vector_auto_shared.db";
+    const int n = 50, dim = 16;
+    char init[256];
+    long long ids[16];
+    double dist[16];
+
+    printf("\n=== auto_update after a rebuild by another connection ===\n");
+    remove(path);
+    sqlite3 *db1 = open_file_db(path);
+    rnd_state = 5151;
+    if (!db1 || setup_random_table(db1, "tas", "L2", dim, n) != 0) {
+        ASSERT(0, "shared auto_update setup");
+        sqlite3_close(db1);
+        return;
+    }
+    sqlite3 *db2 = open_file_db(path);
+    snprintf(init, sizeof(init), "SELECT vector_init('tas', 'v', 'type=f32,dimension=%d,distance=L2');", dim);
+    exec_sql(db2, init);
+
+    /* db1 caches the UINT8 parameters, db2 rebuilds as 1BIT: the next delta of db1 must be encoded as 1BIT */
+    exec_sql(db1, "SELECT vector_quantize('tas', 'v', 'qtype=UINT8,auto_update=1');");
+    exec_sql(db1, "INSERT INTO tas (v) SELECT v FROM tas WHERE id = 1;");
+    exec_sql(db2, "SELECT vector_quantize('tas', 'v', 'qtype=1BIT,auto_update=1');");
+    ASSERT(exec_sql(db1, "INSERT INTO tas (id, v) SELECT 1000, v FROM tas WHERE id = 2;") == SQLITE_OK, "insert after a rebuild by another connection");
+
+    const char *scan = "SELECT rowid, distance FROM vector_quantize_scan('tas', 'v', (SELECT v FROM tas WHERE id = 2), 5);";
+    int count = collect_rows(db2, scan, ids, dist, 16);
+    int found = 0;
+    for (int i = 0; i < count; i++) if (ids[i] == 1000 && dist[i] == 0) found = 1;
+    ASSERT(count == 5 && found, "delta of a connection with stale parameters uses the current qtype");
+    count = collect_rows(db1, scan, ids, dist, 16);
+    found = 0;
+    for (int i = 0; i < count; i++) if (ids[i] == 1000 && dist[i] == 0) found = 1;
+    ASSERT(count == 5 && found, "writing connection scans its own delta");
+
+    sqlite3_close(db2);
+    sqlite3_close(db1);
+    remove(path);
+}
+
+/* ---------- Test: split chunk format and interleaved compatibility ---------- */
+
+/* Rewrites every chunk of vector0_<tbl>_v in the interleaved layout, as written before the split format existed. */
+static int chunks_to_interleaved(sqlite3 *db, const char *tbl, size_t code_size) {
+    char sql[256];
+    sqlite3_stmt *read = NULL, *update = NULL;
+    snprintf(sql, sizeof(sql), "SELECT rowid, counter, data FROM vector0_%s_v;", tbl);
+    if (sqlite3_prepare_v2(db, sql, -1, &read, NULL) != SQLITE_OK) return -1;
+    snprintf(sql, sizeof(sql), "UPDATE vector0_%s_v SET data = ?2 WHERE rowid = ?1;", tbl);
+    if (sqlite3_prepare_v2(db, sql, -1, &update, NULL) != SQLITE_OK) { sqlite3_finalize(read); return -1; }
+
+    int converted = 0;
+    exec_sql(db, "BEGIN;");
+    while (sqlite3_step(read) == SQLITE_ROW) {
+        int counter = sqlite3_column_int(read, 1);
+        vector_records r = vector_chunk_records(VECTOR_CHUNK_FORMAT_SPLIT, (const uint8_t *)sqlite3_column_blob(read, 2), counter, code_size);
+        size_t bytes = vector_chunk_bytes(VECTOR_CHUNK_FORMAT_INTERLEAVED, (size_t)counter, code_size);
+        uint8_t *chunk = (uint8_t *)malloc(bytes + 1);
+        vector_records_interleave(&r, chunk);
+        sqlite3_bind_int64(update, 1, sqlite3_column_int64(read, 0));
+        sqlite3_bind_blob(update, 2, chunk, (int)bytes, SQLITE_TRANSIENT);
+        if (sqlite3_step(update) == SQLITE_DONE) converted++;
+        sqlite3_reset(update);
+        free(chunk);
+    }
+    snprintf(sql, sizeof(sql), "DELETE FROM _sqliteai_vector WHERE tblname = '%s' AND key = 'chunk_format';", tbl);
+    exec_sql(db, sql);
+    exec_sql(db, "COMMIT;");
+    sqlite3_finalize(read);
+    sqlite3_finalize(update);
+    return converted;
+}
+
+/* Number of chunks of vector0_<tbl>_v laid out in format (size and first/last rowids match rowid1/rowid2). */
+static int chunks_in_format(sqlite3 *db, const char *tbl, int format, size_t code_size) {
+    char sql[256];
+    sqlite3_stmt *vm = NULL;
+    snprintf(sql, sizeof(sql), "SELECT rowid1, rowid2, counter, data FROM vector0_%s_v;", tbl);
+    if (sqlite3_prepare_v2(db, sql, -1, &vm, NULL) != SQLITE_OK) return -1;
+
+    int matching = 0;
+    while (sqlite3_step(vm) == SQLITE_ROW) {
+        int counter = sqlite3_column_int(vm, 2);
+        if (counter <= 0 || (size_t)sqlite3_column_bytes(vm, 3) != vector_chunk_bytes(format, (size_t)counter, code_size)) continue;
+        vector_records r = vector_chunk_records(format, (const uint8_t *)sqlite3_column_blob(vm, 3), counter, code_size);
+        if (vector_records_rowid(&r, 0) == sqlite3_column_int64(vm, 0) && vector_records_rowid(&r, counter - 1) == sqlite3_column_int64(vm, 1)) matching++;
+    }
+    sqlite3_finalize(vm);
+    return matching;
+}
+
+static void test_chunk_format(void) {
+    const char *path = "test_vector_chunks.db";
+    const int n = 700, dim = 16, k = 10;
+    const size_t code_size = 16;    /* UINT8 */
+    char sql[2048], stream[2048], update[2048], query[1024], init[256];
+    long long ref_ids[16], ids[16], stream_ids[16];
+    double ref_dist[16], dist[16], stream_dist[16];
+
+    printf("\n=== split chunk format ===\n");
+    remove(path);
+    sqlite3 *db = open_file_db(path);
+    rnd_state = 5151;
+    if (!db || setup_random_table(db, "tcf", "L2", dim, n) != 0) {
+        ASSERT(0, "chunk format setup");
+        sqlite3_close(db);
+        return;
+    }
+    exec_sql(db, "SELECT vector_quantize('tcf', 'v', 'qtype=UINT8,index=ivf,nlist=4,max_memory=4KB,auto_update=1');");
+    snprintf(init, sizeof(init), "SELECT vector_init('tcf', 'v', 'type=f32,dimension=%d,distance=L2');", dim);
+
+    /* codes first (padded to 64 bytes), then the rowids of the chunk */
+    long long nchunks = query_int(db, "SELECT count(*) FROM vector0_tcf_v;");
+    ASSERT(nchunks > 4 && chunks_in_format(db, "tcf", VECTOR_CHUNK_FORMAT_SPLIT, code_size) == nchunks, "new quantization writes split chunks");
+    ASSERT(query_int(db, "SELECT count(*) FROM _sqliteai_vector WHERE tblname = 'tcf' AND key = 'chunk_format' AND value = 2;") == 1, "chunk format is recorded with the quantization");
+
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('tcf', 'v', '%s', %d, 'nprobe=2');", query, k);
+    snprintf(stream, sizeof(stream), "SELECT rowid, distance FROM vector_quantize_scan_stream('tcf', 'v', '%s') ORDER BY distance, rowid LIMIT %d;", query, k);
+    int nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+    int nstream = collect_rows(db, stream, stream_ids, stream_dist, 16);
+    exec_sql(db, "SELECT vector_quantize_preload('tcf', 'v');");
+    int count = collect_rows(db, sql, ids, dist, 16);
+    ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), "preloaded split records match the split chunks");
+    count = collect_rows(db, stream, ids, dist, 16);
+    ASSERT(nstream == k && same_rows(ids, dist, count, stream_ids, stream_dist, nstream), "streaming over preloaded split records");
+
+    /* a database quantized before the split format: interleaved chunks and no format entry */
+    ASSERT(chunks_to_interleaved(db, "tcf", code_size) > 1, "chunks rewritten in the interleaved layout");
+    sqlite3_close(db);
+    db = open_file_db(path);
+    exec_sql(db, init);
+    count = collect_rows(db, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "interleaved chunks are still scanned");
+    count = collect_rows(db, stream, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, stream_ids, stream_dist, nstream), "interleaved chunks are still streamed");
+    exec_sql(db, "SELECT vector_quantize_preload('tcf', 'v');");
+    count = collect_rows(db, sql, ids, dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), "interleaved chunks are preloaded in the split layout");
+
+    /* triggers and compaction keep writing the layout of the table */
+    snprintf(update, sizeof(update), "UPDATE tcf SET v = vector_as_f32('%s') WHERE id = 77;", query);
+    exec_sql(db, update);
+    snprintf(update, sizeof(update), "SELECT rowid, distance FROM vector_quantize_scan('tcf', 'v', '%s', 1, 'nprobe=4');", query);
+    ASSERT(collect_rows(db, update, ids, dist, 1) == 1 && ids[0] == 77, "delta written in the interleaved layout is scanned");
+    ASSERT(query_int(db, "SELECT vector_quantize_compact('tcf', 'v');") == 1, "compaction of interleaved chunks");
+    ASSERT(collect_rows(db, update, ids, dist, 1) == 1 && ids[0] == 77, "compacted interleaved chunks are scanned");
+    nchunks = query_int(db, "SELECT count(*) FROM vector0_tcf_v;");
+    ASSERT(chunks_in_format(db, "tcf", VECTOR_CHUNK_FORMAT_INTERLEAVED, code_size) == nchunks, "compaction keeps the interleaved layout");
+
+    /* a new quantization switches the table to the split layout */
+    exec_sql(db, "SELECT vector_quantize('tcf', 'v', 'qtype=UINT8');");
+    nchunks = query_int(db, "SELECT count(*) FROM vector0_tcf_v;");
+    ASSERT(chunks_in_format(db, "tcf", VECTOR_CHUNK_FORMAT_SPLIT, code_size) == nchunks, "vector_quantize rewrites interleaved chunks in the split layout");
+    ASSERT(collect_rows(db, update, ids, dist, 1) == 1 && ids[0] == 77, "split chunks after the rebuild are scanned");
+
+    sqlite3_close(db);
+    remove(path);
+}
+
+/* ---------- Test: batch distance kernels ---------- */
+
+/* Top-k quantized scans (batch kernels) must return the rows and distances of the streaming scan (single pair kernels). */
+static void test_batch_distance(sqlite3 *db) {
+    const int n = 300, dim = 37, k = 12;
+    const char *distances[] = {"L2", "SQUARED_L2", "DOT", "COSINE", "L1"};
+    const char *qtypes[] = {"UINT8", "INT8", "1BIT", "UINT4", "INT4"};
+    char sql[2048], msg[256], query[512], tbl[32];
+    long long ref_ids[16], ids[16];
+    double ref_dist[16], dist[16];
+
+    printf("\n=== batch distance kernels ===\n");
+    rnd_state = 1717;
+    rnd_json(query, sizeof(query), dim);
+    for (int d = 0; d < 5; d++) {
+        snprintf(tbl, sizeof(tbl), "tbd_%d", d);
+        if (setup_random_table(db, tbl, distances[d], dim, n) != 0) {
+            ASSERT(0, "batch distance setup");
+            return;
+        }
+
+        for (int q = 0; q < 5; q++) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=%s');", tbl, qtypes[q]);
+            exec_sql(db, sql);
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan_stream('%s', 'v', '%s') ORDER BY distance, rowid LIMIT %d;", tbl, query, k);
+            int nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+
+            for (int preload = 0; preload < 2; preload++) {
+                if (preload) {
+                    snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                    exec_sql(db, sql);
+                }
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl, query, k);
+                int count = collect_rows(db, sql, ids, dist, 16);
+                snprintf(msg, sizeof(msg), "batch scan matches the stream (%s, %s, %s)", distances[d], qtypes[q], preload ? "preload" : "disk");
+                ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+            }
+        }
+    }
+}
+
+/* ---------- Test: normalized cosine and cached code norms ---------- */
+
+/* normalized=1 computes cosine as 1 - dot; preloaded 8-bit codes cache their norms for cosine scans. */
+static void test_cosine_norms(sqlite3 *db) {
+    const int n = 1200, dim = 24, k = 10;
+    char sql[4096], msg[256], query[2048], json[2048];
+    long long ref_ids[16], ids[16];
+    double ref_dist[16], dist[16];
+
+    printf("\n=== normalized cosine and cached norms ===\n");
+    rnd_state = 1818;
+    exec_sql(db, "CREATE TABLE tcn_0 (id INTEGER PRIMARY KEY, v BLOB);");
+    exec_sql(db, "CREATE TABLE tcn_1 (id INTEGER PRIMARY KEY, v BLOB);");
+    exec_sql(db, "BEGIN;");
+    for (int i = 0; i < n; i++) {
+        float x[64], norm = 0.0f;
+        for (int j = 0; j < dim; j++) { x[j] = rnd_float(); norm += x[j] * x[j]; }
+        norm = sqrtf(norm);
+        size_t off = snprintf(json, sizeof(json), "[");
+        for (int j = 0; j < dim; j++) off += snprintf(json + off, sizeof(json) - off, "%s%.7f", j ? ", " : "", x[j] / norm);
+        snprintf(json + off, sizeof(json) - off, "]");
+        for (int t = 0; t < 2; t++) {
+            snprintf(sql, sizeof(sql), "INSERT INTO tcn_%d (id, v) VALUES (%d, vector_as_f32('%s'));", t, i + 1, json);
+            exec_sql(db, sql);
+        }
+        if (i == 0) snprintf(query, sizeof(query), "%s", json);
+    }
+    exec_sql(db, "COMMIT;");
+    exec_sql(db, "SELECT vector_init('tcn_0', 'v', 'type=f32,dimension=24,distance=COSINE');");
+    exec_sql(db, "SELECT vector_init('tcn_1', 'v', 'type=f32,dimension=24,distance=COSINE,normalized=1');");
+
+    /* normalized: same neighbors, distances equal up to rounding */
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('tcn_0', 'v', '%s', %d);", query, k);
+    int nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('tcn_1', 'v', '%s', %d);", query, k);
+    int count = collect_rows(db, sql, ids, dist, 16);
+    int close = (nref == k && count == k);
+    for (int i = 0; close && i < k; i++) close = (ids[i] == ref_ids[i]) && fabs(dist[i] - ref_dist[i]) < 1e-5;
+    ASSERT(close, "normalized full scan matches the cosine kernels");
+    ASSERT(count == k && ids[0] == 1 && dist[0] == 0.0, "normalized full scan finds the query itself");
+
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan_stream('tcn_1', 'v', '%s') ORDER BY distance, rowid LIMIT %d;", query, k);
+    int nstream = collect_rows(db, sql, ref_ids, ref_dist, 16);
+    ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nstream), "normalized stream matches the top-k scan");
+
+    /* cached norms: preloaded scans (IVF lists, threads) return the rows and distances of the disk scans */
+    const char *qtypes[] = {"UINT8", "INT8"};
+    const char *options[] = {"nprobe=4", "nprobe=4,threads=4", "nprobe=64,threads=3"};
+    for (int q = 0; q < 2; q++) {
+        for (int o = 0; o < 3; o++) {
+            /* a new quantization invalidates the previous preload */
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize('tcn_0', 'v', 'qtype=%s,index=ivf,nlist=8');", qtypes[q]);
+            exec_sql(db, sql);
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('tcn_0', 'v', '%s', %d, '%s');", query, k, options[o]);
+            nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+            exec_sql(db, "SELECT vector_quantize_preload('tcn_0', 'v');");
+            count = collect_rows(db, sql, ids, dist, 16);
+            snprintf(msg, sizeof(msg), "cached norms match the cosine kernels (%s, %s)", qtypes[q], options[o]);
+            ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+        }
+    }
+}
+
+/* ---------- Test: multi-query batch scan ---------- */
+
+/* Every query of vector_quantize_scan_batch returns the rows of vector_quantize_scan with the same arguments. */
+static void test_quantize_scan_batch(sqlite3 *db) {
+    const char *tbl = "tqb";
+    const int n = 1500, dim = 16, k = 7, nq = 5;
+    const char *configs[][2] = {
+        {"qtype=UINT8", ""},
+        {"qtype=INT8,index=ivf,nlist=16", "nprobe=4"},
+        {"qtype=INT8,index=ivf,nlist=16", "nprobe=3,threads=4"},
+        {"qtype=1BIT", "rerank=4"},
+        {"qtype=PQ,pq_m=4", "threads=3"},
+        {"qtype=UINT8,auto_update=1", "rerank=2,threads=2"},
+    };
+    const int nconfigs = (int)(sizeof(configs) / sizeof(configs[0]));
+    char sql[16384], msg[256], queries[8192], query[nq][1024], options[64];
+    long long ref_ids[16], ids[64];
+    double ref_dist[16], dist[64];
+
+    printf("\n=== vector_quantize_scan_batch ===\n");
+    rnd_state = 1919;
+    if (setup_random_table(db, tbl, "COSINE", dim, n) != 0) {
+        ASSERT(0, "batch scan setup");
+        return;
+    }
+    size_t off = snprintf(queries, sizeof(queries), "[");
+    for (int q = 0; q < nq; q++) {
+        rnd_json(query[q], sizeof(query[q]), dim);
+        off += snprintf(queries + off, sizeof(queries) - off, "%s%s", q ? ", " : "", query[q]);
+    }
+    snprintf(queries + off, sizeof(queries) - off, "]");
+
+    for (int c = 0; c < nconfigs; c++) {
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, configs[c][0]);
+        exec_sql(db, sql);
+        if (strstr(configs[c][0], "auto_update")) {
+            /* deltas and tombstones are scanned by every query */
+            snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE id %% 7 = 0; UPDATE %s SET v = vector_as_f32('%s') WHERE id = 3;", tbl, tbl, query[1]);
+            exec_sql(db, sql);
+        }
+        snprintf(options, sizeof(options), "%s%s", configs[c][1][0] ? ", " : "", configs[c][1]);
+        for (int preload = 0; preload < 2; preload++) {
+            if (preload) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                exec_sql(db, sql);
+            }
+            int ok = 1;
+            for (int q = 0; q < nq && ok; q++) {
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d%s%s%s);", tbl, query[q], k, configs[c][1][0] ? ", '" : "", configs[c][1], configs[c][1][0] ? "'" : "");
+                int nref = collect_rows(db, sql, ref_ids, ref_dist, 16);
+                snprintf(sql, sizeof(sql), "SELECT id, distance FROM vector_quantize_scan_batch('%s', 'v', '%s', %d, %d%s%s%s) WHERE query_idx = %d;", tbl, queries, nq, k, configs[c][1][0] ? ", '" : "", configs[c][1], configs[c][1][0] ? "'" : "", q);
+                int count = collect_rows(db, sql, ids, dist, 64);
+                ok = (nref == k) && same_rows(ids, dist, count, ref_ids, ref_dist, nref);
+            }
+            snprintf(msg, sizeof(msg), "batch queries match single scans (%s%s, %s)", configs[c][0], options, preload ? "preload" : "disk");
+            ASSERT(ok, msg);
+        }
+        if (strstr(configs[c][0], "auto_update")) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize_cleanup('%s', 'v');", tbl);
+            exec_sql(db, sql);
+        }
+    }
+
+    /* rows come sorted by query and distance */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT query_idx, distance FROM vector_quantize_scan_batch('%s', 'v', '%s', %d, %d);", tbl, queries, nq, k);
+    int count = collect_rows(db, sql, ids, dist, 64);
+    int sorted = (count == nq * k);
+    for (int i = 1; i < count && sorted; i++) sorted = (ids[i] > ids[i - 1]) || (ids[i] == ids[i - 1] && dist[i] >= dist[i - 1]);
+    ASSERT(sorted, "batch rows are ordered by query_idx and distance");
+
+    /* queries as a BLOB of nq float32 vectors */
+    {
+        float blob[5 * 16];
+        for (int i = 0; i < nq * dim; i++) blob[i] = rnd_float();
+        sqlite3_stmt *stmt = NULL;
+        snprintf(sql, sizeof(sql), "SELECT count(*), count(DISTINCT query_idx) FROM vector_quantize_scan_batch('%s', 'v', ?1, ?2, %d);", tbl, k);
+        int total = -1, distinct = -1;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+            sqlite3_bind_blob(stmt, 1, blob, (int)sizeof(blob), SQLITE_STATIC);
+            sqlite3_bind_int(stmt, 2, nq);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                total = sqlite3_column_int(stmt, 0);
+                distinct = sqlite3_column_int(stmt, 1);
+            }
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 2, nq + 1);
+            ASSERT(sqlite3_step(stmt) == SQLITE_ERROR, "BLOB size must match nq");
+            sqlite3_finalize(stmt);
+        }
+        ASSERT(total == nq * k && distinct == nq, "BLOB queries");
+    }
+
+    snprintf(sql, sizeof(sql), "SELECT * FROM vector_quantize_scan_batch('%s', 'v', '%s', %d, %d);", tbl, queries, nq - 1, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == -1, "nq must match the number of JSON vectors");
+    snprintf(sql, sizeof(sql), "SELECT * FROM vector_quantize_scan_batch('%s', 'v', '%s', %d, 0);", tbl, queries, nq);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == -1, "k must be positive");
+}
+
+/* ---------- Test: rowid constraints and allow-lists pushed into the scans ---------- */
+
+/* A filtered top-k scan returns the k nearest rows among the matching ones: it must match a streaming scan
+   filtered by SQLite (the unary + keeps the constraint out of the scan) and ordered by distance. */
+static void test_rowid_filter(sqlite3 *db) {
+    const char *tbl = "tfl";
+    const int n = 1500, dim = 8, k = 10;
+    const char *modules[][3] = {
+        {"vector_full_scan", "", ""},
+        {"vector_quantize_scan", "qtype=UINT8", ""},
+        {"vector_quantize_scan", "qtype=UINT8,auto_update=1", "threads=3"},
+        {"vector_quantize_scan", "qtype=INT8,index=ivf,nlist=16", "nprobe=16"},
+    };
+    const char *filters[][2] = {
+        {"rowid BETWEEN 200 AND 260", "+rowid BETWEEN 200 AND 260"},
+        {"rowid > 1490", "+rowid > 1490"},
+        {"rowid IN (5, 17, 300, 999, 1400, 77, 78, 79, 80, 81, 82, 83)", "+rowid IN (5, 17, 300, 999, 1400, 77, 78, 79, 80, 81, 82, 83)"},
+        {"rowid IN (SELECT id FROM tfl_allow) AND rowid < 900", "+rowid IN (SELECT id FROM tfl_allow) AND +rowid < 900"},
+        {"rowid >= 10.5 AND rowid <= 40", "+rowid >= 10.5 AND +rowid <= 40"},
+    };
+    const int nmodules = (int)(sizeof(modules) / sizeof(modules[0]));
+    const int nfilters = (int)(sizeof(filters) / sizeof(filters[0]));
+    char sql[4096], msg[512], query[1024], args[128];
+    long long ref_ids[64], ids[64];
+    double ref_dist[64], dist[64];
+
+    printf("\n=== rowid filter pushdown ===\n");
+    rnd_state = 2020;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "rowid filter setup");
+        return;
+    }
+    exec_sql(db, "CREATE TABLE tfl_allow (id INTEGER); INSERT INTO tfl_allow SELECT id FROM tfl WHERE id % 3 = 0;");
+    rnd_json(query, sizeof(query), dim);
+
+    for (int m = 0; m < nmodules; m++) {
+        int quantized = (modules[m][1][0] != 0);
+        if (quantized) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, modules[m][1]);
+            exec_sql(db, sql);
+            if (strstr(modules[m][1], "auto_update")) {
+                snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE id %% 7 = 0; UPDATE %s SET v = vector_as_f32('%s') WHERE id = 33;", tbl, tbl, query);
+                exec_sql(db, sql);
+            }
+        }
+        snprintf(args, sizeof(args), "%s%s%s", modules[m][2][0] ? ", '" : "", modules[m][2], modules[m][2][0] ? "'" : "");
+        for (int preload = 0; preload < 1 + quantized; preload++) {
+            if (preload) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                exec_sql(db, sql);
+            }
+            for (int f = 0; f < nfilters; f++) {
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s') WHERE %s ORDER BY distance, rowid LIMIT %d;", modules[m][0], tbl, query, filters[f][1], k);
+                int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s', %d%s) WHERE %s;", modules[m][0], tbl, query, k, args, filters[f][0]);
+                int count = collect_rows(db, sql, ids, dist, 64);
+                snprintf(msg, sizeof(msg), "%s %s%s: k nearest among %s", modules[m][0], modules[m][1], preload ? " (preload)" : "", filters[f][0]);
+                ASSERT(nref > 0 && same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+                
+                /* the streaming scan yields exactly the matching rows */
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s') WHERE %s ORDER BY distance, rowid LIMIT %d;", modules[m][0], tbl, query, filters[f][0], k);
+                count = collect_rows(db, sql, ids, dist, 64);
+                snprintf(msg, sizeof(msg), "%s %s%s: streaming scan restricted to %s", modules[m][0], modules[m][1], preload ? " (preload)" : "", filters[f][0]);
+                ASSERT(same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+            }
+
+            /* allow-list argument: a table name or a BLOB of rowids */
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s') WHERE +rowid IN (SELECT id FROM tfl_allow) ORDER BY distance, rowid LIMIT %d;", modules[m][0], tbl, query, k);
+            int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s', %d, '%s', 'tfl_allow');", modules[m][0], tbl, query, k, modules[m][2]);
+            int count = collect_rows(db, sql, ids, dist, 64);
+            snprintf(msg, sizeof(msg), "%s %s%s: allow-list table", modules[m][0], modules[m][1], preload ? " (preload)" : "");
+            ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+
+            sqlite3_int64 allow[500];
+            for (int i = 0; i < 500; i++) allow[i] = (sqlite3_int64)(n - i * 3);
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s') WHERE +rowid %% 3 = %d ORDER BY distance, rowid LIMIT %d;", modules[m][0], tbl, query, n % 3, k);
+            nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+            sqlite3_stmt *stmt = NULL;
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s', %d, '%s', ?1);", modules[m][0], tbl, query, k, modules[m][2]);
+            count = 0;
+            if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK) {
+                sqlite3_bind_blob(stmt, 1, allow, (int)sizeof(allow), SQLITE_STATIC);
+                while (sqlite3_step(stmt) == SQLITE_ROW && count < 64) {
+                    ids[count] = sqlite3_column_int64(stmt, 0);
+                    dist[count++] = sqlite3_column_double(stmt, 1);
+                }
+                sqlite3_finalize(stmt);
+            }
+            snprintf(msg, sizeof(msg), "%s %s%s: allow-list BLOB", modules[m][0], modules[m][1], preload ? " (preload)" : "");
+            ASSERT(nref == k && same_rows(ids, dist, count, ref_ids, ref_dist, nref), msg);
+
+            /* contradictory constraints and empty allow-lists match nothing */
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s', %d%s) WHERE rowid > 100 AND rowid IN (1, 2, 3);", modules[m][0], tbl, query, k, args);
+            ASSERT(collect_rows(db, sql, ids, dist, 64) == 0, "no row matches disjoint rowid constraints");
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', '%s', %d, '%s', x'');", modules[m][0], tbl, query, k, modules[m][2]);
+            ASSERT(collect_rows(db, sql, ids, dist, 64) == 0, "empty allow-list");
+        }
+        if (strstr(modules[m][1], "auto_update")) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize_cleanup('%s', 'v');", tbl);
+            exec_sql(db, sql);
+        }
+    }
+
+    /* HNSW: the k best candidates of the graph search that match the filter */
+    snprintf(sql, sizeof(sql), "SELECT vector_hnsw_build('%s', 'v');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_hnsw_scan('%s', 'v', '%s', %d, 'ef_search=400') WHERE rowid <= 750;", tbl, query, k);
+    int count = collect_rows(db, sql, ids, dist, 64);
+    int ok = (count == k);
+    for (int i = 0; i < count && ok; i++) ok = (ids[i] <= 750) && (i == 0 || dist[i] >= dist[i - 1]);
+    ASSERT(ok, "vector_hnsw_scan: k sorted rows restricted to the rowid range");
+
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_full_scan('%s', 'v', '%s', %d, '', x'0102');", tbl, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == -1, "allow-list BLOB size must be a multiple of 8");
+    snprintf(sql, sizeof(sql), "SELECT rowid FROM vector_full_scan('%s', 'v', '%s', %d, '', 'tfl_missing');", tbl, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == -1, "allow-list table must exist");
+}
+
+/* ---------- Test: scan statistics ---------- */
+
+enum {ST_SCANS, ST_ROWS_SCANNED, ST_ROWS_SKIPPED, ST_CHUNKS_READ, ST_BYTES_TOUCHED, ST_KERNEL_NS, ST_HEAP_UPDATES, ST_PRELOAD_HITS, ST_PRELOAD_MISSES, ST_COUNT};
+
+/* Reads the vector_stats counters of tbl.v; returns 0 if the row exists. */
+static int read_stats(sqlite3 *db, const char *tbl, long long *values) {
+    char sql[512];
+    snprintf(sql, sizeof(sql), "SELECT scans, rows_scanned, rows_skipped, chunks_read, bytes_touched, kernel_ns, heap_updates, preload_hits, preload_misses FROM vector_stats WHERE tbl = '%s' AND col = 'v';", tbl);
+    sqlite3_stmt *stmt = NULL;
+    int rc = -1;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) return -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        for (int i = 0; i < ST_COUNT; i++) values[i] = sqlite3_column_int64(stmt, i);
+        rc = 0;
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+static void test_scan_stats(sqlite3 *db) {
+    const char *tbl = "tst";
+    const int n = 1200, dim = 8, k = 5;
+    char sql[4096], query[1024];
+    long long st[ST_COUNT], ids[64];
+    double dist[64];
+
+    printf("\n=== scan statistics ===\n");
+    rnd_state = 2121;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "scan statistics setup");
+        return;
+    }
+    exec_sql(db, "INSERT INTO tst (id, v) VALUES (1201, NULL), (1202, x'0102'), (1203, NULL);");
+    rnd_json(query, sizeof(query), dim);
+    exec_sql(db, "SELECT vector_stats_reset();");
+
+    /* counters are collected only by the scans run with stats=1 */
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    collect_rows(db, sql, ids, dist, 64);
+    ASSERT(read_stats(db, tbl, st) == 0 && st[ST_SCANS] == 0 && st[ST_ROWS_SCANNED] == 0, "vector_stats: no counters without stats=1");
+
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d, 'stats=1');", tbl, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == k, "vector_full_scan with stats=1");
+    ASSERT(read_stats(db, tbl, st) == 0 && st[ST_SCANS] == 1 && st[ST_ROWS_SCANNED] == n && st[ST_ROWS_SKIPPED] == 3, "vector_stats: full scan rows scanned and skipped");
+    ASSERT(st[ST_BYTES_TOUCHED] == (long long)n * dim * 4 && st[ST_CHUNKS_READ] == 0 && st[ST_KERNEL_NS] > 0, "vector_stats: full scan bytes and kernel time");
+    ASSERT(st[ST_HEAP_UPDATES] >= k && st[ST_HEAP_UPDATES] <= n && st[ST_PRELOAD_HITS] + st[ST_PRELOAD_MISSES] == 0, "vector_stats: full scan heap updates");
+
+    /* quantized scans: chunks from disk, then the preloaded records (a parallel scan counts every shard) */
+    exec_sql(db, "DELETE FROM tst WHERE id = 1202;");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_stats_reset('%s', 'v');", tbl);
+    exec_sql(db, sql);
+    ASSERT(read_stats(db, tbl, st) == 0 && st[ST_SCANS] == 0 && st[ST_ROWS_SCANNED] == 0 && st[ST_KERNEL_NS] == 0, "vector_stats_reset(table, column)");
+
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'stats=1');", tbl, query, k);
+    collect_rows(db, sql, ids, dist, 64);
+    ASSERT(read_stats(db, tbl, st) == 0 && st[ST_ROWS_SCANNED] == n && st[ST_BYTES_TOUCHED] == (long long)n * dim && st[ST_CHUNKS_READ] >= 1 && st[ST_PRELOAD_MISSES] == 1 && st[ST_PRELOAD_HITS] == 0, "vector_stats: quantized scan of the chunks");
+    long long chunks = st[ST_CHUNKS_READ];
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'stats=1,threads=3');", tbl, query, k);
+    collect_rows(db, sql, ids, dist, 64);
+    ASSERT(read_stats(db, tbl, st) == 0 && st[ST_SCANS] == 2 && st[ST_ROWS_SCANNED] == 2 * n && st[ST_CHUNKS_READ] == chunks && st[ST_PRELOAD_HITS] == 1, "vector_stats: parallel scan of the preloaded records");
+
+    /* multi-query batch scan: every query compares every record */
+    snprintf(sql, sizeof(sql), "SELECT query_idx, id FROM vector_quantize_scan_batch('%s', 'v', '[%s, %s]', 2, %d, 'stats=1');", tbl, query, query, k);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == 2 * k, "vector_quantize_scan_batch with stats=1");
+    ASSERT(read_stats(db, tbl, st) == 0 && st[ST_SCANS] == 3 && st[ST_ROWS_SCANNED] == 4 * n && st[ST_PRELOAD_HITS] == 2, "vector_stats: batch scan");
+
+    /* stats=1 in vector_init: streaming scans (which take no options) are counted too */
+    exec_sql(db, "CREATE TABLE tst2 (id INTEGER PRIMARY KEY, v BLOB); INSERT INTO tst2 SELECT id, v FROM tst;");
+    snprintf(sql, sizeof(sql), "SELECT vector_init('tst2', 'v', 'type=f32,dimension=%d,stats=1');", dim);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM vector_full_scan('tst2', 'v', '%s');", query);
+    ASSERT(query_int(db, sql) == n, "streaming scan with stats=1 in vector_init");
+    ASSERT(read_stats(db, "tst2", st) == 0 && st[ST_SCANS] == 1 && st[ST_ROWS_SCANNED] == n && st[ST_ROWS_SKIPPED] == 2, "vector_stats: streaming scan");
+
+    exec_sql(db, "SELECT vector_stats_reset();");
+    ASSERT(read_stats(db, "tst2", st) == 0 && st[ST_SCANS] == 0 && read_stats(db, tbl, st) == 0 && st[ST_SCANS] == 0, "vector_stats_reset()");
+}
+
+/* ---------- Test: parallel quantization build and sampled calibration ---------- */
+
+/* FNV-1a digest of every quantized chunk of tbl.v (bounds, counter, codes and list); 0 on error. */
+static unsigned long long quant_digest(sqlite3 *db, const char *tbl) {
+    char sql[512];
+    snprintf(sql, sizeof(sql), "SELECT rowid1, rowid2, counter, data, ifnull(list, -1) FROM vector0_%s_v ORDER BY ifnull(list, -1), rowid1;", tbl);
+    sqlite3_stmt *stmt = NULL;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) return 0;
+    unsigned long long h = 1469598103934665603ULL;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        long long header[4] = {sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2), sqlite3_column_int64(stmt, 4)};
+        const unsigned char *bytes = (const unsigned char *)header;
+        for (size_t i = 0; i < sizeof(header); i++) h = (h ^ bytes[i]) * 1099511628211ULL;
+        bytes = (const unsigned char *)sqlite3_column_blob(stmt, 3);
+        int len = sqlite3_column_bytes(stmt, 3);
+        for (int i = 0; i < len; i++) h = (h ^ bytes[i]) * 1099511628211ULL;
+    }
+    sqlite3_finalize(stmt);
+    return h;
+}
+
+static void test_parallel_quantize(sqlite3 *db) {
+    const char *tbl = "tpq";
+    const int n = 3000, dim = 16, k = 10;
+    char sql[2048], msg[256], query[1024];
+    long long ref_ids[64], ids[64];
+    double ref_dist[64], dist[64];
+
+    printf("\n=== parallel quantization build ===\n");
+    rnd_state = 6161;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "parallel quantize setup");
+        return;
+    }
+    exec_sql(db, "INSERT INTO tpq (id, v) VALUES (3001, NULL);");
+
+    /* every build must write the same chunks whatever the number of workers (max_memory=16800 is 700 records per chunk) */
+    const char *builds[] = {"qtype=UINT8", "qtype=INT8,max_memory=16800", "qtype=UINT8,calibration=dimension,percentile=99", "qtype=1BIT", "qtype=PQ,pq_m=4", "qtype=INT8,index=ivf,nlist=8"};
+    for (int b = 0; b < 6; b++) {
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s,threads=1');", tbl, builds[b]);
+        long long count = query_int(db, sql);
+        unsigned long long ref = quant_digest(db, tbl);
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s,threads=4');", tbl, builds[b]);
+        long long count4 = query_int(db, sql);
+        snprintf(msg, sizeof(msg), "vector_quantize with threads=4 writes the same chunks as threads=1 (%s)", builds[b]);
+        ASSERT(count == n && count4 == n && ref != 0 && quant_digest(db, tbl) == ref, msg);
+    }
+
+    /* calib_sample: calibration reads a random subset, every row is still quantized */
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+    const char *sampled[] = {"qtype=UINT8,calib_sample=300", "qtype=UINT8,calibration=dimension,calib_sample=300,threads=4", "qtype=INT8,index=ivf,nlist=8,calib_sample=500"};
+    for (int b = 0; b < 3; b++) {
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, sampled[b]);
+        long long count = query_int(db, sql);
+        snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=8');", tbl, query, k);
+        int found = collect_rows(db, sql, ids, dist, 64), overlap = 0;
+        for (int i = 0; i < found; i++) for (int j = 0; j < nref; j++) if (ids[i] == ref_ids[j]) overlap++;
+        snprintf(msg, sizeof(msg), "vector_quantize with %s (%d/%d of the exact neighbors)", sampled[b], overlap, k);
+        ASSERT(count == n && found == k && overlap >= k - 3, msg);
+    }
+
+    /* a sample at least as large as the table is a full pass */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8');", tbl);
+    exec_sql(db, sql);
+    unsigned long long ref = quant_digest(db, tbl);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,calib_sample=%d');", tbl, n + 1);
+    exec_sql(db, sql);
+    ASSERT(quant_digest(db, tbl) == ref, "calib_sample larger than the table matches a full calibration");
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'calib_sample=-1');", tbl);
+    ASSERT(sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK, "invalid calib_sample is rejected");
+}
+
+/* ---------- Test: SIMD quantize kernels ---------- */
+
+extern quantize_functions dispatch_quantize_table;
+
+/* Random float32 component: mostly in [-4, 4], with exact rounding ties and special values mixed in. */
+static float quantize_test_value(void) {
+    float r = rnd_float();
+    unsigned int pick = (rnd_state >> 4) % 16;
+    if (pick == 0) return (float)((int)(r * 600.0f)) * 0.5f;       /* x.5 ties once scaled by 1 */
+    if (pick == 1) return (r < 0.0f) ? -1.0e30f : 1.0e30f;
+    if (pick == 2) return (r < 0.0f) ? -INFINITY : INFINITY;
+    if (pick == 3) return (r < 0.0f) ? NAN : -0.0f;
+    return r * 4.0f;
+}
+
+/* Runs every kernel of table on the same inputs; out must hold 8 * 1100 bytes. */
+static void quantize_test_run(const quantize_functions *table, const float *v, const uint8_t *bytes, const float *offsets, const float *scales, int n, uint8_t *out) {
+    memset(out, 0xA5, 8 * 1100);
+    table->f32_to_u8(v, out, -0.75f, 31.5f, n);
+    table->f32_to_s8(v, out + 1100, 0.25f, 1.0f, n);
+    table->f32_to_u8_dims(v, out + 2 * 1100, offsets, scales, n);
+    table->f32_to_s8_dims(v, out + 3 * 1100, offsets, scales, n);
+    table->f32_to_bit(v, out + 4 * 1100, 0.0f, n);
+    table->f32_to_bit(v, out + 5 * 1100, 0.5f, n);
+    table->u8_to_bit(bytes, out + 6 * 1100, n);
+    table->i8_to_bit(bytes, out + 7 * 1100, n);
+}
+
+/* The dispatched kernels of the native backend must write the bytes of the portable CPU ones (and nothing past them). */
+static void test_quantize_kernels(void) {
+    static float v[1100], offsets[1100], scales[1100];
+    static uint8_t bytes[1100], ref[8 * 1100], out[8 * 1100];
+    const int sizes[] = {1, 3, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 127, 255, 768, 1029};
+    char msg[256];
+
+    printf("\n=== SIMD quantize kernels ===\n");
+    rnd_state = 8118;
+    for (int i = 0; i < 1100; i++) {
+        v[i] = quantize_test_value();
+        offsets[i] = rnd_float();
+        scales[i] = 16.0f + 48.0f * (rnd_float() + 1.0f);
+        bytes[i] = (uint8_t)(rnd_state >> 9);
+    }
+
+    init_distance_functions(true);
+    quantize_functions cpu = dispatch_quantize_table;
+    init_distance_functions(false);
+    quantize_functions native = dispatch_quantize_table;
+
+    int mismatches = 0, first = -1;
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        int n = sizes[s];
+        quantize_test_run(&cpu, v, bytes, offsets, scales, n, ref);
+        quantize_test_run(&native, v, bytes, offsets, scales, n, out);
+        if (memcmp(ref, out, sizeof(ref)) != 0) {
+            mismatches++;
+            if (first < 0) first = n;
+        }
+    }
+    snprintf(msg, sizeof(msg), "quantize kernels match the CPU ones bit for bit (%d sizes differ, first n=%d)", mismatches, first);
+    ASSERT(mismatches == 0, msg);
+
+    /* spot checks of the reference kernels: rounding half away from zero, saturation and LSB first packing */
+    const float sample[8] = {0.5f, -0.5f, 1.49f, -2.5f, 300.0f, -300.0f, NAN, INFINITY};
+    uint8_t q[8];
+    cpu.f32_to_s8(sample, q, 0.0f, 1.0f, 6);
+    ASSERT((int8_t)q[0] == 1 && (int8_t)q[1] == -1 && (int8_t)q[2] == 1 && (int8_t)q[3] == -3 && (int8_t)q[4] == 127 && (int8_t)q[5] == -128, "f32_to_s8 rounds half away from zero and saturates");
+    const float unit[8] = {1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f, 1.0f}, zero[8] = {0};
+    cpu.f32_to_u8_dims(sample, q, zero, unit, 8);
+    ASSERT(q[0] == 1 && q[1] == 0 && q[4] == 255 && q[5] == 0 && q[6] == 0 && q[7] == 255, "f32_to_u8_dims saturates NaN and infinities");
+    cpu.f32_to_bit(sample, q, 0.0f, 8);
+    ASSERT(q[0] == 0x95, "f32_to_bit packs LSB first");
+}
+
+/* ---------- Test: distance constraints pushed into streaming scans ---------- */
+
+/* A streaming scan restricted by distance < or <= must return exactly the rows SQLite keeps when the
+   constraint stays out of the scan (unary +), including the rows tied with the bound. */
+static void test_stream_distance(sqlite3 *db) {
+    const int n = 700, dim = 8;
+    const char *modules[][3] = {
+        {"tsd", "vector_full_scan", ""},
+        {"tsd_u8", "vector_full_scan", ""},
+        {"tsd", "vector_quantize_scan", "qtype=UINT8"},
+        {"tsd", "vector_quantize_scan", "qtype=1BIT"},
+        {"tsd", "vector_quantize_scan", "qtype=INT8,auto_update=1"},
+    };
+    const char *filters[] = {"distance < %.17g", "distance <= %.17g", "distance <= %.17g AND distance < 1e30 AND rowid > 200", "distance < NULL", "distance < 'text'", "distance <= 0"};
+    const int nmodules = (int)(sizeof(modules) / sizeof(modules[0]));
+    const int nfilters = (int)(sizeof(filters) / sizeof(filters[0]));
+    char sql[4096], msg[512], query[1024], json[1024], cond[256], ref_cond[300];
+    static long long ref_ids[1024], ids[1024];
+    static double ref_dist[1024], dist[1024];
+
+    printf("\n=== distance constraints in streaming scans ===\n");
+    rnd_state = 2424;
+    if (setup_random_table(db, "tsd", "L2", dim, n) != 0) {
+        ASSERT(0, "stream distance setup");
+        return;
+    }
+    
+    /* UINT8 vectors use the batch distance kernels */
+    exec_sql(db, "CREATE TABLE tsd_u8 (id INTEGER PRIMARY KEY, v BLOB);");
+    exec_sql(db, "BEGIN;");
+    for (int i = 0; i < n; i++) {
+        int off = snprintf(json, sizeof(json), "[");
+        for (int j = 0; j < dim; j++) off += snprintf(json + off, sizeof(json) - off, "%s%d", j ? ", " : "", (int)((rnd_float() + 1.0f) * 127.0f));
+        snprintf(json + off, sizeof(json) - off, "]");
+        snprintf(sql, sizeof(sql), "INSERT INTO tsd_u8 (id, v) VALUES (%d, vector_as_u8('%s'));", i + 1, json);
+        exec_sql(db, sql);
+    }
+    exec_sql(db, "COMMIT;");
+    exec_sql(db, "SELECT vector_init('tsd_u8', 'v', 'type=u8,dimension=8,distance=L2');");
+    rnd_json(query, sizeof(query), dim);
+
+    for (int m = 0; m < nmodules; m++) {
+        const char *tbl = modules[m][0];
+        int quantized = (modules[m][2][0] != 0);
+        char vec[1200];
+        if (strcmp(tbl, "tsd_u8") == 0) snprintf(vec, sizeof(vec), "vector_as_u8('%s')", json);
+        else snprintf(vec, sizeof(vec), "'%s'", query);
+        if (quantized) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, modules[m][2]);
+            exec_sql(db, sql);
+            if (strstr(modules[m][2], "auto_update")) {
+                snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE id %% 5 = 0; UPDATE %s SET v = vector_as_f32('%s') WHERE id = 42;", tbl, tbl, query);
+                exec_sql(db, sql);
+            }
+        }
+        for (int preload = 0; preload < 1 + quantized; preload++) {
+            if (preload) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                exec_sql(db, sql);
+            }
+            
+            /* the bound is the distance of the 50th nearest row, so <= keeps the rows tied with it */
+            double bound = -1.0;
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', %s) ORDER BY distance LIMIT 1 OFFSET 49;", modules[m][1], tbl, vec);
+            if (collect_rows(db, sql, ref_ids, ref_dist, 1) == 1) bound = ref_dist[0];
+            
+            for (int f = 0; f < nfilters; f++) {
+                snprintf(cond, sizeof(cond), filters[f], bound);
+                snprintf(ref_cond, sizeof(ref_cond), "+%s", cond);
+                for (char *p = strstr(ref_cond, " AND "); p; p = strstr(p + 1, " AND ")) {
+                    memmove(p + 6, p + 5, strlen(p + 5) + 1);
+                    p[5] = '+';
+                }
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', %s) WHERE %s ORDER BY rowid;", modules[m][1], tbl, vec, ref_cond);
+                int nref = collect_rows(db, sql, ref_ids, ref_dist, 1024);
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM %s('%s', 'v', %s) WHERE %s ORDER BY rowid;", modules[m][1], tbl, vec, cond);
+                int count = collect_rows(db, sql, ids, dist, 1024);
+                snprintf(msg, sizeof(msg), "%s %s %s%s: %.60s", modules[m][1], tbl, modules[m][2], preload ? " (preload)" : "", cond);
+                ASSERT(bound >= 0.0 && count == nref && (nref == 0 || same_rows(ids, dist, count, ref_ids, ref_dist, nref)), msg);
+            }
+        }
+        if (strstr(modules[m][2], "auto_update")) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize_cleanup('%s', 'v');", tbl);
+            exec_sql(db, sql);
+        }
+    }
+
+    /* the streaming cursor is filtered again for every row of the outer table */
+    exec_sql(db, "CREATE TABLE tsd_q (v BLOB); INSERT INTO tsd_q SELECT v FROM tsd WHERE id IN (3, 301, 601);");
+    long long joined = query_int(db, "SELECT count(*) FROM tsd_q, vector_full_scan('tsd', 'v', tsd_q.v) WHERE distance < 1.5;");
+    long long separate = query_int(db, "SELECT (SELECT count(*) FROM vector_full_scan('tsd', 'v', (SELECT v FROM tsd WHERE id = 3)) WHERE +distance < 1.5)"
+                                       " + (SELECT count(*) FROM vector_full_scan('tsd', 'v', (SELECT v FROM tsd WHERE id = 301)) WHERE +distance < 1.5)"
+                                       " + (SELECT count(*) FROM vector_full_scan('tsd', 'v', (SELECT v FROM tsd WHERE id = 601)) WHERE +distance < 1.5);");
+    snprintf(msg, sizeof(msg), "correlated streaming scans restart for each outer row (%lld vs %lld rows)", joined, separate);
+    ASSERT(separate > 3 && joined == separate, msg);
+
+    /* the plan hands the constraint to the scan (idxStr 'd' for <, 'D' for <=) */
+    sqlite3_stmt *stmt = NULL;
+    int pushed = 0;
+    if (sqlite3_prepare_v2(db, "EXPLAIN QUERY PLAN SELECT rowid FROM vector_full_scan('tsd', 'v', '[0, 0, 0, 0, 0, 0, 0, 0]') WHERE distance <= 1.0;", -1, &stmt, NULL) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) pushed |= (strstr((const char *)sqlite3_column_text(stmt, 3), ":D") != NULL);
+        sqlite3_finalize(stmt);
+    }
+    ASSERT(pushed, "distance <= is pushed into the streaming scan");
+}
+
+/* ---------- Test: cascaded 1BIT -> 8-bit quantized search ---------- */
+
+/* With cascade large enough for every row to be a candidate, the cascade must return exactly the rows of the
+   direct scan of the 8-bit codes (cascade=0); smaller factors must still find most of the exact neighbors. */
+static void test_quantize_cascade(sqlite3 *db) {
+    const char *tbl = "tcas";
+    const int n = 2000, dim = 32, k = 10;
+    const char *builds[] = {"qtype=UINT8,cascade=8", "qtype=INT8,calibration=dimension,cascade=8,threads=4", "qtype=UINT8,calibration=global,index=ivf,nlist=16,cascade=8", "qtype=INT8,index=none,cascade=8,auto_update=1"};
+    const char *scans[] = {"", "nprobe=4", "threads=4", "rerank=3"};
+    const int nbuilds = (int)(sizeof(builds) / sizeof(builds[0]));
+    const int nscans = (int)(sizeof(scans) / sizeof(scans[0]));
+    char sql[4096], msg[256], query[1024], options[64];
+    long long ref_ids[64], ids[64], exact_ids[64];
+    double ref_dist[64], dist[64], exact_dist[64];
+
+    printf("\n=== cascaded quantized search ===\n");
+    rnd_state = 2525;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "cascade setup");
+        return;
+    }
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    int nexact = collect_rows(db, sql, exact_ids, exact_dist, 64);
+
+    /* both levels live in the same records: one rowid per record, dim/8 more bytes per code */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_memory('%s', 'v');", tbl);
+    long long plain = query_int(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,cascade=8');", tbl);
+    long long count = query_int(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_memory('%s', 'v');", tbl);
+    long long cascaded = query_int(db, sql);
+    snprintf(msg, sizeof(msg), "cascade adds the 1BIT codes to the records (%lld -> %lld bytes)", plain, cascaded);
+    ASSERT(count == n && cascaded - plain == (long long)n * (dim / 8), msg);
+    snprintf(sql, sizeof(sql), "SELECT value FROM _sqliteai_vector WHERE tblname = '%s' AND colname = 'v' AND key = 'cascade';", tbl);
+    ASSERT(query_int(db, sql) == 8, "the cascade factor is saved with the quantization");
+
+    for (int b = 0; b < nbuilds; b++) {
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, builds[b]);
+        exec_sql(db, sql);
+        if (strstr(builds[b], "auto_update")) {
+            snprintf(sql, sizeof(sql), "DELETE FROM %s WHERE id %% 9 = 0; UPDATE %s SET v = vector_as_f32('%s') WHERE id = 77;", tbl, tbl, query);
+            exec_sql(db, sql);
+        }
+        for (int preload = 0; preload < 2; preload++) {
+            if (preload) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                exec_sql(db, sql);
+            }
+            for (int q = 0; q < nscans; q++) {
+                snprintf(options, sizeof(options), "%s%s", scans[q][0] ? "," : "", scans[q]);
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'cascade=0%s');", tbl, query, k, options);
+                int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'cascade=%d%s');", tbl, query, k, n / k, options);
+                int found = collect_rows(db, sql, ids, dist, 64);
+                snprintf(msg, sizeof(msg), "cascade over every row matches the 8-bit scan (%s, %s%s)", builds[b], scans[q][0] ? scans[q] : "default", preload ? ", preload" : "");
+                ASSERT(nref == k && same_rows(ids, dist, found, ref_ids, ref_dist, nref), msg);
+                
+                snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d%s%s%s);", tbl, query, k, scans[q][0] ? ", '" : "", scans[q], scans[q][0] ? "'" : "");
+                found = collect_rows(db, sql, ids, dist, 64);
+                int overlap = count_common_ids(ids, found, exact_ids, nexact);
+                snprintf(msg, sizeof(msg), "cascade=8 keeps %d/%d exact neighbors (%s, %s%s)", overlap, k, builds[b], scans[q][0] ? scans[q] : "default", preload ? ", preload" : "");
+                ASSERT(found == k && overlap >= k / 2, msg);
+            }
+        }
+        if (strstr(builds[b], "auto_update")) {
+            snprintf(sql, sizeof(sql), "SELECT vector_quantize_cleanup('%s', 'v');", tbl);
+            exec_sql(db, sql);
+        }
+    }
+
+    /* rowid constraints restrict the candidates of the first pass */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,cascade=4');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM vector_quantize_scan('%s', 'v', '%s', %d) WHERE rowid > 1500 AND rowid %% 2 = 0;", tbl, query, k);
+    long long filtered = query_int(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM vector_quantize_scan('%s', 'v', '%s', %d) WHERE rowid BETWEEN 1995 AND 1997;", tbl, query, k);
+    ASSERT(filtered > 0 && filtered <= k && query_int(db, sql) == 3, "cascade with rowid constraints");
+
+    /* streaming and batch scans compare the 8-bit level */
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'cascade=0');", tbl, query, k);
+    int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan_stream('%s', 'v', '%s') ORDER BY distance, rowid LIMIT %d;", tbl, query, k);
+    int found = collect_rows(db, sql, ids, dist, 64);
+    ASSERT(nref == k && same_rows(ids, dist, found, ref_ids, ref_dist, nref), "streaming scan of a cascaded quantization");
+    snprintf(sql, sizeof(sql), "SELECT id, distance FROM vector_quantize_scan_batch('%s', 'v', '[%s]', 1, %d);", tbl, query, k);
+    found = collect_rows(db, sql, ids, dist, 64);
+    ASSERT(same_rows(ids, dist, found, ref_ids, ref_dist, nref), "batch scan of a cascaded quantization");
+
+    /* cascade is ignored by 1BIT codes, and a new quantization without it drops the 1BIT level */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=1BIT');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM vector_quantize_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    ASSERT(query_int(db, sql) == k, "cascade is ignored by 1BIT quantization");
+    snprintf(sql, sizeof(sql), "SELECT count(*) FROM %s;", tbl);
+    size_t rows = (size_t)query_int(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT8,cascade=0');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_memory('%s', 'v');", tbl);
+    ASSERT(query_int(db, sql) == (long long)vector_chunk_bytes(VECTOR_CHUNK_FORMAT_SPLIT, rows, (size_t)dim), "cascade=0 quantizes without the 1BIT level");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'cascade=-1');", tbl);
+    ASSERT(sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK, "invalid cascade factor is rejected");
+}
+
+/* ---------- Test: 4-bit quantization ---------- */
+
+extern distance_function_t dispatch_distance_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+extern distance_batch_function_t dispatch_distance_batch_table[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+
+/* UINT4/INT4 codes: the native kernels must return the distances of the CPU ones, the codes take half a byte
+   per dimension and the scans of every layout keep most of the exact neighbors. */
+static void test_quantize_4bit(sqlite3 *db) {
+    static uint8_t codes[5 * 160], bytes[2 * 320];
+    static distance_function_t cpu[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+    static distance_batch_function_t cpu_batch[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+    const int sizes[] = {1, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 129, 160};
+    const int distances[] = {VECTOR_DISTANCE_L2, VECTOR_DISTANCE_SQUARED_L2, VECTOR_DISTANCE_COSINE, VECTOR_DISTANCE_DOT, VECTOR_DISTANCE_L1};
+    const int types[] = {VECTOR_TYPE_U4, VECTOR_TYPE_I4};
+    const char *tbl = "tq4";
+    const int n = 2000, dim = 37, k = 10;
+    const char *builds[] = {"qtype=UINT4", "qtype=INT4", "qtype=4BIT,calibration=dimension", "qtype=INT4,index=ivf,nlist=16", "qtype=UINT4,threads=4"};
+    const int nbuilds = (int)(sizeof(builds) / sizeof(builds[0]));
+    char sql[4096], msg[256], query[1024];
+    long long ids[64], ref_ids[64], exact_ids[64];
+    double dist[64], ref_dist[64], exact_dist[64];
+
+    printf("\n=== 4-bit quantization ===\n");
+    rnd_state = 2626;
+    for (int i = 0; i < (int)sizeof(codes); i++) {
+        rnd_float();
+        codes[i] = (uint8_t)(rnd_state >> 9);
+    }
+
+    init_distance_functions(true);
+    memcpy(cpu, dispatch_distance_table, sizeof(cpu));
+    memcpy(cpu_batch, dispatch_distance_batch_table, sizeof(cpu_batch));
+    init_distance_functions(false);
+
+    /* every candidate of a batch (160 bytes apart) and the single pair kernels, exact integer sums on every backend */
+    int mismatches = 0, first = -1;
+    for (int d = 0; d < 5; d++) {
+        for (int t = 0; t < 2; t++) {
+            distance_function_t ref_fn = cpu[distances[d]][types[t]];
+            distance_function_t fn = dispatch_distance_table[distances[d]][types[t]];
+            distance_batch_function_t ref_batch_fn = cpu_batch[distances[d]][types[t]];
+            distance_batch_function_t batch_fn = dispatch_distance_batch_table[distances[d]][types[t]];
+            for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                float ref[4], out[4];
+                int size = sizes[s];
+                ref_batch_fn(codes, codes + 160, 160, 4, size, ref);
+                if (batch_fn) batch_fn(codes, codes + 160, 160, 4, size, out);
+                else for (int c = 0; c < 4; c++) out[c] = fn(codes, codes + 160 * (c + 1), size);
+                int same = (memcmp(ref, out, sizeof(ref)) == 0);
+                for (int c = 0; c < 4; c++) same = same && (fn(codes, codes + 160 * (c + 1), size) == ref[c]) && (ref_fn(codes, codes + 160 * (c + 1), size) == ref[c]);
+                if (!same) {
+                    mismatches++;
+                    if (first < 0) first = size;
+                }
+            }
+        }
+    }
+    snprintf(msg, sizeof(msg), "4-bit kernels match the CPU ones (%d differ, first n=%d)", mismatches, first);
+    ASSERT(mismatches == 0, msg);
+
+    /* the low nibble holds the first code: the same distances as the unpacked 8-bit codes */
+    for (int i = 0; i < 320; i++) {
+        uint8_t a = (codes[i / 2] >> ((i % 2) * 4)) & 0x0F, b = (codes[160 + i / 2] >> ((i % 2) * 4)) & 0x0F;
+        bytes[i] = a;
+        bytes[320 + i] = b;
+    }
+    float packed = cpu[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U4](codes, codes + 160, 160);
+    float unpacked = cpu[VECTOR_DISTANCE_SQUARED_L2][VECTOR_TYPE_U8](bytes, bytes + 320, 320);
+    for (int i = 0; i < 2 * 320; i++) bytes[i] = (uint8_t)(((bytes[i] ^ 8) - 8) & 0xFF);
+    float packed_dot = cpu[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I4](codes, codes + 160, 160);
+    float unpacked_dot = cpu[VECTOR_DISTANCE_DOT][VECTOR_TYPE_I8](bytes, bytes + 320, 320);
+    ASSERT(packed == unpacked && packed_dot == unpacked_dot, "packed codes decode like UINT8 and INT8 codes");
+
+    rnd_state = 4242;
+    if (setup_random_table(db, tbl, "L2", dim, n) != 0) {
+        ASSERT(0, "4-bit setup");
+        return;
+    }
+    rnd_json(query, sizeof(query), dim);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_full_scan('%s', 'v', '%s', %d);", tbl, query, k);
+    int nexact = collect_rows(db, sql, exact_ids, exact_dist, 64);
+
+    /* (dim + 1) / 2 bytes per code, 4BIT picks INT4 codes for data with negative values, cascade is ignored */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT4,cascade=8');", tbl);
+    long long count = query_int(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_memory('%s', 'v');", tbl);
+    ASSERT(count == n && query_int(db, sql) == (long long)vector_chunk_bytes(VECTOR_CHUNK_FORMAT_SPLIT, (size_t)n, (size_t)(dim + 1) / 2), "4-bit codes take half a byte per dimension");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=4BIT,cascade=0');", tbl);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT value FROM _sqliteai_vector WHERE tblname = '%s' AND colname = 'v' AND key = 'qtype';", tbl);
+    ASSERT(query_int(db, sql) == VECTOR_QUANT_S4BIT, "4BIT picks INT4 codes for negative values");
+
+    for (int b = 0; b < nbuilds; b++) {
+        snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', '%s');", tbl, builds[b]);
+        exec_sql(db, sql);
+        const char *scan = strstr(builds[b], "threads") ? "rerank=4" : "nprobe=16";
+        for (int preload = 0; preload < 2; preload++) {
+            if (preload) {
+                snprintf(sql, sizeof(sql), "SELECT vector_quantize_preload('%s', 'v');", tbl);
+                exec_sql(db, sql);
+            }
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, '%s');", tbl, query, k, scan);
+            int found = collect_rows(db, sql, ids, dist, 64);
+            int overlap = count_common_ids(ids, found, exact_ids, nexact);
+            snprintf(msg, sizeof(msg), "4-bit scan keeps %d/%d exact neighbors (%s%s)", overlap, k, builds[b], preload ? ", preload" : "");
+            ASSERT(found == k && overlap >= k / 2, msg);
+
+            /* the streaming scan compares the same codes */
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', %d, 'nprobe=16,rerank=0');", tbl, query, k);
+            int nref = collect_rows(db, sql, ref_ids, ref_dist, 64);
+            snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan_stream('%s', 'v', '%s') ORDER BY distance, rowid LIMIT %d;", tbl, query, k);
+            found = collect_rows(db, sql, ids, dist, 64);
+            snprintf(msg, sizeof(msg), "4-bit streaming scan matches the top-k scan (%s%s)", builds[b], preload ? ", preload" : "");
+            ASSERT(nref == k && same_rows(ids, dist, found, ref_ids, ref_dist, nref), msg);
+        }
+    }
+    /* incremental updates quantize the new rows the same way */
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=INT4,calibration=global,index=none,auto_update=1'); INSERT INTO %s (id, v) VALUES (%d, vector_as_f32('%s'));", tbl, tbl, n + 1, query);
+    exec_sql(db, sql);
+    snprintf(sql, sizeof(sql), "SELECT rowid, distance FROM vector_quantize_scan('%s', 'v', '%s', 1);", tbl, query);
+    ASSERT(collect_rows(db, sql, ids, dist, 64) == 1 && ids[0] == n + 1 && dist[0] == 0.0, "auto_update adds 4-bit codes");
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize_cleanup('%s', 'v');", tbl);
+    exec_sql(db, sql);
+
+    snprintf(sql, sizeof(sql), "SELECT vector_quantize('%s', 'v', 'qtype=UINT2');", tbl);
+    ASSERT(sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK, "unknown quantization type is rejected");
+}
+
+/* ---------- Test: 8-bit kernels on the native backend ---------- */
+/* the UINT8/INT8 and BIT hamming kernels of the active backend (AVX512-VNNI reworks dot, L2 and cosine around vpdpbusd,
+   NEON-DOTPROD and SVE around udot/sdot) must give the exact integer sums of the CPU batch kernels, for random codes
+   and codes at the ends of the ranges (the CPU single pair kernels accumulate in float and only agree up to rounding
+   on long vectors). On aarch64 the SVE and dotprod tiers can be run under QEMU user mode, see the Makefile */
+
+static void test_integer_kernels(sqlite3 *db) {
+    enum { STRIDE = 4096 };
+    static uint8_t codes[5 * STRIDE];
+    static distance_function_t cpu[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+    static distance_batch_function_t cpu_batch[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+    const int sizes[] = {1, 3, 31, 32, 33, 63, 64, 65, 127, 128, 129, 300, 768, 1023, 4096};
+    const int kernels[][2] = {
+        {VECTOR_DISTANCE_L2, VECTOR_TYPE_U8}, {VECTOR_DISTANCE_SQUARED_L2, VECTOR_TYPE_U8}, {VECTOR_DISTANCE_COSINE, VECTOR_TYPE_U8},
+        {VECTOR_DISTANCE_DOT, VECTOR_TYPE_U8}, {VECTOR_DISTANCE_L1, VECTOR_TYPE_U8},
+        {VECTOR_DISTANCE_L2, VECTOR_TYPE_I8}, {VECTOR_DISTANCE_SQUARED_L2, VECTOR_TYPE_I8}, {VECTOR_DISTANCE_COSINE, VECTOR_TYPE_I8},
+        {VECTOR_DISTANCE_DOT, VECTOR_TYPE_I8}, {VECTOR_DISTANCE_L1, VECTOR_TYPE_I8},
+        {VECTOR_DISTANCE_HAMMING, VECTOR_TYPE_BIT}
+    };
+    const uint8_t fills[] = {0x00, 0x7F, 0x80, 0xFF};
+    char msg[256];
+
+    printf("\n=== 8-bit and hamming kernels ===\n");
+
+    init_distance_functions(true);
+    memcpy(cpu, dispatch_distance_table, sizeof(cpu));
+    memcpy(cpu_batch, dispatch_distance_batch_table, sizeof(cpu_batch));
+    init_distance_functions(false);
+
+    int mismatches = 0, first = -1;
+    for (int pattern = 0; pattern < 5; pattern++) {
+        /* pattern 0: random codes, then every candidate and the query at one extreme against random or extreme codes */
+        rnd_state = 2727;
+        for (int i = 0; i < (int)sizeof(codes); i++) {
+            rnd_float();
+            codes[i] = (uint8_t)(rnd_state >> 9);
+        }
+        if (pattern > 0) {
+            memset(codes, fills[pattern - 1], STRIDE);
+            memset(codes + 3 * STRIDE, fills[pattern - 1], 2 * STRIDE);
+            memset(codes + 2 * STRIDE, fills[4 - pattern], STRIDE);
+        }
+        for (size_t kn = 0; kn < sizeof(kernels) / sizeof(kernels[0]); kn++) {
+            int d = kernels[kn][0], t = kernels[kn][1];
+            distance_function_t ref_fn = cpu[d][t];
+            distance_function_t fn = dispatch_distance_table[d][t];
+            distance_batch_function_t ref_batch_fn = cpu_batch[d][t];
+            distance_batch_function_t batch_fn = dispatch_distance_batch_table[d][t];
+            for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+                float ref[4], out[4];
+                int size = sizes[s];
+                ref_batch_fn(codes, codes + STRIDE, STRIDE, 4, size, ref);
+                if (batch_fn) batch_fn(codes, codes + STRIDE, STRIDE, 4, size, out);
+                else for (int c = 0; c < 4; c++) out[c] = fn(codes, codes + STRIDE * (c + 1), size);
+                int same = (memcmp(ref, out, sizeof(ref)) == 0);
+                for (int c = 0; c < 4; c++) {
+                    float single = ref_fn(codes, codes + STRIDE * (c + 1), size);
+                    same = same && (fn == ref_fn || fn(codes, codes + STRIDE * (c + 1), size) == ref[c]) && (fabsf(single - ref[c]) <= 1e-4f * (1.0f + fabsf(ref[c])));
+                }
+                if (!same) {
+                    mismatches++;
+                    if (first < 0) first = size;
+                }
+            }
+        }
+    }
+    snprintf(msg, sizeof(msg), "8-bit and hamming kernels match the CPU ones (%d differ, first n=%d)", mismatches, first);
+    ASSERT(mismatches == 0, msg);
+}
+
+/* ---------- Test: half precision kernels ---------- */
+/* FLOAT16/BFLOAT16 kernels run whole vectors without special value checks and fall back to the checked kernels
+   on a non-finite result: they agree with the CPU kernels up to rounding, also with an Inf (L2, L1, dot)
+   or a NaN (L2) in one vector, at the start, in the middle or in the tail */
+
+static int half_close(float ref, float out, int size) {
+    if (isnan(ref) || isnan(out)) return isnan(ref) && isnan(out);
+    if (isinf(ref) || isinf(out)) return ref == out;
+    return fabsf(ref - out) <= 1e-5f * ((float)size + fabsf(ref));
+}
+
+static void test_half_kernels(sqlite3 *db) {
+    static uint16_t a[1024], b[1024];
+    static distance_function_t cpu[VECTOR_DISTANCE_MAX][VECTOR_TYPE_MAX];
+    const int sizes[] = {1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 100, 768, 1023};
+    const int distances[] = {VECTOR_DISTANCE_L2, VECTOR_DISTANCE_SQUARED_L2, VECTOR_DISTANCE_COSINE, VECTOR_DISTANCE_DOT, VECTOR_DISTANCE_L1};
+    const int types[] = {VECTOR_TYPE_F16, VECTOR_TYPE_BF16};
+    const float specials[] = {INFINITY, -INFINITY, NAN};
+    char msg[256];
+
+    printf("\n=== Half precision kernels ===\n");
+
+    init_distance_functions(true);
+    memcpy(cpu, dispatch_distance_table, sizeof(cpu));
+    init_distance_functions(false);
+
+    int mismatches = 0, special_mismatches = 0;
+    for (int t = 0; t < 2; t++) {
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            int size = sizes[s];
+            rnd_state = 2828 + (uint32_t)size;
+            for (int i = 0; i < size; i++) {
+                float x = rnd_float() * 4.0f - 2.0f, y = rnd_float() * 4.0f - 2.0f;
+                a[i] = (types[t] == VECTOR_TYPE_F16) ? float32_to_float16(x) : float32_to_bfloat16(x);
+                b[i] = (types[t] == VECTOR_TYPE_F16) ? float32_to_float16(y) : float32_to_bfloat16(y);
+            }
+            for (int d = 0; d < 5; d++) {
+                distance_function_t ref_fn = cpu[distances[d]][types[t]];
+                distance_function_t fn = dispatch_distance_table[distances[d]][types[t]];
+                if (!half_close(ref_fn(a, b, size), fn(a, b, size), size)) mismatches++;
+
+                for (int k = 0; k < 3; k++) {
+                    if (distances[d] == VECTOR_DISTANCE_COSINE) continue;
+                    if (k == 2 && distances[d] != VECTOR_DISTANCE_L2 && distances[d] != VECTOR_DISTANCE_SQUARED_L2) continue;
+                    for (int where = 0; where < 3; where++) {
+                        int pos = (where == 0) ? 0 : (where == 1) ? size / 2 : size - 1;
+                        uint16_t saved = a[pos];
+                        a[pos] = (types[t] == VECTOR_TYPE_F16) ? float32_to_float16(specials[k]) : float32_to_bfloat16(specials[k]);
+                        if (!half_close(ref_fn(a, b, size), fn(a, b, size), size)) special_mismatches++;
+                        a[pos] = saved;
+                    }
+                }
+            }
+        }
+    }
+    snprintf(msg, sizeof(msg), "half precision kernels match the CPU ones (%d differ)", mismatches);
+    ASSERT(mismatches == 0, msg);
+    snprintf(msg, sizeof(msg), "half precision kernels match the CPU ones with Inf and NaN values (%d differ)", special_mismatches);
+    ASSERT(special_mismatches == 0, msg);
+}
+
 /* ---------- Main ---------- */
 
 int main(void) {
@@ -847,6 +3079,75 @@ int main(void) {
         test_distance_functions_hamming(db);
     }
 
+    /* 6. top-k collector */
+    test_topk_large_k(db);
+
+    /* 7. exact reranking */
+    test_quantize_rerank(db);
+
+    /* 8. IVF index */
+    test_quantize_ivf(db);
+
+    /* 9. HNSW index */
+    test_hnsw_scan(db);
+
+    /* 10. multi-threaded scan */
+    test_parallel_scan(db);
+
+    /* 11. product quantization */
+    test_quantize_pq(db);
+
+    /* 12. per-dimension calibration */
+    test_quantize_calibration(db);
+
+    /* 13. auto_update triggers */
+    test_auto_update(db);
+
+    /* 14. memory mapped preload */
+    test_preload_mmap(db);
+
+    /* 15. preloads shared across connections */
+    test_preload_shared();
+    test_auto_update_shared();
+
+    /* 16. split chunk format */
+    test_chunk_format();
+
+    /* 17. batch distance kernels */
+    test_batch_distance(db);
+
+    /* 18. normalized cosine and cached norms */
+    test_cosine_norms(db);
+
+    /* 19. multi-query batch scan */
+    test_quantize_scan_batch(db);
+
+    /* 20. rowid filter pushdown */
+    test_rowid_filter(db);
+
+    /* 21. scan statistics */
+    test_scan_stats(db);
+
+    /* 22. parallel quantization build */
+    test_parallel_quantize(db);
+
+    /* 23. SIMD quantize kernels */
+    test_quantize_kernels();
+
+    /* 24. distance constraints in streaming scans */
+    test_stream_distance(db);
+
+    /* 25. cascaded quantized search */
+    test_quantize_cascade(db);
+
+    /* 26. 4-bit quantization */
+    test_quantize_4bit(db);
+
+    /* 27. 8-bit kernels on the native backend */
+    test_integer_kernels(db);
+
+    /* 28. half precision kernels on the native backend */
+    test_half_kernels(db);
 
     sqlite3_close(db);
 